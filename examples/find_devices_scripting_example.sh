@@ -25,28 +25,21 @@ if ! command -v "$FIND_DEVICES" >/dev/null 2>&1; then
     exit 1
 fi
 
-# Find devices
-if ! $FIND_DEVICES -c $CONFIG_JSON -o $OUT_JSON --no-stdout; then
+# Find devices, and extract the counts and the first sound card and serial port
+# with a single invocation, the queries are printed as shell variable assignments
+# Adjust your configuration to always find one device
+if ! find_devices_output=$($FIND_DEVICES -c $CONFIG_JSON -o $OUT_JSON -q \
+    "audio_devices_count=.audio_devices | length;
+     serial_ports_count=.serial_ports | length;
+     audio_device=.audio_devices[0].plughw_id;
+     serial_port=.serial_ports[0].name;
+     audio_device_card_id=.audio_devices[0].card_id;
+     control_names=.audio_devices[0].controls[].name"); then
     echo "Failed to find devices"
     exit 1
 fi
 
-# Get counts and names
-audio_devices_count=$(jq ".audio_devices | length" $OUT_JSON)
-serial_ports_count=$(jq ".serial_ports | length" $OUT_JSON)
-# Pick the first sound card and serial port
-# Adjust your configuration to alwats find one device
-audio_device=$(jq -r .audio_devices[0].plughw_id $OUT_JSON)
-serial_port=$(jq -r .serial_ports[0].name $OUT_JSON)
-
-# Optional to convert the null values to empty
-# could also be done with jq, but null is nicer to work with that empty
-if [[ -z $audio_device ]]; then
-    audio_device=""
-fi
-if [[ -z $serial_port ]]; then
-    serial_port=""
-fi
+eval "$find_devices_output"
 
 echo "Audio devices count: \"$audio_devices_count\""
 echo "Serial ports count: \"$serial_ports_count\""
@@ -79,17 +72,13 @@ echo "Using: $audio_device"
 echo "Updating the soundcard in the \"direwolf.conf\" file with \"$audio_device\""
 sed -i "s/ADEVICE.*/ADEVICE $audio_device/" $DIREWOLF_CONFIG_FILE
 
-audio_device_card_id=$(jq -r .audio_devices[0].card_id $OUT_JSON)
-controls_count=$(jq ".audio_devices[0].controls | length" $OUT_JSON)
-for ((i = 0; i < $controls_count; i++)); do
-    control_name=$(jq -r .audio_devices[0].controls[$i].name $OUT_JSON)
-    control_value=$(jq -r .audio_devices[0].controls[$i].value $OUT_JSON)
-    control_type=$(jq -r .audio_devices[0].controls[$i].type $OUT_JSON)
-    
+echo "$control_names" | while IFS= read -r control_name; do
+    if [[ -z $control_name ]]; then
+        continue
+    fi
+
     echo
     echo "Control Name: $control_name"
-    echo "Value: $control_value"
-    echo "Type: $control_type"
     echo
 
     amixer -c "$audio_device_card_id" sset "$control_name" 100%
@@ -50,6 +50,26 @@
 #include "find_devices.hpp"
 
 #include <functional>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <new>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 
 #include <alsa/asoundlib.h>
 #include <libudev.h>
@@ -69,8 +89,6 @@
 //                                                                  //
 // **************************************************************** //
 
-void insert_tabs(std::string& s, int tabs, int tab_spaces = 4);
-
 void insert_tabs(std::string& s, int tabs, int tab_spaces)
 {
     std::string padded(tabs * tab_spaces, ' ');
@@ -93,17 +111,63 @@ void insert_tabs(std::string& s, int tabs, int tab_spaces)
     s = result;
 }
 
-namespace 
+bool try_write_file_atomically(const std::string& path, const std::string& content);
+
+bool try_write_file_atomically(const std::string& path, const std::string& content)
 {
-    std::string to_lower(const std::string& str)
+    // Write to a temporary file in the same directory and rename it over the destination,
+    // readers observe either the previous or the new file, never a missing or partial file
+
+    std::string temp_path = fmt::format("{}.{}.tmp", path, getpid());
+
+    mode_t mode = 0666;
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == 0)
     {
-        std::locale loc;
-        std::string s;
-        s.resize(str.size());
-        for (size_t i = 0; i < str.size(); i++)
-            s[i] = std::tolower(str[i], loc);
-        return s;
+        mode = file_stat.st_mode & 0777;
+    }
+
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < content.size())
+    {
+        ssize_t n = write(fd, content.data() + written, content.size() - written);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0)
+        {
+            close(fd);
+            unlink(temp_path.c_str());
+            return false;
+        }
+        written += (size_t)n;
+    }
+
+    bool synced = fsync(fd) == 0;
+
+    if (close(fd) != 0 || !synced || rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    // Make the rename durable
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int directory_fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory_fd >= 0)
+    {
+        fsync(directory_fd);
+        close(directory_fd);
     }
+
+    return true;
 }
 
 // **************************************************************** //
@@ -112,7 +176,7 @@ namespace
 //                                                                  //
 //                                                                  //
 //                                                                  //
-// AUDIO DEVICE                                                     //
+// METRICS                                                          //
 //                                                                  //
 //                                                                  //
 //                                                                  //
@@ -120,1177 +184,4847 @@ namespace
 //                                                                  //
 // **************************************************************** //
 
-audio_device_type operator|(const audio_device_type& l, const audio_device_type& r);
-audio_device_type operator&(const audio_device_type& l, const audio_device_type& r);
-bool enum_device_type_has_flag(const audio_device_type& deviceType, const audio_device_type& flag);
-bool try_parse_audio_device_type(const std::string& type_str, audio_device_type& type);
-bool try_parse_audio_device_channel_id(const std::string& channel_str, audio_device_channel_id& type);
-bool try_parse_audio_device_channel_display_name(const std::string& channel_str, audio_device_channel_id& type);
-std::string to_string(const audio_device_type& deviceType);
-std::string to_string(const audio_device_info& d);
-std::string to_string(const audio_device_channel_id& type);
-std::string to_json(const std::vector<audio_device_info>& devices);
-std::string to_json(const audio_device_info& d, bool wrapping_object, int tabs);
-std::vector<audio_device_info> get_audio_devices();
-std::vector<audio_device_info> get_audio_devices(int card_id);
-bool try_get_audio_device(int card_id, snd_ctl_t*& ctl_handle);
-bool try_get_audio_device(int card_id, int device_id, snd_ctl_t* ctl_handle, audio_device_info& device);
-bool try_get_audio_device(int card_id, int device_id, snd_ctl_t*& ctl_handle, snd_pcm_info_t*& pcm_info);
-bool can_use_audio_device(const audio_device_info& device, snd_pcm_stream_t mode);
-bool can_use_audio_device(const audio_device_info& device);
+metrics_counter& get_metrics_counter(std::string_view name, std::string_view label_name, std::string_view label_value);
+metrics_histogram& get_metrics_histogram(std::string_view name, std::string_view label_name, std::string_view label_value);
+void add_metrics_counter(metrics_counter& counter, uint64_t value);
+void record_metrics_histogram(metrics_histogram& histogram, uint64_t microseconds);
+std::string to_metrics_text();
+std::string to_metrics_labels(std::string_view label_name, std::string_view label_value);
+const alsa_card_metrics& get_alsa_card_metrics(int card_id);
 
-audio_device_type operator|(const audio_device_type& l, const audio_device_type& r)
+namespace
 {
-    return (audio_device_type)((int)l | (int)r);
-}
+    // Upper bounds of the histogram buckets in microseconds, the last bucket is +Inf
+    const std::array<uint64_t, metrics_histogram_bucket_count> metrics_histogram_bounds = {
+        10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+    };
+
+    // The series are kept in deques so that their addresses never change,
+    // the maps are ordered by name so that the series of a metric are rendered together
+    struct metrics_registry
+    {
+        std::mutex mutex;
+        std::deque<metrics_counter> counters;
+        std::deque<metrics_histogram> histograms;
+        std::map<std::string, metrics_counter*> counters_index;
+        std::map<std::string, metrics_histogram*> histograms_index;
+    };
+
+    metrics_registry& get_metrics_registry()
+    {
+        static metrics_registry registry;
+        return registry;
+    }
 
-audio_device_type operator&(const audio_device_type& l, const audio_device_type& r)
-{
-    return (audio_device_type)((int)l & (int)r);
+    // The per card series are resolved once, the slots cover the ALSA card indexes
+    // so that a card operation only loads a pointer before updating the atomics
+    const size_t alsa_card_metrics_slot_count = 32;
+
+    struct alsa_card_metrics_cache
+    {
+        std::mutex mutex;
+        std::deque<alsa_card_metrics> series;
+        std::map<int, const alsa_card_metrics*> index;
+        std::array<std::atomic<const alsa_card_metrics*>, alsa_card_metrics_slot_count> slots {};
+    };
+
+    alsa_card_metrics_cache& get_alsa_card_metrics_cache()
+    {
+        static alsa_card_metrics_cache cache;
+        return cache;
+    }
 }
 
-bool enum_device_type_has_flag(const audio_device_type& deviceType, const audio_device_type& flag)
+std::string to_metrics_labels(std::string_view label_name, std::string_view label_value)
 {
-    return (deviceType & flag) != (audio_device_type)0;
+    if (label_name.empty())
+    {
+        return "";
+    }
+    return fmt::format("{}=\"{}\"", label_name, label_value);
 }
 
-bool try_parse_audio_device_type(const std::string& type_str, audio_device_type& type)
+metrics_counter& get_metrics_counter(std::string_view name, std::string_view label_name, std::string_view label_value)
 {
-    bool result = true;
-    if (type_str == "playback")
+    metrics_registry& registry = get_metrics_registry();
+
+    std::string labels = to_metrics_labels(label_name, label_value);
+    std::string key = fmt::format("{}{{{}}}", name, labels);
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto it = registry.counters_index.find(key);
+    if (it != registry.counters_index.end())
     {
-        type = audio_device_type::playback;
+        return *it->second;
     }
-    else if (type_str == "capture")
+
+    metrics_counter& counter = registry.counters.emplace_back();
+    counter.name = name;
+    counter.labels = labels;
+    registry.counters_index.emplace(key, &counter);
+
+    return counter;
+}
+
+metrics_histogram& get_metrics_histogram(std::string_view name, std::string_view label_name, std::string_view label_value)
+{
+    metrics_registry& registry = get_metrics_registry();
+
+    std::string labels = to_metrics_labels(label_name, label_value);
+    std::string key = fmt::format("{}{{{}}}", name, labels);
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto it = registry.histograms_index.find(key);
+    if (it != registry.histograms_index.end())
     {
-        type = audio_device_type::capture;
+        return *it->second;
     }
-    else if (type_str == "uknown")
+
+    metrics_histogram& histogram = registry.histograms.emplace_back();
+    histogram.name = name;
+    histogram.labels = labels;
+    registry.histograms_index.emplace(key, &histogram);
+
+    return histogram;
+}
+
+void add_metrics_counter(metrics_counter& counter, uint64_t value)
+{
+    counter.value.fetch_add(value, std::memory_order_relaxed);
+}
+
+void record_metrics_histogram(metrics_histogram& histogram, uint64_t microseconds)
+{
+    size_t bucket = std::lower_bound(metrics_histogram_bounds.begin(), metrics_histogram_bounds.end(), microseconds) - metrics_histogram_bounds.begin();
+    histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram.sum_microseconds.fetch_add(microseconds, std::memory_order_relaxed);
+}
+
+const alsa_card_metrics& get_alsa_card_metrics(int card_id)
+{
+    alsa_card_metrics_cache& cache = get_alsa_card_metrics_cache();
+
+    bool has_slot = card_id >= 0 && (size_t)card_id < alsa_card_metrics_slot_count;
+    if (has_slot)
     {
-        type = audio_device_type::uknown;
+        const alsa_card_metrics* metrics = cache.slots[card_id].load(std::memory_order_acquire);
+        if (metrics != nullptr)
+            return *metrics;
     }
-    else
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
+    auto it = cache.index.find(card_id);
+    if (it != cache.index.end())
     {
-        type = audio_device_type::uknown;
-        result = false;
+        return *it->second;
     }
-    return result;
+
+    std::string card = std::to_string(card_id);
+
+    alsa_card_metrics& metrics = cache.series.emplace_back(alsa_card_metrics {
+        get_metrics_histogram("find_devices_alsa_card_enumeration_duration_seconds", "card", card),
+        get_metrics_histogram("find_devices_alsa_pcm_info_duration_seconds", "card", card),
+        get_metrics_histogram("find_devices_alsa_mixer_load_duration_seconds", "card", card),
+        get_metrics_histogram("find_devices_alsa_mixer_set_duration_seconds", "card", card)
+    });
+    cache.index.emplace(card_id, &metrics);
+
+    if (has_slot)
+        cache.slots[card_id].store(&metrics, std::memory_order_release);
+
+    return metrics;
 }
 
-bool try_parse_audio_device_channel_id(const std::string& channel_str, audio_device_channel_id& type)
+scoped_metrics_timer::scoped_metrics_timer(metrics_histogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now())
 {
-    std::string lowercase_channel_str = to_lower(channel_str);
+}
 
-    if (lowercase_channel_str == "front_left")
+scoped_metrics_timer::~scoped_metrics_timer()
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    record_metrics_histogram(histogram, (uint64_t)elapsed.count());
+}
+
+std::string to_metrics_text()
+{
+    metrics_registry& registry = get_metrics_registry();
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::string s;
+    std::string_view previous_name;
+
+    for (const auto& [key, counter] : registry.counters_index)
     {
-        type = audio_device_channel_id::front_left;
-        return true;
+        if (counter->name != previous_name)
+        {
+            s += fmt::format("# TYPE {} counter\n", counter->name);
+            previous_name = counter->name;
+        }
+        std::string label_block = counter->labels.empty() ? "" : fmt::format("{{{}}}", counter->labels);
+        s += fmt::format("{}{} {}\n", counter->name, label_block, counter->value.load(std::memory_order_relaxed));
     }
-    else if (lowercase_channel_str == "front_right")
+
+    previous_name = {};
+
+    // The values are read without stopping the writers, a scrape can be off by the operations in progress
+
+    for (const auto& [key, histogram] : registry.histograms_index)
     {
-        type = audio_device_channel_id::front_right;
-        return true;
+        if (histogram->name != previous_name)
+        {
+            s += fmt::format("# TYPE {} histogram\n", histogram->name);
+            previous_name = histogram->name;
+        }
+
+        std::string separator = histogram->labels.empty() ? "" : ",";
+        std::string label_block = histogram->labels.empty() ? "" : fmt::format("{{{}}}", histogram->labels);
+
+        uint64_t cumulative_count = 0;
+        for (size_t i = 0; i < metrics_histogram_bounds.size(); i++)
+        {
+            cumulative_count += histogram->buckets[i].load(std::memory_order_relaxed);
+            s += fmt::format("{}_bucket{{{}{}le=\"{}\"}} {}\n", histogram->name, histogram->labels, separator, metrics_histogram_bounds[i] / 1000000.0, cumulative_count);
+        }
+        cumulative_count += histogram->buckets[metrics_histogram_bounds.size()].load(std::memory_order_relaxed);
+        s += fmt::format("{}_bucket{{{}{}le=\"+Inf\"}} {}\n", histogram->name, histogram->labels, separator, cumulative_count);
+        s += fmt::format("{}_sum{} {}\n", histogram->name, label_block, histogram->sum_microseconds.load(std::memory_order_relaxed) / 1000000.0);
+        s += fmt::format("{}_count{} {}\n", histogram->name, label_block, cumulative_count);
     }
-    else if (lowercase_channel_str == "front_center")
-    {
-        type = audio_device_channel_id::front_center;
-        return true;
-    } 
-    else if (lowercase_channel_str == "rear_left")
+
+    return s;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// TRACING                                                          //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+void start_tracing();
+void stop_tracing();
+bool is_tracing_enabled();
+bool try_write_trace(const std::string& path);
+
+namespace
+{
+    // Bounds the memory used by long traces, such as a traced server, later events are dropped
+    const size_t trace_event_capacity = 1000000;
+
+    struct trace_event
     {
-        type = audio_device_channel_id::rear_left;
-        return true;
-    }
-    else if (lowercase_channel_str == "rear_right") 
+        const char* name;
+        std::string args;
+        int thread_id;
+        uint64_t start_microseconds;
+        uint64_t duration_microseconds;
+    };
+
+    struct tracer
     {
-        type = audio_device_channel_id::rear_right;
-        return true;
-    }
-    else if (lowercase_channel_str == "rear_center") 
+        std::atomic<bool> enabled {false};
+        std::chrono::steady_clock::time_point start;
+        std::mutex mutex;
+        std::vector<trace_event> events;
+        size_t dropped_count = 0;
+    };
+
+    tracer& get_tracer()
     {
-        type = audio_device_channel_id::rear_center;
-        return true;
+        static tracer t;
+        return t;
     }
-    else if (lowercase_channel_str == "woofer") 
+
+    int get_trace_thread_id()
     {
-        type = audio_device_channel_id::woofer;
-        return true;
+        static thread_local int thread_id = (int)syscall(SYS_gettid);
+        return thread_id;
     }
-    else if (lowercase_channel_str == "side_left") 
+
+    std::string to_trace_string(std::string_view s)
     {
-        type = audio_device_channel_id::side_left;
-        return true;
+        std::string result;
+        result.reserve(s.size());
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            if ((unsigned char)c >= 0x20)
+                result += c;
+        }
+        return result;
     }
-    else if (lowercase_channel_str == "side_right") 
+}
+
+void start_tracing()
+{
+    tracer& t = get_tracer();
+    std::lock_guard<std::mutex> lock(t.mutex);
+    t.events.clear();
+    t.dropped_count = 0;
+    t.start = std::chrono::steady_clock::now();
+    t.enabled.store(true, std::memory_order_relaxed);
+}
+
+void stop_tracing()
+{
+    get_tracer().enabled.store(false, std::memory_order_relaxed);
+}
+
+bool is_tracing_enabled()
+{
+    return get_tracer().enabled.load(std::memory_order_relaxed);
+}
+
+bool try_write_trace(const std::string& path)
+{
+    tracer& t = get_tracer();
+
+    std::string s;
     {
-        type = audio_device_channel_id::side_right;
-        return true;
+        std::lock_guard<std::mutex> lock(t.mutex);
+
+        s += "{\n";
+        s += "    \"displayTimeUnit\": \"ms\",\n";
+        s += fmt::format("    \"otherData\": {{ \"dropped_events\": \"{}\" }},\n", t.dropped_count);
+        s += "    \"traceEvents\": [\n";
+        for (size_t i = 0; i < t.events.size(); i++)
+        {
+            const trace_event& e = t.events[i];
+            s += fmt::format("        {{ \"name\": \"{}\", \"cat\": \"find_devices\", \"ph\": \"X\", \"pid\": {}, \"tid\": {}, \"ts\": {}, \"dur\": {}, \"args\": {{ {} }} }}",
+                e.name, getpid(), e.thread_id, e.start_microseconds, e.duration_microseconds, e.args);
+            if ((i + 1) < t.events.size())
+            {
+                s += ",";
+            }
+            s += "\n";
+        }
+        s += "    ]\n";
+        s += "}\n";
     }
-    else if (lowercase_channel_str == "mono") 
+
+    return try_write_file_atomically(path, s);
+}
+
+trace_span::trace_span(const char* name) : name(name), enabled(is_tracing_enabled())
+{
+    if (enabled)
     {
-        type = audio_device_channel_id::mono;
-        return true;
+        start = std::chrono::steady_clock::now();
     }
-    else if (lowercase_channel_str == "none")
+}
+
+trace_span::trace_span(const char* name, const char* arg_name, int arg_value) : name(name), enabled(is_tracing_enabled())
+{
+    if (enabled)
     {
-        type = audio_device_channel_id::none;
-        return true;
+        args = fmt::format("\"{}\": {}", arg_name, arg_value);
+        start = std::chrono::steady_clock::now();
     }
-
-    return false;
 }
 
-bool try_parse_audio_device_channel_display_name(const std::string& channel_str, audio_device_channel_id& type)
+trace_span::trace_span(const char* name, const char* first_arg_name, int first_arg_value, const char* second_arg_name, int second_arg_value) : name(name), enabled(is_tracing_enabled())
 {
-    std::string lowercase_channel_str = to_lower(channel_str);
-
-    if (lowercase_channel_str == "front left")
+    if (enabled)
     {
-        type = audio_device_channel_id::front_left;
-        return true;
+        args = fmt::format("\"{}\": {}, \"{}\": {}", first_arg_name, first_arg_value, second_arg_name, second_arg_value);
+        start = std::chrono::steady_clock::now();
     }
-    else if (lowercase_channel_str == "front right")
+}
+
+trace_span::trace_span(const char* name, const char* arg_name, std::string_view arg_value) : name(name), enabled(is_tracing_enabled())
+{
+    if (enabled)
     {
-        type = audio_device_channel_id::front_right;
-        return true;
+        args = fmt::format("\"{}\": \"{}\"", arg_name, to_trace_string(arg_value));
+        start = std::chrono::steady_clock::now();
     }
-    else if (lowercase_channel_str == "front center")
-    {
-        type = audio_device_channel_id::front_center;
-        return true;
-    } 
-    else if (lowercase_channel_str == "rear left")
+}
+
+trace_span::~trace_span()
+{
+    if (!enabled)
     {
-        type = audio_device_channel_id::rear_left;
-        return true;
+        return;
     }
-    else if (lowercase_channel_str == "rear right") 
+
+    auto end = std::chrono::steady_clock::now();
+
+    tracer& t = get_tracer();
+    std::lock_guard<std::mutex> lock(t.mutex);
+
+    if (t.events.size() >= trace_event_capacity)
     {
-        type = audio_device_channel_id::rear_right;
-        return true;
+        t.dropped_count++;
+        return;
     }
-    else if (lowercase_channel_str == "rear center") 
-    {
+
+    // Spans started before tracing was restarted are clamped to the start of the trace
+    uint64_t start_microseconds = start > t.start ? (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(start - t.start).count() : 0;
+    uint64_t duration_microseconds = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    t.events.push_back(trace_event{ name, std::move(args), get_trace_thread_id(), start_microseconds, duration_microseconds });
+}
+
+namespace 
+{
+    std::string to_lower(const std::string& str)
+    {
+        std::locale loc;
+        std::string s;
+        s.resize(str.size());
+        for (size_t i = 0; i < str.size(); i++)
+            s[i] = std::tolower(str[i], loc);
+        return s;
+    }
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// WORKER POOL                                                      //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+void set_worker_count(size_t count);
+size_t get_worker_count();
+void parallel_for(size_t count, const std::function<void(size_t)>& body);
+void parallel_invoke(const std::function<void()>& first, const std::function<void()>& second);
+
+namespace
+{
+    // The threads are started on first use, the calling thread is one of the workers
+    struct worker_pool
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::function<void()>> tasks;
+        std::vector<std::thread> threads;
+        size_t worker_count = default_worker_count;
+        bool stopping = false;
+
+        ~worker_pool()
+        {
+            stop();
+        }
+
+        void stop()
+        {
+            std::vector<std::thread> stopped_threads;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                stopped_threads.swap(threads);
+            }
+            condition.notify_all();
+            for (auto& thread : stopped_threads)
+            {
+                thread.join();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = false;
+        }
+
+        void submit(std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.push_back(std::move(task));
+                if (threads.size() + 1 < worker_count)
+                {
+                    threads.emplace_back([this]() { run(); });
+                }
+            }
+            condition.notify_one();
+        }
+
+        void run()
+        {
+            while (true)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                    if (stopping)
+                        return;
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+    };
+
+    worker_pool& get_worker_pool()
+    {
+        static worker_pool pool;
+        return pool;
+    }
+
+    // The body is only called for claimed indexes, which the loop waits for,
+    // a helper task which starts after every index was claimed returns without touching it
+    struct parallel_loop
+    {
+        const std::function<void(size_t)>* body = nullptr;
+        size_t count = 0;
+        std::atomic<size_t> next_index {0};
+        size_t completed_count = 0;
+        std::exception_ptr exception;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+
+    void run_parallel_loop(parallel_loop& loop)
+    {
+        size_t index = 0;
+        while ((index = loop.next_index.fetch_add(1)) < loop.count)
+        {
+            std::exception_ptr exception;
+            try
+            {
+                (*loop.body)(index);
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(loop.mutex);
+            if (exception != nullptr && loop.exception == nullptr)
+                loop.exception = exception;
+            if (++loop.completed_count == loop.count)
+                loop.condition.notify_all();
+        }
+    }
+}
+
+void set_worker_count(size_t count)
+{
+    worker_pool& pool = get_worker_pool();
+
+    // The running threads are stopped, and started again up to the new count on the next loop
+
+    pool.stop();
+
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.worker_count = std::clamp<size_t>(count, 1, max_worker_count);
+}
+
+size_t get_worker_count()
+{
+    worker_pool& pool = get_worker_pool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    return pool.worker_count;
+}
+
+void parallel_for(size_t count, const std::function<void(size_t)>& body)
+{
+    size_t helper_count = std::min(count, get_worker_count());
+    if (helper_count > 0)
+        helper_count--;
+
+    if (helper_count == 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            body(i);
+        }
+        return;
+    }
+
+    auto loop = std::make_shared<parallel_loop>();
+    loop->body = &body;
+    loop->count = count;
+
+    worker_pool& pool = get_worker_pool();
+    for (size_t i = 0; i < helper_count; i++)
+    {
+        pool.submit([loop]() { run_parallel_loop(*loop); });
+    }
+
+    run_parallel_loop(*loop);
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->condition.wait(lock, [&]() { return loop->completed_count == loop->count; });
+
+    if (loop->exception != nullptr)
+    {
+        std::rethrow_exception(loop->exception);
+    }
+}
+
+void parallel_invoke(const std::function<void()>& first, const std::function<void()>& second)
+{
+    parallel_for(2, [&](size_t i) { i == 0 ? first() : second(); });
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// AUDIO DEVICE                                                     //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+audio_device_type operator|(const audio_device_type& l, const audio_device_type& r);
+audio_device_type operator&(const audio_device_type& l, const audio_device_type& r);
+bool enum_device_type_has_flag(const audio_device_type& deviceType, const audio_device_type& flag);
+bool try_parse_audio_device_type(const std::string& type_str, audio_device_type& type);
+bool try_parse_audio_device_channel_id(const std::string& channel_str, audio_device_channel_id& type);
+bool try_parse_audio_device_channel_display_name(const std::string& channel_str, audio_device_channel_id& type);
+std::string to_string(const audio_device_type& deviceType);
+std::string to_string(const audio_device_info& d);
+std::string to_string(const audio_device_channel_id& type);
+std::string to_json(const std::vector<audio_device_info>& devices);
+std::string to_json(const audio_device_info& d, bool wrapping_object, int tabs);
+std::vector<audio_device_info> get_audio_devices();
+std::vector<audio_device_info> get_audio_devices(int card_id);
+bool try_get_audio_device(int card_id, int device_id, audio_device_info& device);
+bool try_parse_audio_device_hw_id(std::string_view hw_id, int& card_id, int& device_id);
+bool try_get_audio_device(int card_id, snd_ctl_t*& ctl_handle);
+bool try_get_audio_device(int card_id, int device_id, snd_ctl_t* ctl_handle, audio_device_info& device);
+bool try_get_audio_device(int card_id, int device_id, snd_ctl_t*& ctl_handle, snd_pcm_info_t*& pcm_info);
+bool can_use_audio_device(const audio_device_info& device, snd_pcm_stream_t mode);
+bool can_use_audio_device(const audio_device_info& device);
+
+audio_device_type operator|(const audio_device_type& l, const audio_device_type& r)
+{
+    return (audio_device_type)((int)l | (int)r);
+}
+
+audio_device_type operator&(const audio_device_type& l, const audio_device_type& r)
+{
+    return (audio_device_type)((int)l & (int)r);
+}
+
+bool enum_device_type_has_flag(const audio_device_type& deviceType, const audio_device_type& flag)
+{
+    return (deviceType & flag) != (audio_device_type)0;
+}
+
+bool try_parse_audio_device_type(const std::string& type_str, audio_device_type& type)
+{
+    bool result = true;
+    if (type_str == "playback")
+    {
+        type = audio_device_type::playback;
+    }
+    else if (type_str == "capture")
+    {
+        type = audio_device_type::capture;
+    }
+    else if (type_str == "uknown")
+    {
+        type = audio_device_type::uknown;
+    }
+    else
+    {
+        type = audio_device_type::uknown;
+        result = false;
+    }
+    return result;
+}
+
+bool try_parse_audio_device_channel_id(const std::string& channel_str, audio_device_channel_id& type)
+{
+    std::string lowercase_channel_str = to_lower(channel_str);
+
+    if (lowercase_channel_str == "front_left")
+    {
+        type = audio_device_channel_id::front_left;
+        return true;
+    }
+    else if (lowercase_channel_str == "front_right")
+    {
+        type = audio_device_channel_id::front_right;
+        return true;
+    }
+    else if (lowercase_channel_str == "front_center")
+    {
+        type = audio_device_channel_id::front_center;
+        return true;
+    } 
+    else if (lowercase_channel_str == "rear_left")
+    {
+        type = audio_device_channel_id::rear_left;
+        return true;
+    }
+    else if (lowercase_channel_str == "rear_right") 
+    {
+        type = audio_device_channel_id::rear_right;
+        return true;
+    }
+    else if (lowercase_channel_str == "rear_center") 
+    {
         type = audio_device_channel_id::rear_center;
         return true;
     }
     else if (lowercase_channel_str == "woofer") 
     {
-        type = audio_device_channel_id::woofer;
-        return true;
+        type = audio_device_channel_id::woofer;
+        return true;
+    }
+    else if (lowercase_channel_str == "side_left") 
+    {
+        type = audio_device_channel_id::side_left;
+        return true;
+    }
+    else if (lowercase_channel_str == "side_right") 
+    {
+        type = audio_device_channel_id::side_right;
+        return true;
+    }
+    else if (lowercase_channel_str == "mono") 
+    {
+        type = audio_device_channel_id::mono;
+        return true;
+    }
+    else if (lowercase_channel_str == "none")
+    {
+        type = audio_device_channel_id::none;
+        return true;
+    }
+
+    return false;
+}
+
+bool try_parse_audio_device_channel_display_name(const std::string& channel_str, audio_device_channel_id& type)
+{
+    std::string lowercase_channel_str = to_lower(channel_str);
+
+    if (lowercase_channel_str == "front left")
+    {
+        type = audio_device_channel_id::front_left;
+        return true;
+    }
+    else if (lowercase_channel_str == "front right")
+    {
+        type = audio_device_channel_id::front_right;
+        return true;
+    }
+    else if (lowercase_channel_str == "front center")
+    {
+        type = audio_device_channel_id::front_center;
+        return true;
+    } 
+    else if (lowercase_channel_str == "rear left")
+    {
+        type = audio_device_channel_id::rear_left;
+        return true;
+    }
+    else if (lowercase_channel_str == "rear right") 
+    {
+        type = audio_device_channel_id::rear_right;
+        return true;
+    }
+    else if (lowercase_channel_str == "rear center") 
+    {
+        type = audio_device_channel_id::rear_center;
+        return true;
+    }
+    else if (lowercase_channel_str == "woofer") 
+    {
+        type = audio_device_channel_id::woofer;
+        return true;
+    }
+    else if (lowercase_channel_str == "side left") 
+    {
+        type = audio_device_channel_id::side_left;
+        return true;
+    }
+    else if (lowercase_channel_str == "side right") 
+    {
+        type = audio_device_channel_id::side_right;
+        return true;
+    }
+    else if (lowercase_channel_str == "mono") 
+    {
+        type = audio_device_channel_id::mono;
+        return true;
+    }
+    else if (lowercase_channel_str == "none")
+    {
+        type = audio_device_channel_id::none;
+        return true;
+    }
+
+    return false;
+}
+
+std::string to_string(const audio_device_type& deviceType)
+{
+    if (deviceType == audio_device_type::capture)
+        return std::string("capture");
+    else if (deviceType == audio_device_type::playback)
+        return std::string("playback");
+    else if (deviceType == audio_device_type::uknown)
+        return std::string("unknown");
+    else if ((deviceType & audio_device_type::capture) != (audio_device_type)0 && (deviceType & audio_device_type::playback) != (audio_device_type)0)
+        return std::string("capture&playback");
+    return std::string("");
+}
+
+std::string to_string(const audio_device_info& d)
+{
+    return std::string("card id: '") + std::to_string(d.card_id) + "', " +
+        "device id: '" + std::to_string(d.device_id) +
+        "', name: '" + d.name +
+        "', desc: '" + d.description +
+        "', type: '" + to_string(d.type) + "'";
+}
+
+std::string to_string(const audio_device_channel_id& type)
+{
+    switch (type)
+    {
+    case audio_device_channel_id::front_left:
+        return "front_left";
+    case audio_device_channel_id::front_right:
+        return "front_right";
+    case audio_device_channel_id::front_center:
+        return "front_center";
+    case audio_device_channel_id::rear_left:
+        return "rear_left";
+    case audio_device_channel_id::rear_right:
+        return "rear_right";
+    case audio_device_channel_id::rear_center:
+        return "rear_center";
+    case audio_device_channel_id::woofer:
+        return "woofer";
+    case audio_device_channel_id::side_left:
+        return "side_left";
+    case audio_device_channel_id::side_right:
+        return "side_right";
+    case audio_device_channel_id::mono:
+        return "mono";
+    case audio_device_channel_id::none:
+        return "none";
+    default:
+        return "";
+    }
+}
+
+std::string to_json(const std::vector<audio_device_info>& devices)
+{
+    std::string s;
+    s.append("{\n");
+    s.append("    \"devices\": [\n");
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        const audio_device_info& d = devices[i];
+        s.append(to_json(d, 2));
+        if ((i + 1) < devices.size())
+        {
+            s.append(",");
+        }
+        s.append("\n");
+    }
+    s.append("    ]\n");
+    s.append("}\n");
+    return s;
+}
+
+std::string to_json(const audio_device_info& d, bool wrapping_object, int tabs)
+{
+    std::string s;
+    if (wrapping_object)
+    {
+        s.append("{\n");
+    }
+    s.append("    \"card_id\": \"" + std::to_string(d.card_id) + "\",\n");
+    s.append("    \"device_id\": \"" + std::to_string(d.device_id) + "\",\n");
+    s.append("    \"plughw_id\": \"" + d.plughw_id + "\",\n");
+    s.append("    \"hw_id\": \"" + d.hw_id + "\",\n");
+    s.append("    \"name\": \"" + d.name + "\",\n");
+    s.append("    \"description\": \"" + d.description + "\",\n");
+    s.append("    \"type\": \"" + to_string(d.type) + "\"");
+    if (wrapping_object)
+    {
+        s.append("\n");
+        s.append("}");
+    }
+    insert_tabs(s, tabs);
+    return s;
+}
+
+std::vector<audio_device_info> alsa_udev_device_backend::get_audio_devices()
+{
+    trace_span span("get_audio_devices");
+
+    std::vector<audio_device_info> devices;
+
+    int card_id = -1;
+    int err = -1;
+
+    // ALSA sample code: https://github.com/bear24rw/alsa-utils/blob/master/aplay/aplay.c
+
+    // Consider using snd_device_name_hint and snd_device_name_get_hint
+    // for more portability, simplicity and support of non PCM devices
+    // Can use snd_ctl_rawmidi_next_device for MIDI devices.
+
+    // Iterate over all available sound cards
+    std::vector<int> card_ids;
+    while (true)
+    {
+        err = snd_card_next(&card_id);
+        if (err != 0 || card_id < 0)
+            break;
+        card_ids.push_back(card_id);
+    }
+
+    // The cards are enumerated concurrently, each with its own control handle,
+    // and merged in card order so that the output does not depend on the timing
+
+    std::vector<std::vector<audio_device_info>> card_devices(card_ids.size());
+
+    parallel_for(card_ids.size(), [&](size_t i) {
+        card_devices[i] = ::get_audio_devices(card_ids[i]);
+    });
+
+    for (const auto& devices_for_card : card_devices)
+    {
+        devices.insert(devices.end(), devices_for_card.begin(), devices_for_card.end());
+    }
+
+    return devices;
+}
+
+std::vector<audio_device_info> get_audio_devices(int card_id)
+{
+    trace_span span("get_audio_devices(card)", "card_id", card_id);
+    scoped_metrics_timer timer(get_alsa_card_metrics(card_id).enumeration);
+
+    std::vector<audio_device_info> devices;
+
+    snd_ctl_t* ctl_handle = nullptr;
+    int err = -1;
+
+    // ALSA sample code: https://github.com/bear24rw/alsa-utils/blob/master/aplay/aplay.c
+
+    // Consider using snd_device_name_hint and snd_device_name_get_hint
+    // for more portability, simplicity and support of non PCM devices
+    // Can use snd_ctl_rawmidi_next_device for MIDI devices.
+
+    err = snd_ctl_open(&ctl_handle, fmt::format("hw:{}", card_id).c_str(), 0);
+    if (err != 0)
+        return devices;;
+
+    // Iterate over all available PCM devices on the current card
+    int device_id = -1;
+    while (true)
+    {
+        err = snd_ctl_pcm_next_device(ctl_handle, &device_id);
+        if (err != 0)
+            continue;
+        if (device_id < 0)
+            break;
+
+        audio_device_info device;
+
+        if (!try_get_audio_device(card_id, device_id, ctl_handle, device))
+            continue;
+
+        devices.push_back(device);
+    }
+
+    snd_ctl_close(ctl_handle);
+
+    return devices;
+}
+
+bool alsa_udev_device_backend::try_get_audio_device(int card_id, int device_id, audio_device_info& device)
+{
+    // Opens only the control interface of the requested card
+
+    snd_ctl_t* ctl_handle = nullptr;
+
+    if (card_id < 0 || device_id < 0 || !::try_get_audio_device(card_id, ctl_handle))
+    {
+        return false;
+    }
+
+    bool result = ::try_get_audio_device(card_id, device_id, ctl_handle, device);
+
+    snd_ctl_close(ctl_handle);
+
+    return result;
+}
+
+bool try_parse_audio_device_hw_id(std::string_view hw_id, int& card_id, int& device_id)
+{
+    // Accepts hw:CARD,DEVICE and plughw:CARD,DEVICE with numeric card and device ids
+
+    if (hw_id.substr(0, 3) == "hw:")
+    {
+        hw_id.remove_prefix(3);
+    }
+    else if (hw_id.substr(0, 7) == "plughw:")
+    {
+        hw_id.remove_prefix(7);
+    }
+    else
+    {
+        return false;
+    }
+
+    size_t comma_pos = hw_id.find(',');
+    if (comma_pos == std::string_view::npos)
+    {
+        return false;
+    }
+
+    int card = -1;
+    int device = -1;
+    if (!try_parse_int(hw_id.substr(0, comma_pos), card) || !try_parse_int(hw_id.substr(comma_pos + 1), device))
+    {
+        return false;
+    }
+
+    card_id = card;
+    device_id = device;
+
+    return true;
+}
+
+bool try_get_audio_device(int card_id, snd_ctl_t*& ctl_handle)
+{
+    int err = snd_ctl_open(&ctl_handle, fmt::format("hw:{}", card_id).c_str(), 0);
+    if (err != 0)
+    {
+        return false;
+    }
+    return true;
+}
+
+bool try_get_audio_device(int card_id, int device_id, snd_ctl_t* ctl_handle, audio_device_info& device)
+{
+    trace_span span("try_get_audio_device", "card_id", card_id, "device_id", device_id);
+
+    snd_pcm_info_t* pcm_info = nullptr;
+    int err = -1;
+
+    snd_pcm_info_alloca(&pcm_info);
+
+    metrics_histogram& pcm_info_metrics = get_alsa_card_metrics(card_id).pcm_info;
+    auto get_pcm_info = [&]() {
+        scoped_metrics_timer timer(pcm_info_metrics);
+        return snd_ctl_pcm_info(ctl_handle, pcm_info);
+    };
+
+    // NOTE: find a better way to identify playback or capture in one go
+
+    snd_pcm_info_set_device(pcm_info, device_id);
+    snd_pcm_info_set_subdevice(pcm_info, 0);
+    snd_pcm_info_set_stream(pcm_info, SND_PCM_STREAM_CAPTURE);
+
+    err = get_pcm_info();
+
+    if (err < 0)
+    {
+        snd_pcm_info_set_device(pcm_info, device_id);
+        snd_pcm_info_set_subdevice(pcm_info, 0);
+        snd_pcm_info_set_stream(pcm_info, SND_PCM_STREAM_PLAYBACK);
+
+        err = get_pcm_info();
+
+        if (err < 0)
+        {
+            return false;
+        }
+        else
+        {
+            device.type = audio_device_type::playback;
+        }
+    }
+    else
+    {
+        device.type = audio_device_type::capture;
+    }
+
+    device.card_id = card_id;
+    device.device_id = device_id;
+
+    // snd_card_get_name and snd_card_get_longname are implemented here:
+    // https://github.com/torvalds/linux/blob/master/sound/usb/card.c
+
+    char* name = nullptr;
+    err = snd_card_get_name(card_id, &name);
+    if (err != 0)
+        device.name = "Unknown";
+    else
+        device.name = name;
+
+    device.stream_name = snd_pcm_info_get_name(pcm_info);
+
+    char* long_name = nullptr;
+    err = snd_card_get_longname(card_id, &long_name);
+    if (err != 0)
+        device.description = "Unknown";
+    else
+        device.description = long_name;
+
+    device.hw_id = fmt::format("hw:{},{}", device.card_id, device.device_id);
+    device.plughw_id = fmt::format("plughw:{},{}", device.card_id, device.device_id);
+
+    // Use snd_pcm_info_get_subdevices_avail, snd_pcm_info_set_subdevice, snd_ctl_pcm_info and
+    // snd_pcm_info_get_subdevice_name to enumerate all subdevices
+    // example here: https://github.com/bear24rw/alsa-utils/blob/master/aplay/aplay.c
+
+    if (device.type == audio_device_type::capture)
+    {
+        snd_pcm_info_set_device(pcm_info, device_id);
+        snd_pcm_info_set_subdevice(pcm_info, 0);
+        snd_pcm_info_set_stream(pcm_info, SND_PCM_STREAM_PLAYBACK);
+
+        err = get_pcm_info();
+
+        if (err >= 0)
+        {
+            device.type = device.type | audio_device_type::playback;
+        }
+    }
+
+    return true;
+}
+
+bool can_use_audio_device(const audio_device_info& device, snd_pcm_stream_t mode)
+{
+    snd_pcm_t* handle;
+
+    int err = snd_pcm_open(&handle, device.hw_id.c_str(), mode, SND_PCM_NONBLOCK);
+
+    if (err < 0)
+    {
+        if (err == -EBUSY)
+        {
+            // Device is busy, cannot open
+            return false;
+        }
+        else if (err == -ENODEV)
+        {
+            // Device does not exist or is not available
+            return false;
+        }
+        else
+        {
+            // Other error occurred, handle it as needed
+            return false;
+        }
+    }
+
+    snd_pcm_close(handle);
+
+    return true;
+}
+
+bool alsa_udev_device_backend::can_use_audio_device(const audio_device_info& device)
+{
+    if (device.type == audio_device_type::capture)
+    {
+        return ::can_use_audio_device(device, SND_PCM_STREAM_CAPTURE);
+    }
+    else if (device.type == audio_device_type::playback)
+    {
+        return ::can_use_audio_device(device, SND_PCM_STREAM_PLAYBACK);
+    }
+    else if (enum_device_type_has_flag(device.type, audio_device_type::capture) &&
+        enum_device_type_has_flag(device.type, audio_device_type::playback))
+    {
+        return ::can_use_audio_device(device, SND_PCM_STREAM_CAPTURE) &&
+            ::can_use_audio_device(device, SND_PCM_STREAM_PLAYBACK);
+    }
+    return false;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// AUDIO DEVICE VOLUME                                              //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume);
+bool try_get_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_volume);
+bool try_get_capture_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result);
+bool try_get_playback_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result);
+bool try_get_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_db_range, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_volume, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_db);
+bool try_get_playback_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result);
+bool try_get_capture_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result);
+audio_device_channel_id parse_audio_device_channel_id(int channel_id);
+int parse_audio_device_channel_type(audio_device_channel_id type);
+bool use_linear_dB_scale(long db_min, long db_max);
+bool try_set_audio_device_volume(const audio_device_info& device, int volume);
+bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel);
+bool try_set_audio_device_volume(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel);
+bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume);
+bool try_set_audio_device_volume_percent(const audio_device_info& device, int volume);
+bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel);
+bool try_set_audio_device_volume_percent(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel);
+bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume);
+bool try_set_audio_device_volume(const audio_device_info& device, int volume, std::function<void(audio_device_channel& channel, int volume)> apply_volume, std::function<bool(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)> set_volume);
+bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume, std::function<bool((snd_mixer_elem_t* elem, int channel_id, int value))> playback_setter, std::function<bool((snd_mixer_elem_t* elem, int channel_id, int value))> capture_setter);
+bool try_set_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value)> set_volume);
+bool try_set_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value)> set_volume);
+bool try_set_playback_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value);
+bool try_set_playback_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value);
+bool try_set_capture_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value);
+bool try_set_capture_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value);
+long get_channel_volume_from_percent(long min, long max, int value);
+int load_audio_device_mixer(snd_mixer_t* handle, int card_id);
+bool try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify);
+bool try_set_audio_device_volume_percent(snd_mixer_t* handle, audio_device_channel_volume_set& set);
+bool try_verify_audio_device_volume_percent(snd_mixer_t* handle, audio_device_channel_volume_set& set);
+std::string to_json(const audio_device_volume_info& d, bool wrapping_object, int tabs);
+std::string to_json(const audio_device_volume_info& d, std::function<std::string(const audio_device_volume_info& d)> render_device, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c)> render_control, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c, const audio_device_channel& ch)> render_channel, bool wrapping_object, int tabs);
+bool test_audio_device(const audio_device_info& device);
+
+bool alsa_udev_device_backend::try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume)
+{
+    trace_span span("try_get_audio_device_volume", "hw_id", device.hw_id);
+
+    bool result = true;
+
+    volume.audio_device = device;
+    volume.controls.clear();
+
+    int err;
+    snd_mixer_t* handle;
+    snd_mixer_selem_id_t* sid;
+
+    // NOTE: can get the error message with snd_strerror(err)
+
+    if ((err = snd_mixer_open(&handle, 0)) < 0)
+    {
+        return false;
+    }
+
+    if ((err = snd_mixer_attach(handle, ("hw:" + std::to_string(device.card_id)).c_str())) < 0)
+    {
+        snd_mixer_close(handle);
+        return false;
+    }
+
+    if ((err = snd_mixer_selem_register(handle, nullptr, nullptr)) < 0)
+    {
+        snd_mixer_close(handle);
+        return false;
+    }
+
+    if ((err = load_audio_device_mixer(handle, device.card_id)) < 0)
+    {
+        snd_mixer_close(handle);
+        return false;
+    }
+
+    snd_mixer_selem_id_malloc(&sid);
+    snd_mixer_selem_id_set_index(sid, 0);
+
+    snd_mixer_elem_t* elem = nullptr;
+
+    for (elem = snd_mixer_first_elem(handle); elem; elem = snd_mixer_elem_next(elem))
+    {
+        snd_mixer_selem_get_id(elem, sid);
+
+        if (!snd_mixer_selem_has_capture_volume(elem) && !snd_mixer_selem_has_playback_volume(elem))
+        {
+            continue;
+        }
+
+        audio_device_volume_control volume_control;
+
+        volume_control.name = snd_mixer_selem_get_name(elem);
+
+        for (int channel_id = 0; channel_id <= SND_MIXER_SCHN_REAR_CENTER; channel_id++)
+        {
+            if (!snd_mixer_selem_has_playback_channel(elem, (snd_mixer_selem_channel_id_t)channel_id) &&
+                !snd_mixer_selem_has_capture_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+                continue;
+
+            audio_device_channel channel;
+
+            channel.name = snd_mixer_selem_channel_name((snd_mixer_selem_channel_id_t)channel_id);
+            channel.id = parse_audio_device_channel_id(channel_id);
+
+            if (snd_mixer_selem_has_playback_volume(elem) && snd_mixer_selem_has_playback_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+            {
+                channel.type = audio_device_type::playback;
+                result = try_get_playback_channel_volume(elem, channel_id, channel);
+                if (!result)
+                    break;
+                result = try_get_playback_channel_volume_percent_linearized(elem, channel_id, channel.volume_percent_linearized);
+                if (!result)
+                    break;
+                volume_control.channels.push_back(channel);
+            }
+            if (snd_mixer_selem_has_capture_volume(elem) && snd_mixer_selem_has_capture_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+            {
+                channel.type = audio_device_type::capture;
+                result = try_get_capture_channel_volume(elem, channel_id, channel);
+                if (!result)
+                    break;
+                result = try_get_capture_channel_volume_percent_linearized(elem, channel_id, channel.volume_percent_linearized);
+                if (!result)
+                    break;
+                volume_control.channels.push_back(channel);
+            }
+
+            // if (channel_id == 0 && snd_mixer_selem_is_playback_mono(elem))
+            // {
+            //     break;
+            // }
+        }
+
+        volume.controls.push_back(volume_control);
+    }
+
+    snd_mixer_selem_id_free(sid);
+    snd_mixer_close(handle);
+
+    return result;
+}
+
+bool try_get_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_volume)
+{
+    long min = 0, max = 0, value = 0;
+    int err;
+    err = get_volume_range(elem, &min, &max);
+    if (err < 0)
+    {
+        return false;
+    }
+    err = get_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, &value);
+    if (err < 0)
+    {
+        return false;
+    }
+    double result_double = ((value - min) * 100.0 / (double)(max - min));
+    result.volume_percent = (int)std::rint(result_double);
+    result.volume = value;
+    result.volume_min = min;
+    result.volume_max = max;
+    return true;
+}
+
+bool try_get_capture_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result)
+{
+    return try_get_channel_volume(elem, channel_id, result,
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_volume_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_capture_volume(elem, channel, value); });
+}
+
+bool try_get_playback_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result)
+{
+    return try_get_channel_volume(elem, channel_id, result,
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_volume_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_playback_volume(elem, channel, value); });
+}
+
+bool try_get_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_db_range, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_volume, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_db)
+{
+    
+    // Some code from this function was copied from https://github.com/alsa-project/alsa-utils/blob/master/alsamixer/volume_mapping.c
+    // Copyright (c) 2010 Clemens Ladisch <clemens@ladisch.de>
+    // Licensed under ISC license.
+    // See copyright message at the top of this file.
+
+    long min, max, value;
+    double normalized, min_norm;
+    int err;    
+
+    err = get_db_range(elem, &min, &max);
+    if (err < 0 || min >= max)
+    {
+        err = get_volume_range(elem, &min, &max);
+        if (err < 0 || min == max)
+        {
+			return false;
+        }
+        err = get_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, &value);
+        if (err < 0)
+        {
+			return false;
+        }
+        double result_double = ((value - min) * 100.0) / (double)(max - min);
+        result = (int)std::rint(result_double);
+        return true;
+    }
+
+    err = get_db(elem, (snd_mixer_selem_channel_id_t)channel_id, &value);
+    if (err < 0)
+    {
+		return false;
+    }
+
+    if (use_linear_dB_scale(min, max))
+    {
+		double result_double = ((value - min) * 100.0) / (double)(max - min);
+        result = (int)std::rint(result_double);
+        return true;
+    }
+    
+   	normalized = pow(10, (value - max) / 6000.0);
+    if (min != SND_CTL_TLV_DB_GAIN_MUTE)
+    {
+		min_norm = pow(10, (min - max) / 6000.0);
+		normalized = (normalized - min_norm) / (1 - min_norm);
+	}
+    
+    result = (int)std::rint(normalized * 100.0);
+
+    return true;
+}
+
+bool try_get_playback_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result)
+{
+    return try_get_channel_volume_percent_linearized(elem, channel_id, result,
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_dB_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_volume_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_playback_volume(elem, channel, value); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_playback_dB(elem, channel, value); });
+}
+
+bool try_get_capture_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result)
+{
+    return try_get_channel_volume_percent_linearized(elem, channel_id, result,
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_dB_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_volume_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_capture_volume(elem, channel, value); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_capture_dB(elem, channel, value); });
+}
+
+audio_device_channel_id parse_audio_device_channel_id(int channel_id)
+{
+    switch (channel_id)
+    {
+    case 0:
+        // if (snd_mixer_selem_has_playback_channel(elem, SND_MIXER_SCHN_MONO))
+        // {
+        //     channel.channel = audio_device_channel_type::mono;
+        // }
+        // else
+        // {
+        return audio_device_channel_id::front_left;
+        //}
+    case 1:
+        return audio_device_channel_id::front_right;
+    case 2:
+        return audio_device_channel_id::rear_left;
+    case 3:
+        return audio_device_channel_id::rear_right;
+    case 4:
+        return audio_device_channel_id::front_center;
+    case 5:
+        return audio_device_channel_id::woofer;
+    case 6:
+        return audio_device_channel_id::side_left;
+    case 7:
+        return audio_device_channel_id::side_right;
+    case 8:
+        return audio_device_channel_id::rear_center;
+    default:
+        return audio_device_channel_id::none;
+    }
+}
+
+int parse_audio_device_channel_type(audio_device_channel_id type)
+{
+    switch (type)
+    {
+    case audio_device_channel_id::front_left:
+        return 0;
+    case audio_device_channel_id::front_right:
+        return 1;
+    case audio_device_channel_id::rear_left:
+        return 2;
+    case audio_device_channel_id::rear_right:
+        return 3;
+    case audio_device_channel_id::front_center:
+        return 4;
+    case audio_device_channel_id::woofer:
+        return 5;
+    case audio_device_channel_id::side_left:
+        return 6;
+    case audio_device_channel_id::side_right:
+        return 7;
+    case audio_device_channel_id::rear_center:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+bool use_linear_dB_scale(long db_min, long db_max)
+{
+    constexpr int MAX_LINEAR_DB_SCALE =	24;
+	return (db_max - db_min) <= (MAX_LINEAR_DB_SCALE * 100);
+}
+
+bool try_set_audio_device_volume(const audio_device_info& device, int volume)
+{
+    return try_set_audio_device_volume(device, volume, 
+        [](audio_device_channel& channel, int volume) { channel.volume = volume; },
+        [](const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel) { return try_set_audio_device_volume(device, control, channel); });
+}
+
+bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel)
+{
+    return try_set_audio_device_volume(device, control_name, channel.id, channel.type, channel.volume);
+}
+
+bool try_set_audio_device_volume(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)
+{
+    return try_set_audio_device_volume(device, control.name, channel.id, channel.type, channel.volume);
+}
+
+bool alsa_udev_device_backend::try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume)
+{
+    return ::try_set_audio_device_volume(device, control_name, channel, channel_type, volume,
+        [](snd_mixer_elem_t* elem, int channel_id, int value) { return try_set_playback_channel_volume(elem, channel_id, value); },
+        [](snd_mixer_elem_t* elem, int channel_id, int value) { return try_set_capture_channel_volume(elem, channel_id, value); });
+}
+
+bool try_set_audio_device_volume_percent(const audio_device_info& device, int volume)
+{
+    return try_set_audio_device_volume(device, volume, 
+        [](audio_device_channel& channel, int volume) { channel.volume_percent = volume; },
+        [](const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel) { return try_set_audio_device_volume_percent(device, control, channel); });
+}
+
+bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel)
+{
+    return try_set_audio_device_volume_percent(device, control_name, channel.id, channel.type, channel.volume_percent);
+}
+
+bool try_set_audio_device_volume_percent(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)
+{
+    return try_set_audio_device_volume_percent(device, control.name, channel.id, channel.type, channel.volume_percent);
+}
+
+bool alsa_udev_device_backend::try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume)
+{
+    return ::try_set_audio_device_volume(device, control_name, channel, channel_type, volume,
+        [](snd_mixer_elem_t* elem, int channel_id, int value) { return try_set_playback_channel_volume_percent(elem, channel_id, value); },
+        [](snd_mixer_elem_t* elem, int channel_id, int value) { return try_set_capture_channel_volume_percent(elem, channel_id, value); });
+}
+
+bool try_set_audio_device_volume(const audio_device_info& device, int volume, std::function<void(audio_device_channel& channel, int volume)> apply_volume, std::function<bool(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)> set_volume)
+{
+    audio_device_volume_info audio_device_volume;
+    if (!try_get_audio_device_volume(device, audio_device_volume))
+    {
+        return false;
+    }
+
+    for (const auto& control : audio_device_volume.controls)
+    {
+        for (auto channel : control.channels)
+        {
+            apply_volume(channel, volume);
+            if (!set_volume(device, control, channel))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume, std::function<bool((snd_mixer_elem_t* elem, int channel_id, int value))> playback_setter, std::function<bool((snd_mixer_elem_t* elem, int channel_id, int value))> capture_setter)
+{
+    trace_span span("try_set_audio_device_volume", "hw_id", device.hw_id);
+    scoped_metrics_timer timer(get_alsa_card_metrics(device.card_id).mixer_set);
+
+    bool result = true;
+
+    int err;
+    snd_mixer_t* handle;
+    snd_mixer_selem_id_t* sid;
+
+    // NOTE: can get the error message with snd_strerror(err)
+
+    if ((err = snd_mixer_open(&handle, 0)) < 0)
+    {
+        return false;
+    }
+
+    if ((err = snd_mixer_attach(handle, ("hw:" + std::to_string(device.card_id)).c_str())) < 0)
+    {
+        snd_mixer_close(handle);
+        return false;
+    }
+
+    if ((err = snd_mixer_selem_register(handle, nullptr, nullptr)) < 0)
+    {
+        snd_mixer_close(handle);
+        return false;
+    }
+
+    if ((err = load_audio_device_mixer(handle, device.card_id)) < 0)
+    {
+        snd_mixer_close(handle);
+        return false;
+    }
+
+    snd_mixer_selem_id_malloc(&sid);
+    snd_mixer_selem_id_set_index(sid, 0);
+
+    snd_mixer_elem_t* elem = nullptr;
+
+    for (elem = snd_mixer_first_elem(handle); elem; elem = snd_mixer_elem_next(elem))
+    {
+        snd_mixer_selem_get_id(elem, sid);
+
+        std::string element_name = snd_mixer_selem_get_name(elem);
+        int channel_id = parse_audio_device_channel_type(channel);
+
+        if (element_name != control_name)
+        {
+            continue;
+        }
+
+        if (channel_type == audio_device_type::playback && snd_mixer_selem_has_playback_volume(elem) && snd_mixer_selem_has_playback_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+        {
+            result = playback_setter(elem, channel_id, volume);
+            break;
+        }
+        else if (channel_type == audio_device_type::capture && snd_mixer_selem_has_capture_volume(elem) && snd_mixer_selem_has_capture_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+        {
+            result = capture_setter(elem, channel_id, volume);
+            break;
+        }
+        else
+        {
+            result = false;
+            break;
+        }
+    }
+
+    snd_mixer_selem_id_free(sid);
+    snd_mixer_close(handle);
+
+    return result;
+}
+
+bool try_set_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value)> set_volume)
+{
+    long min = 0, max = 0;
+    int err;
+    err = get_volume_range(elem, &min, &max);
+    if (err < 0)
+    {
+        return false;
+    }
+    long value_adjusted = get_channel_volume_from_percent(min, max, value);
+    err = set_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, value_adjusted);
+    if (err < 0)
+    {
+        return false;
+    }
+    return true;
+}
+
+bool try_set_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value)> set_volume)
+{
+    long min = 0, max = 0;
+    int err;
+    err = get_volume_range(elem, &min, &max);
+    if (err < 0)
+    {
+        return false;
+    }
+    if (value < min || value > max)
+    {
+        return false;
+    }
+    err = set_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, value);
+    if (err < 0)
+    {
+        return false;
+    }
+    return true;
+}
+
+bool try_set_playback_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value)
+{
+    return try_set_channel_volume_percent(elem, channel_id, value,
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_volume_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) { return snd_mixer_selem_set_playback_volume(elem, channel, value); });
+}
+
+bool try_set_playback_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value)
+{
+    return try_set_channel_volume(elem, channel_id, value,
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_volume_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) { return snd_mixer_selem_set_playback_volume(elem, channel, value); });
+}
+
+bool try_set_capture_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value)
+{
+    return try_set_channel_volume_percent(elem, channel_id, value,
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_volume_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) { return snd_mixer_selem_set_capture_volume(elem, channel, value); });
+}
+
+bool try_set_capture_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value)
+{
+    return try_set_channel_volume(elem, channel_id, value,
+        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_volume_range(elem, min, max); },
+        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) { return snd_mixer_selem_set_capture_volume(elem, channel, value); });
+}
+
+int load_audio_device_mixer(snd_mixer_t* handle, int card_id)
+{
+    scoped_metrics_timer timer(get_alsa_card_metrics(card_id).mixer_load);
+    return snd_mixer_load(handle);
+}
+
+long get_channel_volume_from_percent(long min, long max, int value)
+{
+    double value_adjusted_double = ((value * (double)(max - min)) / 100.0) + min;
+    return (long)std::rint(value_adjusted_double);
+}
+
+bool alsa_udev_device_backend::try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify)
+{
+    trace_span span("try_set_audio_device_volume_percent(card)", "card_id", card_id);
+    scoped_metrics_timer timer(get_alsa_card_metrics(card_id).mixer_set);
+
+    // All the sets of a card are applied with a single mixer session,
+    // instead of loading the mixer again for every control and channel
+
+    int err;
+    snd_mixer_t* handle;
+
+    for (auto& set : sets)
+    {
+        set.success = false;
+        set.verified = false;
+        set.status = audio_device_volume_set_status::not_applied;
+        set.error.clear();
+    }
+
+    auto fail_all = [&]()
+    {
+        for (auto& set : sets)
+        {
+            set.status = (err == -ENOENT || err == -ENODEV) ? audio_device_volume_set_status::device_not_found : audio_device_volume_set_status::failed;
+            set.error = snd_strerror(err);
+        }
+        return false;
+    };
+
+    if ((err = snd_mixer_open(&handle, 0)) < 0)
+    {
+        return fail_all();
+    }
+
+    if ((err = snd_mixer_attach(handle, ("hw:" + std::to_string(card_id)).c_str())) < 0)
+    {
+        snd_mixer_close(handle);
+        return fail_all();
+    }
+
+    if ((err = snd_mixer_selem_register(handle, nullptr, nullptr)) < 0)
+    {
+        snd_mixer_close(handle);
+        return fail_all();
+    }
+
+    if ((err = load_audio_device_mixer(handle, card_id)) < 0)
+    {
+        snd_mixer_close(handle);
+        return fail_all();
+    }
+
+    bool result = true;
+
+    for (auto& set : sets)
+    {
+        if (!::try_set_audio_device_volume_percent(handle, set))
+        {
+            result = false;
+        }
+    }
+
+    if (verify)
+    {
+        // Pick up the values the driver actually applied, which can differ when it clamps or rounds
+
+        snd_mixer_handle_events(handle);
+
+        for (auto& set : sets)
+        {
+            if (set.success && !try_verify_audio_device_volume_percent(handle, set))
+            {
+                result = false;
+            }
+        }
+    }
+
+    snd_mixer_close(handle);
+
+    return result;
+}
+
+bool try_set_audio_device_volume_percent(snd_mixer_t* handle, audio_device_channel_volume_set& set)
+{
+    snd_mixer_selem_id_t* sid;
+    snd_mixer_selem_id_malloc(&sid);
+    snd_mixer_selem_id_set_index(sid, 0);
+    snd_mixer_selem_id_set_name(sid, set.control_name.c_str());
+
+    snd_mixer_elem_t* elem = snd_mixer_find_selem(handle, sid);
+    snd_mixer_selem_id_free(sid);
+
+    if (elem == nullptr)
+    {
+        set.status = audio_device_volume_set_status::control_not_found;
+        set.error = "control not found";
+        return false;
+    }
+
+    int applied_count = 0;
+
+    for (int channel_id = 0; channel_id <= SND_MIXER_SCHN_LAST; channel_id++)
+    {
+        if (set.channel != audio_device_channel_id::none && parse_audio_device_channel_type(set.channel) != channel_id)
+        {
+            continue;
+        }
+
+        if (enum_device_type_has_flag(set.channel_type, audio_device_type::playback) && snd_mixer_selem_has_playback_volume(elem) && snd_mixer_selem_has_playback_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+        {
+            if (!try_set_playback_channel_volume_percent(elem, channel_id, set.volume_percent))
+            {
+                set.status = audio_device_volume_set_status::failed;
+                set.error = "failed to set playback volume";
+                return false;
+            }
+            applied_count++;
+        }
+
+        if (enum_device_type_has_flag(set.channel_type, audio_device_type::capture) && snd_mixer_selem_has_capture_volume(elem) && snd_mixer_selem_has_capture_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+        {
+            if (!try_set_capture_channel_volume_percent(elem, channel_id, set.volume_percent))
+            {
+                set.status = audio_device_volume_set_status::failed;
+                set.error = "failed to set capture volume";
+                return false;
+            }
+            applied_count++;
+        }
+    }
+
+    if (applied_count == 0)
+    {
+        set.status = audio_device_volume_set_status::channel_not_found;
+        set.error = "channel not found";
+        return false;
+    }
+
+    set.success = true;
+    set.status = audio_device_volume_set_status::applied;
+
+    return true;
+}
+
+bool try_verify_audio_device_volume_percent(snd_mixer_t* handle, audio_device_channel_volume_set& set)
+{
+    snd_mixer_selem_id_t* sid;
+    snd_mixer_selem_id_malloc(&sid);
+    snd_mixer_selem_id_set_index(sid, 0);
+    snd_mixer_selem_id_set_name(sid, set.control_name.c_str());
+
+    snd_mixer_elem_t* elem = snd_mixer_find_selem(handle, sid);
+    snd_mixer_selem_id_free(sid);
+
+    if (elem == nullptr)
+    {
+        set.status = audio_device_volume_set_status::not_verified;
+        set.error = "control not found";
+        return false;
+    }
+
+    for (int channel_id = 0; channel_id <= SND_MIXER_SCHN_LAST; channel_id++)
+    {
+        if (set.channel != audio_device_channel_id::none && parse_audio_device_channel_type(set.channel) != channel_id)
+        {
+            continue;
+        }
+
+        long min = 0, max = 0, value = 0;
+
+        if (enum_device_type_has_flag(set.channel_type, audio_device_type::playback) && snd_mixer_selem_has_playback_volume(elem) && snd_mixer_selem_has_playback_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+        {
+            if (snd_mixer_selem_get_playback_volume_range(elem, &min, &max) < 0 ||
+                snd_mixer_selem_get_playback_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, &value) < 0 ||
+                value != get_channel_volume_from_percent(min, max, set.volume_percent))
+            {
+                set.status = audio_device_volume_set_status::not_verified;
+                set.error = "playback volume not applied";
+                return false;
+            }
+        }
+
+        if (enum_device_type_has_flag(set.channel_type, audio_device_type::capture) && snd_mixer_selem_has_capture_volume(elem) && snd_mixer_selem_has_capture_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
+        {
+            if (snd_mixer_selem_get_capture_volume_range(elem, &min, &max) < 0 ||
+                snd_mixer_selem_get_capture_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, &value) < 0 ||
+                value != get_channel_volume_from_percent(min, max, set.volume_percent))
+            {
+                set.status = audio_device_volume_set_status::not_verified;
+                set.error = "capture volume not applied";
+                return false;
+            }
+        }
+    }
+
+    set.verified = true;
+
+    return true;
+}
+
+std::string to_json(const audio_device_volume_info& d, bool wrapping_object, int tabs)
+{
+    return to_json(d,
+        std::function<std::string(const audio_device_volume_info&)>{},
+        std::function<std::string(const audio_device_volume_info&, const audio_device_volume_control&)>{},
+        std::function<std::string(const audio_device_volume_info&, const audio_device_volume_control&, const audio_device_channel&)>{},
+        wrapping_object,
+        tabs);
+}
+
+std::string to_json(const audio_device_volume_info& d, std::function<std::string(const audio_device_volume_info& d)> render_device, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c)> render_control, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c, const audio_device_channel& ch)> render_channel, bool wrapping_object, int tabs)
+{
+    std::string s;
+    if (wrapping_object)
+    {
+        s.append("{\n");
+    }
+    s.append("    \"card_id\": \"" + std::to_string(d.audio_device.card_id) + "\",\n");
+    s.append("    \"device_id\": \"" + std::to_string(d.audio_device.device_id) + "\",\n");
+    s.append("    \"plughw_id\": \"" + d.audio_device.plughw_id + "\",\n");
+    s.append("    \"hw_id\": \"" + d.audio_device.hw_id + "\",\n");
+    s.append("    \"name\": \"" + d.audio_device.name + "\",\n");
+    s.append("    \"description\": \"" + d.audio_device.description + "\",\n");
+    s.append("    \"type\": \"" + to_string(d.audio_device.type) + "\",\n");
+    if (render_device)
+    {
+        std::string render_device_string = render_device(d);
+        if (!render_device_string.empty())
+        {
+            s.append(render_device_string);
+        }
+    }
+    s.append("    \"controls\": [\n");
+    for (size_t i = 0; i < d.controls.size(); i++)
+    {
+        s.append("        {\n");
+        s.append("            \"name\": \"" + d.controls[i].name + "\",\n");
+        if (render_control)
+        {
+            std::string render_control_string = render_control(d, d.controls[i]);
+            if (!render_control_string.empty())
+            {
+                s.append(render_control_string);
+            }
+        }
+        s.append("            \"channels\": [\n");
+        for (size_t j = 0; j < d.controls[i].channels.size(); j++)
+        {
+            s.append("                {\n");
+            s.append("                    \"name\": \"" + d.controls[i].channels[j].name + "\",\n");
+            s.append("                    \"type\": \"" + to_string(d.controls[i].channels[j].type) + "\",\n");
+            s.append("                    \"volume_percent\": \"" + std::to_string(d.controls[i].channels[j].volume_percent) + "\",\n");
+            s.append("                    \"volume\": \"" + std::to_string(d.controls[i].channels[j].volume) + "\",\n");
+            s.append("                    \"volume_min\": \"" + std::to_string(d.controls[i].channels[j].volume_min) + "\",\n");
+            s.append("                    \"volume_max\": \"" + std::to_string(d.controls[i].channels[j].volume_max) + "\",\n");
+            s.append("                    \"channel\": \"" + to_string(d.controls[i].channels[j].id) + "\"");
+            if (render_channel)
+            {
+                std::string render_channel_string = render_channel(d, d.controls[i], d.controls[i].channels[j]);
+                if (!render_channel_string.empty())
+                {
+                    s.append(",\n");
+                    s.append(render_channel_string);
+                }
+                else
+                {
+                    s.append("\n");
+                }
+            }
+            else
+            {
+                s.append("\n");
+            }
+            s.append("                }");
+            if ((j + 1) < d.controls[i].channels.size())
+                s.append(",");
+            s.append("\n");
+        }
+        s.append("            ]\n");
+        s.append("        }");
+        if ((i + 1) < d.controls.size())
+            s.append(",");
+        s.append("\n");
+    }
+    s.append("    ]");
+    if (wrapping_object)
+    {
+        s.append("\n");
+        s.append("}");
+    }
+    insert_tabs(s, tabs);
+    return s;
+}
+
+bool alsa_udev_device_backend::test_audio_device(const audio_device_info& device)
+{
+    int err;
+    snd_pcm_t* pcm_handle;
+    snd_pcm_hw_params_t* hw_params;
+    const unsigned int buffer_size = 1024;  // Specify the buffer size in frames
+    const unsigned int channels = 2;  // Number of audio channels
+    unsigned int sample_rate = 44100;  // Audio sample rate
+
+    // Open the ALSA device for playback
+    err = snd_pcm_open(&pcm_handle, device.hw_id.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0)
+    {
+        return false;
+    }
+
+    // Allocate and initialize hardware parameters object
+    snd_pcm_hw_params_alloca(&hw_params);
+    snd_pcm_hw_params_any(pcm_handle, hw_params);
+
+    // Set hardware parameters for desired configuration
+    snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+    snd_pcm_hw_params_set_format(pcm_handle, hw_params, SND_PCM_FORMAT_S16_LE);
+    snd_pcm_hw_params_set_channels(pcm_handle, hw_params, channels);
+    snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &sample_rate, 0);
+
+    // Apply the hardware parameters to the PCM device
+    err = snd_pcm_hw_params(pcm_handle, hw_params);
+    if (err < 0)
+    {
+        snd_pcm_close(pcm_handle);
+        return false;
+    }
+
+    // Create a buffer to store the zeros
+    short zeros[buffer_size * channels];
+    memset(zeros, 0, sizeof(zeros));
+
+    // Write the buffer of zeros to the PCM device
+    err = snd_pcm_writei(pcm_handle, zeros, buffer_size);
+    if (err < 0)
+    {
+        snd_pcm_close(pcm_handle);
+        return false;
+    }
+
+    // Close the PCM device
+    snd_pcm_close(pcm_handle);
+
+    return true;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// SERIAL PORTS                                                     //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+std::vector<serial_port> get_serial_ports();
+std::string to_json(const serial_port& p, bool wrapping_object, int tabs);
+
+std::vector<serial_port> alsa_udev_device_backend::get_serial_ports()
+{
+    trace_span span("get_serial_ports");
+
+    std::vector<serial_port> ports;
+
+    udev* udev = udev_new();
+    if (udev == nullptr)
+        return ports;
+
+    udev_enumerate* enumerate = udev_enumerate_new(udev);
+    if (enumerate == nullptr)
+    {
+        udev_unref(udev);
+        return ports;
+    }
+
+    // Only supports USB serial ports
+    // Consider using libusb, or USB sysfs in the future
+    // Could there be other types of serial ports that are not tty?
+
+    udev_enumerate_add_match_subsystem(enumerate, "tty");
+
+    {
+        scoped_metrics_timer timer(get_metrics_histogram("find_devices_udev_scan_duration_seconds", "scan", "serial_ports"));
+        udev_enumerate_scan_devices(enumerate);
+    }
+
+    udev_list_entry* devices = udev_enumerate_get_list_entry(enumerate);
+    if (devices == nullptr)
+    {
+        udev_enumerate_unref(enumerate);
+        udev_unref(udev);
+        return ports;
+    }
+
+    udev_list_entry* dev_list_entry;
+    udev_list_entry_foreach(dev_list_entry, devices)
+    {
+        const char* path = udev_list_entry_get_name(dev_list_entry);
+
+        udev_device* dev = udev_device_new_from_syspath(udev, path);
+        if (dev == nullptr)
+            continue;
+
+        const char* devnode = udev_device_get_devnode(dev);
+
+        udev_device* usb_dev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
+        if (usb_dev == nullptr)
+        {
+            udev_device_unref(dev);
+            continue;
+        }
+
+        // Other properties: udevadm info --attribute-walk --path=/sys/bus/usb-serial/devices/ttyUSB0
+        // To inspect the USB tree with libusb: lsusb -t
+        // 
+        // Source code location: https://github.com/systemd/systemd/blob/main/src/libudev/libudev-device.c
+
+        const char* manufacturer = udev_device_get_sysattr_value(usb_dev, "manufacturer");
+        const char* product = udev_device_get_sysattr_value(usb_dev, "product");
+        const char* serial = udev_device_get_sysattr_value(usb_dev, "serial");
+
+        serial_port port;
+
+        if (manufacturer != nullptr)
+            port.manufacturer = manufacturer;
+        if (serial != nullptr)
+            port.device_serial_number = serial;
+        if (product != nullptr)
+            port.description = product;
+        if (devnode != nullptr)
+            port.name = devnode;
+
+        ports.push_back(port);
+
+        udev_device_unref(dev);
+    }
+
+    udev_enumerate_unref(enumerate);
+    udev_unref(udev);
+
+    return ports;
+}
+
+std::string to_json(const serial_port& p, bool wrapping_object, int tabs)
+{
+    std::string s;
+    if (wrapping_object)
+    {
+        s.append("{\n");
+    }
+    s.append("    \"name\": \"" + p.name + "\",\n");
+    s.append("    \"description\": \"" + p.description + "\",\n");
+    s.append("    \"manufacturer\": \"" + p.manufacturer + "\",\n");
+    s.append("    \"device_serial_number\": \"" + p.device_serial_number + "\"");
+    if (wrapping_object)
+    {
+        s.append("\n");
+        s.append("}");
+    }
+    insert_tabs(s, tabs);
+    return s;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// DEVICES                                                          //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+bool try_get_device_description(const audio_device_info& d, device_description& desc);
+bool try_get_device_description(const serial_port& p, device_description& desc);
+bool try_get_device_description(std::function<void(udev_enumerate*)> filter, device_description& desc);
+bool try_get_device_description(udev* udev, udev_enumerate* enumerate, udev_device*& device, udev_device*& usb_device, device_description& desc);
+bool try_get_device_description(udev_device* device, udev_device*& usb_device, device_description& desc);
+void fetch_device_description(udev_device* device, udev_device* usb_device, device_description& desc);
+bool try_find_device(udev* udev, udev_enumerate* enumerate, udev_device*& device, udev_device*& usb_device);
+bool try_find_device(udev_device* device, udev_device*& usb_device);
+int get_topology_depth(udev_device* device);
+std::vector<device_description> get_sibling_audio_devices(const device_description& desc);
+std::vector<device_description> get_sibling_serial_ports(const device_description& desc);
+std::vector<device_description> get_sibling_devices(std::function<void(udev_enumerate*)> filter, const device_description& desc);
+std::vector<audio_device_info> get_audio_devices(const device_description& desc);
+bool try_get_serial_port(const device_description& desc, serial_port& port);
+std::string to_json(const device_description& d, bool wrapping_object, int tabs);
+
+bool alsa_udev_device_backend::try_get_device_description(const audio_device_info& d, device_description& desc)
+{
+    trace_span span("try_get_device_description", "hw_id", d.hw_id);
+
+    return ::try_get_device_description([&d](udev_enumerate* enumerate) {
+        udev_enumerate_add_match_subsystem(enumerate, "sound");
+        udev_enumerate_add_match_sysname(enumerate, fmt::format("card{}", d.card_id).c_str());
+        }, desc);
+}
+
+bool alsa_udev_device_backend::try_get_device_description(const serial_port& p, device_description& desc)
+{
+    trace_span span("try_get_device_description", "port", p.name);
+
+    return ::try_get_device_description([&p](udev_enumerate* enumerate) {
+        udev_enumerate_add_match_subsystem(enumerate, "tty");
+        udev_enumerate_add_match_property(enumerate, "DEVNAME", p.name.c_str());
+        }, desc);
+}
+
+bool try_get_device_description(std::function<void(udev_enumerate*)> filter, device_description& desc)
+{
+    bool found = false;
+
+    udev* udev = udev_new();
+    if (udev == nullptr)
+    {
+        return found;
+    }
+
+    udev_enumerate* enumerate = udev_enumerate_new(udev);
+    if (enumerate == nullptr)
+    {
+        udev_unref(udev);
+        return found;
+    }
+
+    filter(enumerate);
+
+    udev_device* device = nullptr;
+    udev_device* usb_device = nullptr;
+    found = try_get_device_description(udev, enumerate, device, usb_device, desc);
+
+    // NOTE: Should check that the device we found matched the filter? ex: udev_device_get_sysattr_value(dev, "number");
+    // Should check that only one enumeration?
+
+    udev_device_unref(device);
+    udev_enumerate_unref(enumerate);
+    udev_unref(udev);
+
+    return found;
+}
+
+bool try_get_device_description(udev* udev, udev_enumerate* enumerate, udev_device*& device, udev_device*& usb_device, device_description& desc)
+{
+    if (!try_find_device(udev, enumerate, device, usb_device))
+    {
+        return false;
+    }
+
+    fetch_device_description(device, usb_device, desc);
+
+    return true;
+}
+
+bool try_get_device_description(udev_device* device, udev_device*& usb_device, device_description& desc)
+{
+    if (!try_find_device(device, usb_device))
+    {
+        return false;
+    }
+
+    fetch_device_description(device, usb_device, desc);
+
+    return true;
+}
+
+void fetch_device_description(udev_device* device, udev_device* usb_device, device_description& desc)
+{
+    const char* syspath = udev_device_get_syspath(device);
+    const char* usb_syspath = udev_device_get_syspath(usb_device);
+    const char* busnum = udev_device_get_sysattr_value(usb_device, "busnum");
+    const char* devnum = udev_device_get_sysattr_value(usb_device, "devnum");
+    const char* dev_id_vendor = udev_device_get_sysattr_value(usb_device, "idVendor");
+    const char* dev_id_product = udev_device_get_sysattr_value(usb_device, "idProduct");
+    const char* dev_product = udev_device_get_sysattr_value(usb_device, "product");
+    const char* dev_manufacturer = udev_device_get_sysattr_value(usb_device, "manufacturer");
+    
+    // list of allocated devices, minor versions respect the order they are in
+    // https://mirrors.edge.kernel.org/pub/linux/docs/lanana/device-list/devices-2.6.txt
+    const char* dev = udev_device_get_sysattr_value(device, "dev");
+    if (dev != nullptr)
+    {
+        std::string major_minor_str(dev);
+        size_t colon_pos = major_minor_str.find(':');
+        if (colon_pos != std::string::npos)
+        {
+            try_parse_number(major_minor_str.substr(0, colon_pos), desc.major_number);
+            try_parse_number(major_minor_str.substr(colon_pos + 1), desc.minor_number);
+        }
+    }
+
+    if (busnum != nullptr)
+        try_parse_number(busnum, desc.bus_number);
+    if (devnum != nullptr)
+        try_parse_number(devnum, desc.device_number);
+    if (dev_id_product != nullptr)
+        desc.id_product = dev_id_product;
+    if (dev_id_vendor != nullptr)
+        desc.id_vendor = dev_id_vendor;
+    if (dev_product != nullptr)
+        desc.product = dev_product;
+    if (dev_manufacturer != nullptr)
+        desc.manufacturer = dev_manufacturer;
+    if (syspath != nullptr)
+        desc.path = syspath;
+    if (usb_syspath != nullptr)
+        desc.hw_path = usb_syspath;
+
+    desc.topology_depth = get_topology_depth(usb_device);
+}
+
+bool try_find_device(udev* udev, udev_enumerate* enumerate, udev_device*& device, udev_device*& usb_device)
+{
+    {
+        scoped_metrics_timer timer(get_metrics_histogram("find_devices_udev_scan_duration_seconds", "scan", "device"));
+        udev_enumerate_scan_devices(enumerate);
+    }
+
+    udev_list_entry* devices = udev_enumerate_get_list_entry(enumerate);
+    if (devices == nullptr)
+    {
+        return false;
+    }
+
+    device = udev_device_new_from_syspath(udev, udev_list_entry_get_name(devices));
+    if (device == nullptr)
+    {
+        return false;
+    }
+
+    usb_device = udev_device_get_parent_with_subsystem_devtype(device, "usb", "usb_device");
+
+    if (usb_device == nullptr)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool try_find_device(udev_device* device, udev_device*& usb_device)
+{
+    usb_device = udev_device_get_parent_with_subsystem_devtype(device, "usb", "usb_device");
+
+    if (usb_device == nullptr)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+int get_topology_depth(udev_device* device)
+{
+    int depth = 0;
+    udev_device* parent = device;
+    while (true)
+    {
+        parent = udev_device_get_parent(parent);
+        const char* subsystem = udev_device_get_subsystem(parent);
+        if (subsystem == nullptr || strlen(subsystem) == 0)
+            break;
+        depth++;
+    }
+    return depth;
+}
+
+std::vector<device_description> alsa_udev_device_backend::get_sibling_audio_devices(const device_description& desc)
+{
+    return get_sibling_devices([](udev_enumerate* enumerate) {
+        udev_enumerate_add_match_subsystem(enumerate, "sound");
+        udev_enumerate_add_match_sysname(enumerate, "card*");
+        }, desc);
+}
+
+std::vector<device_description> alsa_udev_device_backend::get_sibling_serial_ports(const device_description& desc)
+{
+    return get_sibling_devices([](udev_enumerate* enumerate) {
+        udev_enumerate_add_match_subsystem(enumerate, "tty");
+        }, desc);
+}
+
+std::vector<device_description> get_sibling_devices(std::function<void(udev_enumerate*)> filter, const device_description& desc)
+{
+    trace_span span("get_sibling_devices", "hw_path", desc.hw_path);
+    scoped_metrics_timer timer(get_metrics_histogram("find_devices_sibling_resolution_duration_seconds", "source", "udev"));
+
+    std::vector<device_description> siblings;
+
+    udev* udev = udev_new();
+    if (udev == nullptr)
+        return siblings;
+
+    udev_device* dev = nullptr;
+
+    // Get device from path
+    dev = udev_device_new_from_syspath(udev, desc.path.c_str());
+    if (dev == nullptr)
+    {
+        udev_unref(udev);
+        return siblings;
+    }
+
+    // Get the corresponding USB device
+    udev_device* usb_dev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
+    if (usb_dev == nullptr)
+    {
+        udev_device_unref(dev);
+        udev_unref(udev);
+        return siblings;
+    }
+
+    // Get the USB device's parent USB device
+    udev_device* parent_usb_dev = udev_device_get_parent_with_subsystem_devtype(usb_dev, "usb", "usb_device");
+    if (parent_usb_dev == nullptr)
+    {
+        udev_device_unref(dev);
+        udev_unref(udev);
+        return siblings;
+    }
+
+    udev_enumerate* enumerate = udev_enumerate_new(udev);
+    if (enumerate == nullptr)
+    {
+        udev_device_unref(dev);
+        udev_unref(udev);
+        return siblings;
+    }
+
+    udev_enumerate_add_match_parent(enumerate, parent_usb_dev);
+
+    filter(enumerate);
+
+    {
+        scoped_metrics_timer timer(get_metrics_histogram("find_devices_udev_scan_duration_seconds", "scan", "siblings"));
+        udev_enumerate_scan_devices(enumerate);
+    }
+
+    udev_list_entry* sibling_list_entry = nullptr;
+    udev_device* sibling_dev = nullptr;
+    udev_list_entry* devices = udev_enumerate_get_list_entry(enumerate);
+
+    udev_list_entry_foreach(sibling_list_entry, devices)
+    {
+        const char* path = udev_list_entry_get_name(sibling_list_entry);
+        sibling_dev = udev_device_new_from_syspath(udev, path);
+        udev_device* sibling_usb_device;
+        device_description sibling_desc;
+        if (try_get_device_description(sibling_dev, sibling_usb_device, sibling_desc))
+            siblings.push_back(sibling_desc);
+        udev_device_unref(sibling_dev);
+    }
+
+    udev_device_unref(dev);
+    udev_enumerate_unref(enumerate);
+    udev_unref(udev);
+
+    return siblings;
+}
+
+std::vector<audio_device_info> alsa_udev_device_backend::get_audio_devices(const device_description& desc)
+{
+    std::vector<audio_device_info> devices;
+
+    udev* udev = udev_new();
+    if (!udev)
+        return devices;
+
+    udev_device* dev = nullptr;
+
+    // Get device from path
+    dev = udev_device_new_from_syspath(udev, desc.path.c_str());
+    if (dev == nullptr)
+    {
+        udev_unref(udev);
+        return devices;
+    }
+
+    const char* card_id_str = udev_device_get_sysattr_value(dev, "number");
+    int card_id;
+    if (card_id_str != nullptr && try_parse_number(card_id_str, card_id))
+        devices = ::get_audio_devices(card_id);
+
+    udev_device_unref(dev);
+    udev_unref(udev);
+
+    return devices;
+}
+
+bool alsa_udev_device_backend::try_get_serial_port(const device_description& desc, serial_port& port)
+{
+    udev* udev = udev_new();
+    if (!udev)
+        return false;
+
+    udev_device* dev = nullptr;
+
+    // Get device from path
+    dev = udev_device_new_from_syspath(udev, desc.path.c_str());
+    if (dev == nullptr)
+    {
+        udev_unref(udev);
+        return false;
+    }
+
+    bool found = false;
+
+    const char* devnode = udev_device_get_devnode(dev);
+
+    for (const serial_port& p : get_serial_ports())
+    {
+        if (p.name == devnode)
+        {
+            port = p;
+            found = true;
+            break;
+        }
+    }
+
+    udev_device_unref(dev);
+    udev_unref(udev);
+
+    return found;
+}
+
+std::string to_json(const device_description& d, bool wrapping_object, int tabs)
+{
+    std::string s;
+    if (wrapping_object)
+    {
+        s.append("{\n");
+    }
+    s.append("    \"bus_number\": \"" + std::to_string(d.bus_number) + "\",\n");
+    s.append("    \"device_number\": \"" + std::to_string(d.device_number) + "\",\n");
+    s.append("    \"major_number\": \"" + std::to_string(d.major_number) + "\",\n");
+    s.append("    \"minor_number\": \"" + std::to_string(d.minor_number) + "\",\n");
+    s.append("    \"id_product\": \"" + d.id_product + "\",\n");
+    s.append("    \"id_vendor\": \"" + d.id_vendor + "\",\n");
+    s.append("    \"device_manufacturer\": \"" + d.manufacturer + "\",\n");
+    s.append("    \"path\": \"" + d.path + "\",\n");
+    s.append("    \"hw_path\": \"" + d.hw_path + "\",\n");
+    s.append("    \"product\": \"" + d.product + "\",\n");
+    s.append("    \"topology_depth\": \"" + std::to_string(d.topology_depth) + "\"");
+    if (wrapping_object)
+    {
+        s.append("\n");
+        s.append("}");
+    }
+    insert_tabs(s, tabs);
+    return s;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// DEVICE SNAPSHOT                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+bool try_get_uevent_seqnum(uint64_t& seqnum);
+bool try_get_boot_id(std::string& boot_id);
+bool is_device_snapshot_current(const device_snapshot& snapshot);
+device_snapshot get_device_snapshot();
+bool try_get_sibling_path_prefix(const device_description& desc, std::string& prefix);
+std::vector<std::pair<audio_device_info, device_description>> get_sibling_audio_devices(const device_snapshot& snapshot, const device_description& desc);
+std::vector<std::pair<serial_port, device_description>> get_sibling_serial_ports(const device_snapshot& snapshot, const device_description& desc);
+
+bool try_get_uevent_seqnum(uint64_t& seqnum)
+{
+    // The kernel increments the sequence number for every uevent,
+    // including every hot-plug, so an unchanged number means an unchanged device tree
+
+    std::ifstream file("/sys/kernel/uevent_seqnum");
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    uint64_t value = 0;
+    file >> value;
+    if (file.fail())
+    {
+        return false;
+    }
+
+    seqnum = value;
+
+    return true;
+}
+
+bool try_get_boot_id(std::string& boot_id)
+{
+    // The uevent sequence number restarts on every boot
+
+    std::ifstream file("/proc/sys/kernel/random/boot_id");
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::string value;
+    std::getline(file, value);
+    if (value.empty())
+    {
+        return false;
+    }
+
+    boot_id = value;
+
+    return true;
+}
+
+bool is_device_snapshot_current(const device_snapshot& snapshot)
+{
+    std::string boot_id;
+    uint64_t seqnum = 0;
+
+    if (!try_get_boot_id(boot_id) || !try_get_uevent_seqnum(seqnum))
+    {
+        return false;
+    }
+
+    return snapshot.boot_id == boot_id && snapshot.uevent_seqnum == seqnum;
+}
+
+device_snapshot get_device_snapshot()
+{
+    trace_span span("get_device_snapshot");
+
+    device_snapshot snapshot;
+
+    // Retry if a hot-plug happens during the enumeration,
+    // so that the sequence number describes the devices in the snapshot
+
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        snapshot = device_snapshot{};
+
+        uint64_t seqnum_before = 0;
+        try_get_boot_id(snapshot.boot_id);
+        try_get_uevent_seqnum(seqnum_before);
+
+        for (const auto& d : get_audio_devices())
+        {
+            device_description desc;
+            if (!try_get_device_description(d, desc))
+                desc = device_description{};
+            snapshot.devices.push_back(std::make_pair(d, desc));
+        }
+
+        for (const auto& p : get_serial_ports())
+        {
+            device_description desc;
+            if (!try_get_device_description(p, desc))
+                desc = device_description{};
+            snapshot.ports.push_back(std::make_pair(p, desc));
+        }
+
+        uint64_t seqnum_after = 0;
+        try_get_uevent_seqnum(seqnum_after);
+
+        snapshot.uevent_seqnum = seqnum_after;
+
+        if (seqnum_before == seqnum_after)
+        {
+            break;
+        }
+    }
+
+    return snapshot;
+}
+
+bool try_get_sibling_path_prefix(const device_description& desc, std::string& prefix)
+{
+    // Siblings are devices connected to the same parent USB device (hub) in the topology,
+    // in sysfs the parent USB device is the parent directory of the USB device path
+
+    if (desc.hw_path.empty())
+    {
+        return false;
+    }
+
+    size_t pos = desc.hw_path.find_last_of('/');
+    if (pos == std::string::npos || pos == 0)
+    {
+        return false;
+    }
+
+    prefix = desc.hw_path.substr(0, pos + 1);
+
+    return true;
+}
+
+std::vector<std::pair<audio_device_info, device_description>> get_sibling_audio_devices(const device_snapshot& snapshot, const device_description& desc)
+{
+    scoped_metrics_timer timer(get_metrics_histogram("find_devices_sibling_resolution_duration_seconds", "source", "snapshot"));
+
+    std::vector<std::pair<audio_device_info, device_description>> siblings;
+
+    std::string prefix;
+    if (!try_get_sibling_path_prefix(desc, prefix))
+    {
+        return siblings;
+    }
+
+    for (const auto& d : snapshot.devices)
+    {
+        if (d.second.path.compare(0, prefix.size(), prefix) == 0)
+            siblings.push_back(d);
+    }
+
+    return siblings;
+}
+
+std::vector<std::pair<serial_port, device_description>> get_sibling_serial_ports(const device_snapshot& snapshot, const device_description& desc)
+{
+    scoped_metrics_timer timer(get_metrics_histogram("find_devices_sibling_resolution_duration_seconds", "source", "snapshot"));
+
+    std::vector<std::pair<serial_port, device_description>> siblings;
+
+    std::string prefix;
+    if (!try_get_sibling_path_prefix(desc, prefix))
+    {
+        return siblings;
+    }
+
+    for (const auto& p : snapshot.ports)
+    {
+        if (p.second.path.compare(0, prefix.size(), prefix) == 0)
+            siblings.push_back(p);
+    }
+
+    return siblings;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// DEVICE BACKEND                                                   //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+void set_device_backend(std::shared_ptr<device_backend> backend);
+std::shared_ptr<device_backend> get_device_backend();
+bool is_system_device_backend();
+bool try_get_sibling_path_prefix(const device_description& desc, std::string& prefix);
+bool try_set_fake_channel_volume(audio_device_channel& channel, long value);
+fake_audio_card* find_fake_audio_card(fake_device_backend& backend, int card_id);
+void add_device_backend_call(recording_device_backend& backend, std::chrono::steady_clock::time_point start, const device_backend_call& call);
+const device_backend_call* replay_device_backend_call(replay_device_backend& backend, const std::string& name, const std::string& key);
+std::string get_device_backend_call_key(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value);
+std::string get_device_backend_call_key(int card_id, const std::vector<audio_device_channel_volume_set>& sets, bool verify);
+bool try_write_device_recording(const std::string& path, recording_device_backend& backend);
+std::string to_compact_json(const device_backend_call& call);
+std::string to_compact_json(const audio_device_info& d);
+std::string to_compact_json(const audio_device_volume_control& c);
+std::string to_compact_json(const audio_device_channel_volume_set& set);
+std::string to_compact_json(const serial_port& p);
+std::string to_compact_json(const device_description& d);
+
+namespace
+{
+    // The mutex only guards the replacement of the pointer, the calls run on a copy outside of it
+    std::mutex current_device_backend_mutex;
+    std::shared_ptr<device_backend> current_device_backend = std::make_shared<alsa_udev_device_backend>();
+}
+
+void set_device_backend(std::shared_ptr<device_backend> backend)
+{
+    if (backend == nullptr)
+    {
+        backend = std::make_shared<alsa_udev_device_backend>();
+    }
+
+    // The previous backend is released outside of the lock
+
+    std::lock_guard<std::mutex> lock(current_device_backend_mutex);
+    current_device_backend.swap(backend);
+}
+
+std::shared_ptr<device_backend> get_device_backend()
+{
+    std::lock_guard<std::mutex> lock(current_device_backend_mutex);
+    return current_device_backend;
+}
+
+bool is_system_device_backend()
+{
+    std::shared_ptr<device_backend> backend = get_device_backend();
+
+    while (auto recording = std::dynamic_pointer_cast<recording_device_backend>(backend))
+    {
+        backend = recording->backend;
+    }
+
+    return std::dynamic_pointer_cast<alsa_udev_device_backend>(backend) != nullptr;
+}
+
+std::vector<audio_device_info> get_audio_devices()
+{
+    return get_device_backend()->get_audio_devices();
+}
+
+bool try_get_audio_device(int card_id, int device_id, audio_device_info& device)
+{
+    return get_device_backend()->try_get_audio_device(card_id, device_id, device);
+}
+
+bool can_use_audio_device(const audio_device_info& device)
+{
+    return get_device_backend()->can_use_audio_device(device);
+}
+
+bool test_audio_device(const audio_device_info& device)
+{
+    return get_device_backend()->test_audio_device(device);
+}
+
+bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume)
+{
+    return get_device_backend()->try_get_audio_device_volume(device, volume);
+}
+
+bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume)
+{
+    return get_device_backend()->try_set_audio_device_volume(device, control_name, channel, channel_type, volume);
+}
+
+bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume)
+{
+    return get_device_backend()->try_set_audio_device_volume_percent(device, control_name, channel, channel_type, volume);
+}
+
+bool try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify)
+{
+    return get_device_backend()->try_set_audio_device_volume_percent(card_id, sets, verify);
+}
+
+std::vector<serial_port> get_serial_ports()
+{
+    return get_device_backend()->get_serial_ports();
+}
+
+bool try_get_device_description(const audio_device_info& d, device_description& desc)
+{
+    return get_device_backend()->try_get_device_description(d, desc);
+}
+
+bool try_get_device_description(const serial_port& p, device_description& desc)
+{
+    return get_device_backend()->try_get_device_description(p, desc);
+}
+
+std::vector<device_description> get_sibling_audio_devices(const device_description& desc)
+{
+    return get_device_backend()->get_sibling_audio_devices(desc);
+}
+
+std::vector<device_description> get_sibling_serial_ports(const device_description& desc)
+{
+    return get_device_backend()->get_sibling_serial_ports(desc);
+}
+
+std::vector<audio_device_info> get_audio_devices(const device_description& desc)
+{
+    return get_device_backend()->get_audio_devices(desc);
+}
+
+bool try_get_serial_port(const device_description& desc, serial_port& port)
+{
+    return get_device_backend()->try_get_serial_port(desc, port);
+}
+
+std::vector<audio_device_info> fake_device_backend::get_audio_devices()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<audio_device_info> devices;
+    for (const auto& card : cards)
+    {
+        devices.insert(devices.end(), card.devices.begin(), card.devices.end());
+    }
+    return devices;
+}
+
+bool fake_device_backend::try_get_audio_device(int card_id, int device_id, audio_device_info& device)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    fake_audio_card* card = find_fake_audio_card(*this, card_id);
+    if (card == nullptr)
+    {
+        return false;
+    }
+    for (const auto& d : card->devices)
+    {
+        if (d.device_id == device_id)
+        {
+            device = d;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool fake_device_backend::can_use_audio_device(const audio_device_info& device)
+{
+    audio_device_info d;
+    return try_get_audio_device(device.card_id, device.device_id, d);
+}
+
+bool fake_device_backend::test_audio_device(const audio_device_info& device)
+{
+    return can_use_audio_device(device);
+}
+
+bool fake_device_backend::try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    volume.audio_device = device;
+    volume.controls.clear();
+
+    fake_audio_card* card = find_fake_audio_card(*this, device.card_id);
+    if (card == nullptr)
+    {
+        return false;
+    }
+
+    volume.controls = card->controls;
+
+    return true;
+}
+
+bool fake_device_backend::try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    fake_audio_card* card = find_fake_audio_card(*this, device.card_id);
+    if (card == nullptr)
+    {
+        return false;
+    }
+
+    for (auto& control : card->controls)
+    {
+        if (control.name != control_name)
+            continue;
+        for (auto& c : control.channels)
+        {
+            if (c.id == channel && c.type == channel_type)
+                return try_set_fake_channel_volume(c, value);
+        }
+    }
+
+    return false;
+}
+
+bool fake_device_backend::try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    fake_audio_card* card = find_fake_audio_card(*this, device.card_id);
+    if (card == nullptr)
+    {
+        return false;
+    }
+
+    for (auto& control : card->controls)
+    {
+        if (control.name != control_name)
+            continue;
+        for (auto& c : control.channels)
+        {
+            if (c.id == channel && c.type == channel_type)
+                return try_set_fake_channel_volume(c, get_channel_volume_from_percent(c.volume_min, c.volume_max, value));
+        }
+    }
+
+    return false;
+}
+
+bool fake_device_backend::try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    fake_audio_card* card = find_fake_audio_card(*this, card_id);
+
+    bool result = true;
+
+    for (auto& set : sets)
+    {
+        set.success = false;
+        set.verified = false;
+        set.status = audio_device_volume_set_status::not_applied;
+        set.error.clear();
+
+        if (card == nullptr)
+        {
+            set.status = audio_device_volume_set_status::device_not_found;
+            set.error = "No such device";
+            result = false;
+            continue;
+        }
+
+        auto control = std::find_if(card->controls.begin(), card->controls.end(), [&set](const audio_device_volume_control& c) { return c.name == set.control_name; });
+        if (control == card->controls.end())
+        {
+            set.status = audio_device_volume_set_status::control_not_found;
+            set.error = "control not found";
+            result = false;
+            continue;
+        }
+
+        int applied_count = 0;
+
+        for (auto& c : control->channels)
+        {
+            if (set.channel != audio_device_channel_id::none && set.channel != c.id)
+                continue;
+            if (!enum_device_type_has_flag(set.channel_type, c.type))
+                continue;
+            try_set_fake_channel_volume(c, get_channel_volume_from_percent(c.volume_min, c.volume_max, set.volume_percent));
+            applied_count++;
+        }
+
+        if (applied_count == 0)
+        {
+            set.status = audio_device_volume_set_status::channel_not_found;
+            set.error = "channel not found";
+            result = false;
+            continue;
+        }
+
+        // The fake mixer applies every value exactly
+        set.success = true;
+        set.status = audio_device_volume_set_status::applied;
+        set.verified = verify;
+    }
+
+    return result;
+}
+
+std::vector<serial_port> fake_device_backend::get_serial_ports()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<serial_port> result;
+    for (const auto& p : ports)
+    {
+        result.push_back(p.port);
+    }
+    return result;
+}
+
+bool fake_device_backend::try_get_device_description(const audio_device_info& d, device_description& desc)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    fake_audio_card* card = find_fake_audio_card(*this, d.card_id);
+    if (card == nullptr || card->description.path.empty())
+    {
+        return false;
+    }
+    desc = card->description;
+    return true;
+}
+
+bool fake_device_backend::try_get_device_description(const serial_port& p, device_description& desc)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& port : ports)
+    {
+        if (port.port.name == p.name && !port.description.path.empty())
+        {
+            desc = port.description;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<device_description> fake_device_backend::get_sibling_audio_devices(const device_description& desc)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<device_description> siblings;
+    std::string prefix;
+    if (!try_get_sibling_path_prefix(desc, prefix))
+    {
+        return siblings;
+    }
+    for (const auto& card : cards)
+    {
+        if (card.description.path.compare(0, prefix.size(), prefix) == 0)
+            siblings.push_back(card.description);
+    }
+    return siblings;
+}
+
+std::vector<device_description> fake_device_backend::get_sibling_serial_ports(const device_description& desc)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<device_description> siblings;
+    std::string prefix;
+    if (!try_get_sibling_path_prefix(desc, prefix))
+    {
+        return siblings;
+    }
+    for (const auto& port : ports)
+    {
+        if (port.description.path.compare(0, prefix.size(), prefix) == 0)
+            siblings.push_back(port.description);
+    }
+    return siblings;
+}
+
+std::vector<audio_device_info> fake_device_backend::get_audio_devices(const device_description& desc)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& card : cards)
+    {
+        if (!desc.path.empty() && card.description.path == desc.path)
+            return card.devices;
+    }
+    return {};
+}
+
+bool fake_device_backend::try_get_serial_port(const device_description& desc, serial_port& port)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& p : ports)
+    {
+        if (!desc.path.empty() && p.description.path == desc.path)
+        {
+            port = p.port;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool try_set_fake_channel_volume(audio_device_channel& channel, long value)
+{
+    // Clamped to the range of the channel, like the drivers do
+
+    if (channel.volume_max <= channel.volume_min)
+    {
+        return false;
+    }
+
+    value = std::clamp(value, (long)channel.volume_min, (long)channel.volume_max);
+
+    channel.volume = (int)value;
+    channel.volume_percent = (int)std::rint((value - channel.volume_min) * 100.0 / (double)(channel.volume_max - channel.volume_min));
+    channel.volume_percent_linearized = channel.volume_percent;
+
+    return true;
+}
+
+fake_audio_card* find_fake_audio_card(fake_device_backend& backend, int card_id)
+{
+    for (auto& card : backend.cards)
+    {
+        if (card.card_id == card_id)
+            return &card;
+    }
+    return nullptr;
+}
+
+recording_device_backend::recording_device_backend(std::shared_ptr<device_backend> backend) : backend(backend)
+{
+}
+
+std::vector<audio_device_info> recording_device_backend::get_audio_devices()
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "get_audio_devices";
+    call.devices = backend->get_audio_devices();
+    call.result = true;
+    add_device_backend_call(*this, start, call);
+    return call.devices;
+}
+
+bool recording_device_backend::try_get_audio_device(int card_id, int device_id, audio_device_info& device)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "try_get_audio_device";
+    call.key = fmt::format("{},{}", card_id, device_id);
+    call.result = backend->try_get_audio_device(card_id, device_id, device);
+    if (call.result)
+        call.devices.push_back(device);
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+bool recording_device_backend::can_use_audio_device(const audio_device_info& device)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "can_use_audio_device";
+    call.key = device.hw_id;
+    call.result = backend->can_use_audio_device(device);
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+bool recording_device_backend::test_audio_device(const audio_device_info& device)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "test_audio_device";
+    call.key = device.hw_id;
+    call.result = backend->test_audio_device(device);
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+bool recording_device_backend::try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "try_get_audio_device_volume";
+    call.key = device.hw_id;
+    call.result = backend->try_get_audio_device_volume(device, volume);
+    call.controls = volume.controls;
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+bool recording_device_backend::try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "try_set_audio_device_volume";
+    call.key = get_device_backend_call_key(device, control_name, channel, channel_type, value);
+    call.result = backend->try_set_audio_device_volume(device, control_name, channel, channel_type, value);
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+bool recording_device_backend::try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "try_set_audio_device_volume_percent";
+    call.key = get_device_backend_call_key(device, control_name, channel, channel_type, value);
+    call.result = backend->try_set_audio_device_volume_percent(device, control_name, channel, channel_type, value);
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+bool recording_device_backend::try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "try_set_audio_device_volume_percent";
+    call.key = get_device_backend_call_key(card_id, sets, verify);
+    call.result = backend->try_set_audio_device_volume_percent(card_id, sets, verify);
+    call.sets = sets;
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+std::vector<serial_port> recording_device_backend::get_serial_ports()
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "get_serial_ports";
+    call.ports = backend->get_serial_ports();
+    call.result = true;
+    add_device_backend_call(*this, start, call);
+    return call.ports;
+}
+
+bool recording_device_backend::try_get_device_description(const audio_device_info& d, device_description& desc)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "try_get_audio_device_description";
+    call.key = d.hw_id;
+    call.result = backend->try_get_device_description(d, desc);
+    if (call.result)
+        call.descriptions.push_back(desc);
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+bool recording_device_backend::try_get_device_description(const serial_port& p, device_description& desc)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "try_get_serial_port_description";
+    call.key = p.name;
+    call.result = backend->try_get_device_description(p, desc);
+    if (call.result)
+        call.descriptions.push_back(desc);
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+std::vector<device_description> recording_device_backend::get_sibling_audio_devices(const device_description& desc)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "get_sibling_audio_devices";
+    call.key = desc.path;
+    call.descriptions = backend->get_sibling_audio_devices(desc);
+    call.result = true;
+    add_device_backend_call(*this, start, call);
+    return call.descriptions;
+}
+
+std::vector<device_description> recording_device_backend::get_sibling_serial_ports(const device_description& desc)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "get_sibling_serial_ports";
+    call.key = desc.path;
+    call.descriptions = backend->get_sibling_serial_ports(desc);
+    call.result = true;
+    add_device_backend_call(*this, start, call);
+    return call.descriptions;
+}
+
+std::vector<audio_device_info> recording_device_backend::get_audio_devices(const device_description& desc)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "get_audio_devices_of_description";
+    call.key = desc.path;
+    call.devices = backend->get_audio_devices(desc);
+    call.result = true;
+    add_device_backend_call(*this, start, call);
+    return call.devices;
+}
+
+bool recording_device_backend::try_get_serial_port(const device_description& desc, serial_port& port)
+{
+    auto start = std::chrono::steady_clock::now();
+    device_backend_call call;
+    call.name = "try_get_serial_port";
+    call.key = desc.path;
+    call.result = backend->try_get_serial_port(desc, port);
+    if (call.result)
+        call.ports.push_back(port);
+    add_device_backend_call(*this, start, call);
+    return call.result;
+}
+
+void add_device_backend_call(recording_device_backend& backend, std::chrono::steady_clock::time_point start, const device_backend_call& call)
+{
+    auto duration = std::chrono::steady_clock::now() - start;
+
+    std::lock_guard<std::mutex> lock(backend.mutex);
+    backend.calls.push_back(call);
+    backend.calls.back().duration_microseconds = (int)std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+std::vector<audio_device_info> replay_device_backend::get_audio_devices()
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "get_audio_devices", "");
+    return call != nullptr ? call->devices : std::vector<audio_device_info>{};
+}
+
+bool replay_device_backend::try_get_audio_device(int card_id, int device_id, audio_device_info& device)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "try_get_audio_device", fmt::format("{},{}", card_id, device_id));
+    if (call == nullptr || !call->result || call->devices.empty())
+    {
+        return false;
     }
-    else if (lowercase_channel_str == "side left") 
+    device = call->devices[0];
+    return true;
+}
+
+bool replay_device_backend::can_use_audio_device(const audio_device_info& device)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "can_use_audio_device", device.hw_id);
+    return call != nullptr && call->result;
+}
+
+bool replay_device_backend::test_audio_device(const audio_device_info& device)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "test_audio_device", device.hw_id);
+    return call != nullptr && call->result;
+}
+
+bool replay_device_backend::try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume)
+{
+    volume.audio_device = device;
+    volume.controls.clear();
+
+    const device_backend_call* call = replay_device_backend_call(*this, "try_get_audio_device_volume", device.hw_id);
+    if (call == nullptr)
     {
-        type = audio_device_channel_id::side_left;
-        return true;
+        return false;
     }
-    else if (lowercase_channel_str == "side right") 
+
+    volume.controls = call->controls;
+
+    return call->result;
+}
+
+bool replay_device_backend::try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "try_set_audio_device_volume", get_device_backend_call_key(device, control_name, channel, channel_type, value));
+    return call != nullptr && call->result;
+}
+
+bool replay_device_backend::try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "try_set_audio_device_volume_percent", get_device_backend_call_key(device, control_name, channel, channel_type, value));
+    return call != nullptr && call->result;
+}
+
+bool replay_device_backend::try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "try_set_audio_device_volume_percent", get_device_backend_call_key(card_id, sets, verify));
+
+    for (size_t i = 0; i < sets.size(); i++)
     {
-        type = audio_device_channel_id::side_right;
-        return true;
+        if (call != nullptr && i < call->sets.size())
+        {
+            sets[i].success = call->sets[i].success;
+            sets[i].verified = call->sets[i].verified;
+            sets[i].status = call->sets[i].status;
+            sets[i].error = call->sets[i].error;
+        }
+        else
+        {
+            sets[i].success = false;
+            sets[i].verified = false;
+            sets[i].status = audio_device_volume_set_status::failed;
+            sets[i].error = "not recorded";
+        }
     }
-    else if (lowercase_channel_str == "mono") 
+
+    return call != nullptr && call->result;
+}
+
+std::vector<serial_port> replay_device_backend::get_serial_ports()
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "get_serial_ports", "");
+    return call != nullptr ? call->ports : std::vector<serial_port>{};
+}
+
+bool replay_device_backend::try_get_device_description(const audio_device_info& d, device_description& desc)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "try_get_audio_device_description", d.hw_id);
+    if (call == nullptr || !call->result || call->descriptions.empty())
     {
-        type = audio_device_channel_id::mono;
-        return true;
+        return false;
     }
-    else if (lowercase_channel_str == "none")
+    desc = call->descriptions[0];
+    return true;
+}
+
+bool replay_device_backend::try_get_device_description(const serial_port& p, device_description& desc)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "try_get_serial_port_description", p.name);
+    if (call == nullptr || !call->result || call->descriptions.empty())
     {
-        type = audio_device_channel_id::none;
-        return true;
+        return false;
     }
+    desc = call->descriptions[0];
+    return true;
+}
 
-    return false;
+std::vector<device_description> replay_device_backend::get_sibling_audio_devices(const device_description& desc)
+{
+    const device_backend_call* call = replay_device_backend_call(*this, "get_sibling_audio_devices", desc.path);
+    return call != nullptr ? call->descriptions : std::vector<device_description>{};
 }
 
-std::string to_string(const audio_device_type& deviceType)
+std::vector<device_description> replay_device_backend::get_sibling_serial_ports(const device_description& desc)
 {
-    if (deviceType == audio_device_type::capture)
-        return std::string("capture");
-    else if (deviceType == audio_device_type::playback)
-        return std::string("playback");
-    else if (deviceType == audio_device_type::uknown)
-        return std::string("unknown");
-    else if ((deviceType & audio_device_type::capture) != (audio_device_type)0 && (deviceType & audio_device_type::playback) != (audio_device_type)0)
-        return std::string("capture&playback");
-    return std::string("");
+    const device_backend_call* call = replay_device_backend_call(*this, "get_sibling_serial_ports", desc.path);
+    return call != nullptr ? call->descriptions : std::vector<device_description>{};
 }
 
-std::string to_string(const audio_device_info& d)
+std::vector<audio_device_info> replay_device_backend::get_audio_devices(const device_description& desc)
 {
-    return std::string("card id: '") + std::to_string(d.card_id) + "', " +
-        "device id: '" + std::to_string(d.device_id) +
-        "', name: '" + d.name +
-        "', desc: '" + d.description +
-        "', type: '" + to_string(d.type) + "'";
+    const device_backend_call* call = replay_device_backend_call(*this, "get_audio_devices_of_description", desc.path);
+    return call != nullptr ? call->devices : std::vector<audio_device_info>{};
 }
 
-std::string to_string(const audio_device_channel_id& type)
+bool replay_device_backend::try_get_serial_port(const device_description& desc, serial_port& port)
 {
-    switch (type)
+    const device_backend_call* call = replay_device_backend_call(*this, "try_get_serial_port", desc.path);
+    if (call == nullptr || !call->result || call->ports.empty())
     {
-    case audio_device_channel_id::front_left:
-        return "front_left";
-    case audio_device_channel_id::front_right:
-        return "front_right";
-    case audio_device_channel_id::front_center:
-        return "front_center";
-    case audio_device_channel_id::rear_left:
-        return "rear_left";
-    case audio_device_channel_id::rear_right:
-        return "rear_right";
-    case audio_device_channel_id::rear_center:
-        return "rear_center";
-    case audio_device_channel_id::woofer:
-        return "woofer";
-    case audio_device_channel_id::side_left:
-        return "side_left";
-    case audio_device_channel_id::side_right:
-        return "side_right";
-    case audio_device_channel_id::mono:
-        return "mono";
-    case audio_device_channel_id::none:
-        return "none";
-    default:
-        return "";
+        return false;
     }
+    port = call->ports[0];
+    return true;
 }
 
-std::string to_json(const std::vector<audio_device_info>& devices)
+const device_backend_call* replay_device_backend_call(replay_device_backend& backend, const std::string& name, const std::string& key)
 {
-    std::string s;
-    s.append("{\n");
-    s.append("    \"devices\": [\n");
-    for (size_t i = 0; i < devices.size(); i++)
+    const device_backend_call* call = nullptr;
+
     {
-        const audio_device_info& d = devices[i];
-        s.append(to_json(d, 2));
-        if ((i + 1) < devices.size())
+        std::lock_guard<std::mutex> lock(backend.mutex);
+
+        if (backend.call_index.empty())
         {
-            s.append(",");
+            for (size_t i = 0; i < backend.calls.size(); i++)
+            {
+                backend.call_index[backend.calls[i].name + '\n' + backend.calls[i].key].push_back(i);
+            }
+        }
+
+        auto it = backend.call_index.find(name + '\n' + key);
+        if (it == backend.call_index.end())
+        {
+            return nullptr;
+        }
+
+        size_t& position = backend.call_positions[it->first];
+        call = &backend.calls[it->second[position]];
+        if ((position + 1) < it->second.size())
+        {
+            position++;
         }
-        s.append("\n");
     }
-    s.append("    ]\n");
-    s.append("}\n");
-    return s;
+
+    // The latency is replayed outside of the lock, concurrent calls overlap like they did when recorded
+
+    if (backend.time_scale > 0 && call->duration_microseconds > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(call->duration_microseconds * backend.time_scale)));
+    }
+
+    return call;
 }
 
-std::string to_json(const audio_device_info& d, bool wrapping_object, int tabs)
+std::string get_device_backend_call_key(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value)
+{
+    return fmt::format("{}/{}/{}/{}/{}", device.hw_id, control_name, to_string(channel), (int)channel_type, value);
+}
+
+std::string get_device_backend_call_key(int card_id, const std::vector<audio_device_channel_volume_set>& sets, bool verify)
+{
+    std::string key = fmt::format("{}/{}", card_id, verify);
+    for (const auto& set : sets)
+    {
+        key += fmt::format("/{}/{}/{}/{}", set.control_name, to_string(set.channel), (int)set.channel_type, set.volume_percent);
+    }
+    return key;
+}
+
+bool try_write_device_recording(const std::string& path, recording_device_backend& backend)
 {
+    // One call per line, the enums are written as numbers
+
     std::string s;
-    if (wrapping_object)
     {
-        s.append("{\n");
+        std::lock_guard<std::mutex> lock(backend.mutex);
+
+        s += "{\n";
+        s += "    \"calls\": [\n";
+        for (size_t i = 0; i < backend.calls.size(); i++)
+        {
+            s += "        ";
+            s += to_compact_json(backend.calls[i]);
+            if ((i + 1) < backend.calls.size())
+            {
+                s += ",";
+            }
+            s += "\n";
+        }
+        s += "    ]\n";
+        s += "}\n";
     }
-    s.append("    \"card_id\": \"" + std::to_string(d.card_id) + "\",\n");
-    s.append("    \"device_id\": \"" + std::to_string(d.device_id) + "\",\n");
-    s.append("    \"plughw_id\": \"" + d.plughw_id + "\",\n");
-    s.append("    \"hw_id\": \"" + d.hw_id + "\",\n");
-    s.append("    \"name\": \"" + d.name + "\",\n");
-    s.append("    \"description\": \"" + d.description + "\",\n");
-    s.append("    \"type\": \"" + to_string(d.type) + "\"");
-    if (wrapping_object)
+
+    return try_write_file_atomically(path, s);
+}
+
+std::string to_compact_json(const device_backend_call& call)
+{
+    auto append_list = [](std::string& s, const char* name, const auto& items)
     {
-        s.append("\n");
-        s.append("}");
+        if (items.empty())
+        {
+            return;
+        }
+        s += fmt::format(", \"{}\": [", name);
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (i > 0)
+                s += ", ";
+            s += to_compact_json(items[i]);
+        }
+        s += "]";
+    };
+
+    std::string s = fmt::format("{{ \"name\": \"{}\", \"key\": \"{}\", \"result\": \"{}\", \"duration_microseconds\": \"{}\"",
+        call.name, to_trace_string(call.key), call.result, call.duration_microseconds);
+    append_list(s, "devices", call.devices);
+    append_list(s, "controls", call.controls);
+    append_list(s, "sets", call.sets);
+    append_list(s, "ports", call.ports);
+    append_list(s, "descriptions", call.descriptions);
+    s += " }";
+    return s;
+}
+
+std::string to_compact_json(const audio_device_info& d)
+{
+    return fmt::format("{{ \"card_id\": \"{}\", \"device_id\": \"{}\", \"hw_id\": \"{}\", \"plughw_id\": \"{}\", \"name\": \"{}\", \"stream_name\": \"{}\", \"description\": \"{}\", \"type\": \"{}\" }}",
+        d.card_id, d.device_id, to_trace_string(d.hw_id), to_trace_string(d.plughw_id), to_trace_string(d.name), to_trace_string(d.stream_name), to_trace_string(d.description), (int)d.type);
+}
+
+std::string to_compact_json(const audio_device_volume_control& c)
+{
+    std::string s = fmt::format("{{ \"name\": \"{}\", \"channels\": [", to_trace_string(c.name));
+    for (size_t i = 0; i < c.channels.size(); i++)
+    {
+        const audio_device_channel& ch = c.channels[i];
+        if (i > 0)
+            s += ", ";
+        s += fmt::format("{{ \"name\": \"{}\", \"type\": \"{}\", \"channel\": \"{}\", \"volume\": \"{}\", \"volume_min\": \"{}\", \"volume_max\": \"{}\", \"volume_percent\": \"{}\", \"volume_percent_linearized\": \"{}\" }}",
+            to_trace_string(ch.name), (int)ch.type, (int)ch.id, ch.volume, ch.volume_min, ch.volume_max, ch.volume_percent, ch.volume_percent_linearized);
     }
-    insert_tabs(s, tabs);
+    s += "] }";
     return s;
 }
 
-std::vector<audio_device_info> get_audio_devices()
+std::string to_compact_json(const audio_device_channel_volume_set& set)
+{
+    return fmt::format("{{ \"control_name\": \"{}\", \"channel\": \"{}\", \"channel_type\": \"{}\", \"volume_percent\": \"{}\", \"success\": \"{}\", \"verified\": \"{}\", \"status\": \"{}\", \"error\": \"{}\" }}",
+        to_trace_string(set.control_name), (int)set.channel, (int)set.channel_type, set.volume_percent, set.success, set.verified, (int)set.status, to_trace_string(set.error));
+}
+
+std::string to_compact_json(const serial_port& p)
+{
+    return fmt::format("{{ \"name\": \"{}\", \"description\": \"{}\", \"manufacturer\": \"{}\", \"device_serial_number\": \"{}\" }}",
+        to_trace_string(p.name), to_trace_string(p.description), to_trace_string(p.manufacturer), to_trace_string(p.device_serial_number));
+}
+
+std::string to_compact_json(const device_description& d)
+{
+    return fmt::format("{{ \"bus_number\": \"{}\", \"device_number\": \"{}\", \"major_number\": \"{}\", \"minor_number\": \"{}\", \"id_product\": \"{}\", \"id_vendor\": \"{}\", \"device_manufacturer\": \"{}\", \"path\": \"{}\", \"hw_path\": \"{}\", \"product\": \"{}\", \"topology_depth\": \"{}\" }}",
+        d.bus_number, d.device_number, d.major_number, d.minor_number, to_trace_string(d.id_product), to_trace_string(d.id_vendor), to_trace_string(d.manufacturer), to_trace_string(d.path), to_trace_string(d.hw_path), to_trace_string(d.product), d.topology_depth);
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// DEVICE MONITOR                                                   //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+bool try_create_device_monitor(device_monitor& monitor);
+bool wait_for_device_change(device_monitor& monitor, int timeout_milliseconds);
+void close_device_monitor(device_monitor& monitor);
+bool try_create_mixer_monitor(const std::vector<int>& card_ids, mixer_monitor& monitor);
+bool wait_for_mixer_change(mixer_monitor& monitor, int timeout_milliseconds, std::vector<int>& changed_card_ids);
+void close_mixer_monitor(mixer_monitor& monitor);
+
+device_monitor::~device_monitor()
+{
+    close_device_monitor(*this);
+}
+
+bool try_create_device_monitor(device_monitor& monitor)
 {
-    std::vector<audio_device_info> devices;
+    close_device_monitor(monitor);
 
-    int card_id = -1;
-    int err = -1;
+    monitor.udev_context = udev_new();
+    if (monitor.udev_context == nullptr)
+    {
+        return false;
+    }
 
-    // ALSA sample code: https://github.com/bear24rw/alsa-utils/blob/master/aplay/aplay.c
+    monitor.monitor = udev_monitor_new_from_netlink(monitor.udev_context, "udev");
+    if (monitor.monitor == nullptr)
+    {
+        close_device_monitor(monitor);
+        return false;
+    }
 
-    // Consider using snd_device_name_hint and snd_device_name_get_hint
-    // for more portability, simplicity and support of non PCM devices
-    // Can use snd_ctl_rawmidi_next_device for MIDI devices.
+    udev_monitor_filter_add_match_subsystem_devtype(monitor.monitor, "sound", nullptr);
+    udev_monitor_filter_add_match_subsystem_devtype(monitor.monitor, "tty", nullptr);
+    udev_monitor_filter_add_match_subsystem_devtype(monitor.monitor, "usb", "usb_device");
 
-    // Iterate over all available sound cards
-    while (true)
+    if (udev_monitor_enable_receiving(monitor.monitor) < 0)
     {
-        err = snd_card_next(&card_id);
-        if (err != 0 || card_id < 0)
-            break;
-        std::vector<audio_device_info> devices_for_card = get_audio_devices(card_id);
-        devices.insert(devices.end(), devices_for_card.begin(), devices_for_card.end());
+        close_device_monitor(monitor);
+        return false;
     }
 
-    return devices;
+    return true;
 }
 
-std::vector<audio_device_info> get_audio_devices(int card_id)
+bool wait_for_device_change(device_monitor& monitor, int timeout_milliseconds)
 {
-    std::vector<audio_device_info> devices;
-
-    snd_ctl_t* ctl_handle = nullptr;
-    int err = -1;
-
-    // ALSA sample code: https://github.com/bear24rw/alsa-utils/blob/master/aplay/aplay.c
-
-    // Consider using snd_device_name_hint and snd_device_name_get_hint
-    // for more portability, simplicity and support of non PCM devices
-    // Can use snd_ctl_rawmidi_next_device for MIDI devices.
+    if (monitor.monitor == nullptr)
+    {
+        return false;
+    }
 
-    err = snd_ctl_open(&ctl_handle, fmt::format("hw:{}", card_id).c_str(), 0);
-    if (err != 0)
-        return devices;;
+    pollfd fd = {};
+    fd.fd = udev_monitor_get_fd(monitor.monitor);
+    fd.events = POLLIN;
 
-    // Iterate over all available PCM devices on the current card
-    int device_id = -1;
-    while (true)
+    if (poll(&fd, 1, timeout_milliseconds) <= 0)
     {
-        err = snd_ctl_pcm_next_device(ctl_handle, &device_id);
-        if (err != 0)
-            continue;
-        if (device_id < 0)
-            break;
-
-        audio_device_info device;
+        return false;
+    }
 
-        if (!try_get_audio_device(card_id, device_id, ctl_handle, device))
-            continue;
+    // A hot-plug produces a burst of events, drain them all at once
 
-        devices.push_back(device);
+    bool changed = false;
+    udev_device* device = nullptr;
+    while ((device = udev_monitor_receive_device(monitor.monitor)) != nullptr)
+    {
+        changed = true;
+        udev_device_unref(device);
     }
 
-    snd_ctl_close(ctl_handle);
-
-    return devices;
+    return changed;
 }
 
-bool try_get_audio_device(int card_id, snd_ctl_t*& ctl_handle)
+void close_device_monitor(device_monitor& monitor)
 {
-    int err = snd_ctl_open(&ctl_handle, fmt::format("hw:{}", card_id).c_str(), 0);
-    if (err != 0)
+    if (monitor.monitor != nullptr)
     {
-        return false;
+        udev_monitor_unref(monitor.monitor);
     }
-    return true;
+    if (monitor.udev_context != nullptr)
+    {
+        udev_unref(monitor.udev_context);
+    }
+    monitor.monitor = nullptr;
+    monitor.udev_context = nullptr;
 }
 
-bool try_get_audio_device(int card_id, int device_id, snd_ctl_t* ctl_handle, audio_device_info& device)
+mixer_monitor::~mixer_monitor()
 {
-    snd_pcm_info_t* pcm_info = nullptr;
-    int err = -1;
-
-    snd_pcm_info_alloca(&pcm_info);
-
-    // NOTE: find a better way to identify playback or capture in one go
+    close_mixer_monitor(*this);
+}
 
-    snd_pcm_info_set_device(pcm_info, device_id);
-    snd_pcm_info_set_subdevice(pcm_info, 0);
-    snd_pcm_info_set_stream(pcm_info, SND_PCM_STREAM_CAPTURE);
+bool try_create_mixer_monitor(const std::vector<int>& card_ids, mixer_monitor& monitor)
+{
+    close_mixer_monitor(monitor);
 
-    err = snd_ctl_pcm_info(ctl_handle, pcm_info);
+    // Cards whose mixer cannot be opened are not monitored
 
-    if (err < 0)
+    for (int card_id : card_ids)
     {
-        snd_pcm_info_set_device(pcm_info, device_id);
-        snd_pcm_info_set_subdevice(pcm_info, 0);
-        snd_pcm_info_set_stream(pcm_info, SND_PCM_STREAM_PLAYBACK);
+        snd_mixer_t* handle;
 
-        err = snd_ctl_pcm_info(ctl_handle, pcm_info);
-
-        if (err < 0)
+        if (snd_mixer_open(&handle, 0) < 0)
         {
-            return false;
+            continue;
         }
-        else
+
+        if (snd_mixer_attach(handle, ("hw:" + std::to_string(card_id)).c_str()) < 0 ||
+            snd_mixer_selem_register(handle, nullptr, nullptr) < 0 ||
+            load_audio_device_mixer(handle, card_id) < 0)
         {
-            device.type = audio_device_type::playback;
+            snd_mixer_close(handle);
+            continue;
         }
-    }
-    else
-    {
-        device.type = audio_device_type::capture;
-    }
-
-    device.card_id = card_id;
-    device.device_id = device_id;
-
-    // snd_card_get_name and snd_card_get_longname are implemented here:
-    // https://github.com/torvalds/linux/blob/master/sound/usb/card.c
-
-    char* name = nullptr;
-    err = snd_card_get_name(card_id, &name);
-    if (err != 0)
-        device.name = "Unknown";
-    else
-        device.name = name;
 
-    device.stream_name = snd_pcm_info_get_name(pcm_info);
-
-    char* long_name = nullptr;
-    err = snd_card_get_longname(card_id, &long_name);
-    if (err != 0)
-        device.description = "Unknown";
-    else
-        device.description = long_name;
+        monitor.mixers.emplace_back(card_id, handle);
+    }
 
-    device.hw_id = fmt::format("hw:{},{}", device.card_id, device.device_id);
-    device.plughw_id = fmt::format("plughw:{},{}", device.card_id, device.device_id);
+    return !monitor.mixers.empty();
+}
 
-    // Use snd_pcm_info_get_subdevices_avail, snd_pcm_info_set_subdevice, snd_ctl_pcm_info and
-    // snd_pcm_info_get_subdevice_name to enumerate all subdevices
-    // example here: https://github.com/bear24rw/alsa-utils/blob/master/aplay/aplay.c
+bool wait_for_mixer_change(mixer_monitor& monitor, int timeout_milliseconds, std::vector<int>& changed_card_ids)
+{
+    changed_card_ids.clear();
 
-    if (device.type == audio_device_type::capture)
+    if (monitor.mixers.empty())
     {
-        snd_pcm_info_set_device(pcm_info, device_id);
-        snd_pcm_info_set_subdevice(pcm_info, 0);
-        snd_pcm_info_set_stream(pcm_info, SND_PCM_STREAM_PLAYBACK);
+        return false;
+    }
 
-        err = snd_ctl_pcm_info(ctl_handle, pcm_info);
+    std::vector<pollfd> fds;
+    std::vector<size_t> fd_counts;
 
-        if (err >= 0)
+    for (const auto& [card_id, handle] : monitor.mixers)
+    {
+        int count = snd_mixer_poll_descriptors_count(handle);
+        if (count < 0)
         {
-            device.type = device.type | audio_device_type::playback;
+            count = 0;
+        }
+        size_t offset = fds.size();
+        fds.resize(offset + count);
+        if (count > 0)
+        {
+            count = snd_mixer_poll_descriptors(handle, fds.data() + offset, count);
+            fds.resize(offset + std::max(count, 0));
         }
+        fd_counts.push_back(fds.size() - offset);
     }
 
-    return true;
-}
+    if (poll(fds.data(), fds.size(), timeout_milliseconds) <= 0)
+    {
+        return false;
+    }
 
-bool can_use_audio_device(const audio_device_info& device, snd_pcm_stream_t mode)
-{
-    snd_pcm_t* handle;
+    // Only the mixers with pending events are handled, the events also update the cached values
+    // A removed card reports an error, its mixer stops being monitored
 
-    int err = snd_pcm_open(&handle, device.hw_id.c_str(), mode, SND_PCM_NONBLOCK);
+    std::vector<std::pair<int, snd_mixer_t*>> mixers;
 
-    if (err < 0)
+    size_t offset = 0;
+    for (size_t i = 0; i < monitor.mixers.size(); i++)
     {
-        if (err == -EBUSY)
+        auto [card_id, handle] = monitor.mixers[i];
+        unsigned short revents = 0;
+
+        if (fd_counts[i] > 0 && snd_mixer_poll_descriptors_revents(handle, fds.data() + offset, fd_counts[i], &revents) < 0)
         {
-            // Device is busy, cannot open
-            return false;
+            revents = POLLERR;
         }
-        else if (err == -ENODEV)
+
+        offset += fd_counts[i];
+
+        if (revents & (POLLERR | POLLHUP | POLLNVAL))
         {
-            // Device does not exist or is not available
-            return false;
+            snd_mixer_close(handle);
+            changed_card_ids.push_back(card_id);
+            continue;
         }
-        else
+
+        if ((revents & POLLIN) && snd_mixer_handle_events(handle) > 0)
         {
-            // Other error occurred, handle it as needed
-            return false;
+            changed_card_ids.push_back(card_id);
         }
+
+        mixers.emplace_back(card_id, handle);
     }
 
-    snd_pcm_close(handle);
+    monitor.mixers = std::move(mixers);
 
-    return true;
+    return !changed_card_ids.empty();
 }
 
-bool can_use_audio_device(const audio_device_info& device)
+void close_mixer_monitor(mixer_monitor& monitor)
 {
-    if (device.type == audio_device_type::capture)
-    {
-        return can_use_audio_device(device, SND_PCM_STREAM_CAPTURE);
-    }
-    else if (device.type == audio_device_type::playback)
-    {
-        return can_use_audio_device(device, SND_PCM_STREAM_PLAYBACK);
-    }
-    else if (enum_device_type_has_flag(device.type, audio_device_type::capture) &&
-        enum_device_type_has_flag(device.type, audio_device_type::playback))
+    for (const auto& [card_id, handle] : monitor.mixers)
     {
-        return can_use_audio_device(device, SND_PCM_STREAM_CAPTURE) &&
-            can_use_audio_device(device, SND_PCM_STREAM_PLAYBACK);
+        snd_mixer_close(handle);
     }
-    return false;
+    monitor.mixers.clear();
 }
 
 // **************************************************************** //
 //                                                                  //
 //                                                                  //
-// AUDIO DEVICE VOLUME                                              //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// DEVICE SNAPSHOT FILE                                             //
+//                                                                  //
+//                                                                  //
+//                                                                  //
 //                                                                  //
 //                                                                  //
 // **************************************************************** //
 
-bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume);
-bool try_get_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_volume);
-bool try_get_capture_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result);
-bool try_get_playback_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result);
-bool try_get_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_db_range, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_volume, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_db);
-bool try_get_playback_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result);
-bool try_get_capture_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result);
-audio_device_channel_id parse_audio_device_channel_id(int channel_id);
-int parse_audio_device_channel_type(audio_device_channel_id type);
-bool use_linear_dB_scale(long db_min, long db_max);
-bool try_set_audio_device_volume(const audio_device_info& device, int volume);
-bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel);
-bool try_set_audio_device_volume(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel);
-bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume);
-bool try_set_audio_device_volume_percent(const audio_device_info& device, int volume);
-bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel);
-bool try_set_audio_device_volume_percent(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel);
-bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume);
-bool try_set_audio_device_volume(const audio_device_info& device, int volume, std::function<void(audio_device_channel& channel, int volume)> apply_volume, std::function<bool(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)> set_volume);
-bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume, std::function<bool((snd_mixer_elem_t* elem, int channel_id, int value))> playback_setter, std::function<bool((snd_mixer_elem_t* elem, int channel_id, int value))> capture_setter);
-bool try_set_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value)> set_volume);
-bool try_set_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value)> set_volume);
-bool try_set_playback_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value);
-bool try_set_playback_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value);
-bool try_set_capture_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value);
-bool try_set_capture_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value);
-std::string to_json(const audio_device_volume_info& d, bool wrapping_object, int tabs);
-std::string to_json(const audio_device_volume_info& d, std::function<std::string(const audio_device_volume_info& d)> render_device, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c)> render_control, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c, const audio_device_channel& ch)> render_channel, bool wrapping_object, int tabs);
-bool test_audio_device(const audio_device_info& device);
+// File layout, all offsets are from the start of the file and aligned to 8 bytes:
+//
+//   snapshot_file_header
+//   snapshot_audio_device_record[audio_device_count]
+//   snapshot_serial_port_record[serial_port_count]
+//   snapshot_index_entry[index_size]
+//   string table
+//
+// Records refer to strings by offset and length into the string table,
+// the index is an open addressing hash table with linear probing
 
-bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume)
+namespace
 {
-    bool result = true;
-
-    volume.audio_device = device;
-    volume.controls.clear();
+    const char snapshot_file_magic[8] = { 'F', 'D', 'S', 'N', 'A', 'P', '\0', '\0' };
+    const uint32_t snapshot_file_version = 1;
 
-    int err;
-    snd_mixer_t* handle;
-    snd_mixer_selem_id_t* sid;
-
-    snd_mixer_open(&handle, 0);
-
-    // NOTE: can get the error message with snd_strerror(err)
-
-    if ((err = snd_mixer_open(&handle, 0)) < 0)
+    struct snapshot_string
     {
-        return false;
-    }
+        uint32_t offset;
+        uint32_t length;
+    };
 
-    if ((err = snd_mixer_attach(handle, ("hw:" + std::to_string(device.card_id)).c_str())) < 0)
+    struct snapshot_file_header
     {
-        snd_mixer_close(handle);
-        return false;
-    }
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t file_size;
+        uint64_t uevent_seqnum;
+        snapshot_string boot_id;
+        uint32_t audio_device_count;
+        uint32_t serial_port_count;
+        uint64_t audio_devices_offset;
+        uint64_t serial_ports_offset;
+        uint64_t index_offset;
+        uint64_t index_size;
+        uint64_t strings_offset;
+        uint64_t strings_size;
+    };
+
+    struct snapshot_description_record
+    {
+        int32_t bus_number;
+        int32_t device_number;
+        int32_t topology_depth;
+        int32_t major_number;
+        int32_t minor_number;
+        uint32_t reserved;
+        snapshot_string path;
+        snapshot_string hw_path;
+        snapshot_string id_vendor;
+        snapshot_string id_product;
+        snapshot_string product;
+        snapshot_string manufacturer;
+    };
+
+    struct snapshot_audio_device_record
+    {
+        snapshot_string hw_id;
+        snapshot_string plughw_id;
+        snapshot_string name;
+        snapshot_string stream_name;
+        snapshot_string description;
+        int32_t card_id;
+        int32_t device_id;
+        int32_t type;
+        uint32_t reserved;
+        snapshot_description_record device;
+    };
+
+    struct snapshot_serial_port_record
+    {
+        snapshot_string name;
+        snapshot_string description;
+        snapshot_string manufacturer;
+        snapshot_string device_serial_number;
+        snapshot_description_record device;
+    };
+
+    enum class snapshot_index_key : uint32_t
+    {
+        empty = 0,
+        audio_hw_id = 1,
+        audio_vendor_product = 2,
+        port_devnode = 3,
+        port_vendor_product = 4,
+        port_serial_number = 5
+    };
+
+    struct snapshot_index_entry
+    {
+        uint64_t hash;
+        uint32_t key;
+        uint32_t record;
+    };
 
-    if ((err = snd_mixer_selem_register(handle, nullptr, nullptr)) < 0)
+    static_assert(sizeof(snapshot_file_header) % 8 == 0);
+    static_assert(sizeof(snapshot_audio_device_record) % 8 == 0);
+    static_assert(sizeof(snapshot_serial_port_record) % 8 == 0);
+    static_assert(sizeof(snapshot_index_entry) % 8 == 0);
+
+    uint64_t hash_snapshot_key(snapshot_index_key key, std::string_view a, std::string_view b = {})
     {
-        snd_mixer_close(handle);
-        return false;
+        // 64-bit FNV-1a over the key type and the key strings
+        uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash](unsigned char c) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        };
+        add((unsigned char)key);
+        for (unsigned char c : a)
+            add(c);
+        add(0);
+        for (unsigned char c : b)
+            add(c);
+        // Zero hashes are reserved for empty slots
+        return hash == 0 ? 1 : hash;
     }
 
-    if ((err = snd_mixer_load(handle)) < 0)
+    size_t align_to_8(size_t n)
     {
-        snd_mixer_close(handle);
-        return false;
+        return (n + 7) & ~(size_t)7;
     }
+}
 
-    snd_mixer_selem_id_malloc(&sid);
-    snd_mixer_selem_id_set_index(sid, 0);
-
-    snd_mixer_elem_t* elem = nullptr;
+std::string_view get_string(const mapped_device_snapshot& snapshot, const snapshot_string& s);
+bool is_valid_header(const mapped_device_snapshot& snapshot);
+const snapshot_file_header& get_header(const mapped_device_snapshot& snapshot);
+const snapshot_audio_device_record& get_audio_device_record(const mapped_device_snapshot& snapshot, size_t index);
+const snapshot_serial_port_record& get_serial_port_record(const mapped_device_snapshot& snapshot, size_t index);
+device_description get_description(const mapped_device_snapshot& snapshot, const snapshot_description_record& r);
+void get_audio_device(const mapped_device_snapshot& snapshot, const snapshot_audio_device_record& r, audio_device_info& device, device_description& desc);
+void get_serial_port(const mapped_device_snapshot& snapshot, const snapshot_serial_port_record& r, serial_port& port, device_description& desc);
+std::vector<uint32_t> find_records(const mapped_device_snapshot& snapshot, snapshot_index_key key, std::function<bool(uint32_t record)> match, uint64_t hash);
+
+mapped_device_snapshot::~mapped_device_snapshot()
+{
+    unmap_device_snapshot(*this);
+}
 
-    for (elem = snd_mixer_first_elem(handle); elem; elem = snd_mixer_elem_next(elem))
+bool try_write_device_snapshot(const std::string& path, const device_snapshot& snapshot)
+{
+    std::string strings;
+
+    auto add_string = [&strings](const std::string& s) {
+        snapshot_string result;
+        result.offset = (uint32_t)strings.size();
+        result.length = (uint32_t)s.size();
+        strings += s;
+        return result;
+    };
+
+    auto make_description = [&add_string](const device_description& d) {
+        snapshot_description_record r = {};
+        r.bus_number = d.bus_number;
+        r.device_number = d.device_number;
+        r.topology_depth = d.topology_depth;
+        r.major_number = d.major_number;
+        r.minor_number = d.minor_number;
+        r.path = add_string(d.path);
+        r.hw_path = add_string(d.hw_path);
+        r.id_vendor = add_string(d.id_vendor);
+        r.id_product = add_string(d.id_product);
+        r.product = add_string(d.product);
+        r.manufacturer = add_string(d.manufacturer);
+        return r;
+    };
+
+    std::vector<snapshot_audio_device_record> devices;
+    std::vector<snapshot_serial_port_record> ports;
+    std::vector<std::pair<uint64_t, std::pair<snapshot_index_key, uint32_t>>> keys;
+
+    snapshot_file_header header = {};
+    memcpy(header.magic, snapshot_file_magic, sizeof(header.magic));
+    header.version = snapshot_file_version;
+    header.header_size = sizeof(snapshot_file_header);
+    header.uevent_seqnum = snapshot.uevent_seqnum;
+    header.boot_id = add_string(snapshot.boot_id);
+
+    for (const auto& [d, desc] : snapshot.devices)
     {
-        snd_mixer_selem_get_id(elem, sid);
+        snapshot_audio_device_record r = {};
+        r.hw_id = add_string(d.hw_id);
+        r.plughw_id = add_string(d.plughw_id);
+        r.name = add_string(d.name);
+        r.stream_name = add_string(d.stream_name);
+        r.description = add_string(d.description);
+        r.card_id = d.card_id;
+        r.device_id = d.device_id;
+        r.type = (int32_t)d.type;
+        r.device = make_description(desc);
+        uint32_t record = (uint32_t)devices.size();
+        devices.push_back(r);
+        keys.push_back({ hash_snapshot_key(snapshot_index_key::audio_hw_id, d.hw_id), { snapshot_index_key::audio_hw_id, record } });
+        if (!desc.id_vendor.empty() || !desc.id_product.empty())
+            keys.push_back({ hash_snapshot_key(snapshot_index_key::audio_vendor_product, desc.id_vendor, desc.id_product), { snapshot_index_key::audio_vendor_product, record } });
+    }
 
-        if (!snd_mixer_selem_has_capture_volume(elem) && !snd_mixer_selem_has_playback_volume(elem))
-        {
-            continue;
-        }
+    for (const auto& [p, desc] : snapshot.ports)
+    {
+        snapshot_serial_port_record r = {};
+        r.name = add_string(p.name);
+        r.description = add_string(p.description);
+        r.manufacturer = add_string(p.manufacturer);
+        r.device_serial_number = add_string(p.device_serial_number);
+        r.device = make_description(desc);
+        uint32_t record = (uint32_t)ports.size();
+        ports.push_back(r);
+        keys.push_back({ hash_snapshot_key(snapshot_index_key::port_devnode, p.name), { snapshot_index_key::port_devnode, record } });
+        if (!desc.id_vendor.empty() || !desc.id_product.empty())
+            keys.push_back({ hash_snapshot_key(snapshot_index_key::port_vendor_product, desc.id_vendor, desc.id_product), { snapshot_index_key::port_vendor_product, record } });
+        if (!p.device_serial_number.empty())
+            keys.push_back({ hash_snapshot_key(snapshot_index_key::port_serial_number, p.device_serial_number), { snapshot_index_key::port_serial_number, record } });
+    }
 
-        audio_device_volume_control volume_control;
+    // Keep the index at most half full, sized as a power of two for masking
 
-        volume_control.name = snd_mixer_selem_get_name(elem);
+    size_t index_size = 8;
+    while (index_size < keys.size() * 2)
+        index_size *= 2;
 
-        for (int channel_id = 0; channel_id <= SND_MIXER_SCHN_REAR_CENTER; channel_id++)
-        {
-            if (!snd_mixer_selem_has_playback_channel(elem, (snd_mixer_selem_channel_id_t)channel_id) &&
-                !snd_mixer_selem_has_capture_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
-                continue;
+    std::vector<snapshot_index_entry> index(index_size, snapshot_index_entry{});
+    for (const auto& [hash, value] : keys)
+    {
+        size_t slot = hash & (index_size - 1);
+        while (index[slot].key != (uint32_t)snapshot_index_key::empty)
+            slot = (slot + 1) & (index_size - 1);
+        index[slot].hash = hash;
+        index[slot].key = (uint32_t)value.first;
+        index[slot].record = value.second;
+    }
 
-            audio_device_channel channel;
+    header.audio_device_count = (uint32_t)devices.size();
+    header.serial_port_count = (uint32_t)ports.size();
+    header.audio_devices_offset = sizeof(snapshot_file_header);
+    header.serial_ports_offset = header.audio_devices_offset + devices.size() * sizeof(snapshot_audio_device_record);
+    header.index_offset = header.serial_ports_offset + ports.size() * sizeof(snapshot_serial_port_record);
+    header.index_size = index_size;
+    header.strings_offset = header.index_offset + index_size * sizeof(snapshot_index_entry);
+    header.strings_size = strings.size();
+    header.file_size = align_to_8(header.strings_offset + strings.size());
+
+    std::string content(header.file_size, '\0');
+    memcpy(content.data(), &header, sizeof(header));
+    if (devices.size() > 0)
+        memcpy(content.data() + header.audio_devices_offset, devices.data(), devices.size() * sizeof(snapshot_audio_device_record));
+    if (ports.size() > 0)
+        memcpy(content.data() + header.serial_ports_offset, ports.data(), ports.size() * sizeof(snapshot_serial_port_record));
+    memcpy(content.data() + header.index_offset, index.data(), index_size * sizeof(snapshot_index_entry));
+    memcpy(content.data() + header.strings_offset, strings.data(), strings.size());
+
+    // Readers which mapped the previous file keep using it until they unmap it
+
+    return try_write_file_atomically(path, content);
+}
 
-            channel.name = snd_mixer_selem_channel_name((snd_mixer_selem_channel_id_t)channel_id);
-            channel.id = parse_audio_device_channel_id(channel_id);
+bool try_map_device_snapshot(const std::string& path, mapped_device_snapshot& snapshot)
+{
+    unmap_device_snapshot(snapshot);
 
-            if (snd_mixer_selem_has_playback_volume(elem) && snd_mixer_selem_has_playback_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
-            {
-                channel.type = audio_device_type::playback;
-                result = try_get_playback_channel_volume(elem, channel_id, channel);
-                if (!result)
-                    break;
-                result = try_get_playback_channel_volume_percent_linearized(elem, channel_id, channel.volume_percent_linearized);
-                if (!result)
-                    break;
-                volume_control.channels.push_back(channel);
-            }
-            if (snd_mixer_selem_has_capture_volume(elem) && snd_mixer_selem_has_capture_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
-            {
-                channel.type = audio_device_type::capture;
-                result = try_get_capture_channel_volume(elem, channel_id, channel);
-                if (!result)
-                    break;
-                result = try_get_capture_channel_volume_percent_linearized(elem, channel_id, channel.volume_percent_linearized);
-                if (!result)
-                    break;
-                volume_control.channels.push_back(channel);
-            }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
 
-            // if (channel_id == 0 && snd_mixer_selem_is_playback_mono(elem))
-            // {
-            //     break;
-            // }
-        }
+    // A file owned by another user, ex: planted in a shared directory, is ignored
 
-        volume.controls.push_back(volume_control);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_uid != geteuid() || file_stat.st_size < (off_t)sizeof(snapshot_file_header))
+    {
+        close(fd);
+        return false;
     }
 
-    snd_mixer_selem_id_free(sid);
-    snd_mixer_close(handle);
+    void* data = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
 
-    return result;
-}
+    close(fd);
 
-bool try_get_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_volume)
-{
-    long min = 0, max = 0, value = 0;
-    int err;
-    err = get_volume_range(elem, &min, &max);
-    if (err < 0)
+    if (data == MAP_FAILED)
     {
         return false;
     }
-    err = get_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, &value);
-    if (err < 0)
+
+    snapshot.data = (const char*)data;
+    snapshot.size = (size_t)file_stat.st_size;
+
+    // Only the header is validated, once, the accessors and the records read the mapping in place
+
+    if (!is_valid_header(snapshot))
     {
+        unmap_device_snapshot(snapshot);
         return false;
     }
-    double result_double = ((value - min) * 100.0 / (double)(max - min));
-    result.volume_percent = (int)std::rint(result_double);
-    result.volume = value;
-    result.volume_min = min;
-    result.volume_max = max;
-    return true;
-}
 
-bool try_get_capture_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result)
-{
-    return try_get_channel_volume(elem, channel_id, result,
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_volume_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_capture_volume(elem, channel, value); });
+    return true;
 }
 
-bool try_get_playback_channel_volume(snd_mixer_elem_t* elem, int channel_id, audio_device_channel& result)
+void unmap_device_snapshot(mapped_device_snapshot& snapshot)
 {
-    return try_get_channel_volume(elem, channel_id, result,
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_volume_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_playback_volume(elem, channel, value); });
+    if (snapshot.data != nullptr)
+    {
+        munmap((void*)snapshot.data, snapshot.size);
+    }
+    snapshot.data = nullptr;
+    snapshot.size = 0;
 }
 
-bool try_get_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_db_range, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_volume, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value)> get_db)
+bool is_valid_header(const mapped_device_snapshot& snapshot)
 {
-    
-    // Some code from this function was copied from https://github.com/alsa-project/alsa-utils/blob/master/alsamixer/volume_mapping.c
-    // Copyright (c) 2010 Clemens Ladisch <clemens@ladisch.de>
-    // Licensed under ISC license.
-    // See copyright message at the top of this file.
+    if (snapshot.data == nullptr || snapshot.size < sizeof(snapshot_file_header))
+    {
+        return false;
+    }
 
-    long min, max, value;
-    double normalized, min_norm;
-    int err;    
+    snapshot_file_header header;
+    memcpy(&header, snapshot.data, sizeof(header));
 
-    err = get_db_range(elem, &min, &max);
-    if (err < 0 || min >= max)
+    if (memcmp(header.magic, snapshot_file_magic, sizeof(header.magic)) != 0 ||
+        header.version != snapshot_file_version ||
+        header.header_size != sizeof(snapshot_file_header) ||
+        header.file_size != snapshot.size)
     {
-        err = get_volume_range(elem, &min, &max);
-        if (err < 0 || min == max)
-        {
-			return false;
-        }
-        err = get_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, &value);
-        if (err < 0)
-        {
-			return false;
-        }
-        double result_double = ((value - min) * 100.0) / (double)(max - min);
-        result = (int)std::rint(result_double);
-        return true;
+        return false;
     }
 
-    err = get_db(elem, (snd_mixer_selem_channel_id_t)channel_id, &value);
-    if (err < 0)
+    // Every table must fit in the file, the bounds are checked by division so that a corrupt count cannot wrap around
+
+    auto fits = [&snapshot](uint64_t offset, uint64_t count, uint64_t record_size) {
+        return offset <= snapshot.size && count <= (snapshot.size - offset) / record_size;
+    };
+
+    if (!fits(header.audio_devices_offset, header.audio_device_count, sizeof(snapshot_audio_device_record)) ||
+        !fits(header.serial_ports_offset, header.serial_port_count, sizeof(snapshot_serial_port_record)) ||
+        !fits(header.index_offset, header.index_size, sizeof(snapshot_index_entry)) ||
+        !fits(header.strings_offset, header.strings_size, 1))
     {
-		return false;
+        return false;
     }
 
-    if (use_linear_dB_scale(min, max))
+    uint64_t devices_end = header.audio_devices_offset + (uint64_t)header.audio_device_count * sizeof(snapshot_audio_device_record);
+    uint64_t ports_end = header.serial_ports_offset + (uint64_t)header.serial_port_count * sizeof(snapshot_serial_port_record);
+    uint64_t index_end = header.index_offset + header.index_size * sizeof(snapshot_index_entry);
+
+    if (header.audio_devices_offset < sizeof(snapshot_file_header) ||
+        header.serial_ports_offset < devices_end ||
+        header.index_offset < ports_end ||
+        header.strings_offset < index_end ||
+        index_end > snapshot.size ||
+        header.index_size == 0 || (header.index_size & (header.index_size - 1)) != 0)
     {
-		double result_double = ((value - min) * 100.0) / (double)(max - min);
-        result = (int)std::rint(result_double);
-        return true;
+        return false;
     }
-    
-   	normalized = pow(10, (value - max) / 6000.0);
-    if (min != SND_CTL_TLV_DB_GAIN_MUTE)
+
+    // The tables are read in place, their offsets must keep the records aligned
+
+    if (header.audio_devices_offset % 8 != 0 ||
+        header.serial_ports_offset % 8 != 0 ||
+        header.index_offset % 8 != 0)
     {
-		min_norm = pow(10, (min - max) / 6000.0);
-		normalized = (normalized - min_norm) / (1 - min_norm);
-	}
-    
-    result = (int)std::rint(normalized * 100.0);
+        return false;
+    }
 
     return true;
 }
 
-bool try_get_playback_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result)
+const snapshot_file_header& get_header(const mapped_device_snapshot& snapshot)
 {
-    return try_get_channel_volume_percent_linearized(elem, channel_id, result,
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_dB_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_volume_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_playback_volume(elem, channel, value); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_playback_dB(elem, channel, value); });
+    // The mapping is page aligned, and only kept once its header is valid
+    return *reinterpret_cast<const snapshot_file_header*>(snapshot.data);
 }
 
-bool try_get_capture_channel_volume_percent_linearized(snd_mixer_elem_t* elem, int channel_id, int& result)
+const snapshot_audio_device_record& get_audio_device_record(const mapped_device_snapshot& snapshot, size_t index)
 {
-    return try_get_channel_volume_percent_linearized(elem, channel_id, result,
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_dB_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_volume_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_capture_volume(elem, channel, value); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) { return snd_mixer_selem_get_capture_dB(elem, channel, value); });
+    const snapshot_file_header& header = get_header(snapshot);
+    return *reinterpret_cast<const snapshot_audio_device_record*>(snapshot.data + header.audio_devices_offset + index * sizeof(snapshot_audio_device_record));
 }
 
-audio_device_channel_id parse_audio_device_channel_id(int channel_id)
+const snapshot_serial_port_record& get_serial_port_record(const mapped_device_snapshot& snapshot, size_t index)
 {
-    switch (channel_id)
-    {
-    case 0:
-        // if (snd_mixer_selem_has_playback_channel(elem, SND_MIXER_SCHN_MONO))
-        // {
-        //     channel.channel = audio_device_channel_type::mono;
-        // }
-        // else
-        // {
-        return audio_device_channel_id::front_left;
-        //}
-    case 1:
-        return audio_device_channel_id::front_right;
-    case 2:
-        return audio_device_channel_id::rear_left;
-    case 3:
-        return audio_device_channel_id::rear_right;
-    case 4:
-        return audio_device_channel_id::front_center;
-    case 5:
-        return audio_device_channel_id::woofer;
-    case 6:
-        return audio_device_channel_id::side_left;
-    case 7:
-        return audio_device_channel_id::side_right;
-    case 8:
-        return audio_device_channel_id::rear_center;
-    default:
-        return audio_device_channel_id::none;
-    }
+    const snapshot_file_header& header = get_header(snapshot);
+    return *reinterpret_cast<const snapshot_serial_port_record*>(snapshot.data + header.serial_ports_offset + index * sizeof(snapshot_serial_port_record));
 }
 
-int parse_audio_device_channel_type(audio_device_channel_id type)
+std::string_view get_string(const mapped_device_snapshot& snapshot, const snapshot_string& s)
 {
-    switch (type)
+    const snapshot_file_header& header = get_header(snapshot);
+    if ((uint64_t)s.offset + s.length > header.strings_size)
     {
-    case audio_device_channel_id::front_left:
-        return 0;
-    case audio_device_channel_id::front_right:
-        return 1;
-    case audio_device_channel_id::rear_left:
-        return 2;
-    case audio_device_channel_id::rear_right:
-        return 3;
-    case audio_device_channel_id::front_center:
-        return 4;
-    case audio_device_channel_id::woofer:
-        return 5;
-    case audio_device_channel_id::side_left:
-        return 6;
-    case audio_device_channel_id::side_right:
-        return 7;
-    case audio_device_channel_id::rear_center:
-        return 8;
-    default:
-        return 0;
+        return {};
     }
+    return std::string_view(snapshot.data + header.strings_offset + s.offset, s.length);
 }
 
-bool use_linear_dB_scale(long db_min, long db_max)
+device_description get_description(const mapped_device_snapshot& snapshot, const snapshot_description_record& r)
 {
-    constexpr int MAX_LINEAR_DB_SCALE =	24;
-	return (db_max - db_min) <= (MAX_LINEAR_DB_SCALE * 100);
+    device_description d;
+    d.bus_number = r.bus_number;
+    d.device_number = r.device_number;
+    d.topology_depth = r.topology_depth;
+    d.major_number = r.major_number;
+    d.minor_number = r.minor_number;
+    d.path = get_string(snapshot, r.path);
+    d.hw_path = get_string(snapshot, r.hw_path);
+    d.id_vendor = get_string(snapshot, r.id_vendor);
+    d.id_product = get_string(snapshot, r.id_product);
+    d.product = get_string(snapshot, r.product);
+    d.manufacturer = get_string(snapshot, r.manufacturer);
+    return d;
 }
 
-bool try_set_audio_device_volume(const audio_device_info& device, int volume)
+void get_audio_device(const mapped_device_snapshot& snapshot, const snapshot_audio_device_record& r, audio_device_info& device, device_description& desc)
 {
-    return try_set_audio_device_volume(device, volume, 
-        [](audio_device_channel& channel, int volume) { channel.volume = volume; },
-        [](const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel) { return try_set_audio_device_volume(device, control, channel); });
+    device.hw_id = get_string(snapshot, r.hw_id);
+    device.plughw_id = get_string(snapshot, r.plughw_id);
+    device.name = get_string(snapshot, r.name);
+    device.stream_name = get_string(snapshot, r.stream_name);
+    device.description = get_string(snapshot, r.description);
+    device.card_id = r.card_id;
+    device.device_id = r.device_id;
+    device.type = (audio_device_type)r.type;
+    desc = get_description(snapshot, r.device);
 }
 
-bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel)
+void get_serial_port(const mapped_device_snapshot& snapshot, const snapshot_serial_port_record& r, serial_port& port, device_description& desc)
 {
-    return try_set_audio_device_volume(device, control_name, channel.id, channel.type, channel.volume);
+    port.name = get_string(snapshot, r.name);
+    port.description = get_string(snapshot, r.description);
+    port.manufacturer = get_string(snapshot, r.manufacturer);
+    port.device_serial_number = get_string(snapshot, r.device_serial_number);
+    desc = get_description(snapshot, r.device);
 }
 
-bool try_set_audio_device_volume(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)
+bool is_device_snapshot_current(const mapped_device_snapshot& snapshot)
 {
-    return try_set_audio_device_volume(device, control.name, channel.id, channel.type, channel.volume);
+    std::string boot_id;
+    uint64_t seqnum = 0;
+
+    if (!try_get_boot_id(boot_id) || !try_get_uevent_seqnum(seqnum))
+    {
+        return false;
+    }
+
+    return get_boot_id(snapshot) == boot_id && get_uevent_seqnum(snapshot) == seqnum;
 }
 
-bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume)
+uint64_t get_uevent_seqnum(const mapped_device_snapshot& snapshot)
 {
-    return try_set_audio_device_volume(device, control_name, channel, channel_type, volume,
-        [](snd_mixer_elem_t* elem, int channel_id, int value) { return try_set_playback_channel_volume(elem, channel_id, value); },
-        [](snd_mixer_elem_t* elem, int channel_id, int value) { return try_set_capture_channel_volume(elem, channel_id, value); });
+    if (snapshot.data == nullptr)
+        return 0;
+    return get_header(snapshot).uevent_seqnum;
 }
 
-bool try_set_audio_device_volume_percent(const audio_device_info& device, int volume)
+std::string_view get_boot_id(const mapped_device_snapshot& snapshot)
 {
-    return try_set_audio_device_volume(device, volume, 
-        [](audio_device_channel& channel, int volume) { channel.volume_percent = volume; },
-        [](const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel) { return try_set_audio_device_volume_percent(device, control, channel); });
+    if (snapshot.data == nullptr)
+        return {};
+    return get_string(snapshot, get_header(snapshot).boot_id);
 }
 
-bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel)
+size_t get_audio_device_count(const mapped_device_snapshot& snapshot)
 {
-    return try_set_audio_device_volume_percent(device, control_name, channel.id, channel.type, channel.volume_percent);
+    if (snapshot.data == nullptr)
+        return 0;
+    return get_header(snapshot).audio_device_count;
 }
 
-bool try_set_audio_device_volume_percent(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)
+size_t get_serial_port_count(const mapped_device_snapshot& snapshot)
 {
-    return try_set_audio_device_volume_percent(device, control.name, channel.id, channel.type, channel.volume_percent);
+    if (snapshot.data == nullptr)
+        return 0;
+    return get_header(snapshot).serial_port_count;
 }
 
-bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume)
+bool try_get_audio_device(const mapped_device_snapshot& snapshot, size_t index, audio_device_info& device, device_description& desc)
 {
-    return try_set_audio_device_volume(device, control_name, channel, channel_type, volume,
-        [](snd_mixer_elem_t* elem, int channel_id, int value) { return try_set_playback_channel_volume_percent(elem, channel_id, value); },
-        [](snd_mixer_elem_t* elem, int channel_id, int value) { return try_set_capture_channel_volume_percent(elem, channel_id, value); });
+    if (index >= get_audio_device_count(snapshot))
+    {
+        return false;
+    }
+
+    get_audio_device(snapshot, get_audio_device_record(snapshot, index), device, desc);
+
+    return true;
+}
+
+bool try_get_serial_port(const mapped_device_snapshot& snapshot, size_t index, serial_port& port, device_description& desc)
+{
+    if (index >= get_serial_port_count(snapshot))
+    {
+        return false;
+    }
+
+    get_serial_port(snapshot, get_serial_port_record(snapshot, index), port, desc);
+
+    return true;
 }
 
-bool try_set_audio_device_volume(const audio_device_info& device, int volume, std::function<void(audio_device_channel& channel, int volume)> apply_volume, std::function<bool(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)> set_volume)
+std::vector<uint32_t> find_records(const mapped_device_snapshot& snapshot, snapshot_index_key key, std::function<bool(uint32_t record)> match, uint64_t hash)
 {
-    audio_device_volume_info audio_device_volume;
-    if (!try_get_audio_device_volume(device, audio_device_volume))
+    std::vector<uint32_t> records;
+
+    if (snapshot.data == nullptr)
     {
-        return false;
+        return records;
     }
 
-    for (const auto& control : audio_device_volume.controls)
+    const snapshot_file_header& header = get_header(snapshot);
+    const snapshot_index_entry* index = reinterpret_cast<const snapshot_index_entry*>(snapshot.data + header.index_offset);
+
+    // The index holds hashes only, candidates are confirmed against the record strings
+
+    size_t mask = header.index_size - 1;
+    size_t slot = hash & mask;
+    for (size_t probes = 0; probes < header.index_size; probes++)
     {
-        for (auto channel : control.channels)
-        {
-            apply_volume(channel, volume);
-            if (!set_volume(device, control, channel))
-            {
-                return false;
-            }
-        }
+        const snapshot_index_entry& entry = index[slot];
+        if (entry.key == (uint32_t)snapshot_index_key::empty)
+            break;
+        if (entry.key == (uint32_t)key && entry.hash == hash && match(entry.record))
+            records.push_back(entry.record);
+        slot = (slot + 1) & mask;
     }
 
-    return true;
+    return records;
 }
 
-bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int volume, std::function<bool((snd_mixer_elem_t* elem, int channel_id, int value))> playback_setter, std::function<bool((snd_mixer_elem_t* elem, int channel_id, int value))> capture_setter)
-{
-    bool result = true;
+// The matchers compare the string table in place, only the found records are decoded
 
-    int err;
-    snd_mixer_t* handle;
-    snd_mixer_selem_id_t* sid;
+bool try_find_audio_device(const mapped_device_snapshot& snapshot, std::string_view hw_id, audio_device_info& device, device_description& desc)
+{
+    size_t count = get_audio_device_count(snapshot);
 
-    // NOTE: can get the error message with snd_strerror(err)
+    std::vector<uint32_t> records = find_records(snapshot, snapshot_index_key::audio_hw_id, [&](uint32_t record) {
+        return record < count && get_string(snapshot, get_audio_device_record(snapshot, record).hw_id) == hw_id;
+    }, hash_snapshot_key(snapshot_index_key::audio_hw_id, hw_id));
 
-    if ((err = snd_mixer_open(&handle, 0)) < 0)
+    if (records.empty())
     {
         return false;
     }
 
-    if ((err = snd_mixer_attach(handle, ("hw:" + std::to_string(device.card_id)).c_str())) < 0)
+    return try_get_audio_device(snapshot, records[0], device, desc);
+}
+
+bool try_find_serial_port(const mapped_device_snapshot& snapshot, std::string_view devnode, serial_port& port, device_description& desc)
+{
+    size_t count = get_serial_port_count(snapshot);
+
+    std::vector<uint32_t> records = find_records(snapshot, snapshot_index_key::port_devnode, [&](uint32_t record) {
+        return record < count && get_string(snapshot, get_serial_port_record(snapshot, record).name) == devnode;
+    }, hash_snapshot_key(snapshot_index_key::port_devnode, devnode));
+
+    if (records.empty())
     {
-        snd_mixer_close(handle);
         return false;
     }
 
-    if ((err = snd_mixer_selem_register(handle, nullptr, nullptr)) < 0)
+    return try_get_serial_port(snapshot, records[0], port, desc);
+}
+
+std::vector<std::pair<audio_device_info, device_description>> find_audio_devices(const mapped_device_snapshot& snapshot, std::string_view id_vendor, std::string_view id_product)
+{
+    std::vector<std::pair<audio_device_info, device_description>> devices;
+
+    size_t count = get_audio_device_count(snapshot);
+
+    std::vector<uint32_t> records = find_records(snapshot, snapshot_index_key::audio_vendor_product, [&](uint32_t record) {
+        if (record >= count)
+            return false;
+        const snapshot_description_record& r = get_audio_device_record(snapshot, record).device;
+        return get_string(snapshot, r.id_vendor) == id_vendor && get_string(snapshot, r.id_product) == id_product;
+    }, hash_snapshot_key(snapshot_index_key::audio_vendor_product, id_vendor, id_product));
+
+    // Probing visits the slots in table order, return the devices in enumeration order
+    std::sort(records.begin(), records.end());
+
+    for (uint32_t record : records)
     {
-        snd_mixer_close(handle);
-        return false;
+        audio_device_info d;
+        device_description dd;
+        if (try_get_audio_device(snapshot, record, d, dd))
+            devices.push_back(std::make_pair(d, dd));
     }
 
-    if ((err = snd_mixer_load(handle)) < 0)
+    return devices;
+}
+
+std::vector<std::pair<serial_port, device_description>> find_serial_ports(const mapped_device_snapshot& snapshot, std::string_view id_vendor, std::string_view id_product)
+{
+    std::vector<std::pair<serial_port, device_description>> ports;
+
+    size_t count = get_serial_port_count(snapshot);
+
+    std::vector<uint32_t> records = find_records(snapshot, snapshot_index_key::port_vendor_product, [&](uint32_t record) {
+        if (record >= count)
+            return false;
+        const snapshot_description_record& r = get_serial_port_record(snapshot, record).device;
+        return get_string(snapshot, r.id_vendor) == id_vendor && get_string(snapshot, r.id_product) == id_product;
+    }, hash_snapshot_key(snapshot_index_key::port_vendor_product, id_vendor, id_product));
+
+    std::sort(records.begin(), records.end());
+
+    for (uint32_t record : records)
     {
-        snd_mixer_close(handle);
-        return false;
+        serial_port p;
+        device_description dd;
+        if (try_get_serial_port(snapshot, record, p, dd))
+            ports.push_back(std::make_pair(p, dd));
     }
 
-    snd_mixer_selem_id_malloc(&sid);
-    snd_mixer_selem_id_set_index(sid, 0);
+    return ports;
+}
 
-    snd_mixer_elem_t* elem = nullptr;
+std::vector<std::pair<serial_port, device_description>> find_serial_ports_by_serial_number(const mapped_device_snapshot& snapshot, std::string_view serial_number)
+{
+    std::vector<std::pair<serial_port, device_description>> ports;
 
-    for (elem = snd_mixer_first_elem(handle); elem; elem = snd_mixer_elem_next(elem))
+    size_t count = get_serial_port_count(snapshot);
+
+    std::vector<uint32_t> records = find_records(snapshot, snapshot_index_key::port_serial_number, [&](uint32_t record) {
+        return record < count && get_string(snapshot, get_serial_port_record(snapshot, record).device_serial_number) == serial_number;
+    }, hash_snapshot_key(snapshot_index_key::port_serial_number, serial_number));
+
+    std::sort(records.begin(), records.end());
+
+    for (uint32_t record : records)
     {
-        snd_mixer_selem_get_id(elem, sid);
+        serial_port p;
+        device_description dd;
+        if (try_get_serial_port(snapshot, record, p, dd))
+            ports.push_back(std::make_pair(p, dd));
+    }
 
-        std::string element_name = snd_mixer_selem_get_name(elem);
-        int channel_id = parse_audio_device_channel_type(channel);
+    return ports;
+}
 
-        if (element_name != control_name)
+std::vector<std::pair<audio_device_info, device_description>> find_audio_devices(const mapped_device_snapshot& snapshot, const compiled_audio_device_filter& filter)
+{
+    std::vector<std::pair<audio_device_info, device_description>> devices;
+
+    // The type and the string patterns are matched against the records in place
+
+    size_t count = get_audio_device_count(snapshot);
+    for (size_t i = 0; i < count; i++)
+    {
+        const snapshot_audio_device_record& r = get_audio_device_record(snapshot, i);
+        if (!match_audio_device_type((audio_device_type)r.type, filter.filter) ||
+            !match_pattern(*filter.name, get_string(snapshot, r.name)) ||
+            !match_pattern(*filter.description, get_string(snapshot, r.description)) ||
+            !match_pattern(*filter.stream_name, get_string(snapshot, r.stream_name)))
         {
             continue;
         }
 
-        if (channel_type == audio_device_type::playback && snd_mixer_selem_has_playback_volume(elem) && snd_mixer_selem_has_playback_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
-        {
-            result = playback_setter(elem, channel_id, volume);
-            break;
-        }
-        else if (channel_type == audio_device_type::capture && snd_mixer_selem_has_capture_volume(elem) && snd_mixer_selem_has_capture_channel(elem, (snd_mixer_selem_channel_id_t)channel_id))
-        {
-            result = capture_setter(elem, channel_id, volume);
-            break;
-        }
-        else
-        {
-            result = false;
-            break;
-        }
+        audio_device_info d;
+        device_description dd;
+        get_audio_device(snapshot, r, d, dd);
+        devices.push_back(std::make_pair(d, dd));
     }
 
-    snd_mixer_selem_id_free(sid);
-    snd_mixer_close(handle);
-
-    return result;
+    return devices;
 }
 
-bool try_set_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value)> set_volume)
+std::vector<std::pair<serial_port, device_description>> find_serial_ports(const mapped_device_snapshot& snapshot, const compiled_serial_port_filter& filter)
 {
-    long min = 0, max = 0;
-    int err;
-    err = get_volume_range(elem, &min, &max);
-    if (err < 0)
-    {
-        return false;
-    }
-    double value_adjusted_double = ((value * (double)(max - min)) / 100.0) + min;
-    long value_adjusted = (long)std::rint(value_adjusted_double);
-    err = set_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, value_adjusted);
-    if (err < 0)
+    std::vector<std::pair<serial_port, device_description>> ports;
+
+    size_t count = get_serial_port_count(snapshot);
+    for (size_t i = 0; i < count; i++)
     {
-        return false;
+        const snapshot_serial_port_record& r = get_serial_port_record(snapshot, i);
+        if (!match_pattern(*filter.name, get_string(snapshot, r.name)) ||
+            !match_pattern(*filter.description, get_string(snapshot, r.description)) ||
+            !match_pattern(*filter.manufacturer, get_string(snapshot, r.manufacturer)) ||
+            !match_pattern(*filter.device_serial_number, get_string(snapshot, r.device_serial_number)))
+        {
+            continue;
+        }
+
+        serial_port p;
+        device_description dd;
+        get_serial_port(snapshot, r, p, dd);
+        ports.push_back(std::make_pair(p, dd));
     }
-    return true;
+
+    return ports;
 }
 
-bool try_set_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value, std::function<int(snd_mixer_elem_t *elem, long *min, long *max)> get_volume_range, std::function<int(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value)> set_volume)
+device_snapshot to_device_snapshot(const mapped_device_snapshot& snapshot)
 {
-    long min = 0, max = 0;
-    int err;
-    err = get_volume_range(elem, &min, &max);
-    if (err < 0)
+    device_snapshot result;
+
+    if (snapshot.data == nullptr)
     {
-        return false;
+        return result;
     }
-    if (value < min || value > max)
+
+    result.boot_id = get_boot_id(snapshot);
+    result.uevent_seqnum = get_uevent_seqnum(snapshot);
+
+    size_t audio_device_count = get_audio_device_count(snapshot);
+    for (size_t i = 0; i < audio_device_count; i++)
     {
-        return false;
+        audio_device_info d;
+        device_description desc;
+        get_audio_device(snapshot, get_audio_device_record(snapshot, i), d, desc);
+        result.devices.push_back(std::make_pair(d, desc));
     }
-    err = set_volume(elem, (snd_mixer_selem_channel_id_t)channel_id, value);
-    if (err < 0)
+
+    size_t serial_port_count = get_serial_port_count(snapshot);
+    for (size_t i = 0; i < serial_port_count; i++)
     {
-        return false;
+        serial_port p;
+        device_description desc;
+        get_serial_port(snapshot, get_serial_port_record(snapshot, i), p, desc);
+        result.ports.push_back(std::make_pair(p, desc));
     }
-    return true;
-}
 
-bool try_set_playback_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value)
-{
-    return try_set_channel_volume_percent(elem, channel_id, value,
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_volume_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) { return snd_mixer_selem_set_playback_volume(elem, channel, value); });
+    return result;
 }
 
-bool try_set_playback_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value)
-{
-    return try_set_channel_volume(elem, channel_id, value,
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_playback_volume_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) { return snd_mixer_selem_set_playback_volume(elem, channel, value); });
-}
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// FILTERS                                                          //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
 
-bool try_set_capture_channel_volume_percent(snd_mixer_elem_t* elem, int channel_id, int value)
-{
-    return try_set_channel_volume_percent(elem, channel_id, value,
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_volume_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) { return snd_mixer_selem_set_capture_volume(elem, channel, value); });
-}
+bool try_compile_pattern(const std::string& pattern, std::shared_ptr<const compiled_pattern>& compiled);
+bool match_pattern(const compiled_pattern& pattern, std::string_view value);
+bool try_compile_filter(const audio_device_filter& filter, compiled_audio_device_filter& compiled);
+bool try_compile_filter(const serial_port_filter& filter, compiled_serial_port_filter& compiled);
+bool match_audio_device(const audio_device_info& d, const compiled_audio_device_filter& m);
+bool match_port(const serial_port& p, const compiled_serial_port_filter& m);
 
-bool try_set_capture_channel_volume(snd_mixer_elem_t* elem, int channel_id, int value)
+namespace
 {
-    return try_set_channel_volume(elem, channel_id, value,
-        [](snd_mixer_elem_t *elem, long *min, long *max) { return snd_mixer_selem_get_capture_volume_range(elem, min, max); },
-        [](snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) { return snd_mixer_selem_set_capture_volume(elem, channel, value); });
-}
+    // Patterns are usually the same few filters for the life of the process,
+    // the cache is cleared if it grows past its capacity
+    const size_t pattern_cache_capacity = 256;
 
-std::string to_json(const audio_device_volume_info& d, bool wrapping_object, int tabs)
-{
-    return to_json(d,
-        std::function<std::string(const audio_device_volume_info&)>{},
-        std::function<std::string(const audio_device_volume_info&, const audio_device_volume_control&)>{},
-        std::function<std::string(const audio_device_volume_info&, const audio_device_volume_control&, const audio_device_channel&)>{},
-        wrapping_object,
-        tabs);
-}
+    struct pattern_cache
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<const compiled_pattern>> patterns;
+    };
 
-std::string to_json(const audio_device_volume_info& d, std::function<std::string(const audio_device_volume_info& d)> render_device, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c)> render_control, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c, const audio_device_channel& ch)> render_channel, bool wrapping_object, int tabs)
-{
-    std::string s;
-    if (wrapping_object)
+    pattern_cache& get_pattern_cache()
     {
-        s.append("{\n");
+        static pattern_cache cache;
+        return cache;
     }
-    s.append("    \"card_id\": \"" + std::to_string(d.audio_device.card_id) + "\",\n");
-    s.append("    \"device_id\": \"" + std::to_string(d.audio_device.device_id) + "\",\n");
-    s.append("    \"plughw_id\": \"" + d.audio_device.plughw_id + "\",\n");
-    s.append("    \"hw_id\": \"" + d.audio_device.hw_id + "\",\n");
-    s.append("    \"name\": \"" + d.audio_device.name + "\",\n");
-    s.append("    \"description\": \"" + d.audio_device.description + "\",\n");
-    s.append("    \"type\": \"" + to_string(d.audio_device.type) + "\",\n");
-    if (render_device)
+
+    char to_lower_ascii(char c)
     {
-        std::string render_device_string = render_device(d);
-        if (!render_device_string.empty())
-        {
-            s.append(render_device_string);
-        }
+        return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
     }
-    s.append("    \"controls\": [\n");
-    for (size_t i = 0; i < d.controls.size(); i++)
+
+    bool contains_lowercase(std::string_view value, std::string_view lowercase_pattern)
     {
-        s.append("        {\n");
-        s.append("            \"name\": \"" + d.controls[i].name + "\",\n");
-        if (render_control)
-        {
-            std::string render_control_string = render_control(d, d.controls[i]);
-            if (!render_control_string.empty())
-            {
-                s.append(render_control_string);
-            }
-        }
-        s.append("            \"channels\": [\n");
-        for (size_t j = 0; j < d.controls[i].channels.size(); j++)
+        return std::search(value.begin(), value.end(), lowercase_pattern.begin(), lowercase_pattern.end(),
+            [](char v, char p) { return to_lower_ascii(v) == p; }) != value.end();
+    }
+
+    bool match_lowercase_glob(std::string_view value, std::string_view lowercase_glob)
+    {
+        // Backtracks to the last star only, which is enough for * and ?
+
+        size_t v = 0;
+        size_t g = 0;
+        size_t star = std::string_view::npos;
+        size_t star_v = 0;
+
+        while (v < value.size())
         {
-            s.append("                {\n");
-            s.append("                    \"name\": \"" + d.controls[i].channels[j].name + "\",\n");
-            s.append("                    \"type\": \"" + to_string(d.controls[i].channels[j].type) + "\",\n");
-            s.append("                    \"volume_percent\": \"" + std::to_string(d.controls[i].channels[j].volume_percent) + "\",\n");
-            s.append("                    \"volume\": \"" + std::to_string(d.controls[i].channels[j].volume) + "\",\n");
-            s.append("                    \"volume_min\": \"" + std::to_string(d.controls[i].channels[j].volume_min) + "\",\n");
-            s.append("                    \"volume_max\": \"" + std::to_string(d.controls[i].channels[j].volume_max) + "\",\n");
-            s.append("                    \"channel\": \"" + to_string(d.controls[i].channels[j].id) + "\"");
-            if (render_channel)
+            if (g < lowercase_glob.size() && (lowercase_glob[g] == '?' || lowercase_glob[g] == to_lower_ascii(value[v])))
             {
-                std::string render_channel_string = render_channel(d, d.controls[i], d.controls[i].channels[j]);
-                if (!render_channel_string.empty())
-                {
-                    s.append(",\n");
-                    s.append(render_channel_string);
-                }
-                else
-                {
-                    s.append("\n");
-                }
+                v++;
+                g++;
             }
-            else
+            else if (g < lowercase_glob.size() && lowercase_glob[g] == '*')
             {
-                s.append("\n");
-            }
-            s.append("                }");
-            if ((j + 1) < d.controls[i].channels.size())
-                s.append(",");
-            s.append("\n");
-        }
-        s.append("            ]\n");
-        s.append("        }");
-        if ((i + 1) < d.controls.size())
-            s.append(",");
-        s.append("\n");
-    }
-    s.append("    ]");
-    if (wrapping_object)
-    {
-        s.append("\n");
-        s.append("}");
+                star = g++;
+                star_v = v;
+            }
+            else if (star != std::string_view::npos)
+            {
+                g = star + 1;
+                v = ++star_v;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        while (g < lowercase_glob.size() && lowercase_glob[g] == '*')
+            g++;
+
+        return g == lowercase_glob.size();
     }
-    insert_tabs(s, tabs);
-    return s;
 }
 
-bool test_audio_device(const audio_device_info& device)
+bool try_compile_pattern(const std::string& pattern, std::shared_ptr<const compiled_pattern>& compiled)
 {
-    int err;
-    snd_pcm_t* pcm_handle;
-    snd_pcm_hw_params_t* hw_params;
-    const unsigned int buffer_size = 1024;  // Specify the buffer size in frames
-    const unsigned int channels = 2;  // Number of audio channels
-    unsigned int sample_rate = 44100;  // Audio sample rate
+    pattern_cache& cache = get_pattern_cache();
 
-    // Open the ALSA device for playback
-    err = snd_pcm_open(&pcm_handle, device.hw_id.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
-    if (err < 0)
     {
-        return false;
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto it = cache.patterns.find(pattern);
+        if (it != cache.patterns.end())
+        {
+            compiled = it->second;
+            return true;
+        }
     }
 
-    // Allocate and initialize hardware parameters object
-    snd_pcm_hw_params_alloca(&hw_params);
-    snd_pcm_hw_params_any(pcm_handle, hw_params);
+    auto result = std::make_shared<compiled_pattern>();
 
-    // Set hardware parameters for desired configuration
-    snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
-    snd_pcm_hw_params_set_format(pcm_handle, hw_params, SND_PCM_FORMAT_S16_LE);
-    snd_pcm_hw_params_set_channels(pcm_handle, hw_params, channels);
-    snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &sample_rate, 0);
+    std::string_view text = pattern;
 
-    // Apply the hardware parameters to the PCM device
-    err = snd_pcm_hw_params(pcm_handle, hw_params);
-    if (err < 0)
+    if (text.substr(0, 6) == "regex:")
     {
-        snd_pcm_close(pcm_handle);
-        return false;
+        result->type = pattern_type::regex;
+        result->text = text.substr(6);
+        try
+        {
+            result->regex = std::regex(result->text, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        }
+        catch (const std::regex_error&)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if (text.substr(0, 5) == "glob:")
+        {
+            result->type = pattern_type::glob;
+            text.remove_prefix(5);
+        }
+        else
+        {
+            result->type = text.empty() ? pattern_type::any : pattern_type::substring;
+        }
+        result->text.reserve(text.size());
+        for (char c : text)
+            result->text.push_back(to_lower_ascii(c));
     }
 
-    // Create a buffer to store the zeros
-    short zeros[buffer_size * channels];
-    memset(zeros, 0, sizeof(zeros));
-
-    // Write the buffer of zeros to the PCM device
-    err = snd_pcm_writei(pcm_handle, zeros, buffer_size);
-    if (err < 0)
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.patterns.size() >= pattern_cache_capacity)
     {
-        snd_pcm_close(pcm_handle);
-        return false;
+        cache.patterns.clear();
     }
+    cache.patterns[pattern] = result;
 
-    // Close the PCM device
-    snd_pcm_close(pcm_handle);
+    compiled = result;
 
     return true;
 }
 
+bool match_pattern(const compiled_pattern& pattern, std::string_view value)
+{
+    switch (pattern.type)
+    {
+    case pattern_type::any:
+        return true;
+    case pattern_type::substring:
+        return contains_lowercase(value, pattern.text);
+    case pattern_type::glob:
+        return match_lowercase_glob(value, pattern.text);
+    case pattern_type::regex:
+        return std::regex_search(value.begin(), value.end(), pattern.regex);
+    }
+    return false;
+}
+
+bool try_compile_filter(const audio_device_filter& filter, compiled_audio_device_filter& compiled)
+{
+    compiled.filter = filter;
+    return try_compile_pattern(filter.name_filter, compiled.name) &&
+        try_compile_pattern(filter.desc_filter, compiled.description) &&
+        try_compile_pattern(filter.stream_name_filter, compiled.stream_name);
+}
+
+bool try_compile_filter(const serial_port_filter& filter, compiled_serial_port_filter& compiled)
+{
+    compiled.filter = filter;
+    return try_compile_pattern(filter.name_filter, compiled.name) &&
+        try_compile_pattern(filter.description_filter, compiled.description) &&
+        try_compile_pattern(filter.manufacturer_filter, compiled.manufacturer) &&
+        try_compile_pattern(filter.device_serial_number, compiled.device_serial_number);
+}
+
 // **************************************************************** //
 //                                                                  //
 //                                                                  //
 //                                                                  //
 //                                                                  //
 //                                                                  //
-// SERIAL PORTS                                                     //
+// AUDIO DEVICE SEARCH                                              //
 //                                                                  //
 //                                                                  //
 //                                                                  //
@@ -1298,107 +5032,280 @@ bool test_audio_device(const audio_device_info& device)
 //                                                                  //
 // **************************************************************** //
 
-std::vector<serial_port> get_serial_ports();
-std::string to_json(const serial_port& p, bool wrapping_object, int tabs);
+std::vector<audio_device_info> get_audio_devices(const audio_device_filter& m);
+std::vector<audio_device_volume_info> get_audio_devices(const std::string& id);
+bool match_audio_device(const audio_device_info& d, const audio_device_filter& m);
+bool match_audio_device(const audio_device_info& d, const compiled_audio_device_filter& m);
+bool match_audio_device_type(audio_device_type type, const audio_device_filter& m);
+bool match_device(const device_description& p, const audio_device_filter& m);
+bool try_get_audio_device_channel(const audio_device_info& audio_device, const std::string& control_name, audio_device_channel_id channel_id, audio_device_type channel_type, audio_device_channel& channel);
+bool try_get_audio_device_channel(const audio_device_info& audio_device, const std::string& control_name, const std::string& channel_name, std::vector<audio_device_channel>& result);
+bool try_set_audio_device_volume_percent(const audio_device_info& audio_device, const std::string& control_name, const std::string& channel_name, audio_device_type type, int value);
+
+std::vector<audio_device_info> get_audio_devices(const audio_device_filter& m)
+{
+    std::vector<audio_device_info> matched_devices;
+    compiled_audio_device_filter filter;
+    if (!try_compile_filter(m, filter))
+        return matched_devices;
+    std::vector<audio_device_info> devices = get_audio_devices();
+    for (const auto& d : devices)
+    {
+        if (match_audio_device(d, filter))
+        {
+            matched_devices.emplace_back(std::move(d));
+        }
+    }
+    return matched_devices;
+}
 
-std::vector<serial_port> get_serial_ports()
+std::vector<audio_device_volume_info> get_audio_devices(const std::string& id)
 {
-    std::vector<serial_port> ports;
+    std::vector<audio_device_volume_info> matched_devices;
 
-    udev* udev = udev_new();
-    if (udev == nullptr)
-        return ports;
+    // Resolve the hw or plughw id directly, without enumerating every card
 
-    udev_enumerate* enumerate = udev_enumerate_new(udev);
-    if (enumerate == nullptr)
+    audio_device_info d;
+    int card_id = -1;
+    int device_id = -1;
+
+    if (try_parse_audio_device_hw_id(id, card_id, device_id) && try_get_audio_device(card_id, device_id, d) && (d.hw_id == id || d.plughw_id == id))
     {
-        udev_unref(udev);
-        return ports;
+        audio_device_volume_info volume_info;
+        try_get_audio_device_volume(d, volume_info);
+        matched_devices.push_back(volume_info);
     }
 
-    // Only supports USB serial ports
-    // Consider using libusb, or USB sysfs in the future
-    // Could there be other types of serial ports that are not tty?
+    return matched_devices;
+}
 
-    udev_enumerate_add_match_subsystem(enumerate, "tty");
+bool match_audio_device(const audio_device_info& d, const audio_device_filter& m)
+{
+    compiled_audio_device_filter filter;
+    return try_compile_filter(m, filter) && match_audio_device(d, filter);
+}
+
+bool match_audio_device(const audio_device_info& d, const compiled_audio_device_filter& compiled)
+{
+    // The type is checked before the strings
 
-    udev_enumerate_scan_devices(enumerate);
+    return match_audio_device_type(d.type, compiled.filter) &&
+        match_pattern(*compiled.name, d.name) &&
+        match_pattern(*compiled.description, d.description) &&
+        match_pattern(*compiled.stream_name, d.stream_name);
+}
 
-    udev_list_entry* devices = udev_enumerate_get_list_entry(enumerate);
-    if (devices == nullptr)
+bool match_audio_device_type(audio_device_type type, const audio_device_filter& m)
+{
+    if (m.playback_and_capture && !m.playback_or_capture &&
+        !(enum_device_type_has_flag(type, audio_device_type::playback) && enum_device_type_has_flag(type, audio_device_type::capture)))
     {
-        udev_enumerate_unref(enumerate);
-        udev_unref(udev);
-        return ports;
+        return false;
     }
-
-    udev_list_entry* dev_list_entry;
-    udev_list_entry_foreach(dev_list_entry, devices)
+    if (!m.playback_and_capture && m.playback_or_capture &&
+        !(enum_device_type_has_flag(type, audio_device_type::playback) || enum_device_type_has_flag(type, audio_device_type::capture)))
     {
-        const char* path = udev_list_entry_get_name(dev_list_entry);
+        return false;
+    }
+    if (!m.playback_and_capture && !m.playback_or_capture && (m.playback_only || m.capture_only))
+    {
+        if (m.playback_only && (!enum_device_type_has_flag(type, audio_device_type::playback) || enum_device_type_has_flag(type, audio_device_type::capture)))
+        {
+            return false;
+        }
+        if (m.capture_only && (!enum_device_type_has_flag(type, audio_device_type::capture) || enum_device_type_has_flag(type, audio_device_type::playback)))
+        {
+            return false;
+        }
+    }
 
-        udev_device* dev = udev_device_new_from_syspath(udev, path);
-        if (dev == nullptr)
-            continue;
+    return true;
+}
 
-        const char* devnode = udev_device_get_devnode(dev);
+bool match_device(const device_description& p, const audio_device_filter& m)
+{
+    if (m.bus != -1 && m.bus != p.bus_number)
+        return false;
+    if (m.device != -1 && m.device != p.device_number)
+        return false;
+    if (m.topology != -1 && m.topology != p.topology_depth)
+        return false;
+    if (!m.path.empty() && (m.path.find(p.path) == std::string::npos || m.path.substr(0, p.path.size()) != p.path))
+        return false;
+    if (!m.hw_path.empty() && (m.hw_path.find(p.hw_path) == std::string::npos || m.hw_path.substr(0, p.hw_path.size()) != p.hw_path))
+        return false;
 
-        udev_device* usb_dev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
-        if (usb_dev == nullptr)
+    return true;
+}
+
+bool try_get_audio_device_channel(const audio_device_info& audio_device, const audio_device_volume_control& control, const audio_device_channel& channel, audio_device_channel& result)
+{
+    audio_device_volume_info volume;
+    try_get_audio_device_volume(audio_device, volume);
+
+    for (auto& volume_control : volume.controls)
+    {
+        if (volume_control.name != control.name)
         {
-            udev_device_unref(dev);
             continue;
         }
 
-        // Other properties: udevadm info --attribute-walk --path=/sys/bus/usb-serial/devices/ttyUSB0
-        // To inspect the USB tree with libusb: lsusb -t
-        // 
-        // Source code location: https://github.com/systemd/systemd/blob/main/src/libudev/libudev-device.c
+        for (auto& control_channel : control.channels)
+        {
+            if (control_channel.id != channel.id || control_channel.type != channel.type)
+            {
+                continue;
+            }
 
-        const char* manufacturer = udev_device_get_sysattr_value(usb_dev, "manufacturer");
-        const char* product = udev_device_get_sysattr_value(usb_dev, "product");
-        const char* serial = udev_device_get_sysattr_value(usb_dev, "serial");
+            result = control_channel;
+            return true;
+        }
+    }
 
-        serial_port port;
+    return false;
+}
 
-        if (manufacturer != nullptr)
-            port.manufacturer = manufacturer;
-        if (serial != nullptr)
-            port.device_serial_number = serial;
-        if (product != nullptr)
-            port.description = product;
-        if (devnode != nullptr)
-            port.name = devnode;
+bool try_get_audio_device_channel(const audio_device_info& audio_device, const std::string& control_name, audio_device_channel_id channel_id, audio_device_type channel_type, audio_device_channel& result)
+{
+    audio_device_volume_info volume;
+    try_get_audio_device_volume(audio_device, volume);
 
-        ports.push_back(port);
+    for (auto& control : volume.controls)
+    {
+        if (control.name != control_name)
+        {
+            continue;
+        }
 
-        udev_device_unref(dev);
+        for (auto& channel : control.channels)
+        {
+            if (channel.id != channel_id || channel.type != channel_type)
+            {
+                continue;
+            }
+
+            result = channel;
+            return true;
+        }
     }
 
-    udev_enumerate_unref(enumerate);
-    udev_unref(udev);
+    return false;
+}
 
-    return ports;
+bool try_get_audio_device_channel(const audio_device_info& audio_device, const std::string& control_name, const std::string& channel_name, std::vector<audio_device_channel>& result)
+{
+    audio_device_volume_info volume;
+    try_get_audio_device_volume(audio_device, volume);
+
+    for (auto& control : volume.controls)
+    {
+        if (control.name != control_name)
+        {
+            continue;
+        }
+
+        for (auto& channel : control.channels)
+        {
+            if (to_string(channel.id) != channel_name)
+            {
+                continue;
+            }
+
+            result.push_back(channel);
+        }
+    }
+
+    return result.size() > 0;
 }
 
-std::string to_json(const serial_port& p, bool wrapping_object, int tabs)
+bool try_set_audio_device_volume_percent(const audio_device_info& audio_device, const std::string& control_name, const std::string& channel_name, audio_device_type type, int value)
 {
-    std::string s;
-    if (wrapping_object)
+    std::vector<audio_device_channel> channels;
+
+    if (!try_get_audio_device_channel(audio_device, control_name, channel_name, channels))
     {
-        s.append("{\n");
+        return false;
     }
-    s.append("    \"name\": \"" + p.name + "\",\n");
-    s.append("    \"description\": \"" + p.description + "\",\n");
-    s.append("    \"manufacturer\": \"" + p.manufacturer + "\",\n");
-    s.append("    \"device_serial_number\": \"" + p.device_serial_number + "\"");
-    if (wrapping_object)
+
+    for (auto& control_channel : channels)
+    {        
+        if (control_channel.type != type && !enum_device_type_has_flag(control_channel.type, type))
+        {
+            continue;
+        }
+
+        control_channel.volume_percent = value;
+        if (!try_set_audio_device_volume_percent(audio_device, control_name, control_channel))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// SERIAL PORT SEARCH                                               //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+std::vector<serial_port> get_serial_ports(const serial_port_filter& m);
+bool match_port(const serial_port& p, const serial_port_filter& m);
+bool match_port(const serial_port& p, const compiled_serial_port_filter& m);
+bool match_device(const device_description& p, const serial_port_filter& m);
+
+std::vector<serial_port> get_serial_ports(const serial_port_filter& m)
+{
+    std::vector<serial_port> matchedPorts;
+    compiled_serial_port_filter filter;
+    if (!try_compile_filter(m, filter))
+        return matchedPorts;
+    std::vector<serial_port> ports = get_serial_ports();
+    for (serial_port p : ports)
     {
-        s.append("\n");
-        s.append("}");
+        if (match_port(p, filter))
+            matchedPorts.push_back(p);
     }
-    insert_tabs(s, tabs);
-    return s;
+    return matchedPorts;
+}
+
+bool match_port(const serial_port& p, const serial_port_filter& m)
+{
+    compiled_serial_port_filter filter;
+    return try_compile_filter(m, filter) && match_port(p, filter);
+}
+
+bool match_port(const serial_port& p, const compiled_serial_port_filter& m)
+{
+    return match_pattern(*m.name, p.name) &&
+        match_pattern(*m.description, p.description) &&
+        match_pattern(*m.manufacturer, p.manufacturer) &&
+        match_pattern(*m.device_serial_number, p.device_serial_number);
+}
+
+bool match_device(const device_description& p, const serial_port_filter& m)
+{
+    if (m.bus != -1 && m.bus != p.bus_number)
+        return false;
+    if (m.device != -1 && m.device != p.device_number)
+        return false;
+    if (m.topology != -1 && m.topology != p.topology_depth)
+        return false;
+    if (!m.path.empty() && (m.path.find(p.path) == std::string::npos || m.path.substr(0, p.path.size()) != p.path))
+        return false;
+    if (!m.hw_path.empty() && (m.hw_path.find(p.hw_path) == std::string::npos || m.hw_path.substr(0, p.hw_path.size()) != p.hw_path))
+        return false;
+
+    return true;
 }
 
 // **************************************************************** //
@@ -1407,17 +5314,7 @@ std::string to_json(const serial_port& p, bool wrapping_object, int tabs)
 //                                                                  //
 //                                                                  //
 //                                                                  //
-//                                                                  //
-//                                                                  //
-//                                                                  //
-//                                                                  //
-//                                                                  //
-// DEVICES                                                          //
-//                                                                  //
-//                                                                  //
-//                                                                  //
-//                                                                  //
-//                                                                  //
+// SEARCH                                                           //
 //                                                                  //
 //                                                                  //
 //                                                                  //
@@ -1425,368 +5322,814 @@ std::string to_json(const serial_port& p, bool wrapping_object, int tabs)
 //                                                                  //
 // **************************************************************** //
 
-bool try_get_device_description(const audio_device_info& d, device_description& desc);
-bool try_get_device_description(const serial_port& p, device_description& desc);
-bool try_get_device_description(std::function<void(udev_enumerate*)> filter, device_description& desc);
-bool try_get_device_description(udev* udev, udev_enumerate* enumerate, udev_device*& device, udev_device*& usb_device, device_description& desc);
-bool try_get_device_description(udev_device* device, udev_device*& usb_device, device_description& desc);
-void fetch_device_description(udev_device* device, udev_device* usb_device, device_description& desc);
-bool try_find_device(udev* udev, udev_enumerate* enumerate, udev_device*& device, udev_device*& usb_device);
-bool try_find_device(udev_device* device, udev_device*& usb_device);
-int get_topology_depth(udev_device* device);
-std::vector<device_description> get_sibling_audio_devices(const device_description& desc);
-std::vector<device_description> get_sibling_serial_ports(const device_description& desc);
-std::vector<device_description> get_sibling_devices(std::function<void(udev_enumerate*)> filter, const device_description& desc);
-std::vector<audio_device_info> get_audio_devices(const device_description& desc);
-bool try_get_serial_port(const device_description& desc, serial_port& port);
-std::string to_json(const device_description& d, bool wrapping_object, int tabs);
+std::vector<std::pair<audio_device_info, device_description>> filter_audio_devices(const search_options& options, const std::vector<audio_device_info>& devices);
+std::vector<std::pair<serial_port, device_description>> filter_serial_ports(const search_options& options, const std::vector<serial_port>& ports);
+std::vector<audio_device_info> get_sibling_audio_devices(const search_options& options, const std::vector<std::pair<serial_port, device_description>>& ports);
+std::vector<serial_port> get_sibling_serial_ports(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices);
+std::vector<std::pair<audio_device_volume_info, device_description>> map_device_to_volume(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices);
+std::vector<std::pair<audio_device_info, device_description>> filter_audio_devices(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices);
+std::vector<std::pair<serial_port, device_description>> filter_serial_ports(const search_options& options, const std::vector<std::pair<serial_port, device_description>>& ports);
+std::vector<std::pair<audio_device_info, device_description>> get_sibling_audio_devices(const search_options& options, const device_snapshot& snapshot, const std::vector<std::pair<serial_port, device_description>>& ports);
+std::vector<std::pair<serial_port, device_description>> get_sibling_serial_ports(const search_options& options, const device_snapshot& snapshot, const std::vector<std::pair<audio_device_info, device_description>>& devices);
+search_result search(const search_options& options);
+search_result search(const search_options& options, const device_snapshot& snapshot);
+search_result search(const search_options& options, const mapped_device_snapshot& snapshot);
+device_snapshot get_device_snapshot(const search_options& options);
+bool try_map_cached_device_snapshot(const search_options& options, mapped_device_snapshot& snapshot);
+device_snapshot update_cached_device_snapshot(const search_options& options);
+void sort(const search_options& options, search_result& result);
+bool has_audio_device_description_filter(const search_options& options);
+bool has_serial_port_description_filter(const search_options& options);
+bool needs_audio_device_descriptions(const search_options& options);
+bool needs_serial_port_descriptions(const search_options& options);
+std::vector<audio_device_unique_volume_set> generate_unique_volume_set(const search_options& options, const search_result& result);
+std::string create_unique_channel_id(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel);
+audio_device_unique_volume_set create_unique_volume_set_object(const audio_device_volume_info& volume, const audio_device_volume_control& control, const audio_device_channel& channel, const audio_device_volume_set& volume_set);
+std::vector<audio_device_unique_volume_set> apply_volume_sets(const search_options& options, search_result& result, bool measure_error);
+bool verify_volume_sets(const search_options& options, const search_result& result);
+void update_devices_volume(search_result& result);
+
+scoped_timing::scoped_timing(const search_options& options, std::string_view name, std::string_view device) : timings((options.timings != nullptr && options.timings->enabled) ? options.timings.get() : nullptr)
+{
+    if (timings == nullptr)
+    {
+        return;
+    }
+    entry.name = name;
+    entry.device = device;
+    start = std::chrono::steady_clock::now();
+}
 
-bool try_get_device_description(const audio_device_info& d, device_description& desc)
+scoped_timing::~scoped_timing()
 {
-    return try_get_device_description([&d](udev_enumerate* enumerate) {
-        udev_enumerate_add_match_subsystem(enumerate, "sound");
-        udev_enumerate_add_match_sysname(enumerate, fmt::format("card{}", d.card_id).c_str());
-        }, desc);
+    if (timings == nullptr)
+    {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    entry.start_microseconds = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(start - timings->start).count();
+    entry.duration_microseconds = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::lock_guard<std::mutex> lock(timings->mutex);
+    timings->entries.push_back(std::move(entry));
 }
 
-bool try_get_device_description(const serial_port& p, device_description& desc)
+std::vector<std::pair<audio_device_info, device_description>> filter_audio_devices(const search_options& options, const std::vector<audio_device_info>& devices)
 {
-    return try_get_device_description([&p](udev_enumerate* enumerate) {
-        udev_enumerate_add_match_subsystem(enumerate, "tty");
-        udev_enumerate_add_match_property(enumerate, "DEVNAME", p.name.c_str());
-        }, desc);
+    // The descriptions are looked up concurrently, then filtered in the order of the devices,
+    // a description which nothing uses is never looked up and is left empty
+
+    std::vector<audio_device_info> matched_devices;
+    compiled_audio_device_filter filter;
+    if (!try_compile_filter(options.audio_filter, filter))
+        return {};
+    for (const audio_device_info& d : devices)
+    {
+        if (match_audio_device(d, filter))
+            matched_devices.push_back(d);
+    }
+
+    std::vector<device_description> descriptions(matched_devices.size());
+    std::vector<char> has_descriptions(matched_devices.size(), false);
+
+    if (needs_audio_device_descriptions(options))
+    {
+        parallel_for(matched_devices.size(), [&](size_t i) {
+            scoped_timing timing(options, "description", matched_devices[i].hw_id);
+            has_descriptions[i] = try_get_device_description(matched_devices[i], descriptions[i]);
+        });
+    }
+
+    std::vector<std::pair<audio_device_info, device_description>> audio_devices;
+    for (size_t i = 0; i < matched_devices.size(); i++)
+    {
+        const audio_device_info& d = matched_devices[i];
+        device_description& desc = descriptions[i];
+        if (has_descriptions[i])
+        {
+            if (!match_device(desc, options.audio_filter))
+                continue;
+        }
+        else if (has_audio_device_description_filter(options))
+            continue;
+        if (std::find_if(audio_devices.begin(), audio_devices.end(), [&](const auto& dev) { return dev.first.hw_id == d.hw_id; }) != audio_devices.end())
+            continue;
+        audio_devices.push_back(std::make_pair(d, desc));
+    }
+    return audio_devices;
 }
 
-bool try_get_device_description(std::function<void(udev_enumerate*)> filter, device_description& desc)
+std::vector<std::pair<serial_port, device_description>> filter_serial_ports(const search_options& options, const std::vector<serial_port>& ports)
 {
-    bool found = false;
+    std::vector<serial_port> matched_ports;
+    compiled_serial_port_filter filter;
+    if (!try_compile_filter(options.port_filter, filter))
+        return {};
+    for (const serial_port& p : ports)
+    {
+        if (match_port(p, filter))
+            matched_ports.push_back(p);
+    }
 
-    udev* udev = udev_new();
-    if (udev == nullptr)
+    std::vector<device_description> descriptions(matched_ports.size());
+    std::vector<char> has_descriptions(matched_ports.size(), false);
+
+    if (needs_serial_port_descriptions(options))
     {
-        return found;
+        parallel_for(matched_ports.size(), [&](size_t i) {
+            scoped_timing timing(options, "description", matched_ports[i].name);
+            has_descriptions[i] = try_get_device_description(matched_ports[i], descriptions[i]);
+        });
     }
 
-    udev_enumerate* enumerate = udev_enumerate_new(udev);
-    if (enumerate == nullptr)
+    std::vector<std::pair<serial_port, device_description>> serial_ports;
+    for (size_t i = 0; i < matched_ports.size(); i++)
     {
-        udev_unref(udev);
-        return found;
+        const serial_port& p = matched_ports[i];
+        device_description& desc = descriptions[i];
+        if (has_descriptions[i])
+        {
+            if (!match_device(desc, options.port_filter))
+                continue;
+        }
+        else if (has_serial_port_description_filter(options))
+            continue;
+        if (std::find_if(serial_ports.begin(), serial_ports.end(), [&](const auto& port) { return port.first.name == p.name; }) != serial_ports.end())
+            continue;
+        serial_ports.push_back(std::make_pair(p, desc));
     }
+    return serial_ports;
+}
 
-    filter(enumerate);
+std::vector<std::pair<audio_device_info, device_description>> filter_audio_devices(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices)
+{
+    std::vector<std::pair<audio_device_info, device_description>> audio_devices;
+    compiled_audio_device_filter filter;
+    if (!try_compile_filter(options.audio_filter, filter))
+        return audio_devices;
+    for (const auto& [d, desc] : devices)
+    {
+        if (!match_audio_device(d, filter))
+            continue;
+        if (!desc.path.empty())
+        {
+            if (!match_device(desc, options.audio_filter))
+                continue;
+        }
+        else if (has_audio_device_description_filter(options))
+            continue;
+        if (std::find_if(audio_devices.begin(), audio_devices.end(), [&](const auto& dev) { return dev.first.hw_id == d.hw_id; }) != audio_devices.end())
+            continue;
+        audio_devices.push_back(std::make_pair(d, desc));
+    }
+    return audio_devices;
+}
 
-    udev_device* device = nullptr;
-    udev_device* usb_device = nullptr;
-    found = try_get_device_description(udev, enumerate, device, usb_device, desc);
+std::vector<std::pair<serial_port, device_description>> filter_serial_ports(const search_options& options, const std::vector<std::pair<serial_port, device_description>>& ports)
+{
+    std::vector<std::pair<serial_port, device_description>> serial_ports;
+    compiled_serial_port_filter filter;
+    if (!try_compile_filter(options.port_filter, filter))
+        return serial_ports;
+    for (const auto& [p, desc] : ports)
+    {
+        if (!match_port(p, filter))
+            continue;
+        if (!desc.path.empty())
+        {
+            if (!match_device(desc, options.port_filter))
+                continue;
+        }
+        else if (has_serial_port_description_filter(options))
+            continue;
+        if (std::find_if(serial_ports.begin(), serial_ports.end(), [&](const auto& port) { return port.first.name == p.name; }) != serial_ports.end())
+            continue;
+        serial_ports.push_back(std::make_pair(p, desc));
+    }
+    return serial_ports;
+}
 
-    // NOTE: Should check that the device we found matched the filter? ex: udev_device_get_sysattr_value(dev, "number");
-    // Should check that only one enumeration?
+std::vector<audio_device_info> get_sibling_audio_devices(const search_options& options, const std::vector<std::pair<serial_port, device_description>>& ports)
+{
+    // The siblings of every port are looked up concurrently, and merged in the order of the ports
 
-    udev_device_unref(device);
-    udev_enumerate_unref(enumerate);
-    udev_unref(udev);
+    std::vector<std::vector<audio_device_info>> port_devices(ports.size());
 
-    return found;
+    parallel_for(ports.size(), [&](size_t i) {
+        scoped_timing timing(options, "siblings", ports[i].first.name);
+        for (const auto& d : get_sibling_audio_devices(ports[i].second))
+        {
+            for (const auto& a : get_audio_devices(d))
+                port_devices[i].push_back(a);
+        }
+    });
+
+    std::vector<audio_device_info> devices;
+    for (const auto& sibling_devices : port_devices)
+    {
+        for (const auto& a : sibling_devices)
+        {
+            if (std::find_if(devices.begin(), devices.end(), [&](const auto& dev) { return dev.hw_id == a.hw_id; }) != devices.end())
+                continue;
+            devices.push_back(a);
+        }
+    }
+    return devices;
 }
 
-bool try_get_device_description(udev* udev, udev_enumerate* enumerate, udev_device*& device, udev_device*& usb_device, device_description& desc)
+std::vector<serial_port> get_sibling_serial_ports(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices)
 {
-    if (!try_find_device(udev, enumerate, device, usb_device))
+    std::vector<std::vector<serial_port>> device_ports(devices.size());
+
+    parallel_for(devices.size(), [&](size_t i) {
+        scoped_timing timing(options, "siblings", devices[i].first.hw_id);
+        for (const auto& d : get_sibling_serial_ports(devices[i].second))
+        {
+            serial_port p;
+            if (try_get_serial_port(d, p))
+                device_ports[i].push_back(p);
+        }
+    });
+
+    std::vector<serial_port> ports;
+    for (const auto& sibling_ports : device_ports)
     {
-        return false;
+        for (const auto& p : sibling_ports)
+        {
+            if (std::find_if(ports.begin(), ports.end(), [&](const auto& port) { return port.name == p.name; }) != ports.end())
+                continue;
+            ports.push_back(p);
+        }
     }
+    return ports;
+}
 
-    fetch_device_description(device, usb_device, desc);
+std::vector<std::pair<audio_device_info, device_description>> get_sibling_audio_devices(const search_options& options, const device_snapshot& snapshot, const std::vector<std::pair<serial_port, device_description>>& ports)
+{
+    std::vector<std::pair<audio_device_info, device_description>> devices;
+    for (const auto& p : ports)
+    {
+        scoped_timing timing(options, "siblings", p.first.name);
+        for (const auto& d : get_sibling_audio_devices(snapshot, p.second))
+        {
+            if (std::find_if(devices.begin(), devices.end(), [&](const auto& dev) { return dev.first.hw_id == d.first.hw_id; }) != devices.end())
+                continue;
+            devices.push_back(d);
+        }
+    }
+    return devices;
+}
 
-    return true;
+std::vector<std::pair<serial_port, device_description>> get_sibling_serial_ports(const search_options& options, const device_snapshot& snapshot, const std::vector<std::pair<audio_device_info, device_description>>& devices)
+{
+    std::vector<std::pair<serial_port, device_description>> ports;
+    for (const auto& a : devices)
+    {
+        scoped_timing timing(options, "siblings", a.first.hw_id);
+        for (const auto& p : get_sibling_serial_ports(snapshot, a.second))
+        {
+            if (std::find_if(ports.begin(), ports.end(), [&](const auto& port) { return port.first.name == p.first.name; }) != ports.end())
+                continue;
+            ports.push_back(p);
+        }
+    }
+    return ports;
 }
 
-bool try_get_device_description(udev_device* device, udev_device*& usb_device, device_description& desc)
+std::vector<std::pair<audio_device_volume_info, device_description>> map_device_to_volume(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices)
 {
-    if (!try_find_device(device, usb_device))
+    // The mixer belongs to the card, it is loaded once per card and copied to the other devices of the card
+    // The cards are loaded concurrently, the devices keep their order
+
+    std::vector<size_t> card_first_devices;
+    std::vector<size_t> device_cards(devices.size());
+    for (size_t i = 0; i < devices.size(); i++)
     {
-        return false;
+        auto it = std::find_if(card_first_devices.begin(), card_first_devices.end(), [&](size_t first) { return devices[first].first.card_id == devices[i].first.card_id; });
+        device_cards[i] = it - card_first_devices.begin();
+        if (it == card_first_devices.end())
+            card_first_devices.push_back(i);
     }
 
-    fetch_device_description(device, usb_device, desc);
+    std::vector<audio_device_volume_info> card_volumes(card_first_devices.size());
 
-    return true;
+    parallel_for(card_first_devices.size(), [&](size_t i) {
+        const audio_device_info& device = devices[card_first_devices[i]].first;
+        scoped_timing timing(options, "mixer_load", device.hw_id);
+        try_get_audio_device_volume(device, card_volumes[i]);
+    });
+
+    std::vector<std::pair<audio_device_volume_info, device_description>> devices_volumes;
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        audio_device_volume_info device_volume = card_volumes[device_cards[i]];
+        device_volume.audio_device = devices[i].first;
+        devices_volumes.push_back(std::make_pair(device_volume, devices[i].second));
+    }
+    return devices_volumes;
 }
 
-void fetch_device_description(udev_device* device, udev_device* usb_device, device_description& desc)
+search_result search(const search_options& options)
 {
-    const char* syspath = udev_device_get_syspath(device);
-    const char* usb_syspath = udev_device_get_syspath(usb_device);
-    const char* busnum = udev_device_get_sysattr_value(usb_device, "busnum");
-    const char* devnum = udev_device_get_sysattr_value(usb_device, "devnum");
-    const char* dev_id_vendor = udev_device_get_sysattr_value(usb_device, "idVendor");
-    const char* dev_id_product = udev_device_get_sysattr_value(usb_device, "idProduct");
-    const char* dev_product = udev_device_get_sysattr_value(usb_device, "product");
-    const char* dev_manufacturer = udev_device_get_sysattr_value(usb_device, "manufacturer");
-    
-    // list of allocated devices, minor versions respect the order they are in
-    // https://mirrors.edge.kernel.org/pub/linux/docs/lanana/device-list/devices-2.6.txt
-    const char* dev = udev_device_get_sysattr_value(device, "dev");
-    if (dev != nullptr)
+    // The cached snapshot is used only when a cache file is configured
+
+    if (!options.cache_file.empty())
     {
-        std::string major_minor_str(dev);
-        size_t colon_pos = major_minor_str.find(':');
-        if (colon_pos != std::string::npos)
+        mapped_device_snapshot snapshot;
+        if (try_map_cached_device_snapshot(options, snapshot))
         {
-            try_parse_number(major_minor_str.substr(0, colon_pos), desc.major_number);
-            try_parse_number(major_minor_str.substr(colon_pos + 1), desc.minor_number);
+            return search(options, snapshot);
         }
+        return search(options, update_cached_device_snapshot(options));
     }
 
-    if (busnum != nullptr)
-        try_parse_number(busnum, desc.bus_number);
-    if (devnum != nullptr)
-        try_parse_number(devnum, desc.device_number);
-    if (dev_id_product != nullptr)
-        desc.id_product = dev_id_product;
-    if (dev_id_vendor != nullptr)
-        desc.id_vendor = dev_id_vendor;
-    if (dev_product != nullptr)
-        desc.product = dev_product;
-    if (dev_manufacturer != nullptr)
-        desc.manufacturer = dev_manufacturer;
-    if (syspath != nullptr)
-        desc.path = syspath;
-    if (usb_syspath != nullptr)
-        desc.hw_path = usb_syspath;
+    // The audio and serial port stages run concurrently unless one depends on the other,
+    // the port siblings need the ports, and the audio siblings only need the filtered audio devices
+
+    search_result result;
+    if (options.search_mode == search_mode::independent)
+    {
+        parallel_invoke(
+            [&]() { result.devices = map_device_to_volume(options, filter_audio_devices(options, get_audio_devices())); },
+            [&]() { result.ports = filter_serial_ports(options, get_serial_ports()); });
+    }
+    else if (options.search_mode == search_mode::port_siblings)
+    {
+        result.ports = filter_serial_ports(options, get_serial_ports());
+        result.devices = map_device_to_volume(options, filter_audio_devices(options, get_sibling_audio_devices(options, result.ports)));
+    }
+    else if (options.search_mode == search_mode::audio_siblings)
+    {
+        auto devices = filter_audio_devices(options, get_audio_devices());
+        parallel_invoke(
+            [&]() { result.devices = map_device_to_volume(options, devices); },
+            [&]() { result.ports = filter_serial_ports(options, get_sibling_serial_ports(options, devices)); });
+    }
+    return result;
+}
+
+search_result search(const search_options& options, const device_snapshot& snapshot)
+{
+    // Only the mixer state is read from the devices, everything else comes from the snapshot
+
+    search_result result;
+    if (options.search_mode == search_mode::independent)
+    {
+        result.devices = map_device_to_volume(options, filter_audio_devices(options, snapshot.devices));
+        result.ports = filter_serial_ports(options, snapshot.ports);
+    }
+    else if (options.search_mode == search_mode::port_siblings)
+    {
+        result.ports = filter_serial_ports(options, snapshot.ports);
+        result.devices = map_device_to_volume(options, filter_audio_devices(options, get_sibling_audio_devices(options, snapshot, result.ports)));
+    }
+    else if (options.search_mode == search_mode::audio_siblings)
+    {
+        auto devices = filter_audio_devices(options, snapshot.devices);
+        result.devices = map_device_to_volume(options, devices);
+        result.ports = filter_serial_ports(options, get_sibling_serial_ports(options, snapshot, devices));
+    }
+    return result;
+}
+
+search_result search(const search_options& options, const mapped_device_snapshot& snapshot)
+{
+    // The siblings are looked up across every record, those searches use the decoded snapshot
+
+    if (options.search_mode != search_mode::independent)
+    {
+        return search(options, to_device_snapshot(snapshot));
+    }
+
+    search_result result;
+
+    compiled_audio_device_filter audio_filter;
+    compiled_serial_port_filter port_filter;
+    if (try_compile_filter(options.audio_filter, audio_filter))
+    {
+        result.devices = map_device_to_volume(options, filter_audio_devices(options, find_audio_devices(snapshot, audio_filter)));
+    }
+    if (try_compile_filter(options.port_filter, port_filter))
+    {
+        result.ports = filter_serial_ports(options, find_serial_ports(snapshot, port_filter));
+    }
+
+    return result;
+}
+
+void sort(const search_options& options, search_result& result)
+{
+    const auto& audio_order_by = options.audio_filter.order_by;
+    const auto& audio_order_direction = options.audio_filter.order_direction;
+    bool audio_ascending = (audio_order_direction == "asc" || audio_order_direction == "ascending");
+
+    const auto& port_order_by = options.port_filter.order_by;
+    const auto& port_order_direction = options.port_filter.order_direction;
+    bool port_ascending = (port_order_direction == "asc" || port_order_direction == "ascending");
+
+    auto compare_devices = [&](const auto& a, const auto& b)
+    {
+        const auto& [volume_info_a, description_a] = a;
+        const auto& [volume_info_b, description_b] = b;
+
+        if (audio_order_by == "major")
+        {
+            return audio_ascending ? description_a.major_number < description_b.major_number :
+                description_a.major_number > description_b.major_number;
+        } 
+        else if (audio_order_by == "minor")
+        {
+            return audio_ascending ? description_a.minor_number < description_b.minor_number :
+                description_a.minor_number > description_b.minor_number;
+        }
+
+        return false;
+    };
+
+    auto compare_ports = [&](const auto& a, const auto& b)
+    {
+        const auto& [port_a, description_a] = a;
+        const auto& [port_b, description_b] = b;
+
+        if (port_order_by == "major")
+        {
+            return port_ascending ? description_a.major_number < description_b.major_number :
+                description_a.major_number > description_b.major_number;
+        }
+        else if (port_order_by == "minor")
+        {
+            return port_ascending ? description_a.minor_number < description_b.minor_number :
+                description_a.minor_number > description_b.minor_number;
+        }
+
+        return false;
+    };
+
+    std::sort(result.devices.begin(), result.devices.end(), compare_devices);
+    std::sort(result.ports.begin(), result.ports.end(), compare_ports);
+}
+
+bool has_audio_device_description_filter(const search_options& options)
+{
+    return (options.audio_filter.bus != -1 ||
+        options.audio_filter.device != -1 ||
+        !options.audio_filter.path.empty() ||
+        !options.audio_filter.hw_path.empty() ||
+        options.audio_filter.topology != -1);
+}
 
-    desc.topology_depth = get_topology_depth(usb_device);
+bool has_serial_port_description_filter(const search_options& options)
+{
+    return (options.port_filter.bus != -1 ||
+        options.port_filter.device != -1 ||
+        !options.port_filter.path.empty() ||
+        !options.port_filter.hw_path.empty() ||
+        options.port_filter.topology != -1);
 }
 
-bool try_find_device(udev* udev, udev_enumerate* enumerate, udev_device*& device, udev_device*& usb_device)
+bool needs_audio_device_descriptions(const search_options& options)
 {
-    udev_enumerate_scan_devices(enumerate);
+    // The audio siblings are found from the hw_path, and the sort can order by the major or minor numbers
 
-    udev_list_entry* devices = udev_enumerate_get_list_entry(enumerate);
-    if (devices == nullptr)
+    return (options.include_descriptions ||
+        has_audio_device_description_filter(options) ||
+        options.search_mode == search_mode::audio_siblings ||
+        options.audio_filter.order_by == "major" ||
+        options.audio_filter.order_by == "minor");
+}
+
+bool needs_serial_port_descriptions(const search_options& options)
+{
+    return (options.include_descriptions ||
+        has_serial_port_description_filter(options) ||
+        options.search_mode == search_mode::port_siblings ||
+        options.port_filter.order_by == "major" ||
+        options.port_filter.order_by == "minor");
+}
+
+std::vector<audio_device_unique_volume_set> generate_unique_volume_set(const search_options& options, const search_result& result)
+{
+    std::map<std::string, audio_device_unique_volume_set> visitors;
+
+    for (auto& dd : result.devices)
     {
-        return false;
+        audio_device_volume_info volume = dd.first;
+
+        for (auto& volume_set : options.volume_set)
+        {
+            if (volume_set.volume == -1)
+            {
+                continue;
+            }
+
+            for (auto& control : volume.controls)
+            {
+                // if the control name is set and it does not match, skip it
+                if (volume_set.control_name.size() > 0 && volume_set.control_name != control.name)
+                {
+                    continue;
+                }
+
+                for (auto& channel : control.channels)
+                {
+                    // if the channel type is set and it does not match, skip it
+                    if (volume_set.audio_channel_type != audio_device_type::uknown && channel.type != volume_set.audio_channel_type)
+                    {
+                        continue;
+                    }
+
+                    if (volume_set.audio_channels.size() == 0)
+                    {
+                        audio_device_unique_volume_set visitor = create_unique_volume_set_object(volume, control, channel, volume_set);
+
+                        if (!visitors.contains(visitor.unique_channel_id) || visitors[visitor.unique_channel_id].property_set_count < visitor.property_set_count)
+                            visitors[visitor.unique_channel_id] = visitor;
+
+                        continue;
+                    }
+
+                    for (auto& channel_set : volume_set.audio_channels)
+                    {
+                        if (channel_set != channel.id)
+                        {
+                            continue;
+                        }
+
+                        audio_device_unique_volume_set visitor = create_unique_volume_set_object(volume, control, channel, volume_set);
+
+                        if (!visitors.contains(visitor.unique_channel_id) || visitors[visitor.unique_channel_id].property_set_count < visitor.property_set_count)
+                            visitors[visitor.unique_channel_id] = visitor;
+                    }
+                }
+            }
+        }
     }
 
-    device = udev_device_new_from_syspath(udev, udev_list_entry_get_name(devices));
-    if (device == nullptr)
+    std::vector<audio_device_unique_volume_set> visitors_vect;
+    for (const auto& v : visitors)
     {
-        return false;
+        visitors_vect.push_back(v.second);
     }
 
-    usb_device = udev_device_get_parent_with_subsystem_devtype(device, "usb", "usb_device");
+    return visitors_vect;
+}
 
-    if (usb_device == nullptr)
+audio_device_unique_volume_set create_unique_volume_set_object(const audio_device_volume_info& volume, const audio_device_volume_control& control, const audio_device_channel& channel, const audio_device_volume_set& volume_set)
+{
+    audio_device_unique_volume_set visitor;
+    visitor.volume = volume;
+    visitor.control = control;
+    visitor.channel = channel;
+    visitor.volume_set = volume_set;
+    visitor.unique_channel_id = create_unique_channel_id(volume.audio_device, control, channel);
+    if (volume_set.control_name.size() > 0)
+        visitor.property_set_count++;
+    if (volume_set.audio_channels.size() > 0)
+        visitor.property_set_count++;
+    return visitor;
+}
+
+std::string create_unique_channel_id(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel)
+{
+    return fmt::format("{},{},{},{}", device.hw_id, control.name, to_string(channel.id), to_string(channel.type));
+}
+
+std::vector<audio_device_unique_volume_set> apply_volume_sets(const search_options& options, search_result& result, bool measure_error)
+{
+    std::vector<audio_device_unique_volume_set> visitors_vect = generate_unique_volume_set(options, result);
+
+    for (auto& visitor : visitors_vect)
     {
-        return false;
+        audio_device_channel updated_channel = visitor.channel;
+        updated_channel.volume_percent = visitor.volume_set.volume;
+        try_set_audio_device_volume_percent(visitor.volume.audio_device, visitor.control, updated_channel);
+
+        if (measure_error)
+        {
+            audio_device_channel new_channel;
+            try_get_audio_device_channel(visitor.volume.audio_device, visitor.control.name, visitor.channel.id, visitor.channel.type, new_channel);
+
+            double percentage_error_double = ((new_channel.volume_percent - visitor.volume_set.volume) / (visitor.volume_set.volume * 1.0)) * 100.0;
+            int percentage_error = (int)std::rint(percentage_error_double);
+            visitor.volume_control_error_percent = percentage_error;
+            visitor.volume_control_error = std::abs(new_channel.volume_percent - visitor.volume_set.volume);
+        }
     }
 
-    return true;
+    update_devices_volume(result);
+
+    return visitors_vect;
 }
 
-bool try_find_device(udev_device* device, udev_device*& usb_device)
+bool verify_volume_sets(const search_options& options, const search_result& result)
 {
-    usb_device = udev_device_get_parent_with_subsystem_devtype(device, "usb", "usb_device");
+    std::vector<audio_device_unique_volume_set> audio_set_result = generate_unique_volume_set(options, result);
 
-    if (usb_device == nullptr)
+    for (auto& audio_set : audio_set_result)
     {
-        return false;
+        audio_device_channel channel;
+        try_get_audio_device_channel(audio_set.volume.audio_device, audio_set.control.name, audio_set.channel.id, audio_set.channel.type, channel);
+
+        if (channel.volume_percent == audio_set.volume_set.volume)
+        {
+            continue;
+        }
+
+        if (audio_set.volume_set.volume_max_error == 0 && channel.volume_percent != audio_set.volume_set.volume)
+        {
+            return false;
+        }
+
+        if (!(channel.volume_percent <= (audio_set.volume_set.volume + audio_set.volume_set.volume_max_error) &&
+            channel.volume_percent >= std::abs(audio_set.volume_set.volume - audio_set.volume_set.volume_max_error)))
+        {
+            return false;
+        }
     }
 
     return true;
 }
 
-int get_topology_depth(udev_device* device)
+void update_devices_volume(search_result& result)
 {
-    int depth = 0;
-    udev_device* parent = device;
-    while (true)
+    for (auto& d : result.devices)
     {
-        parent = udev_device_get_parent(parent);
-        const char* subsystem = udev_device_get_subsystem(parent);
-        if (subsystem == nullptr || strlen(subsystem) == 0)
-            break;
-        depth++;
+        try_get_audio_device_volume(d.first.audio_device, d.first);
     }
-    return depth;
 }
 
-std::vector<device_description> get_sibling_audio_devices(const device_description& desc)
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// DEVICE SNAPSHOT CACHE                                            //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+device_snapshot get_device_snapshot(const search_options& options);
+bool try_map_cached_device_snapshot(const search_options& options, mapped_device_snapshot& snapshot);
+device_snapshot update_cached_device_snapshot(const search_options& options);
+
+device_snapshot get_device_snapshot(const search_options& options)
 {
-    return get_sibling_devices([](udev_enumerate* enumerate) {
-        udev_enumerate_add_match_subsystem(enumerate, "sound");
-        udev_enumerate_add_match_sysname(enumerate, "card*");
-        }, desc);
+    if (options.cache_file.empty())
+    {
+        return get_device_snapshot();
+    }
+
+    mapped_device_snapshot mapped_snapshot;
+    if (try_map_cached_device_snapshot(options, mapped_snapshot))
+    {
+        return to_device_snapshot(mapped_snapshot);
+    }
+
+    return update_cached_device_snapshot(options);
 }
 
-std::vector<device_description> get_sibling_serial_ports(const device_description& desc)
+bool try_map_cached_device_snapshot(const search_options& options, mapped_device_snapshot& snapshot)
 {
-    return get_sibling_devices([](udev_enumerate* enumerate) {
-        udev_enumerate_add_match_subsystem(enumerate, "tty");
-        }, desc);
+    if (try_map_device_snapshot(options.cache_file, snapshot) && is_device_snapshot_current(snapshot))
+    {
+        add_metrics_counter(get_metrics_counter("find_devices_snapshot_cache_total", "result", "hit"));
+        return true;
+    }
+
+    add_metrics_counter(get_metrics_counter("find_devices_snapshot_cache_total", "result", "miss"));
+    return false;
 }
 
-std::vector<device_description> get_sibling_devices(std::function<void(udev_enumerate*)> filter, const device_description& desc)
+device_snapshot update_cached_device_snapshot(const search_options& options)
 {
-    std::vector<device_description> siblings;
+    device_snapshot snapshot = get_device_snapshot();
+    try_write_device_snapshot(options.cache_file, snapshot);
+    return snapshot;
+}
 
-    udev* udev = udev_new();
-    if (udev == nullptr)
-        return siblings;
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// SHARED MEMORY SNAPSHOT                                           //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
 
-    udev_device* dev = nullptr;
+bool try_create_shared_snapshot(const std::string& name, size_t capacity, shared_snapshot& snapshot);
+bool try_publish_shared_snapshot(shared_snapshot& snapshot, std::string_view payload);
+bool is_shared_snapshot_writer_alive(const std::string& name);
 
-    // Get device from path
-    dev = udev_device_new_from_syspath(udev, desc.path.c_str());
-    if (dev == nullptr)
-    {
-        udev_unref(udev);
-        return siblings;
-    }
+bool try_create_shared_snapshot(const std::string& name, size_t capacity, shared_snapshot& snapshot)
+{
+    close_shared_snapshot(snapshot);
 
-    // Get the corresponding USB device
-    udev_device* usb_dev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
-    if (usb_dev == nullptr)
-    {
-        udev_device_unref(dev);
-        udev_unref(udev);
-        return siblings;
-    }
+    // Unlinking the segment of a live writer would leave its readers on a segment nobody updates,
+    // only the segment of a writer which exited without unlinking it is recreated
 
-    // Get the USB device's parent USB device
-    udev_device* parent_usb_dev = udev_device_get_parent_with_subsystem_devtype(usb_dev, "usb", "usb_device");
-    if (parent_usb_dev == nullptr)
+    if (is_shared_snapshot_writer_alive(name))
     {
-        udev_device_unref(dev);
-        udev_unref(udev);
-        return siblings;
+        return false;
     }
 
-    udev_enumerate* enumerate = udev_enumerate_new(udev);
-    if (enumerate == nullptr)
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
     {
-        udev_device_unref(dev);
-        udev_unref(udev);
-        return siblings;
+        return false;
     }
 
-    udev_enumerate_add_match_parent(enumerate, parent_usb_dev);
+    size_t size = sizeof(shared_snapshot_header) + capacity;
 
-    filter(enumerate);
+    if (ftruncate(fd, (off_t)size) != 0)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
 
-    udev_enumerate_scan_devices(enumerate);
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 
-    udev_list_entry* sibling_list_entry = nullptr;
-    udev_device* sibling_dev = nullptr;
-    udev_list_entry* devices = udev_enumerate_get_list_entry(enumerate);
+    close(fd);
 
-    udev_list_entry_foreach(sibling_list_entry, devices)
+    if (data == MAP_FAILED)
     {
-        const char* path = udev_list_entry_get_name(sibling_list_entry);
-        sibling_dev = udev_device_new_from_syspath(udev, path);
-        udev_device* sibling_usb_device;
-        device_description sibling_desc;
-        if (try_get_device_description(sibling_dev, sibling_usb_device, sibling_desc))
-            siblings.push_back(sibling_desc);
-        udev_device_unref(sibling_dev);
+        shm_unlink(name.c_str());
+        return false;
     }
 
-    udev_device_unref(dev);
-    udev_enumerate_unref(enumerate);
-    udev_unref(udev);
+    // The segment is zero filled, construct the header in place
+    shared_snapshot_header* header = new (data) shared_snapshot_header{};
+    memcpy(header->magic, shared_snapshot_magic, sizeof(header->magic));
+    header->version = shared_snapshot_version;
+    header->capacity = (uint32_t)capacity;
+    header->writer_pid = (int32_t)getpid();
 
-    return siblings;
+    snapshot.name = name;
+    snapshot.data = data;
+    snapshot.size = size;
+    snapshot.owner = true;
+
+    return true;
 }
 
-std::vector<audio_device_info> get_audio_devices(const device_description& desc)
+bool is_shared_snapshot_writer_alive(const std::string& name)
 {
-    std::vector<audio_device_info> devices;
-
-    udev* udev = udev_new();
-    if (!udev)
-        return devices;
-
-    udev_device* dev = nullptr;
+    // Segments of another version are never in use by a writer of this version
 
-    // Get device from path
-    dev = udev_device_new_from_syspath(udev, desc.path.c_str());
-    if (dev == nullptr)
+    shared_snapshot existing;
+    if (!try_open_shared_snapshot(name, existing))
     {
-        udev_unref(udev);
-        return devices;
+        return false;
     }
 
-    const char* card_id_str = udev_device_get_sysattr_value(dev, "number");
-    int card_id;
-    if (card_id_str != nullptr && try_parse_number(card_id_str, card_id))
-        devices = get_audio_devices(card_id);
-
-    udev_device_unref(dev);
-    udev_unref(udev);
+    int32_t writer_pid = ((const shared_snapshot_header*)existing.data)->writer_pid;
 
-    return devices;
+    return writer_pid > 0 && (kill(writer_pid, 0) == 0 || errno == EPERM);
 }
 
-bool try_get_serial_port(const device_description& desc, serial_port& port)
+bool try_publish_shared_snapshot(shared_snapshot& snapshot, std::string_view payload)
 {
-    udev* udev = udev_new();
-    if (!udev)
+    if (snapshot.data == nullptr || !snapshot.owner)
+    {
         return false;
+    }
 
-    udev_device* dev = nullptr;
+    shared_snapshot_header* header = (shared_snapshot_header*)snapshot.data;
+    char* data = (char*)snapshot.data + sizeof(shared_snapshot_header);
 
-    // Get device from path
-    dev = udev_device_new_from_syspath(udev, desc.path.c_str());
-    if (dev == nullptr)
+    if (payload.size() > header->capacity)
     {
-        udev_unref(udev);
         return false;
     }
 
-    bool found = false;
-
-    const char* devnode = udev_device_get_devnode(dev);
-
-    for (const serial_port& p : get_serial_ports())
+    uint32_t current_size = header->size.load(std::memory_order_relaxed);
+    if (header->generation.load(std::memory_order_relaxed) > 0 &&
+        current_size == payload.size() && memcmp(data, payload.data(), payload.size()) == 0)
     {
-        if (p.name == devnode)
-        {
-            port = p;
-            found = true;
-            break;
-        }
+        return true;
     }
 
-    udev_device_unref(dev);
-    udev_unref(udev);
+    // There is a single writer, the sequence is odd while the payload is updated
 
-    return found;
-}
+    uint64_t sequence = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
 
-std::string to_json(const device_description& d, bool wrapping_object, int tabs)
-{
-    std::string s;
-    if (wrapping_object)
-    {
-        s.append("{\n");
-    }
-    s.append("    \"bus_number\": \"" + std::to_string(d.bus_number) + "\",\n");
-    s.append("    \"device_number\": \"" + std::to_string(d.device_number) + "\",\n");
-    s.append("    \"major_number\": \"" + std::to_string(d.major_number) + "\",\n");
-    s.append("    \"minor_number\": \"" + std::to_string(d.minor_number) + "\",\n");
-    s.append("    \"id_product\": \"" + d.id_product + "\",\n");
-    s.append("    \"id_vendor\": \"" + d.id_vendor + "\",\n");
-    s.append("    \"device_manufacturer\": \"" + d.manufacturer + "\",\n");
-    s.append("    \"path\": \"" + d.path + "\",\n");
-    s.append("    \"hw_path\": \"" + d.hw_path + "\",\n");
-    s.append("    \"product\": \"" + d.product + "\",\n");
-    s.append("    \"topology_depth\": \"" + std::to_string(d.topology_depth) + "\"");
-    if (wrapping_object)
-    {
-        s.append("\n");
-        s.append("}");
-    }
-    insert_tabs(s, tabs);
-    return s;
+    memcpy(data, payload.data(), payload.size());
+    header->size.store((uint32_t)payload.size(), std::memory_order_relaxed);
+    header->generation.store(header->generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    header->sequence.store(sequence + 2, std::memory_order_release);
+
+    return true;
 }
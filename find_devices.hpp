@@ -38,6 +38,23 @@
 #include <sstream>
 #include <optional>
 #include <functional>
+#include <cstdint>
+#include <string_view>
+#include <charconv>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <regex>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
 
 // **************************************************************** //
 //                                                                  //
@@ -70,8 +87,134 @@ namespace
         }
         return false;
     }
+
+    bool try_parse_int(std::string_view str, int& number)
+    {
+        // Parses without allocating, the whole string must be a number
+        int maybe_number = -1;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), maybe_number);
+        if (str.empty() || ec != std::errc() || ptr != str.data() + str.size())
+            return false;
+        number = maybe_number;
+        return true;
+    }
 }
 
+bool try_write_file_atomically(const std::string& path, const std::string& content);
+void insert_tabs(std::string& s, int tabs, int tab_spaces = 4);
+
+// **************************************************************** //
+//                                                                  //
+// METRICS                                                          //
+//                                                                  //
+// **************************************************************** //
+
+// Counters and fixed bucket latency histograms, updated with relaxed atomics
+// The series are created on first use, references to them stay valid for the lifetime of the process
+
+const size_t metrics_histogram_bucket_count = 16;
+
+struct metrics_counter
+{
+    std::string name;
+    std::string labels;
+    std::atomic<uint64_t> value {0};
+};
+
+struct metrics_histogram
+{
+    std::string name;
+    std::string labels;
+    std::array<std::atomic<uint64_t>, metrics_histogram_bucket_count + 1> buckets {};
+    std::atomic<uint64_t> sum_microseconds {0};
+};
+
+metrics_counter& get_metrics_counter(std::string_view name, std::string_view label_name = {}, std::string_view label_value = {});
+metrics_histogram& get_metrics_histogram(std::string_view name, std::string_view label_name = {}, std::string_view label_value = {});
+
+// The series of an ALSA card, resolved once per card so that the card operations skip the registry lookup
+
+struct alsa_card_metrics
+{
+    metrics_histogram& enumeration;
+    metrics_histogram& pcm_info;
+    metrics_histogram& mixer_load;
+    metrics_histogram& mixer_set;
+};
+
+const alsa_card_metrics& get_alsa_card_metrics(int card_id);
+
+void add_metrics_counter(metrics_counter& counter, uint64_t value = 1);
+void record_metrics_histogram(metrics_histogram& histogram, uint64_t microseconds);
+
+// Records the lifetime of the timer into a histogram
+
+struct scoped_metrics_timer
+{
+    scoped_metrics_timer(metrics_histogram& histogram);
+    scoped_metrics_timer(const scoped_metrics_timer&) = delete;
+    scoped_metrics_timer& operator=(const scoped_metrics_timer&) = delete;
+    ~scoped_metrics_timer();
+
+    metrics_histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Renders every series in the Prometheus text exposition format
+std::string to_metrics_text();
+
+// **************************************************************** //
+//                                                                  //
+// TRACING                                                          //
+//                                                                  //
+// **************************************************************** //
+
+// Scoped spans recorded as Chrome trace events, viewable in chrome://tracing or Perfetto
+// While tracing is disabled a span costs a single relaxed atomic load
+
+void start_tracing();
+void stop_tracing();
+bool is_tracing_enabled();
+bool try_write_trace(const std::string& path);
+
+struct trace_span
+{
+    trace_span(const char* name);
+    trace_span(const char* name, const char* arg_name, int arg_value);
+    trace_span(const char* name, const char* first_arg_name, int first_arg_value, const char* second_arg_name, int second_arg_value);
+    trace_span(const char* name, const char* arg_name, std::string_view arg_value);
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+    ~trace_span();
+
+    const char* name = nullptr;
+    bool enabled = false;
+    std::string args;
+    std::chrono::steady_clock::time_point start;
+};
+
+// **************************************************************** //
+//                                                                  //
+// WORKER POOL                                                      //
+//                                                                  //
+// **************************************************************** //
+
+// A process wide pool of worker threads, used to run the independent search stages and the per device work concurrently
+// The calling thread runs the loop bodies too, so nested loops never wait on a task that has not started
+// A worker count of 1 runs everything on the calling thread, the count is limited to max_worker_count
+
+const size_t default_worker_count = 4;
+const size_t max_worker_count = 64;
+
+void set_worker_count(size_t count);
+size_t get_worker_count();
+
+// Runs body for every index from 0 to count, and returns when all have completed
+// The first exception thrown by a body is rethrown once the other bodies have completed
+
+void parallel_for(size_t count, const std::function<void(size_t)>& body);
+void parallel_invoke(const std::function<void()>& first, const std::function<void()>& second);
+
 // **************************************************************** //
 //                                                                  //
 // AUDIO DEVICES                                                    //
@@ -107,6 +250,8 @@ struct audio_device_info
 };
 
 std::vector<audio_device_info> get_audio_devices();
+bool try_get_audio_device(int card_id, int device_id, audio_device_info& device);
+bool try_parse_audio_device_hw_id(std::string_view hw_id, int& card_id, int& device_id);
 bool can_use_audio_device(const audio_device_info& device);
 bool test_audio_device(const audio_device_info& device);
 
@@ -172,6 +317,36 @@ bool try_set_audio_device_volume_percent(const audio_device_info& device, int vo
 bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel& channel);
 bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value);
 
+// The outcome of a volume set, the error of the set describes the failure
+
+enum class audio_device_volume_set_status
+{
+    not_applied,
+    applied,
+    device_not_found,
+    control_not_found,
+    channel_not_found,
+    failed,
+    not_verified
+};
+
+// One volume set of a batch, the results are filled in when the batch is applied
+// A channel of none sets every channel of the control
+
+struct audio_device_channel_volume_set
+{
+    std::string control_name;
+    audio_device_channel_id channel = audio_device_channel_id::none;
+    audio_device_type channel_type = audio_device_type::playback | audio_device_type::capture;
+    int volume_percent = 0;
+    bool success = false;
+    bool verified = false;
+    audio_device_volume_set_status status = audio_device_volume_set_status::not_applied;
+    std::string error;
+};
+
+bool try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify);
+
 std::string to_json(const audio_device_volume_info& d, bool wrapping_object = true, int tabs = 0);
 std::string to_json(const audio_device_volume_info& d, std::function<std::string(const audio_device_volume_info& d)> render_device, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c)> render_control, std::function<std::string(const audio_device_volume_info& d, const audio_device_volume_control& c, const audio_device_channel& ch)> render_channel, bool wrapping_object, int tabs);
 
@@ -231,3 +406,705 @@ std::vector<audio_device_info> get_audio_devices(const device_description& desc)
 bool try_get_serial_port(const device_description& desc, serial_port& p);
 
 std::string to_json(const device_description& d, bool wrapping_object = true, int tabs = 0);
+
+// **************************************************************** //
+//                                                                  //
+// DEVICE SNAPSHOT                                                  //
+//                                                                  //
+// **************************************************************** //
+
+// A snapshot of the enumerated devices and their descriptions
+// Devices and ports without a description have an empty description path
+// The snapshot is valid for as long as the boot id and the uevent sequence number are unchanged
+
+struct device_snapshot
+{
+    std::string boot_id;
+    uint64_t uevent_seqnum = 0;
+    std::vector<std::pair<audio_device_info, device_description>> devices;
+    std::vector<std::pair<serial_port, device_description>> ports;
+};
+
+bool try_get_uevent_seqnum(uint64_t& seqnum);
+bool try_get_boot_id(std::string& boot_id);
+bool is_device_snapshot_current(const device_snapshot& snapshot);
+
+device_snapshot get_device_snapshot();
+
+std::vector<std::pair<audio_device_info, device_description>> get_sibling_audio_devices(const device_snapshot& snapshot, const device_description& desc);
+std::vector<std::pair<serial_port, device_description>> get_sibling_serial_ports(const device_snapshot& snapshot, const device_description& desc);
+
+// **************************************************************** //
+//                                                                  //
+// DEVICE BACKEND                                                   //
+//                                                                  //
+// **************************************************************** //
+
+// The card, PCM, mixer, udev and tty queries of this library go through the current backend
+// The default backend uses libasound and libudev, it can be replaced to run without the hardware
+// The device and mixer monitors always watch the system devices, see is_system_device_backend
+
+struct device_backend
+{
+    virtual ~device_backend() = default;
+
+    virtual std::vector<audio_device_info> get_audio_devices() = 0;
+    virtual bool try_get_audio_device(int card_id, int device_id, audio_device_info& device) = 0;
+    virtual bool can_use_audio_device(const audio_device_info& device) = 0;
+    virtual bool test_audio_device(const audio_device_info& device) = 0;
+
+    virtual bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume) = 0;
+    virtual bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) = 0;
+    virtual bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) = 0;
+    virtual bool try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify) = 0;
+
+    virtual std::vector<serial_port> get_serial_ports() = 0;
+
+    virtual bool try_get_device_description(const audio_device_info& d, device_description& desc) = 0;
+    virtual bool try_get_device_description(const serial_port& p, device_description& desc) = 0;
+    virtual std::vector<device_description> get_sibling_audio_devices(const device_description& desc) = 0;
+    virtual std::vector<device_description> get_sibling_serial_ports(const device_description& desc) = 0;
+    virtual std::vector<audio_device_info> get_audio_devices(const device_description& desc) = 0;
+    virtual bool try_get_serial_port(const device_description& desc, serial_port& port) = 0;
+};
+
+struct alsa_udev_device_backend : public device_backend
+{
+    std::vector<audio_device_info> get_audio_devices() override;
+    bool try_get_audio_device(int card_id, int device_id, audio_device_info& device) override;
+    bool can_use_audio_device(const audio_device_info& device) override;
+    bool test_audio_device(const audio_device_info& device) override;
+
+    bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume) override;
+    bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) override;
+    bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) override;
+    bool try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify) override;
+
+    std::vector<serial_port> get_serial_ports() override;
+
+    bool try_get_device_description(const audio_device_info& d, device_description& desc) override;
+    bool try_get_device_description(const serial_port& p, device_description& desc) override;
+    std::vector<device_description> get_sibling_audio_devices(const device_description& desc) override;
+    std::vector<device_description> get_sibling_serial_ports(const device_description& desc) override;
+    std::vector<audio_device_info> get_audio_devices(const device_description& desc) override;
+    bool try_get_serial_port(const device_description& desc, serial_port& port) override;
+};
+
+// An in-memory sound card, with its PCM devices, mixer controls and the description of its USB device
+// Siblings are found from the hw_path of the descriptions, like in a device snapshot
+
+struct fake_audio_card
+{
+    int card_id = -1;
+    std::vector<audio_device_info> devices;
+    std::vector<audio_device_volume_control> controls;
+    device_description description;
+};
+
+struct fake_serial_port
+{
+    serial_port port;
+    device_description description;
+};
+
+// Serves a device population held in memory, volume sets update the fake mixer controls
+// The cards and ports must not be changed once the backend is in use
+
+struct fake_device_backend : public device_backend
+{
+    std::vector<audio_device_info> get_audio_devices() override;
+    bool try_get_audio_device(int card_id, int device_id, audio_device_info& device) override;
+    bool can_use_audio_device(const audio_device_info& device) override;
+    bool test_audio_device(const audio_device_info& device) override;
+
+    bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume) override;
+    bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) override;
+    bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) override;
+    bool try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify) override;
+
+    std::vector<serial_port> get_serial_ports() override;
+
+    bool try_get_device_description(const audio_device_info& d, device_description& desc) override;
+    bool try_get_device_description(const serial_port& p, device_description& desc) override;
+    std::vector<device_description> get_sibling_audio_devices(const device_description& desc) override;
+    std::vector<device_description> get_sibling_serial_ports(const device_description& desc) override;
+    std::vector<audio_device_info> get_audio_devices(const device_description& desc) override;
+    bool try_get_serial_port(const device_description& desc, serial_port& port) override;
+
+    std::vector<fake_audio_card> cards;
+    std::vector<fake_serial_port> ports;
+    std::mutex mutex;
+};
+
+// One recorded backend call, the key identifies its arguments
+// The results are kept in the fields used by the call, a single device, port or description as a list of one
+
+struct device_backend_call
+{
+    std::string name;
+    std::string key;
+    bool result = false;
+    int duration_microseconds = 0;
+    std::vector<audio_device_info> devices;
+    std::vector<audio_device_volume_control> controls;
+    std::vector<audio_device_channel_volume_set> sets;
+    std::vector<serial_port> ports;
+    std::vector<device_description> descriptions;
+};
+
+// Forwards every call to another backend, and records its results and latency
+
+struct recording_device_backend : public device_backend
+{
+    recording_device_backend(std::shared_ptr<device_backend> backend);
+
+    std::vector<audio_device_info> get_audio_devices() override;
+    bool try_get_audio_device(int card_id, int device_id, audio_device_info& device) override;
+    bool can_use_audio_device(const audio_device_info& device) override;
+    bool test_audio_device(const audio_device_info& device) override;
+
+    bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume) override;
+    bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) override;
+    bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) override;
+    bool try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify) override;
+
+    std::vector<serial_port> get_serial_ports() override;
+
+    bool try_get_device_description(const audio_device_info& d, device_description& desc) override;
+    bool try_get_device_description(const serial_port& p, device_description& desc) override;
+    std::vector<device_description> get_sibling_audio_devices(const device_description& desc) override;
+    std::vector<device_description> get_sibling_serial_ports(const device_description& desc) override;
+    std::vector<audio_device_info> get_audio_devices(const device_description& desc) override;
+    bool try_get_serial_port(const device_description& desc, serial_port& port) override;
+
+    std::shared_ptr<device_backend> backend;
+    std::vector<device_backend_call> calls;
+    std::mutex mutex;
+};
+
+bool try_write_device_recording(const std::string& path, recording_device_backend& backend);
+
+// Answers every call with the results recorded for the same call and arguments, in the recorded order,
+// the last results are repeated once used up, and calls that were not recorded fail
+// Each call first waits for its recorded latency multiplied by the time scale, a time scale of 0 does not wait
+// The calls must not be changed once the backend is in use
+
+struct replay_device_backend : public device_backend
+{
+    std::vector<audio_device_info> get_audio_devices() override;
+    bool try_get_audio_device(int card_id, int device_id, audio_device_info& device) override;
+    bool can_use_audio_device(const audio_device_info& device) override;
+    bool test_audio_device(const audio_device_info& device) override;
+
+    bool try_get_audio_device_volume(const audio_device_info& device, audio_device_volume_info& volume) override;
+    bool try_set_audio_device_volume(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) override;
+    bool try_set_audio_device_volume_percent(const audio_device_info& device, const std::string& control_name, const audio_device_channel_id& channel, const audio_device_type& channel_type, int value) override;
+    bool try_set_audio_device_volume_percent(int card_id, std::vector<audio_device_channel_volume_set>& sets, bool verify) override;
+
+    std::vector<serial_port> get_serial_ports() override;
+
+    bool try_get_device_description(const audio_device_info& d, device_description& desc) override;
+    bool try_get_device_description(const serial_port& p, device_description& desc) override;
+    std::vector<device_description> get_sibling_audio_devices(const device_description& desc) override;
+    std::vector<device_description> get_sibling_serial_ports(const device_description& desc) override;
+    std::vector<audio_device_info> get_audio_devices(const device_description& desc) override;
+    bool try_get_serial_port(const device_description& desc, serial_port& port) override;
+
+    std::vector<device_backend_call> calls;
+    double time_scale = 1.0;
+    std::map<std::string, std::vector<size_t>> call_index;
+    std::map<std::string, size_t> call_positions;
+    std::mutex mutex;
+};
+
+void set_device_backend(std::shared_ptr<device_backend> backend);
+std::shared_ptr<device_backend> get_device_backend();
+
+// True when the current backend reads the system devices, directly or through a recording,
+// the monitors only report the changes of the devices of such a backend
+bool is_system_device_backend();
+
+// **************************************************************** //
+//                                                                  //
+// DEVICE MONITOR                                                   //
+//                                                                  //
+// **************************************************************** //
+
+struct udev;
+struct udev_monitor;
+
+// Waits for udev events from sound cards, serial ports and USB devices
+
+struct device_monitor
+{
+    device_monitor() = default;
+    device_monitor(const device_monitor&) = delete;
+    device_monitor& operator=(const device_monitor&) = delete;
+    ~device_monitor();
+
+    udev* udev_context = nullptr;
+    udev_monitor* monitor = nullptr;
+};
+
+bool try_create_device_monitor(device_monitor& monitor);
+bool wait_for_device_change(device_monitor& monitor, int timeout_milliseconds);
+void close_device_monitor(device_monitor& monitor);
+
+struct _snd_mixer;
+
+// Waits for mixer value changes on a set of sound cards
+
+struct mixer_monitor
+{
+    mixer_monitor() = default;
+    mixer_monitor(const mixer_monitor&) = delete;
+    mixer_monitor& operator=(const mixer_monitor&) = delete;
+    ~mixer_monitor();
+
+    std::vector<std::pair<int, _snd_mixer*>> mixers;
+};
+
+bool try_create_mixer_monitor(const std::vector<int>& card_ids, mixer_monitor& monitor);
+bool wait_for_mixer_change(mixer_monitor& monitor, int timeout_milliseconds, std::vector<int>& changed_card_ids);
+void close_mixer_monitor(mixer_monitor& monitor);
+
+// **************************************************************** //
+//                                                                  //
+// DEVICE SNAPSHOT FILE                                             //
+//                                                                  //
+// **************************************************************** //
+
+// A device snapshot stored in a versioned binary file made of fixed layout records,
+// a string table and a hash index, the file is memory mapped read-only and used in place
+// Lookups by hw_id, devnode, vendor and product id, and serial number go through the index
+// Only files owned by the effective user are mapped
+
+struct mapped_device_snapshot
+{
+    mapped_device_snapshot() = default;
+    mapped_device_snapshot(const mapped_device_snapshot&) = delete;
+    mapped_device_snapshot& operator=(const mapped_device_snapshot&) = delete;
+    ~mapped_device_snapshot();
+
+    // Only set once the header has been validated
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+bool try_write_device_snapshot(const std::string& path, const device_snapshot& snapshot);
+
+bool try_map_device_snapshot(const std::string& path, mapped_device_snapshot& snapshot);
+void unmap_device_snapshot(mapped_device_snapshot& snapshot);
+
+bool is_device_snapshot_current(const mapped_device_snapshot& snapshot);
+uint64_t get_uevent_seqnum(const mapped_device_snapshot& snapshot);
+std::string_view get_boot_id(const mapped_device_snapshot& snapshot);
+
+size_t get_audio_device_count(const mapped_device_snapshot& snapshot);
+size_t get_serial_port_count(const mapped_device_snapshot& snapshot);
+bool try_get_audio_device(const mapped_device_snapshot& snapshot, size_t index, audio_device_info& device, device_description& desc);
+bool try_get_serial_port(const mapped_device_snapshot& snapshot, size_t index, serial_port& port, device_description& desc);
+
+bool try_find_audio_device(const mapped_device_snapshot& snapshot, std::string_view hw_id, audio_device_info& device, device_description& desc);
+bool try_find_serial_port(const mapped_device_snapshot& snapshot, std::string_view devnode, serial_port& port, device_description& desc);
+std::vector<std::pair<audio_device_info, device_description>> find_audio_devices(const mapped_device_snapshot& snapshot, std::string_view id_vendor, std::string_view id_product);
+std::vector<std::pair<serial_port, device_description>> find_serial_ports(const mapped_device_snapshot& snapshot, std::string_view id_vendor, std::string_view id_product);
+std::vector<std::pair<serial_port, device_description>> find_serial_ports_by_serial_number(const mapped_device_snapshot& snapshot, std::string_view serial_number);
+
+device_snapshot to_device_snapshot(const mapped_device_snapshot& snapshot);
+
+// **************************************************************** //
+//                                                                  //
+// SEARCH                                                           //
+//                                                                  //
+// **************************************************************** //
+
+// The search, filter, sort and volume set functions of the find_devices command line,
+// the command line and the server are built on top of them
+
+struct search_options;
+
+struct audio_device_filter
+{
+    std::string name_filter = "";
+    std::string desc_filter = "";
+    std::string stream_name_filter = "";
+    bool playback_only = false; // TODO: use audio_device_type?
+    bool capture_only = false; // TODO: use audio_device_type?
+    bool playback_or_capture = false; // TODO: use audio_device_type?
+    bool playback_and_capture = false; // TODO: use audio_device_type?
+    int bus = -1;
+    int device = -1;
+    int topology = -1;
+    std::string path;
+    std::string hw_path;
+    std::string order_by;
+    std::string order_direction;
+};
+
+struct audio_device_volume_set
+{
+    std::string control_name;
+    std::vector<audio_device_channel_id> audio_channels;
+    audio_device_type audio_channel_type = audio_device_type::uknown;
+    int volume = -1;
+    int volume_max_error = 0;
+};
+
+struct audio_device_unique_volume_set
+{
+    audio_device_volume_set volume_set;
+    audio_device_volume_info volume;
+    audio_device_volume_control control;
+    audio_device_channel channel;
+    std::string unique_channel_id;
+    int property_set_count = 0;
+    int volume_control_error = 0;
+    int volume_control_error_percent = 0;
+};
+
+struct serial_port_filter
+{
+    std::string name_filter = "";
+    std::string description_filter = "";
+    std::string manufacturer_filter = "";
+    std::string device_serial_number = "";
+    int bus = -1;
+    int device = -1;
+    int topology = -1;
+    std::string path;
+    std::string hw_path;
+    std::string order_by;
+    std::string order_direction;
+};
+
+// The string filters are compiled once per search, the compiled patterns are cached and shared by the searches of the process
+// A pattern is a case insensitive substring by default,
+// "glob:" matches the whole value with * and ?, ex: "glob:USB Audio*",
+// "regex:" searches the value with an ECMAScript regular expression, use ^ and $ to anchor it, ex: "regex:^USB Audio.*"
+
+enum class pattern_type
+{
+    any,
+    substring,
+    glob,
+    regex
+};
+
+struct compiled_pattern
+{
+    pattern_type type = pattern_type::any;
+    std::string text;
+    std::regex regex;
+};
+
+struct compiled_audio_device_filter
+{
+    audio_device_filter filter;
+    std::shared_ptr<const compiled_pattern> name;
+    std::shared_ptr<const compiled_pattern> description;
+    std::shared_ptr<const compiled_pattern> stream_name;
+};
+
+struct compiled_serial_port_filter
+{
+    serial_port_filter filter;
+    std::shared_ptr<const compiled_pattern> name;
+    std::shared_ptr<const compiled_pattern> description;
+    std::shared_ptr<const compiled_pattern> manufacturer;
+    std::shared_ptr<const compiled_pattern> device_serial_number;
+};
+
+bool try_compile_pattern(const std::string& pattern, std::shared_ptr<const compiled_pattern>& compiled);
+bool match_pattern(const compiled_pattern& pattern, std::string_view value);
+bool try_compile_filter(const audio_device_filter& filter, compiled_audio_device_filter& compiled);
+bool try_compile_filter(const serial_port_filter& filter, compiled_serial_port_filter& compiled);
+
+// Match the compiled filter against the records of a mapped snapshot in place, and only decode the matching records
+// The device description filters are left to filter_audio_devices and filter_serial_ports
+std::vector<std::pair<audio_device_info, device_description>> find_audio_devices(const mapped_device_snapshot& snapshot, const compiled_audio_device_filter& filter);
+std::vector<std::pair<serial_port, device_description>> find_serial_ports(const mapped_device_snapshot& snapshot, const compiled_serial_port_filter& filter);
+
+enum class search_mode
+{
+    not_set,
+    independent,
+    audio_siblings,
+    port_siblings
+};
+
+struct search_result
+{
+    std::vector<std::pair<audio_device_volume_info, device_description>> devices;
+    std::vector<std::pair<serial_port, device_description>> ports;
+};
+
+// Monotonic timings of the phases of a run, and of the per device steps within the phases
+// Steps have a device, phases do not, the start is relative to the start of the run
+
+struct timing_entry
+{
+    std::string name;
+    std::string device;
+    uint64_t start_microseconds = 0;
+    uint64_t duration_microseconds = 0;
+};
+
+struct run_timings
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::atomic<bool> enabled {true};
+    std::mutex mutex;
+    std::vector<timing_entry> entries;
+};
+
+// Records its lifetime when timings are enabled, does nothing otherwise
+
+struct scoped_timing
+{
+    scoped_timing(const search_options& options, std::string_view name, std::string_view device = {});
+    scoped_timing(const scoped_timing&) = delete;
+    scoped_timing& operator=(const scoped_timing&) = delete;
+    ~scoped_timing();
+
+    run_timings* timings = nullptr;
+    timing_entry entry;
+    std::chrono::steady_clock::time_point start;
+};
+
+struct search_options
+{
+    audio_device_filter audio_filter;
+    serial_port_filter port_filter;
+    std::vector<audio_device_volume_set> volume_set;
+    enum search_mode search_mode = search_mode::independent;
+    std::string cache_file;
+    std::shared_ptr<run_timings> timings;
+    bool include_descriptions = true; // false only looks up the descriptions the filters, siblings or sort need
+};
+
+std::vector<audio_device_info> get_audio_devices(const audio_device_filter& m);
+std::vector<audio_device_volume_info> get_audio_devices(const std::string& id);
+bool match_audio_device(const audio_device_info& d, const audio_device_filter& m);
+bool match_audio_device(const audio_device_info& d, const compiled_audio_device_filter& m);
+bool match_audio_device_type(audio_device_type type, const audio_device_filter& m);
+bool match_device(const device_description& p, const audio_device_filter& m);
+bool try_get_audio_device_channel(const audio_device_info& audio_device, const std::string& control_name, audio_device_channel_id channel_id, audio_device_type channel_type, audio_device_channel& channel);
+bool try_get_audio_device_channel(const audio_device_info& audio_device, const std::string& control_name, const std::string& channel_name, std::vector<audio_device_channel>& result);
+bool try_set_audio_device_volume_percent(const audio_device_info& audio_device, const std::string& control_name, const std::string& channel_name, audio_device_type type, int value);
+
+std::vector<serial_port> get_serial_ports(const serial_port_filter& m);
+bool match_port(const serial_port& p, const serial_port_filter& m);
+bool match_port(const serial_port& p, const compiled_serial_port_filter& m);
+bool match_device(const device_description& p, const serial_port_filter& m);
+
+std::vector<std::pair<audio_device_info, device_description>> filter_audio_devices(const search_options& options, const std::vector<audio_device_info>& devices);
+std::vector<std::pair<audio_device_info, device_description>> filter_audio_devices(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices);
+std::vector<std::pair<serial_port, device_description>> filter_serial_ports(const search_options& options, const std::vector<serial_port>& ports);
+std::vector<std::pair<serial_port, device_description>> filter_serial_ports(const search_options& options, const std::vector<std::pair<serial_port, device_description>>& ports);
+std::vector<audio_device_info> get_sibling_audio_devices(const search_options& options, const std::vector<std::pair<serial_port, device_description>>& ports);
+std::vector<serial_port> get_sibling_serial_ports(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices);
+std::vector<std::pair<audio_device_info, device_description>> get_sibling_audio_devices(const search_options& options, const device_snapshot& snapshot, const std::vector<std::pair<serial_port, device_description>>& ports);
+std::vector<std::pair<serial_port, device_description>> get_sibling_serial_ports(const search_options& options, const device_snapshot& snapshot, const std::vector<std::pair<audio_device_info, device_description>>& devices);
+std::vector<std::pair<audio_device_volume_info, device_description>> map_device_to_volume(const search_options& options, const std::vector<std::pair<audio_device_info, device_description>>& devices);
+
+// Uses the snapshot cached in the cache file when one is set, and still current
+search_result search(const search_options& options);
+search_result search(const search_options& options, const device_snapshot& snapshot);
+search_result search(const search_options& options, const mapped_device_snapshot& snapshot);
+device_snapshot get_device_snapshot(const search_options& options);
+void sort(const search_options& options, search_result& result);
+
+// Volume sets are applied to the devices of a search result, the most specific set of a channel wins
+std::vector<audio_device_unique_volume_set> generate_unique_volume_set(const search_options& options, const search_result& result);
+std::vector<audio_device_unique_volume_set> apply_volume_sets(const search_options& options, search_result& result, bool measure_error);
+bool verify_volume_sets(const search_options& options, const search_result& result);
+void update_devices_volume(search_result& result);
+std::string create_unique_channel_id(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel);
+
+// **************************************************************** //
+//                                                                  //
+// SHARED MEMORY SNAPSHOT                                           //
+//                                                                  //
+// **************************************************************** //
+
+// The server publishes the search result as JSON into a POSIX shared memory segment
+// The segment is protected by a seqlock: the sequence is odd while the writer is updating the payload,
+// readers copy the payload and retry if the sequence changed, readers never block the writer
+// The generation only changes when the payload changes
+// The header records the pid of the writer, a segment is only replaced once its writer is gone
+
+struct shared_snapshot_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> generation;
+    std::atomic<uint32_t> size;
+    int32_t writer_pid;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+inline const char shared_snapshot_magic[8] = { 'F', 'D', 'S', 'H', 'M', '\0', '\0', '\0' };
+inline const uint32_t shared_snapshot_version = 2;
+
+struct shared_snapshot
+{
+    shared_snapshot() = default;
+    shared_snapshot(const shared_snapshot&) = delete;
+    shared_snapshot& operator=(const shared_snapshot&) = delete;
+    ~shared_snapshot();
+
+    std::string name;
+    void* data = nullptr;
+    size_t size = 0;
+    bool owner = false;
+};
+
+bool try_create_shared_snapshot(const std::string& name, size_t capacity, shared_snapshot& snapshot);
+bool try_publish_shared_snapshot(shared_snapshot& snapshot, std::string_view payload);
+
+bool try_open_shared_snapshot(const std::string& name, shared_snapshot& snapshot);
+bool try_read_shared_snapshot(const shared_snapshot& snapshot, std::string& payload, uint64_t& generation);
+uint64_t get_shared_snapshot_generation(const shared_snapshot& snapshot);
+void close_shared_snapshot(shared_snapshot& snapshot);
+void wait_for_shared_snapshot_writer(int attempt);
+
+inline shared_snapshot::~shared_snapshot()
+{
+    close_shared_snapshot(*this);
+}
+
+inline bool try_open_shared_snapshot(const std::string& name, shared_snapshot& snapshot)
+{
+    close_shared_snapshot(snapshot);
+
+    int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat shm_stat;
+    if (fstat(fd, &shm_stat) != 0 || shm_stat.st_size < (off_t)sizeof(shared_snapshot_header))
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)shm_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const shared_snapshot_header* header = (const shared_snapshot_header*)data;
+    if (memcmp(header->magic, shared_snapshot_magic, sizeof(header->magic)) != 0 ||
+        header->version != shared_snapshot_version ||
+        sizeof(shared_snapshot_header) + header->capacity > (size_t)shm_stat.st_size)
+    {
+        munmap(data, (size_t)shm_stat.st_size);
+        return false;
+    }
+
+    snapshot.name = name;
+    snapshot.data = data;
+    snapshot.size = (size_t)shm_stat.st_size;
+    snapshot.owner = false;
+
+    return true;
+}
+
+inline bool try_read_shared_snapshot(const shared_snapshot& snapshot, std::string& payload, uint64_t& generation)
+{
+    if (snapshot.data == nullptr)
+    {
+        return false;
+    }
+
+    const shared_snapshot_header* header = (const shared_snapshot_header*)snapshot.data;
+    const char* data = (const char*)snapshot.data + sizeof(shared_snapshot_header);
+
+    for (int attempt = 0; attempt < 1000; attempt++)
+    {
+        if (attempt > 0)
+        {
+            wait_for_shared_snapshot_writer(attempt);
+        }
+
+        uint64_t sequence_before = header->sequence.load(std::memory_order_acquire);
+        if (sequence_before & 1)
+        {
+            continue;
+        }
+
+        uint32_t size = header->size.load(std::memory_order_relaxed);
+        uint64_t maybe_generation = header->generation.load(std::memory_order_relaxed);
+        if (size > header->capacity)
+        {
+            continue;
+        }
+
+        payload.assign(data, size);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (header->sequence.load(std::memory_order_relaxed) == sequence_before)
+        {
+            generation = maybe_generation;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+inline void wait_for_shared_snapshot_writer(int attempt)
+{
+    // Spin briefly while the writer copies the payload, then give up the time slice
+    // so that a writer preempted in the middle of an update can finish it
+
+    if (attempt < 64)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+    else
+    {
+        sched_yield();
+    }
+}
+
+inline uint64_t get_shared_snapshot_generation(const shared_snapshot& snapshot)
+{
+    if (snapshot.data == nullptr)
+    {
+        return 0;
+    }
+
+    // Cheap enough to poll, compare with the last generation before copying the payload
+    return ((const shared_snapshot_header*)snapshot.data)->generation.load(std::memory_order_acquire);
+}
+
+inline void close_shared_snapshot(shared_snapshot& snapshot)
+{
+    if (snapshot.data != nullptr)
+    {
+        munmap(snapshot.data, snapshot.size);
+        if (snapshot.owner)
+        {
+            shm_unlink(snapshot.name.c_str());
+        }
+    }
+    snapshot.data = nullptr;
+    snapshot.size = 0;
+    snapshot.owner = false;
+}
@@ -0,0 +1,814 @@
+// **************************************************************** //
+// find_devices - Audio device and serial ports search utility      //
+// Version 0.1.0                                                    //
+// https://github.com/iontodirel/find_devices                       //
+// Copyright (c) 2023 Ion Todirel                                   //
+// **************************************************************** //
+//
+// find_devices_bench.cpp
+// Benchmarks of the search, filter, sort and rendering hot paths.
+//
+// MIT License
+//
+// Copyright (c) 2022 Ion Todirel
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "find_devices_cli.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <sstream>
+
+#include <cxxopts.hpp>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// **************************************************************** //
+//                                                                  //
+// DATA TYPES                                                       //
+//                                                                  //
+// **************************************************************** //
+
+struct bench_options
+{
+    std::vector<int> sizes = { 1, 10, 100, 1000 };
+    int min_time_milliseconds = 200;
+    std::string filter;
+    std::string output_file;
+    std::string replay_file;
+    double replay_time_scale = 1.0;
+};
+
+struct bench_result
+{
+    std::string name;
+    int size = 0;
+    uint64_t iterations = 0;
+    double nanoseconds_per_iteration = 0;
+};
+
+// A synthetic device population served by a fake backend, every card has one USB audio device
+// and one serial port connected to the same USB hub, like a typical radio interface
+
+struct bench_population
+{
+    std::shared_ptr<fake_device_backend> backend;
+    device_snapshot snapshot;
+    search_result result;
+    std::string request_body;
+};
+
+// **************************************************************** //
+//                                                                  //
+// SYNTHETIC DEVICES                                                //
+//                                                                  //
+// **************************************************************** //
+
+bench_population create_bench_population(int size);
+std::vector<audio_device_volume_control> create_bench_controls();
+
+bench_population create_bench_population(int size)
+{
+    bench_population population;
+
+    population.backend = std::make_shared<fake_device_backend>();
+
+    for (int i = 0; i < size; i++)
+    {
+        std::string hub_path = fmt::format("/sys/devices/pci0000:00/0000:00:14.0/usb1/1-{}", i + 1);
+        std::string usb_path = fmt::format("{}/1-{}.1", hub_path, i + 1);
+
+        audio_device_info device;
+        device.card_id = i;
+        device.device_id = 0;
+        device.hw_id = fmt::format("hw:{},0", i);
+        device.plughw_id = fmt::format("plughw:{},0", i);
+        device.name = fmt::format("USB Audio Device {}", i);
+        device.stream_name = "USB Audio";
+        device.description = fmt::format("C-Media Electronics Inc. USB Audio Device at usb-0000:00:14.0-{}.1, full speed", i + 1);
+        device.type = audio_device_type::playback | audio_device_type::capture;
+
+        device_description device_desc;
+        device_desc.bus_number = 1;
+        device_desc.device_number = i + 2;
+        device_desc.path = usb_path + ":1.0/sound/card" + std::to_string(i);
+        device_desc.hw_path = usb_path;
+        device_desc.id_vendor = "0d8c";
+        device_desc.id_product = "000c";
+        device_desc.product = "USB Audio Device";
+        device_desc.manufacturer = "C-Media Electronics Inc.";
+        device_desc.topology_depth = 2;
+        device_desc.major_number = 116;
+        device_desc.minor_number = i;
+
+        serial_port port;
+        port.name = fmt::format("/dev/ttyUSB{}", i);
+        port.description = "CP2102 USB to UART Bridge Controller";
+        port.manufacturer = "Silicon Labs";
+        port.device_serial_number = fmt::format("{:04}", i);
+
+        device_description port_desc;
+        port_desc.bus_number = 1;
+        port_desc.device_number = i + 3;
+        port_desc.path = fmt::format("{}/1-{}.2:1.0/ttyUSB{}", hub_path, i + 1, i);
+        port_desc.hw_path = fmt::format("{}/1-{}.2", hub_path, i + 1);
+        port_desc.id_vendor = "10c4";
+        port_desc.id_product = "ea60";
+        port_desc.product = "CP2102 USB to UART Bridge Controller";
+        port_desc.manufacturer = "Silicon Labs";
+        port_desc.topology_depth = 2;
+        port_desc.major_number = 188;
+        port_desc.minor_number = i;
+
+        fake_audio_card card;
+        card.card_id = i;
+        card.devices.push_back(device);
+        card.controls = create_bench_controls();
+        card.description = device_desc;
+
+        fake_serial_port fake_port;
+        fake_port.port = port;
+        fake_port.description = port_desc;
+
+        population.backend->cards.push_back(card);
+        population.backend->ports.push_back(fake_port);
+    }
+
+    set_device_backend(population.backend);
+
+    population.snapshot = get_device_snapshot();
+
+    for (const auto& [d, desc] : population.snapshot.devices)
+    {
+        audio_device_volume_info volume;
+        try_get_audio_device_volume(d, volume);
+        population.result.devices.emplace_back(volume, desc);
+    }
+    population.result.ports = population.snapshot.ports;
+
+    population.request_body = R"({
+    "search_criteria": {
+        "audio": { "desc": "C-Media", "type": "playback|capture" },
+        "port": { "name": "ttyUSB" }
+    },
+    "search_mode": "audio-siblings",
+    "sort": {
+        "audio": { "order_by": "minor", "order_direction": "descending" },
+        "port": { "order_by": "minor", "order_direction": "descending" }
+    },
+    "volume_control": {
+        "playback_value": "50",
+        "capture_value": "30"
+    }
+})";
+
+    return population;
+}
+
+std::vector<audio_device_volume_control> create_bench_controls()
+{
+    // The controls of a CM108 based interface
+
+    auto create_channel = [](const std::string& name, audio_device_channel_id id, audio_device_type type, int value)
+    {
+        audio_device_channel channel;
+        channel.name = name;
+        channel.id = id;
+        channel.type = type;
+        channel.volume = value;
+        channel.volume_min = 0;
+        channel.volume_max = 100;
+        channel.volume_percent = value;
+        channel.volume_percent_linearized = value;
+        return channel;
+    };
+
+    audio_device_volume_control speaker;
+    speaker.name = "Speaker";
+    speaker.channels.push_back(create_channel("Front Left", audio_device_channel_id::front_left, audio_device_type::playback, 75));
+    speaker.channels.push_back(create_channel("Front Right", audio_device_channel_id::front_right, audio_device_type::playback, 75));
+
+    audio_device_volume_control mic;
+    mic.name = "Mic";
+    mic.channels.push_back(create_channel("Mono", audio_device_channel_id::mono, audio_device_type::playback, 0));
+    mic.channels.push_back(create_channel("Mono", audio_device_channel_id::mono, audio_device_type::capture, 50));
+
+    return { speaker, mic };
+}
+
+// **************************************************************** //
+//                                                                  //
+// BENCHMARKS                                                       //
+//                                                                  //
+// **************************************************************** //
+
+namespace
+{
+    // Keeps the compiler from discarding the benchmarked work, without storing the value anywhere
+    template<typename T>
+    void do_not_optimize(const T& value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+}
+
+bool try_parse_bench_command_line(int argc, char* argv[], bench_options& options);
+void run_benchmarks(const bench_options& options, int size, std::vector<bench_result>& results);
+void run_http_benchmarks(const bench_options& options, int size, const bench_population& population, const args& args, std::vector<bench_result>& results);
+bool try_connect_bench_client(int port, int& fd);
+bool try_send_bench_request(int fd, const std::string& request, std::string& response);
+bool try_run_replay_benchmarks(const bench_options& options, std::vector<bench_result>& results);
+std::string to_json(const bench_options& options, const std::vector<bench_result>& results);
+
+template<typename F>
+void run_benchmark(const bench_options& options, const std::string& name, int size, std::vector<bench_result>& results, F f)
+{
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+    {
+        return;
+    }
+
+    // The iterations are doubled until a batch runs for at least the minimum time
+
+    auto min_time = std::chrono::milliseconds(options.min_time_milliseconds);
+
+    uint64_t iterations = 1;
+    std::chrono::steady_clock::duration elapsed {};
+
+    while (true)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; i++)
+        {
+            f();
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+
+        if (elapsed >= min_time || iterations >= (1ull << 40))
+        {
+            break;
+        }
+
+        iterations *= 2;
+    }
+
+    bench_result result;
+    result.name = name;
+    result.size = size;
+    result.iterations = iterations;
+    result.nanoseconds_per_iteration = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (double)iterations;
+    results.push_back(result);
+
+    fmt::print(stderr, "{:<40} {:>6} {:>14.1f} ns\n", name, size, result.nanoseconds_per_iteration);
+}
+
+void run_benchmarks(const bench_options& options, int size, std::vector<bench_result>& results)
+{
+    bench_population population = create_bench_population(size);
+
+    args args;
+    args.ignore_config = true;
+    args.no_stdout = true;
+    args.disable_write_file = true;
+    args.audio_filter.desc_filter = "C-Media";
+    args.audio_filter.playback_or_capture = true;
+    args.audio_filter.order_by = "minor";
+    args.audio_filter.order_direction = "descending";
+    args.port_filter.name_filter = "ttyUSB";
+    args.port_filter.order_by = "minor";
+    args.port_filter.order_direction = "descending";
+
+    audio_device_volume_set playback_set;
+    playback_set.audio_channel_type = audio_device_type::playback;
+    playback_set.volume = 50;
+    audio_device_volume_set capture_set;
+    capture_set.control_name = "Mic";
+    capture_set.audio_channel_type = audio_device_type::capture;
+    capture_set.volume = 30;
+    args.volume_set.push_back(playback_set);
+    args.volume_set.push_back(capture_set);
+
+    run_benchmark(options, "get_device_snapshot", size, results, [&]()
+    {
+        do_not_optimize(get_device_snapshot().devices.size());
+    });
+
+    run_benchmark(options, "search", size, results, [&]()
+    {
+        do_not_optimize(search(args, population.snapshot).devices.size());
+    });
+
+    // The filters are compiled once, like in a search
+
+    compiled_audio_device_filter audio_filter;
+    compiled_serial_port_filter port_filter;
+    try_compile_filter(args.audio_filter, audio_filter);
+    try_compile_filter(args.port_filter, port_filter);
+
+    run_benchmark(options, "match_audio_device", size, results, [&]()
+    {
+        for (const auto& d : population.snapshot.devices)
+            do_not_optimize(match_audio_device(d.first, audio_filter));
+    });
+
+    run_benchmark(options, "match_port", size, results, [&]()
+    {
+        for (const auto& p : population.snapshot.ports)
+            do_not_optimize(match_port(p.first, port_filter));
+    });
+
+    run_benchmark(options, "filter_audio_devices", size, results, [&]()
+    {
+        do_not_optimize(filter_audio_devices(args, population.snapshot.devices).size());
+    });
+
+    run_benchmark(options, "filter_serial_ports", size, results, [&]()
+    {
+        do_not_optimize(filter_serial_ports(args, population.snapshot.ports).size());
+    });
+
+    run_benchmark(options, "get_sibling_serial_ports", size, results, [&]()
+    {
+        do_not_optimize(get_sibling_serial_ports(args, population.snapshot, population.snapshot.devices).size());
+    });
+
+    run_benchmark(options, "generate_unique_volume_set", size, results, [&]()
+    {
+        do_not_optimize(generate_unique_volume_set(args, population.result).size());
+    });
+
+    std::vector<audio_device_unique_volume_set> audio_set_result = generate_unique_volume_set(args, population.result);
+
+    run_benchmark(options, "sort", size, results, [&]()
+    {
+        search_result result = population.result;
+        sort(args, result);
+        do_not_optimize(result.devices.size());
+    });
+
+    run_benchmark(options, "to_json_audio_device_info", size, results, [&]()
+    {
+        for (const auto& d : population.snapshot.devices)
+            do_not_optimize(to_json(d.first).size());
+    });
+
+    run_benchmark(options, "to_json_audio_device_volume_info", size, results, [&]()
+    {
+        for (const auto& d : population.result.devices)
+            do_not_optimize(to_json(d.first).size());
+    });
+
+    run_benchmark(options, "to_json_serial_port", size, results, [&]()
+    {
+        for (const auto& p : population.snapshot.ports)
+            do_not_optimize(to_json(p.first).size());
+    });
+
+    run_benchmark(options, "to_json_device_description", size, results, [&]()
+    {
+        for (const auto& d : population.snapshot.devices)
+            do_not_optimize(to_json(d.second).size());
+    });
+
+    run_benchmark(options, "to_json_search_result", size, results, [&]()
+    {
+        do_not_optimize(to_json(args, population.result, audio_set_result, true).size());
+    });
+
+    std::string rendered = to_json(population.snapshot.devices.empty() ? audio_device_info() : population.snapshot.devices[0].first);
+
+    run_benchmark(options, "insert_tabs", size, results, [&]()
+    {
+        for (int i = 0; i < size; i++)
+        {
+            std::string s = rendered;
+            insert_tabs(s, 2);
+            do_not_optimize(s.size());
+        }
+    });
+
+    // The results of a volume set request, three sets per device
+
+    std::vector<audio_device_channel_volume_set> volume_sets;
+    std::vector<std::pair<int, int>> volume_set_hw_ids;
+    for (const auto& [d, desc] : population.snapshot.devices)
+    {
+        for (const auto& [control_name, channel] : { std::make_pair("Speaker", audio_device_channel_id::front_left), std::make_pair("Speaker", audio_device_channel_id::front_right), std::make_pair("Mic", audio_device_channel_id::mono) })
+        {
+            audio_device_channel_volume_set set;
+            set.control_name = control_name;
+            set.channel = channel;
+            set.volume_percent = 50;
+            set.success = true;
+            set.verified = true;
+            volume_sets.push_back(set);
+            volume_set_hw_ids.emplace_back(d.card_id, d.device_id);
+        }
+    }
+
+    run_benchmark(options, "to_json_volume_sets", size, results, [&]()
+    {
+        do_not_optimize(to_json(volume_sets, volume_set_hw_ids, true).size());
+    });
+
+    // One output file per device, like a profiles run with a file per profile
+
+    std::vector<file_write_result> files;
+    for (int i = 0; i < size; i++)
+    {
+        file_write_result file;
+        file.path = fmt::format("/var/lib/find_devices/radio{}.json", i);
+        file.description = fmt::format("radio{}", i);
+        file.success = true;
+        file.changed = (i % 2) == 0;
+        files.push_back(file);
+    }
+
+    run_benchmark(options, "to_json_file_writes", size, results, [&]()
+    {
+        do_not_optimize(to_json(files).size());
+    });
+
+    // The phases of a run, and the steps of every device
+
+    run_timings timings;
+    for (const char* phase : { "snapshot", "search", "sort", "volume", "render" })
+    {
+        timings.entries.push_back(timing_entry{ phase, "", 100, 2500 });
+    }
+    for (const auto& [d, desc] : population.snapshot.devices)
+    {
+        timings.entries.push_back(timing_entry{ "mixer_load", d.hw_id, 200, 850 });
+        timings.entries.push_back(timing_entry{ "siblings", d.hw_id, 1200, 40 });
+    }
+
+    run_benchmark(options, "to_json_timings", size, results, [&]()
+    {
+        do_not_optimize(to_json(timings).size());
+    });
+
+    run_benchmark(options, "http_post_devices", size, results, [&]()
+    {
+        nlohmann::json j = nlohmann::json::parse(population.request_body);
+        do_not_optimize(process_devices_to_json(j, population.snapshot).size());
+    });
+
+    run_http_benchmarks(options, size, population, args, results);
+
+    set_device_backend(nullptr);
+}
+
+void run_http_benchmarks(const bench_options& options, int size, const bench_population& population, const args& args, std::vector<bench_result>& results)
+{
+    // The GET requests go through a server on the loopback interface and the /devices handler,
+    // the refresh which renders the served JSON is measured on its own
+
+    server_state state;
+    state.instance_id = "bench";
+
+    shared_snapshot shared_memory;
+    state.shared_memory = &shared_memory;
+
+    std::shared_ptr<const device_snapshot> devices = std::make_shared<const device_snapshot>(population.snapshot);
+
+    publish_server_snapshot(args, devices, state, shared_memory);
+
+    run_benchmark(options, "publish_server_snapshot", size, results, [&]()
+    {
+        publish_server_snapshot(args, devices, state, shared_memory);
+    });
+
+    if (!options.filter.empty() && std::string("http_get_devices").find(options.filter) == std::string::npos &&
+        std::string("http_get_devices_not_modified").find(options.filter) == std::string::npos)
+    {
+        return;
+    }
+
+    const char* server_options[] = {
+        "listening_ports", "127.0.0.1:0",
+        "num_threads", "1",
+        "enable_keep_alive", "yes",
+        nullptr
+    };
+
+    try
+    {
+        CivetServer server(server_options);
+
+        DevicesHttpHandler devices_handler(args, state);
+        server.addHandler("/devices", devices_handler);
+
+        std::vector<int> ports = server.getListeningPorts();
+
+        int fd = -1;
+        if (ports.empty() || !try_connect_bench_client(ports[0], fd))
+        {
+            fmt::print(stderr, "Failed to connect to the benchmark server, skipping the HTTP benchmarks\n");
+            return;
+        }
+
+        std::string etag = get_server_snapshot(state)->etag;
+        std::string get_request = "GET /devices HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+        std::string not_modified_request = fmt::format("GET /devices HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\nIf-None-Match: {}\r\n\r\n", etag);
+        std::string response;
+
+        // The connection is opened again if the server closed it, which is then part of the measurement
+
+        auto get = [&](const std::string& request)
+        {
+            if (!try_send_bench_request(fd, request, response))
+            {
+                close(fd);
+                fd = -1;
+                if (try_connect_bench_client(ports[0], fd))
+                    try_send_bench_request(fd, request, response);
+            }
+            do_not_optimize(response.size());
+        };
+
+        run_benchmark(options, "http_get_devices", size, results, [&]()
+        {
+            get(get_request);
+        });
+
+        run_benchmark(options, "http_get_devices_not_modified", size, results, [&]()
+        {
+            get(not_modified_request);
+        });
+
+        if (fd >= 0)
+            close(fd);
+
+        server.close();
+    }
+    catch (const std::exception& e)
+    {
+        fmt::print(stderr, "Failed to start the benchmark server, skipping the HTTP benchmarks: {}\n", e.what());
+    }
+}
+
+bool try_connect_bench_client(int port, int& fd)
+{
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // Requests are small writes followed by a read, do not delay them
+    int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+bool try_send_bench_request(int fd, const std::string& request, std::string& response)
+{
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    size_t sent = 0;
+    while (sent < request.size())
+    {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += (size_t)n;
+    }
+
+    // Reads the headers, then as many bytes as the Content-Length, a 304 has no body
+
+    response.clear();
+
+    char buffer[16384];
+    size_t headers_end = std::string::npos;
+    size_t content_length = 0;
+
+    while (true)
+    {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            return false;
+        response.append(buffer, (size_t)n);
+
+        if (headers_end == std::string::npos)
+        {
+            headers_end = response.find("\r\n\r\n");
+            if (headers_end == std::string::npos)
+                continue;
+            headers_end += 4;
+
+            size_t length_pos = response.find("Content-Length: ");
+            if (length_pos != std::string::npos && length_pos < headers_end)
+            {
+                size_t length_end = response.find("\r\n", length_pos);
+                int length = 0;
+                if (try_parse_int(std::string_view(response).substr(length_pos + 16, length_end - length_pos - 16), length))
+                    content_length = (size_t)length;
+            }
+        }
+
+        if (response.size() >= headers_end + content_length)
+            return true;
+    }
+}
+
+bool try_run_replay_benchmarks(const bench_options& options, std::vector<bench_result>& results)
+{
+    // Replays a recording made with find_devices --record, the size is the number of recorded audio devices
+
+    auto backend = std::make_shared<replay_device_backend>();
+    backend->time_scale = options.replay_time_scale;
+    if (!try_read_device_recording(options.replay_file, *backend))
+    {
+        fmt::print(stderr, "Failed to read recording file {}\n", options.replay_file);
+        return false;
+    }
+
+    set_device_backend(backend);
+
+    args args;
+    args.ignore_config = true;
+    args.no_stdout = true;
+    args.disable_write_file = true;
+
+    int size = (int)get_device_snapshot().devices.size();
+
+    run_benchmark(options, "replay_get_device_snapshot", size, results, [&]()
+    {
+        do_not_optimize(get_device_snapshot().devices.size());
+    });
+
+    run_benchmark(options, "replay_search", size, results, [&]()
+    {
+        do_not_optimize(search(args).devices.size());
+    });
+
+    set_device_backend(nullptr);
+
+    return true;
+}
+
+bool try_parse_bench_command_line(int argc, char* argv[], bench_options& options)
+{
+    cxxopts::Options cxxopts_options("find_devices_bench", "Benchmarks of the find_devices hot paths");
+
+    cxxopts_options.add_options()
+        ("sizes", "Comma separated device population sizes", cxxopts::value<std::string>()->default_value("1,10,100,1000"))
+        ("min-time", "Minimum run time of each benchmark in milliseconds", cxxopts::value<int>()->default_value("200"))
+        ("filter", "Only run the benchmarks with names containing the filter", cxxopts::value<std::string>()->default_value(""))
+        ("o,output-file", "Write the JSON results to a file instead of stdout", cxxopts::value<std::string>()->default_value(""))
+        ("replay", "Benchmark a recording made with find_devices --record instead of the synthetic devices", cxxopts::value<std::string>()->default_value(""))
+        ("replay-time-scale", "Multiplies the recorded latencies, 0 replays without waiting", cxxopts::value<double>()->default_value("1"))
+        ("h,help", "Print usage");
+
+    try
+    {
+        auto result = cxxopts_options.parse(argc, argv);
+
+        if (result.count("help") > 0)
+        {
+            printf("%s\n", cxxopts_options.help().c_str());
+            return false;
+        }
+
+        options.sizes.clear();
+        std::istringstream ss(result["sizes"].as<std::string>());
+        std::string size_str;
+        while (std::getline(ss, size_str, ','))
+        {
+            int size = 0;
+            if (!try_parse_int(size_str, size) || size < 1)
+            {
+                fmt::print(stderr, "Invalid size: {}\n", size_str);
+                return false;
+            }
+            options.sizes.push_back(size);
+        }
+
+        options.min_time_milliseconds = result["min-time"].as<int>();
+        options.filter = result["filter"].as<std::string>();
+        options.output_file = result["output-file"].as<std::string>();
+        options.replay_file = result["replay"].as<std::string>();
+        options.replay_time_scale = result["replay-time-scale"].as<double>();
+    }
+    catch (const std::exception& e)
+    {
+        fmt::print(stderr, "{}\n", e.what());
+        return false;
+    }
+
+    return true;
+}
+
+std::string to_json(const bench_options& options, const std::vector<bench_result>& results)
+{
+    std::string s;
+    s += "{\n";
+#ifdef GIT_HASH
+    s += fmt::format("    \"git_hash\": \"{}\",\n", STRINGIFY(GIT_HASH));
+#endif
+    s += fmt::format("    \"min_time_milliseconds\": \"{}\",\n", options.min_time_milliseconds);
+    s += "    \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const bench_result& r = results[i];
+        s += "        {\n";
+        s += fmt::format("            \"name\": \"{}\",\n", r.name);
+        s += fmt::format("            \"size\": \"{}\",\n", r.size);
+        s += fmt::format("            \"iterations\": \"{}\",\n", r.iterations);
+        s += fmt::format("            \"ns_per_iteration\": \"{:.1f}\"\n", r.nanoseconds_per_iteration);
+        s += "        }";
+        if ((i + 1) < results.size())
+        {
+            s.append(",");
+        }
+        s.append("\n");
+    }
+    s += "    ]\n";
+    s += "}";
+    return s;
+}
+
+// **************************************************************** //
+//                                                                  //
+// MAIN                                                             //
+//                                                                  //
+// **************************************************************** //
+
+int main(int argc, char* argv[])
+{
+    bench_options options;
+
+    if (!try_parse_bench_command_line(argc, argv, options))
+    {
+        return 1;
+    }
+
+    std::vector<bench_result> results;
+
+    if (!options.replay_file.empty())
+    {
+        if (!try_run_replay_benchmarks(options, results))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        for (int size : options.sizes)
+        {
+            run_benchmarks(options, size, results);
+        }
+    }
+
+    std::string json = to_json(options, results);
+
+    if (options.output_file.empty())
+    {
+        printf("%s\n", json.c_str());
+    }
+    else if (!try_write_file_atomically(options.output_file, json))
+    {
+        fmt::print(stderr, "Failed to write {}\n", options.output_file);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,552 @@
+// **************************************************************** //
+// find_devices - Audio device and serial ports search utility      //
+// Version 0.1.0                                                    //
+// https://github.com/iontodirel/find_devices                       //
+// Copyright (c) 2023 Ion Todirel                                   //
+// **************************************************************** //
+//
+// find_devices_c.cpp
+// C interface of the device enumeration, description and volume functions.
+//
+// MIT License
+//
+// Copyright (c) 2022 Ion Todirel
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "find_devices_c.h"
+#include "find_devices.hpp"
+
+#include <cstring>
+#include <new>
+
+// **************************************************************** //
+//                                                                  //
+// HANDLES                                                          //
+//                                                                  //
+// **************************************************************** //
+
+struct find_devices_snapshot
+{
+    device_snapshot snapshot;
+};
+
+struct find_devices_audio_device_iterator
+{
+    const find_devices_snapshot* snapshot = nullptr;
+    size_t index = 0;
+    bool started = false;
+};
+
+struct find_devices_serial_port_iterator
+{
+    const find_devices_snapshot* snapshot = nullptr;
+    size_t index = 0;
+    bool started = false;
+};
+
+struct find_devices_volume
+{
+    audio_device_volume_info volume;
+};
+
+// Descriptions are the device_description objects of the snapshot, they are never dereferenced as find_devices_description
+
+static_assert(FIND_DEVICES_TYPE_PLAYBACK == (int)audio_device_type::playback);
+static_assert(FIND_DEVICES_TYPE_CAPTURE == (int)audio_device_type::capture);
+static_assert(FIND_DEVICES_CHANNEL_FRONT_LEFT == (int)audio_device_channel_id::front_left);
+static_assert(FIND_DEVICES_CHANNEL_MONO == (int)audio_device_channel_id::mono);
+
+namespace
+{
+    int copy_string(const std::string& s, char* buffer, size_t buffer_size, size_t* required_size)
+    {
+        if (required_size != nullptr)
+        {
+            *required_size = s.size() + 1;
+        }
+        if (buffer == nullptr || buffer_size < s.size() + 1)
+        {
+            return FIND_DEVICES_BUFFER_TOO_SMALL;
+        }
+        memcpy(buffer, s.c_str(), s.size() + 1);
+        return FIND_DEVICES_OK;
+    }
+
+    const find_devices_description* to_description_handle(const device_description& desc)
+    {
+        return reinterpret_cast<const find_devices_description*>(&desc);
+    }
+
+    const device_description& from_description_handle(const find_devices_description* description)
+    {
+        return *reinterpret_cast<const device_description*>(description);
+    }
+
+    template<typename T>
+    int next(T* iterator, size_t count)
+    {
+        if (iterator == nullptr)
+        {
+            return FIND_DEVICES_INVALID_ARGUMENT;
+        }
+        if (iterator->started && iterator->index < count)
+        {
+            iterator->index++;
+        }
+        iterator->started = true;
+        return iterator->index < count ? FIND_DEVICES_OK : FIND_DEVICES_END;
+    }
+
+    const std::pair<audio_device_info, device_description>* get_current(const find_devices_audio_device_iterator* iterator)
+    {
+        if (iterator == nullptr || !iterator->started || iterator->index >= iterator->snapshot->snapshot.devices.size())
+        {
+            return nullptr;
+        }
+        return &iterator->snapshot->snapshot.devices[iterator->index];
+    }
+
+    const std::pair<serial_port, device_description>* get_current(const find_devices_serial_port_iterator* iterator)
+    {
+        if (iterator == nullptr || !iterator->started || iterator->index >= iterator->snapshot->snapshot.ports.size())
+        {
+            return nullptr;
+        }
+        return &iterator->snapshot->snapshot.ports[iterator->index];
+    }
+}
+
+// **************************************************************** //
+//                                                                  //
+// SNAPSHOT                                                         //
+//                                                                  //
+// **************************************************************** //
+
+int find_devices_snapshot_create(find_devices_snapshot** snapshot)
+{
+    if (snapshot == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    // No exception can cross the C interface
+
+    try
+    {
+        *snapshot = new find_devices_snapshot{ get_device_snapshot() };
+    }
+    catch (const std::exception&)
+    {
+        *snapshot = nullptr;
+        return FIND_DEVICES_ERROR;
+    }
+
+    return FIND_DEVICES_OK;
+}
+
+void find_devices_snapshot_destroy(find_devices_snapshot* snapshot)
+{
+    delete snapshot;
+}
+
+size_t find_devices_snapshot_audio_device_count(const find_devices_snapshot* snapshot)
+{
+    return snapshot != nullptr ? snapshot->snapshot.devices.size() : 0;
+}
+
+size_t find_devices_snapshot_serial_port_count(const find_devices_snapshot* snapshot)
+{
+    return snapshot != nullptr ? snapshot->snapshot.ports.size() : 0;
+}
+
+// **************************************************************** //
+//                                                                  //
+// AUDIO DEVICES                                                    //
+//                                                                  //
+// **************************************************************** //
+
+int find_devices_audio_device_iterator_create(const find_devices_snapshot* snapshot, find_devices_audio_device_iterator** iterator)
+{
+    if (snapshot == nullptr || iterator == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+    *iterator = new (std::nothrow) find_devices_audio_device_iterator{ snapshot };
+    return *iterator != nullptr ? FIND_DEVICES_OK : FIND_DEVICES_ERROR;
+}
+
+int find_devices_audio_device_iterator_next(find_devices_audio_device_iterator* iterator)
+{
+    return next(iterator, iterator != nullptr ? iterator->snapshot->snapshot.devices.size() : 0);
+}
+
+void find_devices_audio_device_iterator_reset(find_devices_audio_device_iterator* iterator)
+{
+    if (iterator != nullptr)
+    {
+        iterator->index = 0;
+        iterator->started = false;
+    }
+}
+
+void find_devices_audio_device_iterator_destroy(find_devices_audio_device_iterator* iterator)
+{
+    delete iterator;
+}
+
+int find_devices_audio_device_get_string(const find_devices_audio_device_iterator* iterator, find_devices_audio_device_field field, char* buffer, size_t buffer_size, size_t* required_size)
+{
+    auto current = get_current(iterator);
+    if (current == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    const audio_device_info& d = current->first;
+
+    switch (field)
+    {
+    case FIND_DEVICES_AUDIO_DEVICE_HW_ID:
+        return copy_string(d.hw_id, buffer, buffer_size, required_size);
+    case FIND_DEVICES_AUDIO_DEVICE_PLUGHW_ID:
+        return copy_string(d.plughw_id, buffer, buffer_size, required_size);
+    case FIND_DEVICES_AUDIO_DEVICE_NAME:
+        return copy_string(d.name, buffer, buffer_size, required_size);
+    case FIND_DEVICES_AUDIO_DEVICE_STREAM_NAME:
+        return copy_string(d.stream_name, buffer, buffer_size, required_size);
+    case FIND_DEVICES_AUDIO_DEVICE_DESCRIPTION:
+        return copy_string(d.description, buffer, buffer_size, required_size);
+    default:
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+}
+
+int find_devices_audio_device_get_int(const find_devices_audio_device_iterator* iterator, find_devices_audio_device_field field, int* value)
+{
+    auto current = get_current(iterator);
+    if (current == nullptr || value == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    const audio_device_info& d = current->first;
+
+    switch (field)
+    {
+    case FIND_DEVICES_AUDIO_DEVICE_CARD_ID:
+        *value = d.card_id;
+        return FIND_DEVICES_OK;
+    case FIND_DEVICES_AUDIO_DEVICE_DEVICE_ID:
+        *value = d.device_id;
+        return FIND_DEVICES_OK;
+    case FIND_DEVICES_AUDIO_DEVICE_TYPE:
+        *value = (int)d.type;
+        return FIND_DEVICES_OK;
+    default:
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+}
+
+int find_devices_audio_device_get_description(const find_devices_audio_device_iterator* iterator, const find_devices_description** description)
+{
+    auto current = get_current(iterator);
+    if (current == nullptr || description == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    // Devices without a description have an empty path in the snapshot
+
+    if (current->second.path.empty())
+    {
+        *description = nullptr;
+        return FIND_DEVICES_NOT_FOUND;
+    }
+
+    *description = to_description_handle(current->second);
+    return FIND_DEVICES_OK;
+}
+
+// **************************************************************** //
+//                                                                  //
+// SERIAL PORTS                                                     //
+//                                                                  //
+// **************************************************************** //
+
+int find_devices_serial_port_iterator_create(const find_devices_snapshot* snapshot, find_devices_serial_port_iterator** iterator)
+{
+    if (snapshot == nullptr || iterator == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+    *iterator = new (std::nothrow) find_devices_serial_port_iterator{ snapshot };
+    return *iterator != nullptr ? FIND_DEVICES_OK : FIND_DEVICES_ERROR;
+}
+
+int find_devices_serial_port_iterator_next(find_devices_serial_port_iterator* iterator)
+{
+    return next(iterator, iterator != nullptr ? iterator->snapshot->snapshot.ports.size() : 0);
+}
+
+void find_devices_serial_port_iterator_reset(find_devices_serial_port_iterator* iterator)
+{
+    if (iterator != nullptr)
+    {
+        iterator->index = 0;
+        iterator->started = false;
+    }
+}
+
+void find_devices_serial_port_iterator_destroy(find_devices_serial_port_iterator* iterator)
+{
+    delete iterator;
+}
+
+int find_devices_serial_port_get_string(const find_devices_serial_port_iterator* iterator, find_devices_serial_port_field field, char* buffer, size_t buffer_size, size_t* required_size)
+{
+    auto current = get_current(iterator);
+    if (current == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    const serial_port& p = current->first;
+
+    switch (field)
+    {
+    case FIND_DEVICES_SERIAL_PORT_NAME:
+        return copy_string(p.name, buffer, buffer_size, required_size);
+    case FIND_DEVICES_SERIAL_PORT_DESCRIPTION:
+        return copy_string(p.description, buffer, buffer_size, required_size);
+    case FIND_DEVICES_SERIAL_PORT_MANUFACTURER:
+        return copy_string(p.manufacturer, buffer, buffer_size, required_size);
+    case FIND_DEVICES_SERIAL_PORT_DEVICE_SERIAL_NUMBER:
+        return copy_string(p.device_serial_number, buffer, buffer_size, required_size);
+    default:
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+}
+
+int find_devices_serial_port_get_description(const find_devices_serial_port_iterator* iterator, const find_devices_description** description)
+{
+    auto current = get_current(iterator);
+    if (current == nullptr || description == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    if (current->second.path.empty())
+    {
+        *description = nullptr;
+        return FIND_DEVICES_NOT_FOUND;
+    }
+
+    *description = to_description_handle(current->second);
+    return FIND_DEVICES_OK;
+}
+
+// **************************************************************** //
+//                                                                  //
+// DEVICE DESCRIPTIONS                                              //
+//                                                                  //
+// **************************************************************** //
+
+int find_devices_description_get_string(const find_devices_description* description, find_devices_description_field field, char* buffer, size_t buffer_size, size_t* required_size)
+{
+    if (description == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    const device_description& d = from_description_handle(description);
+
+    switch (field)
+    {
+    case FIND_DEVICES_DESCRIPTION_PATH:
+        return copy_string(d.path, buffer, buffer_size, required_size);
+    case FIND_DEVICES_DESCRIPTION_HW_PATH:
+        return copy_string(d.hw_path, buffer, buffer_size, required_size);
+    case FIND_DEVICES_DESCRIPTION_ID_VENDOR:
+        return copy_string(d.id_vendor, buffer, buffer_size, required_size);
+    case FIND_DEVICES_DESCRIPTION_ID_PRODUCT:
+        return copy_string(d.id_product, buffer, buffer_size, required_size);
+    case FIND_DEVICES_DESCRIPTION_PRODUCT:
+        return copy_string(d.product, buffer, buffer_size, required_size);
+    case FIND_DEVICES_DESCRIPTION_MANUFACTURER:
+        return copy_string(d.manufacturer, buffer, buffer_size, required_size);
+    default:
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+}
+
+int find_devices_description_get_int(const find_devices_description* description, find_devices_description_field field, int* value)
+{
+    if (description == nullptr || value == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    const device_description& d = from_description_handle(description);
+
+    switch (field)
+    {
+    case FIND_DEVICES_DESCRIPTION_BUS_NUMBER:
+        *value = d.bus_number;
+        return FIND_DEVICES_OK;
+    case FIND_DEVICES_DESCRIPTION_DEVICE_NUMBER:
+        *value = d.device_number;
+        return FIND_DEVICES_OK;
+    case FIND_DEVICES_DESCRIPTION_TOPOLOGY_DEPTH:
+        *value = d.topology_depth;
+        return FIND_DEVICES_OK;
+    case FIND_DEVICES_DESCRIPTION_MAJOR_NUMBER:
+        *value = d.major_number;
+        return FIND_DEVICES_OK;
+    case FIND_DEVICES_DESCRIPTION_MINOR_NUMBER:
+        *value = d.minor_number;
+        return FIND_DEVICES_OK;
+    default:
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+}
+
+// **************************************************************** //
+//                                                                  //
+// VOLUME                                                           //
+//                                                                  //
+// **************************************************************** //
+
+int find_devices_volume_create(find_devices_volume** volume)
+{
+    if (volume == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+    *volume = new (std::nothrow) find_devices_volume;
+    return *volume != nullptr ? FIND_DEVICES_OK : FIND_DEVICES_ERROR;
+}
+
+int find_devices_volume_read(find_devices_volume* volume, const find_devices_audio_device_iterator* iterator)
+{
+    auto current = get_current(iterator);
+    if (current == nullptr || volume == nullptr)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    try
+    {
+        return try_get_audio_device_volume(current->first, volume->volume) ? FIND_DEVICES_OK : FIND_DEVICES_ERROR;
+    }
+    catch (const std::exception&)
+    {
+        return FIND_DEVICES_ERROR;
+    }
+}
+
+void find_devices_volume_destroy(find_devices_volume* volume)
+{
+    delete volume;
+}
+
+size_t find_devices_volume_control_count(const find_devices_volume* volume)
+{
+    return volume != nullptr ? volume->volume.controls.size() : 0;
+}
+
+int find_devices_volume_get_control_name(const find_devices_volume* volume, size_t control, char* buffer, size_t buffer_size, size_t* required_size)
+{
+    if (volume == nullptr || control >= volume->volume.controls.size())
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+    return copy_string(volume->volume.controls[control].name, buffer, buffer_size, required_size);
+}
+
+size_t find_devices_volume_channel_count(const find_devices_volume* volume, size_t control)
+{
+    if (volume == nullptr || control >= volume->volume.controls.size())
+    {
+        return 0;
+    }
+    return volume->volume.controls[control].channels.size();
+}
+
+int find_devices_volume_get_channel(const find_devices_volume* volume, size_t control, size_t channel, find_devices_channel* result)
+{
+    if (volume == nullptr || result == nullptr || control >= volume->volume.controls.size() || channel >= volume->volume.controls[control].channels.size())
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    const audio_device_channel& c = volume->volume.controls[control].channels[channel];
+
+    result->channel = c.id == audio_device_channel_id::none ? FIND_DEVICES_CHANNEL_ALL : (int)c.id;
+    result->type = (int)c.type;
+    result->volume = c.volume;
+    result->volume_min = c.volume_min;
+    result->volume_max = c.volume_max;
+    result->volume_percent = c.volume_percent;
+
+    return FIND_DEVICES_OK;
+}
+
+int find_devices_volume_set_percent(const find_devices_audio_device_iterator* iterator, const char* control_name, find_devices_channel_id channel, int type, int volume_percent)
+{
+    auto current = get_current(iterator);
+    if (current == nullptr || control_name == nullptr || channel < FIND_DEVICES_CHANNEL_ALL || channel > FIND_DEVICES_CHANNEL_MONO || volume_percent < 0 || volume_percent > 100)
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    // At least one of the type flags, and no other bits
+    if (type < FIND_DEVICES_TYPE_PLAYBACK || type > (FIND_DEVICES_TYPE_PLAYBACK | FIND_DEVICES_TYPE_CAPTURE))
+    {
+        return FIND_DEVICES_INVALID_ARGUMENT;
+    }
+
+    try
+    {
+        std::vector<audio_device_channel_volume_set> sets(1);
+        sets[0].control_name = control_name;
+        sets[0].channel = channel == FIND_DEVICES_CHANNEL_ALL ? audio_device_channel_id::none : (audio_device_channel_id)channel;
+        sets[0].channel_type = (audio_device_type)type;
+        sets[0].volume_percent = volume_percent;
+
+        if (try_set_audio_device_volume_percent(current->first.card_id, sets, false))
+        {
+            return FIND_DEVICES_OK;
+        }
+
+        switch (sets[0].status)
+        {
+        case audio_device_volume_set_status::device_not_found:
+        case audio_device_volume_set_status::control_not_found:
+        case audio_device_volume_set_status::channel_not_found:
+            return FIND_DEVICES_NOT_FOUND;
+        default:
+            return FIND_DEVICES_ERROR;
+        }
+    }
+    catch (const std::exception&)
+    {
+        return FIND_DEVICES_ERROR;
+    }
+}
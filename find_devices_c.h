@@ -0,0 +1,213 @@
+// **************************************************************** //
+// find_devices - Audio device and serial ports search utility      //
+// Version 0.1.0                                                    //
+// https://github.com/iontodirel/find_devices                       //
+// Copyright (c) 2023 Ion Todirel                                   //
+// **************************************************************** //
+//
+// find_devices_c.h
+// C interface of the device enumeration, description and volume functions.
+//
+// MIT License
+//
+// Copyright (c) 2022 Ion Todirel
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A C interface over the device snapshot, for callers that cannot use the C++ API
+// The snapshot is enumerated once, the iterators, descriptions and fields then read it in place
+// Strings are copied into buffers provided by the caller, no memory allocated by the library is returned
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// **************************************************************** //
+//                                                                  //
+// STATUS CODES                                                     //
+//                                                                  //
+// **************************************************************** //
+
+#define FIND_DEVICES_OK 0
+#define FIND_DEVICES_ERROR -1
+#define FIND_DEVICES_END -2
+#define FIND_DEVICES_NOT_FOUND -3
+#define FIND_DEVICES_INVALID_ARGUMENT -4
+#define FIND_DEVICES_BUFFER_TOO_SMALL -5
+
+// **************************************************************** //
+//                                                                  //
+// HANDLES AND FIELDS                                               //
+//                                                                  //
+// **************************************************************** //
+
+typedef struct find_devices_snapshot find_devices_snapshot;
+typedef struct find_devices_audio_device_iterator find_devices_audio_device_iterator;
+typedef struct find_devices_serial_port_iterator find_devices_serial_port_iterator;
+typedef struct find_devices_description find_devices_description;
+typedef struct find_devices_volume find_devices_volume;
+
+// The type values are flags, a device with both playback and capture streams has a type of 3
+
+#define FIND_DEVICES_TYPE_PLAYBACK 1
+#define FIND_DEVICES_TYPE_CAPTURE 2
+
+typedef enum find_devices_audio_device_field
+{
+    FIND_DEVICES_AUDIO_DEVICE_HW_ID,
+    FIND_DEVICES_AUDIO_DEVICE_PLUGHW_ID,
+    FIND_DEVICES_AUDIO_DEVICE_NAME,
+    FIND_DEVICES_AUDIO_DEVICE_STREAM_NAME,
+    FIND_DEVICES_AUDIO_DEVICE_DESCRIPTION,
+    FIND_DEVICES_AUDIO_DEVICE_CARD_ID,
+    FIND_DEVICES_AUDIO_DEVICE_DEVICE_ID,
+    FIND_DEVICES_AUDIO_DEVICE_TYPE
+} find_devices_audio_device_field;
+
+typedef enum find_devices_serial_port_field
+{
+    FIND_DEVICES_SERIAL_PORT_NAME,
+    FIND_DEVICES_SERIAL_PORT_DESCRIPTION,
+    FIND_DEVICES_SERIAL_PORT_MANUFACTURER,
+    FIND_DEVICES_SERIAL_PORT_DEVICE_SERIAL_NUMBER
+} find_devices_serial_port_field;
+
+typedef enum find_devices_description_field
+{
+    FIND_DEVICES_DESCRIPTION_PATH,
+    FIND_DEVICES_DESCRIPTION_HW_PATH,
+    FIND_DEVICES_DESCRIPTION_ID_VENDOR,
+    FIND_DEVICES_DESCRIPTION_ID_PRODUCT,
+    FIND_DEVICES_DESCRIPTION_PRODUCT,
+    FIND_DEVICES_DESCRIPTION_MANUFACTURER,
+    FIND_DEVICES_DESCRIPTION_BUS_NUMBER,
+    FIND_DEVICES_DESCRIPTION_DEVICE_NUMBER,
+    FIND_DEVICES_DESCRIPTION_TOPOLOGY_DEPTH,
+    FIND_DEVICES_DESCRIPTION_MAJOR_NUMBER,
+    FIND_DEVICES_DESCRIPTION_MINOR_NUMBER
+} find_devices_description_field;
+
+// The channel values follow the channel ids of find_devices.hpp, -1 selects every channel of a control
+
+typedef enum find_devices_channel_id
+{
+    FIND_DEVICES_CHANNEL_ALL = -1,
+    FIND_DEVICES_CHANNEL_FRONT_LEFT = 0,
+    FIND_DEVICES_CHANNEL_FRONT_RIGHT,
+    FIND_DEVICES_CHANNEL_FRONT_CENTER,
+    FIND_DEVICES_CHANNEL_REAR_LEFT,
+    FIND_DEVICES_CHANNEL_REAR_RIGHT,
+    FIND_DEVICES_CHANNEL_REAR_CENTER,
+    FIND_DEVICES_CHANNEL_WOOFER,
+    FIND_DEVICES_CHANNEL_SIDE_LEFT,
+    FIND_DEVICES_CHANNEL_SIDE_RIGHT,
+    FIND_DEVICES_CHANNEL_MONO
+} find_devices_channel_id;
+
+typedef struct find_devices_channel
+{
+    int channel;
+    int type;
+    int volume;
+    int volume_min;
+    int volume_max;
+    int volume_percent;
+} find_devices_channel;
+
+// **************************************************************** //
+//                                                                  //
+// SNAPSHOT                                                         //
+//                                                                  //
+// **************************************************************** //
+
+// Enumerates the sound cards and the serial ports, with their descriptions
+int find_devices_snapshot_create(find_devices_snapshot** snapshot);
+void find_devices_snapshot_destroy(find_devices_snapshot* snapshot);
+
+size_t find_devices_snapshot_audio_device_count(const find_devices_snapshot* snapshot);
+size_t find_devices_snapshot_serial_port_count(const find_devices_snapshot* snapshot);
+
+// **************************************************************** //
+//                                                                  //
+// AUDIO DEVICES                                                    //
+//                                                                  //
+// **************************************************************** //
+
+// An iterator is positioned before the first device, next returns FIND_DEVICES_END after the last device
+// Iterators and descriptions are valid for as long as their snapshot is
+int find_devices_audio_device_iterator_create(const find_devices_snapshot* snapshot, find_devices_audio_device_iterator** iterator);
+int find_devices_audio_device_iterator_next(find_devices_audio_device_iterator* iterator);
+void find_devices_audio_device_iterator_reset(find_devices_audio_device_iterator* iterator);
+void find_devices_audio_device_iterator_destroy(find_devices_audio_device_iterator* iterator);
+
+// required_size is the size of the string with its terminator, it can be NULL
+int find_devices_audio_device_get_string(const find_devices_audio_device_iterator* iterator, find_devices_audio_device_field field, char* buffer, size_t buffer_size, size_t* required_size);
+int find_devices_audio_device_get_int(const find_devices_audio_device_iterator* iterator, find_devices_audio_device_field field, int* value);
+int find_devices_audio_device_get_description(const find_devices_audio_device_iterator* iterator, const find_devices_description** description);
+
+// **************************************************************** //
+//                                                                  //
+// SERIAL PORTS                                                     //
+//                                                                  //
+// **************************************************************** //
+
+int find_devices_serial_port_iterator_create(const find_devices_snapshot* snapshot, find_devices_serial_port_iterator** iterator);
+int find_devices_serial_port_iterator_next(find_devices_serial_port_iterator* iterator);
+void find_devices_serial_port_iterator_reset(find_devices_serial_port_iterator* iterator);
+void find_devices_serial_port_iterator_destroy(find_devices_serial_port_iterator* iterator);
+
+int find_devices_serial_port_get_string(const find_devices_serial_port_iterator* iterator, find_devices_serial_port_field field, char* buffer, size_t buffer_size, size_t* required_size);
+int find_devices_serial_port_get_description(const find_devices_serial_port_iterator* iterator, const find_devices_description** description);
+
+// **************************************************************** //
+//                                                                  //
+// DEVICE DESCRIPTIONS                                              //
+//                                                                  //
+// **************************************************************** //
+
+int find_devices_description_get_string(const find_devices_description* description, find_devices_description_field field, char* buffer, size_t buffer_size, size_t* required_size);
+int find_devices_description_get_int(const find_devices_description* description, find_devices_description_field field, int* value);
+
+// **************************************************************** //
+//                                                                  //
+// VOLUME                                                           //
+//                                                                  //
+// **************************************************************** //
+
+// A volume handle holds the mixer controls of one device, it can be read again for any device
+int find_devices_volume_create(find_devices_volume** volume);
+int find_devices_volume_read(find_devices_volume* volume, const find_devices_audio_device_iterator* iterator);
+void find_devices_volume_destroy(find_devices_volume* volume);
+
+size_t find_devices_volume_control_count(const find_devices_volume* volume);
+int find_devices_volume_get_control_name(const find_devices_volume* volume, size_t control, char* buffer, size_t buffer_size, size_t* required_size);
+size_t find_devices_volume_channel_count(const find_devices_volume* volume, size_t control);
+int find_devices_volume_get_channel(const find_devices_volume* volume, size_t control, size_t channel, find_devices_channel* result);
+
+// Sets the volume of the matching channels of a control, type is a combination of one or both type flags
+// Returns FIND_DEVICES_NOT_FOUND when the device, the control or a matching channel does not exist
+int find_devices_volume_set_percent(const find_devices_audio_device_iterator* iterator, const char* control_name, find_devices_channel_id channel, int type, int volume_percent);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,5000 @@
+// **************************************************************** //
+// find_devices - Audio device and serial ports search utility      // 
+// Version 0.1.0                                                    //
+// https://github.com/iontodirel/find_devices                       //
+// Copyright (c) 2023 Ion Todirel                                   //
+// **************************************************************** //
+//
+// find_devices_cli.cpp
+// The command line, server and daemon of the audio device and serial ports finding utility.
+// 
+// MIT License
+// 
+// Copyright (c) 2022 Ion Todirel
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "find_devices_cli.hpp"
+
+#include <map>
+#include <fstream>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <csignal>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <set>
+#include <mutex>
+#include <future>
+#include <string_view>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <poll.h>
+
+#include <nlohmann/json.hpp>
+#include <fmt/format.h>
+#include <fmt/color.h>
+#include <cxxopts.hpp>
+#include <civetweb.h>
+#include <CivetServer.h>
+
+// **************************************************************** //
+//                                                                  //
+// UTILITIES                                                        //
+//                                                                  //
+// **************************************************************** //
+
+namespace
+{
+    template<class F, class ...Args>
+    void print_stdout(F f, Args... args)
+    {
+        printf(format(f, args ...).c_str());
+    }
+
+    uint64_t hash_content(std::string_view content)
+    {
+        // 64-bit FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : content)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool try_read_file(const std::string& path, std::string& content)
+    {
+        std::ifstream file(path, std::ios_base::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        std::ostringstream ss;
+        ss << file.rdbuf();
+        content = ss.str();
+        return true;
+    }
+
+    bool try_parse_bool(const std::string& s, bool& b)
+    {
+        if (s == "true")
+            b = true;
+        else if (s == "false")
+            b = false;
+        else
+            return false;
+        return true;
+    }
+
+    std::string get_full_path(const std::string& path)
+    {
+        std::filesystem::path p = path;
+        if (p.is_absolute())
+            return path;
+        return std::filesystem::current_path() / path;
+    }
+
+    std::string to_lower(const std::string& str)
+    {
+        std::locale loc;
+        std::string s;
+        s.resize(str.size());
+        for (size_t i = 0; i < str.size(); i++)
+            s[i] = std::tolower(str[i], loc);
+        return s;
+    }
+
+    bool try_find_new_filename(const std::filesystem::path& file_name, std::string& new_filename)
+    {
+        int i = 1;
+        int max_count = 1000;
+        while (i < max_count)
+        {
+            new_filename = (file_name.parent_path() / (file_name.stem().string() + std::to_string(i) + file_name.extension().string())).string();
+
+            if (!std::filesystem::exists(new_filename))
+                return true;
+
+            i++;
+        }
+        return false;
+    }
+}
+
+// **************************************************************** //
+//                                                                  //
+//                                                                  //
+// DATA TYPES                                                       //
+//                                                                  //
+//                                                                  //
+// **************************************************************** //
+
+struct audio_device_volume_probe
+{
+    int retrieved_volume = 0;
+    int set_volume = 0;
+    int error = 0;
+    int error_percent = 0;
+    std::string unique_channel_id;
+};
+
+struct option_handler
+{
+    std::string command_line_arg_name;
+    bool has_type = false;
+    std::shared_ptr<cxxopts::Value> type;
+    std::function<void(const cxxopts::ParseResult&)> read_handler;
+};
+
+// **************************************************************** //
+//                                                                  //
+// PARSE TYPE FUNCTIONS                                             //
+//                                                                  //
+// **************************************************************** //
+
+void parse_audio_device_type(const std::string& typeStr, args& args)
+{
+    args.audio_filter.playback_or_capture = false;
+    args.audio_filter.playback_only = false;
+    args.audio_filter.capture_only = false;
+    args.audio_filter.playback_and_capture = false;
+
+    if (typeStr == "playback")
+    {
+        args.audio_filter.playback_only = true;
+    }
+    else if (typeStr == "capture")
+    {
+        args.audio_filter.capture_only = true;
+    }
+    else if (typeStr == "playback|capture" || typeStr == "playback | capture" ||
+        typeStr == "capture|playback" || typeStr == "capture | playback")
+    {
+        args.audio_filter.playback_or_capture = true;
+    }
+    else if (typeStr == "playback&capture" || typeStr == "playback & capture" ||
+        typeStr == "capture&playback" || typeStr == "capture & playback")
+    {
+        args.audio_filter.playback_and_capture = true;
+    }
+}
+
+bool try_parse_channels(const std::string& channels_str, std::vector<audio_device_channel_id>& channels)
+{
+    std::istringstream ss(channels_str);
+    std::string channel_str;
+
+    while (std::getline(ss, channel_str, ','))
+    {
+        audio_device_channel_id channel_id;
+        try_parse_audio_device_channel_display_name(channel_str, channel_id);
+        channels.push_back(channel_id);
+    }
+
+    return true;
+}
+
+bool try_parse_included_devices(const std::string& mode_str, included_devices& mode)
+{
+    if (mode_str == "audio")
+    {
+        mode = included_devices::audio;
+    }
+    else if (mode_str == "ports")
+    {
+        mode = included_devices::ports;
+    }
+    else if (mode_str == "all")
+    {
+        mode = included_devices::all;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool try_parse_search_mode(const std::string& mode_str, search_mode& mode)
+{
+    if (mode_str == "independent")
+    {
+        mode = search_mode::independent;
+    }
+    else if (mode_str == "audio-siblings")
+    {
+        mode = search_mode::audio_siblings;
+    }
+    else if (mode_str == "port-siblings")
+    {
+        mode = search_mode::port_siblings;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool is_valid_worker_count(int count)
+{
+    return count >= 1 && (size_t)count <= max_worker_count;
+}
+
+// **************************************************************** //
+//                                                                  //
+// JSON                                                             //
+//                                                                  //
+// **************************************************************** //
+
+std::string create_unique_channel_id(const audio_device_info& device, const audio_device_volume_control& control, const audio_device_channel& channel);
+std::string to_json(const args& args, const search_result& result, const std::vector<audio_device_unique_volume_set>& audio_set_result, bool volume_control_return_value);
+std::string to_json(const args& args, const search_result& result, const std::vector<audio_device_unique_volume_set>& audio_set_result, bool volume_control_return_value, std::function<std::string()> render_properties);
+std::string to_json(const search_result& result, const std::vector<audio_device_unique_volume_set>& audio_set_result, int tabs);
+std::string to_json(const std::vector<file_write_result>& files);
+std::string to_json(run_timings& timings);
+std::string to_json(const args& args, const std::vector<file_write_result>& files);
+
+std::string to_json(const audio_device_volume_info& d, const std::vector<audio_device_unique_volume_set>& audio_set_result, bool wrapping_object, int tabs)
+{
+    return to_json(d,
+        [](const audio_device_volume_info&) { return ""; },
+        [](const audio_device_volume_info&, const audio_device_volume_control&) { return ""; },
+        [&audio_set_result](const audio_device_volume_info& d, const audio_device_volume_control& control, const audio_device_channel& channel)
+        {
+            std::string result;
+
+            std::string channel_id = create_unique_channel_id(d.audio_device, control, channel);
+
+            auto audio_set = std::find_if(audio_set_result.begin(), audio_set_result.end(), [&channel_id](const audio_device_unique_volume_set& e) {
+                return e.unique_channel_id == channel_id;
+            });
+
+            if (audio_set != std::end(audio_set_result))
+            {
+                result.append(fmt::format("                    \"volume_control_volume\": \"{}\",\n", (*audio_set).volume_set.volume));
+                result.append(fmt::format("                    \"volume_control_error\": \"{}\",\n", (*audio_set).volume_control_error));
+                result.append(fmt::format("                    \"volume_control_error_percent\": \"{}\"\n", (*audio_set).volume_control_error_percent));
+            }
+
+            return result;
+        },
+        wrapping_object,
+        tabs);
+}
+
+std::string to_json(const search_result& result, const std::vector<audio_device_unique_volume_set>& audio_set_result, int tabs)
+{
+    // Renders the audio_devices and serial_ports properties, without the enclosing object
+
+    std::string indent(tabs * 4, ' ');
+
+    std::string s;
+    s += indent + "\"audio_devices\": [\n";
+    size_t i = 0;
+    for (const auto& d : result.devices)
+    {
+        s += indent + "    {\n";
+        s += to_json(d.first, audio_set_result, false, tabs + 1);
+        s += ",\n";
+        s += to_json(d.second, false, tabs + 1);
+        s += "\n";
+        s += indent + "    }";
+        if ((i + 1) < result.devices.size())
+        {
+            s.append(",");
+        }
+        s.append("\n");
+        i++;
+    }
+
+    s += indent + "],\n";
+    s += indent + "\"serial_ports\": [\n";
+
+    size_t j = 0;
+    for (const auto& p : result.ports)
+    {
+        s += indent + "    {\n";
+        s += to_json(p.first, false, tabs + 1);
+        s += ",\n";
+        s += to_json(p.second, false, tabs + 1);
+        s += "\n";
+        s += indent + "    }";
+        if ((j + 1) < result.ports.size())
+        {
+            s.append(",");
+        }
+        s.append("\n");
+        j++;
+    }
+
+    s += indent + "]";
+
+    return s;
+}
+
+std::string to_json(const args& args, const search_result& result, const std::vector<audio_device_unique_volume_set>& audio_set_result, bool volume_control_return_value)
+{
+    return to_json(args, result, audio_set_result, volume_control_return_value, std::function<std::string()>{});
+}
+
+std::string to_json(const args& args, const search_result& result, const std::vector<audio_device_unique_volume_set>& audio_set_result, bool volume_control_return_value, std::function<std::string()> render_properties)
+{
+    scoped_metrics_timer timer(get_metrics_histogram("find_devices_json_render_duration_seconds"));
+
+    std::string s;
+    s += "{\n";
+    s += to_json(result, audio_set_result, 1);
+
+    if (args.test_volume_control)
+    {
+        s += ",\n";
+        s += "    \"volume_control_test_result\": ";
+        if (volume_control_return_value)
+            s += "\"success\"";
+        else
+            s += "\"failure\"";
+    }
+
+    if (render_properties)
+    {
+        std::string render_properties_string = render_properties();
+        if (!render_properties_string.empty())
+        {
+            s += ",\n";
+            s += render_properties_string;
+        }
+    }
+
+    if (!args.ignore_config)
+    {
+        s += ",\n";
+        std::string config_file = std::filesystem::absolute(args.config_file).string();
+        s += "    \"config_file\": \"" + config_file + "\"\n";
+    }
+    else
+    {
+        s += "\n";
+    }
+
+    s += "}";
+
+    return s;
+}
+
+std::string to_json(run_timings& timings)
+{
+    std::vector<timing_entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(timings.mutex);
+        entries = timings.entries;
+    }
+
+    auto to_milliseconds = [](uint64_t microseconds) { return fmt::format("{:.3f}", microseconds / 1000.0); };
+
+    auto render_entries = [&](bool steps)
+    {
+        std::string s;
+        bool first = true;
+        for (const auto& e : entries)
+        {
+            if (e.device.empty() == steps)
+            {
+                continue;
+            }
+            if (!first)
+            {
+                s += ",\n";
+            }
+            first = false;
+            s += "            {\n";
+            s += fmt::format("                \"name\": \"{}\",\n", e.name);
+            if (steps)
+            {
+                s += fmt::format("                \"device\": \"{}\",\n", e.device);
+            }
+            s += fmt::format("                \"start_ms\": \"{}\",\n", to_milliseconds(e.start_microseconds));
+            s += fmt::format("                \"duration_ms\": \"{}\"\n", to_milliseconds(e.duration_microseconds));
+            s += "            }";
+        }
+        if (!first)
+        {
+            s += "\n";
+        }
+        return s;
+    };
+
+    std::string s;
+    s += "    \"timings\": {\n";
+    s += "        \"phases\": [\n";
+    s += render_entries(false);
+    s += "        ],\n";
+    s += "        \"steps\": [\n";
+    s += render_entries(true);
+    s += "        ]\n";
+    s += "    }";
+    return s;
+}
+
+std::string to_json(const args& args, const std::vector<file_write_result>& files)
+{
+    // The properties of this run only, which are left out of the output file content
+
+    std::string s;
+    if (files.size() > 0)
+    {
+        s += to_json(files);
+    }
+    if (args.timings != nullptr && args.timings->enabled)
+    {
+        if (!s.empty())
+            s += ",\n";
+        s += to_json(*args.timings);
+    }
+    return s;
+}
+
+std::string to_json(const std::vector<file_write_result>& files)
+{
+    std::string s;
+    s += "    \"files\": [\n";
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        s += "        {\n";
+        s += "            \"path\": \"" + files[i].path + "\",\n";
+        s += "            \"description\": \"" + files[i].description + "\",\n";
+        s += fmt::format("            \"success\": \"{}\",\n", files[i].success);
+        s += fmt::format("            \"changed\": \"{}\"\n", files[i].changed);
+        s += "        }";
+        if ((i + 1) < files.size())
+        {
+            s.append(",");
+        }
+        s.append("\n");
+    }
+    s += "    ]";
+    return s;
+}
+
+// **************************************************************** //
+//                                                                  //
+// TEST DATA                                                        //
+//                                                                  //
+// **************************************************************** //
+
+// The sound cards, their mixer controls and the serial ports are read from a JSON file,
+// and served by a fake backend instead of the system devices, see examples/test_data.json
+// The fields use the same names as the JSON output
+
+bool try_read_test_data(const std::string& path, fake_device_backend& backend);
+bool try_parse_test_data(const nlohmann::json& j, fake_device_backend& backend);
+bool try_parse_test_audio_card(const nlohmann::json& j, fake_audio_card& card);
+bool try_parse_test_audio_channel(const nlohmann::json& j, audio_device_channel& channel);
+bool try_parse_test_serial_port(const nlohmann::json& j, fake_serial_port& port);
+bool try_parse_test_audio_device_type(const std::string& type_str, audio_device_type& type);
+device_description parse_test_device_description(const nlohmann::json& j);
+
+bool try_read_test_data(const std::string& path, fake_device_backend& backend)
+{
+    std::string content;
+    if (!try_read_file(path, content))
+    {
+        return false;
+    }
+
+    nlohmann::json j = nlohmann::json::parse(content, nullptr, false);
+    if (j.is_discarded())
+    {
+        return false;
+    }
+
+    try
+    {
+        return try_parse_test_data(j, backend);
+    }
+    catch (const nlohmann::json::exception&)
+    {
+        return false;
+    }
+}
+
+bool try_parse_test_data(const nlohmann::json& j, fake_device_backend& backend)
+{
+    if (j.contains("audio_devices"))
+    {
+        for (const nlohmann::json& item : j["audio_devices"])
+        {
+            fake_audio_card card;
+            if (!try_parse_test_audio_card(item, card))
+            {
+                return false;
+            }
+            backend.cards.push_back(card);
+        }
+    }
+
+    if (j.contains("serial_ports"))
+    {
+        for (const nlohmann::json& item : j["serial_ports"])
+        {
+            fake_serial_port port;
+            if (!try_parse_test_serial_port(item, port))
+            {
+                return false;
+            }
+            backend.ports.push_back(port);
+        }
+    }
+
+    return true;
+}
+
+bool try_parse_test_audio_card(const nlohmann::json& j, fake_audio_card& card)
+{
+    if (!try_parse_number(j.value("card_id", ""), card.card_id) || card.card_id < 0)
+    {
+        return false;
+    }
+
+    card.description = parse_test_device_description(j);
+
+    // A card without a devices list has a single PCM device 0
+
+    nlohmann::json devices = j.value("devices", nlohmann::json::array({ nlohmann::json::object() }));
+
+    for (const nlohmann::json& item : devices)
+    {
+        audio_device_info device;
+        device.card_id = card.card_id;
+        device.device_id = 0;
+        if (item.contains("device_id") && !try_parse_number(item.value("device_id", ""), device.device_id))
+        {
+            return false;
+        }
+        device.hw_id = fmt::format("hw:{},{}", device.card_id, device.device_id);
+        device.plughw_id = fmt::format("plughw:{},{}", device.card_id, device.device_id);
+        device.name = item.value("name", j.value("name", ""));
+        device.description = item.value("description", j.value("description", ""));
+        device.stream_name = item.value("stream_name", j.value("stream_name", ""));
+        if (!try_parse_test_audio_device_type(item.value("type", j.value("type", "capture&playback")), device.type))
+        {
+            return false;
+        }
+        card.devices.push_back(device);
+    }
+
+    if (j.contains("controls"))
+    {
+        for (const nlohmann::json& item : j["controls"])
+        {
+            audio_device_volume_control control;
+            control.name = item.value("name", "");
+            if (item.contains("channels"))
+            {
+                for (const nlohmann::json& channel_item : item["channels"])
+                {
+                    audio_device_channel channel;
+                    if (!try_parse_test_audio_channel(channel_item, channel))
+                    {
+                        return false;
+                    }
+                    control.channels.push_back(channel);
+                }
+            }
+            card.controls.push_back(control);
+        }
+    }
+
+    return true;
+}
+
+bool try_parse_test_audio_channel(const nlohmann::json& j, audio_device_channel& channel)
+{
+    channel.name = j.value("name", "");
+    channel.volume_min = 0;
+    channel.volume_max = 100;
+
+    if (!try_parse_audio_device_channel_display_name(channel.name, channel.id) ||
+        !try_parse_audio_device_type(j.value("type", ""), channel.type))
+    {
+        return false;
+    }
+
+    if (j.contains("volume_min"))
+        try_parse_number(j.value("volume_min", ""), channel.volume_min);
+    if (j.contains("volume_max"))
+        try_parse_number(j.value("volume_max", ""), channel.volume_max);
+
+    if (channel.volume_max <= channel.volume_min)
+    {
+        return false;
+    }
+
+    // The volume can be given as a raw value or as a percent of the range
+
+    int volume_percent = 0;
+    if (j.contains("volume"))
+    {
+        if (!try_parse_number(j.value("volume", ""), channel.volume))
+            return false;
+    }
+    else if (try_parse_number(j.value("volume_percent", "0"), volume_percent))
+    {
+        channel.volume = (int)std::rint(channel.volume_min + (channel.volume_max - channel.volume_min) * volume_percent / 100.0);
+    }
+
+    channel.volume = std::clamp(channel.volume, channel.volume_min, channel.volume_max);
+    channel.volume_percent = (int)std::rint((channel.volume - channel.volume_min) * 100.0 / (double)(channel.volume_max - channel.volume_min));
+    channel.volume_percent_linearized = channel.volume_percent;
+
+    return true;
+}
+
+bool try_parse_test_serial_port(const nlohmann::json& j, fake_serial_port& port)
+{
+    port.port.name = j.value("name", "");
+    port.port.description = j.value("description", "");
+    port.port.manufacturer = j.value("manufacturer", "");
+    port.port.device_serial_number = j.value("device_serial_number", "");
+    port.description = parse_test_device_description(j);
+    return !port.port.name.empty();
+}
+
+bool try_parse_test_audio_device_type(const std::string& type_str, audio_device_type& type)
+{
+    // Accepts the output format, ex: capture&playback
+
+    type = audio_device_type::uknown;
+
+    std::istringstream ss(type_str);
+    std::string part;
+    while (std::getline(ss, part, '&'))
+    {
+        audio_device_type part_type;
+        if (!try_parse_audio_device_type(part, part_type))
+        {
+            return false;
+        }
+        type = type | part_type;
+    }
+
+    return type != audio_device_type::uknown;
+}
+
+device_description parse_test_device_description(const nlohmann::json& j)
+{
+    device_description desc;
+    try_parse_number(j.value("bus_number", ""), desc.bus_number);
+    try_parse_number(j.value("device_number", ""), desc.device_number);
+    try_parse_number(j.value("major_number", ""), desc.major_number);
+    try_parse_number(j.value("minor_number", ""), desc.minor_number);
+    try_parse_number(j.value("topology_depth", ""), desc.topology_depth);
+    desc.id_product = j.value("id_product", "");
+    desc.id_vendor = j.value("id_vendor", "");
+    desc.manufacturer = j.value("device_manufacturer", "");
+    desc.path = j.value("path", "");
+    desc.hw_path = j.value("hw_path", "");
+    desc.product = j.value("product", "");
+    return desc;
+}
+
+// **************************************************************** //
+//                                                                  //
+// DEVICE RECORDING                                                 //
+//                                                                  //
+// **************************************************************** //
+
+// The backend calls recorded with --record, and replayed with --replay, see try_write_device_recording
+// The enums are recorded as numbers, the descriptions use the same names as the test data
+
+bool try_read_device_recording(const std::string& path, replay_device_backend& backend);
+bool try_parse_recorded_call(const nlohmann::json& j, device_backend_call& call);
+audio_device_info parse_recorded_audio_device(const nlohmann::json& j);
+audio_device_volume_control parse_recorded_audio_control(const nlohmann::json& j);
+audio_device_channel_volume_set parse_recorded_volume_set(const nlohmann::json& j);
+serial_port parse_recorded_serial_port(const nlohmann::json& j);
+
+bool try_read_device_recording(const std::string& path, replay_device_backend& backend)
+{
+    std::string content;
+    if (!try_read_file(path, content))
+    {
+        return false;
+    }
+
+    nlohmann::json j = nlohmann::json::parse(content, nullptr, false);
+    if (j.is_discarded() || !j.contains("calls"))
+    {
+        return false;
+    }
+
+    try
+    {
+        for (const nlohmann::json& item : j["calls"])
+        {
+            device_backend_call call;
+            if (!try_parse_recorded_call(item, call))
+            {
+                return false;
+            }
+            backend.calls.push_back(call);
+        }
+    }
+    catch (const nlohmann::json::exception&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool try_parse_recorded_call(const nlohmann::json& j, device_backend_call& call)
+{
+    call.name = j.value("name", "");
+    call.key = j.value("key", "");
+
+    if (call.name.empty() ||
+        !try_parse_bool(j.value("result", ""), call.result) ||
+        !try_parse_number(j.value("duration_microseconds", ""), call.duration_microseconds))
+    {
+        return false;
+    }
+
+    for (const nlohmann::json& item : j.value("devices", nlohmann::json::array()))
+        call.devices.push_back(parse_recorded_audio_device(item));
+    for (const nlohmann::json& item : j.value("controls", nlohmann::json::array()))
+        call.controls.push_back(parse_recorded_audio_control(item));
+    for (const nlohmann::json& item : j.value("sets", nlohmann::json::array()))
+        call.sets.push_back(parse_recorded_volume_set(item));
+    for (const nlohmann::json& item : j.value("ports", nlohmann::json::array()))
+        call.ports.push_back(parse_recorded_serial_port(item));
+    for (const nlohmann::json& item : j.value("descriptions", nlohmann::json::array()))
+        call.descriptions.push_back(parse_test_device_description(item));
+
+    return true;
+}
+
+audio_device_info parse_recorded_audio_device(const nlohmann::json& j)
+{
+    audio_device_info device;
+    int type = 0;
+    try_parse_number(j.value("card_id", ""), device.card_id);
+    try_parse_number(j.value("device_id", ""), device.device_id);
+    try_parse_number(j.value("type", ""), type);
+    device.type = (audio_device_type)type;
+    device.hw_id = j.value("hw_id", "");
+    device.plughw_id = j.value("plughw_id", "");
+    device.name = j.value("name", "");
+    device.stream_name = j.value("stream_name", "");
+    device.description = j.value("description", "");
+    return device;
+}
+
+audio_device_volume_control parse_recorded_audio_control(const nlohmann::json& j)
+{
+    audio_device_volume_control control;
+    control.name = j.value("name", "");
+    for (const nlohmann::json& item : j.value("channels", nlohmann::json::array()))
+    {
+        audio_device_channel channel;
+        int type = 0;
+        int id = (int)audio_device_channel_id::none;
+        channel.name = item.value("name", "");
+        try_parse_number(item.value("type", ""), type);
+        try_parse_number(item.value("channel", ""), id);
+        channel.type = (audio_device_type)type;
+        channel.id = (audio_device_channel_id)id;
+        try_parse_number(item.value("volume", ""), channel.volume);
+        try_parse_number(item.value("volume_min", ""), channel.volume_min);
+        try_parse_number(item.value("volume_max", ""), channel.volume_max);
+        try_parse_number(item.value("volume_percent", ""), channel.volume_percent);
+        try_parse_number(item.value("volume_percent_linearized", ""), channel.volume_percent_linearized);
+        control.channels.push_back(channel);
+    }
+    return control;
+}
+
+audio_device_channel_volume_set parse_recorded_volume_set(const nlohmann::json& j)
+{
+    audio_device_channel_volume_set set;
+    int channel = (int)audio_device_channel_id::none;
+    int channel_type = 0;
+    set.control_name = j.value("control_name", "");
+    try_parse_number(j.value("channel", ""), channel);
+    try_parse_number(j.value("channel_type", ""), channel_type);
+    set.channel = (audio_device_channel_id)channel;
+    set.channel_type = (audio_device_type)channel_type;
+    try_parse_number(j.value("volume_percent", ""), set.volume_percent);
+    try_parse_bool(j.value("success", ""), set.success);
+    try_parse_bool(j.value("verified", ""), set.verified);
+    set.error = j.value("error", "");
+
+    // Recordings made before the status was recorded only tell whether the set succeeded
+    int status = set.success ? (int)audio_device_volume_set_status::applied : (int)audio_device_volume_set_status::failed;
+    try_parse_number(j.value("status", ""), status);
+    set.status = (audio_device_volume_set_status)status;
+
+    return set;
+}
+
+serial_port parse_recorded_serial_port(const nlohmann::json& j)
+{
+    serial_port port;
+    port.name = j.value("name", "");
+    port.description = j.value("description", "");
+    port.manufacturer = j.value("manufacturer", "");
+    port.device_serial_number = j.value("device_serial_number", "");
+    return port;
+}
+
+// **************************************************************** //
+//                                                                  //
+// QUERY                                                            //
+//                                                                  //
+// **************************************************************** //
+
+//
+//  Small path expression language evaluated over the search result,
+//  field names are the same as the ones used in the JSON output:
+//
+//    .audio_devices | length
+//    .audio_devices[0].plughw_id
+//    .audio_devices[-1].controls[].name
+//    .serial_ports[description~cp210][0].name
+//    .audio_devices | length == 1
+//    AUDIO_DEVICE=.audio_devices[0].plughw_id
+//
+//  Supported functions: length, first, last
+//  Supported filter operators: = (equals), != (not equals), ~ (contains, case insensitive)
+//  Supported comparison operators: ==, !=, <, <=, >, >=
+//
+
+struct query_parser
+{
+    std::string_view expression;
+    size_t position = 0;
+    std::string error;
+};
+
+bool try_parse_queries(const std::string& queries_str, std::vector<query>& queries);
+bool try_evaluate_query(const std::string& expression, const search_result& result, query_value& value, std::string& error);
+bool try_evaluate_query(query_parser& parser, const query_value& root, query_value& value);
+bool try_evaluate_query_path(query_parser& parser, const query_value& root, query_value& value);
+bool try_evaluate_query_function(query_parser& parser, const std::string& function, query_value& value);
+bool try_evaluate_query_comparison(query_parser& parser, query_value& value);
+void skip_whitespace(query_parser& parser);
+bool try_consume(query_parser& parser, std::string_view token);
+bool try_read_identifier(query_parser& parser, std::string& identifier);
+bool try_read_literal(query_parser& parser, std::string& literal);
+bool compare_query_values(const std::string& l, const std::string& op, const std::string& r);
+query_value apply_query_field(const query_value& value, const std::string& field, bool iterating);
+query_value apply_query_index(const query_value& value, int index, bool iterating);
+query_value apply_query_filter(const query_value& value, const std::string& field, const std::string& op, const std::string& literal, bool iterating);
+query_value make_query_scalar(const std::string& text);
+query_value make_query_boolean(bool b);
+query_value make_query_list(std::vector<query_value> items);
+query_value make_query_value(const search_result& result);
+query_value make_query_value(const std::pair<audio_device_volume_info, device_description>& device);
+query_value make_query_value(const std::pair<serial_port, device_description>& port);
+query_value make_query_value(const audio_device_volume_control& control);
+query_value make_query_value(const audio_device_channel& channel);
+query_value make_query_value(const device_description& d, const std::string& field);
+std::string to_string(const query_value& value);
+std::string to_shell_string(const std::string& s);
+bool print_queries(const args& args, const search_result& result);
+
+bool try_parse_queries(const std::string& queries_str, std::vector<query>& queries)
+{
+    // Queries are separated by ';', for example: "A=.audio_devices | length; B=.serial_ports | length"
+    // A query can optionally be prefixed by a shell variable name followed by '='
+
+    std::istringstream ss(queries_str);
+    std::string query_str;
+
+    while (std::getline(ss, query_str, ';'))
+    {
+        size_t begin = query_str.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos)
+        {
+            continue;
+        }
+
+        query q;
+        q.expression = query_str.substr(begin);
+
+        size_t equals_pos = q.expression.find('=');
+        if (equals_pos != std::string::npos && equals_pos > 0 && q.expression[0] != '.')
+        {
+            std::string name = q.expression.substr(0, equals_pos);
+            bool valid_name = std::all_of(name.begin(), name.end(), [](char c) { return std::isalnum((unsigned char)c) || c == '_'; }) && !std::isdigit((unsigned char)name[0]);
+            if (!valid_name)
+            {
+                return false;
+            }
+            q.name = name;
+            q.expression = q.expression.substr(equals_pos + 1);
+        }
+
+        queries.push_back(q);
+    }
+
+    return true;
+}
+
+bool try_evaluate_query(const std::string& expression, const search_result& result, query_value& value, std::string& error)
+{
+    query_parser parser;
+    parser.expression = expression;
+
+    query_value root = make_query_value(result);
+
+    if (!try_evaluate_query(parser, root, value))
+    {
+        error = parser.error;
+        return false;
+    }
+
+    return true;
+}
+
+bool try_evaluate_query(query_parser& parser, const query_value& root, query_value& value)
+{
+    if (!try_evaluate_query_path(parser, root, value))
+    {
+        return false;
+    }
+
+    skip_whitespace(parser);
+
+    while (parser.position < parser.expression.size() && parser.expression[parser.position] == '|')
+    {
+        parser.position++;
+
+        std::string function;
+        if (!try_read_identifier(parser, function))
+        {
+            parser.error = fmt::format("expected function name at position {}", parser.position);
+            return false;
+        }
+
+        if (!try_evaluate_query_function(parser, function, value))
+        {
+            return false;
+        }
+
+        skip_whitespace(parser);
+    }
+
+    if (!try_evaluate_query_comparison(parser, value))
+    {
+        return false;
+    }
+
+    skip_whitespace(parser);
+
+    if (parser.position < parser.expression.size())
+    {
+        parser.error = fmt::format("unexpected character '{}' at position {}", parser.expression[parser.position], parser.position);
+        return false;
+    }
+
+    return true;
+}
+
+bool try_evaluate_query_path(query_parser& parser, const query_value& root, query_value& value)
+{
+    skip_whitespace(parser);
+
+    if (parser.position >= parser.expression.size() || parser.expression[parser.position] != '.')
+    {
+        parser.error = fmt::format("expected '.' at position {}", parser.position);
+        return false;
+    }
+
+    value = root;
+
+    // Once a list is iterated with [], all subsequent steps are applied to each element
+    bool iterating = false;
+
+    while (parser.position < parser.expression.size())
+    {
+        char c = parser.expression[parser.position];
+
+        if (c == '.')
+        {
+            parser.position++;
+            std::string field;
+            if (try_read_identifier(parser, field))
+            {
+                value = apply_query_field(value, field, iterating);
+            }
+        }
+        else if (c == '[')
+        {
+            parser.position++;
+            skip_whitespace(parser);
+
+            if (try_consume(parser, "]"))
+            {
+                if (iterating)
+                {
+                    std::vector<query_value> items;
+                    for (const auto& item : value.items)
+                        items.insert(items.end(), item.items.begin(), item.items.end());
+                    value = make_query_list(items);
+                }
+                else if (value.type != query_value_type::list)
+                {
+                    value = make_query_list({});
+                }
+                iterating = true;
+                continue;
+            }
+
+            std::string index_or_field;
+            if (!try_read_literal(parser, index_or_field))
+            {
+                parser.error = fmt::format("expected index or filter at position {}", parser.position);
+                return false;
+            }
+
+            int index = 0;
+            if (try_parse_number(index_or_field, index))
+            {
+                value = apply_query_index(value, index, iterating);
+            }
+            else
+            {
+                skip_whitespace(parser);
+                std::string op;
+                if (try_consume(parser, "!="))
+                    op = "!=";
+                else if (try_consume(parser, "="))
+                    op = "=";
+                else if (try_consume(parser, "~"))
+                    op = "~";
+                else
+                {
+                    parser.error = fmt::format("expected filter operator at position {}", parser.position);
+                    return false;
+                }
+
+                std::string literal;
+                if (!try_read_literal(parser, literal))
+                {
+                    parser.error = fmt::format("expected filter value at position {}", parser.position);
+                    return false;
+                }
+
+                value = apply_query_filter(value, index_or_field, op, literal, iterating);
+            }
+
+            skip_whitespace(parser);
+            if (!try_consume(parser, "]"))
+            {
+                parser.error = fmt::format("expected ']' at position {}", parser.position);
+                return false;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool try_evaluate_query_function(query_parser& parser, const std::string& function, query_value& value)
+{
+    if (function == "length")
+    {
+        size_t length = 0;
+        if (value.type == query_value_type::list)
+            length = value.items.size();
+        else if (value.type == query_value_type::scalar)
+            length = value.text.size();
+        value = make_query_scalar(std::to_string(length));
+    }
+    else if (function == "first" || function == "last")
+    {
+        if (value.type != query_value_type::list || value.items.empty())
+            value = query_value{};
+        else
+            value = (function == "first") ? value.items.front() : value.items.back();
+    }
+    else
+    {
+        parser.error = fmt::format("unknown function \"{}\"", function);
+        return false;
+    }
+    return true;
+}
+
+bool try_evaluate_query_comparison(query_parser& parser, query_value& value)
+{
+    skip_whitespace(parser);
+
+    std::string op;
+    for (std::string_view candidate : { "==", "!=", "<=", ">=", "<", ">" })
+    {
+        if (try_consume(parser, candidate))
+        {
+            op = candidate;
+            break;
+        }
+    }
+
+    if (op.empty())
+    {
+        return true;
+    }
+
+    std::string literal;
+    if (!try_read_literal(parser, literal))
+    {
+        parser.error = fmt::format("expected value at position {}", parser.position);
+        return false;
+    }
+
+    value = make_query_boolean(compare_query_values(to_string(value), op, literal));
+
+    return true;
+}
+
+void skip_whitespace(query_parser& parser)
+{
+    while (parser.position < parser.expression.size() && std::isspace((unsigned char)parser.expression[parser.position]))
+    {
+        parser.position++;
+    }
+}
+
+bool try_consume(query_parser& parser, std::string_view token)
+{
+    if (parser.expression.substr(parser.position, token.size()) == token)
+    {
+        parser.position += token.size();
+        return true;
+    }
+    return false;
+}
+
+bool try_read_identifier(query_parser& parser, std::string& identifier)
+{
+    skip_whitespace(parser);
+    size_t begin = parser.position;
+    while (parser.position < parser.expression.size() && (std::isalnum((unsigned char)parser.expression[parser.position]) || parser.expression[parser.position] == '_'))
+    {
+        parser.position++;
+    }
+    identifier = std::string(parser.expression.substr(begin, parser.position - begin));
+    return !identifier.empty();
+}
+
+bool try_read_literal(query_parser& parser, std::string& literal)
+{
+    skip_whitespace(parser);
+
+    if (parser.position >= parser.expression.size())
+    {
+        return false;
+    }
+
+    char quote = parser.expression[parser.position];
+    if (quote == '"' || quote == '\'')
+    {
+        size_t end = parser.expression.find(quote, parser.position + 1);
+        if (end == std::string_view::npos)
+        {
+            return false;
+        }
+        literal = std::string(parser.expression.substr(parser.position + 1, end - parser.position - 1));
+        parser.position = end + 1;
+        return true;
+    }
+
+    size_t begin = parser.position;
+    while (parser.position < parser.expression.size())
+    {
+        char c = parser.expression[parser.position];
+        if (std::isspace((unsigned char)c) || c == ']' || c == '=' || c == '!' || c == '~' || c == '|')
+            break;
+        parser.position++;
+    }
+    literal = std::string(parser.expression.substr(begin, parser.position - begin));
+    return !literal.empty();
+}
+
+bool compare_query_values(const std::string& l, const std::string& op, const std::string& r)
+{
+    int l_number = 0;
+    int r_number = 0;
+    int compare_result = 0;
+    if (try_parse_number(l, l_number) && try_parse_number(r, r_number))
+        compare_result = (l_number < r_number) ? -1 : (l_number > r_number ? 1 : 0);
+    else
+        compare_result = l.compare(r);
+
+    if (op == "==")
+        return compare_result == 0;
+    if (op == "!=")
+        return compare_result != 0;
+    if (op == "<")
+        return compare_result < 0;
+    if (op == "<=")
+        return compare_result <= 0;
+    if (op == ">")
+        return compare_result > 0;
+    if (op == ">=")
+        return compare_result >= 0;
+    return false;
+}
+
+query_value apply_query_field(const query_value& value, const std::string& field, bool iterating)
+{
+    if (iterating)
+    {
+        std::vector<query_value> items;
+        for (const auto& item : value.items)
+            items.push_back(apply_query_field(item, field, false));
+        return make_query_list(items);
+    }
+    if (value.type != query_value_type::object || !value.field)
+    {
+        return query_value{};
+    }
+    return value.field(field);
+}
+
+query_value apply_query_index(const query_value& value, int index, bool iterating)
+{
+    if (iterating)
+    {
+        std::vector<query_value> items;
+        for (const auto& item : value.items)
+            items.push_back(apply_query_index(item, index, false));
+        return make_query_list(items);
+    }
+    if (value.type != query_value_type::list)
+    {
+        return query_value{};
+    }
+    if (index < 0)
+    {
+        index += (int)value.items.size();
+    }
+    if (index < 0 || index >= (int)value.items.size())
+    {
+        return query_value{};
+    }
+    return value.items[index];
+}
+
+query_value apply_query_filter(const query_value& value, const std::string& field, const std::string& op, const std::string& literal, bool iterating)
+{
+    if (iterating)
+    {
+        std::vector<query_value> items;
+        for (const auto& item : value.items)
+            items.push_back(apply_query_filter(item, field, op, literal, false));
+        return make_query_list(items);
+    }
+    std::vector<query_value> items;
+    for (const auto& item : value.items)
+    {
+        std::string item_value = to_string(apply_query_field(item, field, false));
+        bool match = false;
+        if (op == "=")
+            match = item_value == literal;
+        else if (op == "!=")
+            match = item_value != literal;
+        else if (op == "~")
+            match = to_lower(item_value).find(to_lower(literal)) != std::string::npos;
+        if (match)
+            items.push_back(item);
+    }
+    return make_query_list(items);
+}
+
+query_value make_query_scalar(const std::string& text)
+{
+    query_value value;
+    value.type = query_value_type::scalar;
+    value.text = text;
+    return value;
+}
+
+query_value make_query_boolean(bool b)
+{
+    query_value value;
+    value.type = query_value_type::boolean;
+    value.text = b ? "true" : "false";
+    return value;
+}
+
+query_value make_query_list(std::vector<query_value> items)
+{
+    query_value value;
+    value.type = query_value_type::list;
+    value.items = std::move(items);
+    return value;
+}
+
+query_value make_query_value(const search_result& result)
+{
+    query_value value;
+    value.type = query_value_type::object;
+    value.field = [&result](const std::string& field)
+    {
+        std::vector<query_value> items;
+        if (field == "audio_devices")
+        {
+            for (const auto& d : result.devices)
+                items.push_back(make_query_value(d));
+            return make_query_list(items);
+        }
+        if (field == "serial_ports")
+        {
+            for (const auto& p : result.ports)
+                items.push_back(make_query_value(p));
+            return make_query_list(items);
+        }
+        return query_value{};
+    };
+    return value;
+}
+
+query_value make_query_value(const std::pair<audio_device_volume_info, device_description>& device)
+{
+    query_value value;
+    value.type = query_value_type::object;
+    value.field = [&device](const std::string& field)
+    {
+        const audio_device_info& d = device.first.audio_device;
+        if (field == "card_id")
+            return make_query_scalar(std::to_string(d.card_id));
+        if (field == "device_id")
+            return make_query_scalar(std::to_string(d.device_id));
+        if (field == "plughw_id")
+            return make_query_scalar(d.plughw_id);
+        if (field == "hw_id")
+            return make_query_scalar(d.hw_id);
+        if (field == "name")
+            return make_query_scalar(d.name);
+        if (field == "stream_name")
+            return make_query_scalar(d.stream_name);
+        if (field == "description")
+            return make_query_scalar(d.description);
+        if (field == "type")
+            return make_query_scalar(to_string(d.type));
+        if (field == "controls")
+        {
+            std::vector<query_value> items;
+            for (const auto& control : device.first.controls)
+                items.push_back(make_query_value(control));
+            return make_query_list(items);
+        }
+        return make_query_value(device.second, field);
+    };
+    return value;
+}
+
+query_value make_query_value(const std::pair<serial_port, device_description>& port)
+{
+    query_value value;
+    value.type = query_value_type::object;
+    value.field = [&port](const std::string& field)
+    {
+        const serial_port& p = port.first;
+        if (field == "name")
+            return make_query_scalar(p.name);
+        if (field == "description")
+            return make_query_scalar(p.description);
+        if (field == "manufacturer")
+            return make_query_scalar(p.manufacturer);
+        if (field == "device_serial_number")
+            return make_query_scalar(p.device_serial_number);
+        return make_query_value(port.second, field);
+    };
+    return value;
+}
+
+query_value make_query_value(const audio_device_volume_control& control)
+{
+    query_value value;
+    value.type = query_value_type::object;
+    value.field = [&control](const std::string& field)
+    {
+        if (field == "name")
+            return make_query_scalar(control.name);
+        if (field == "channels")
+        {
+            std::vector<query_value> items;
+            for (const auto& channel : control.channels)
+                items.push_back(make_query_value(channel));
+            return make_query_list(items);
+        }
+        return query_value{};
+    };
+    return value;
+}
+
+query_value make_query_value(const audio_device_channel& channel)
+{
+    query_value value;
+    value.type = query_value_type::object;
+    value.field = [&channel](const std::string& field)
+    {
+        if (field == "name")
+            return make_query_scalar(channel.name);
+        if (field == "type")
+            return make_query_scalar(to_string(channel.type));
+        if (field == "volume_percent")
+            return make_query_scalar(std::to_string(channel.volume_percent));
+        if (field == "volume")
+            return make_query_scalar(std::to_string(channel.volume));
+        if (field == "volume_min")
+            return make_query_scalar(std::to_string(channel.volume_min));
+        if (field == "volume_max")
+            return make_query_scalar(std::to_string(channel.volume_max));
+        if (field == "channel")
+            return make_query_scalar(to_string(channel.id));
+        return query_value{};
+    };
+    return value;
+}
+
+query_value make_query_value(const device_description& d, const std::string& field)
+{
+    if (field == "bus_number")
+        return make_query_scalar(std::to_string(d.bus_number));
+    if (field == "device_number")
+        return make_query_scalar(std::to_string(d.device_number));
+    if (field == "major_number")
+        return make_query_scalar(std::to_string(d.major_number));
+    if (field == "minor_number")
+        return make_query_scalar(std::to_string(d.minor_number));
+    if (field == "id_product")
+        return make_query_scalar(d.id_product);
+    if (field == "id_vendor")
+        return make_query_scalar(d.id_vendor);
+    if (field == "device_manufacturer")
+        return make_query_scalar(d.manufacturer);
+    if (field == "path")
+        return make_query_scalar(d.path);
+    if (field == "hw_path")
+        return make_query_scalar(d.hw_path);
+    if (field == "product")
+        return make_query_scalar(d.product);
+    if (field == "topology_depth")
+        return make_query_scalar(std::to_string(d.topology_depth));
+    return query_value{};
+}
+
+std::string to_string(const query_value& value)
+{
+    if (value.type == query_value_type::scalar || value.type == query_value_type::boolean)
+    {
+        return value.text;
+    }
+    if (value.type == query_value_type::list)
+    {
+        std::string s;
+        for (size_t i = 0; i < value.items.size(); i++)
+        {
+            s += to_string(value.items[i]);
+            if ((i + 1) < value.items.size())
+                s += "\n";
+        }
+        return s;
+    }
+    return "";
+}
+
+std::string to_shell_string(const std::string& s)
+{
+    std::string result = "'";
+    for (char c : s)
+    {
+        if (c == '\'')
+            result += "'\\''";
+        else
+            result += c;
+    }
+    result += "'";
+    return result;
+}
+
+bool print_queries(const args& args, const search_result& result)
+{
+    bool success = true;
+
+    for (const auto& q : args.queries)
+    {
+        query_value value;
+        std::string error;
+
+        if (!try_evaluate_query(q.expression, result, value, error))
+        {
+            fprintf(stderr, "Error evaluating query \"%s\": %s\n", q.expression.c_str(), error.c_str());
+            success = false;
+            continue;
+        }
+
+        std::string value_str = to_string(value);
+
+        // Comparisons evaluating to false are reported through the exit code
+        if (value.type == query_value_type::boolean && value.text == "false")
+        {
+            success = false;
+        }
+
+        if (q.name.empty())
+            printf("%s\n", value_str.c_str());
+        else
+            printf("%s=%s\n", q.name.c_str(), to_shell_string(value_str).c_str());
+    }
+
+    return success;
+}
+
+// **************************************************************** //
+//                                                                  //
+// COMMAND LINE                                                     //
+//                                                                  //
+// **************************************************************** //
+
+bool has_volume_control_options(int argc, char* argv[]);
+bool try_parse_command_line(int argc, char* argv[], args& args);
+
+bool has_volume_control_options(int argc, char* argv[])
+{
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "--audio.volume" || arg == "--audio.control" ||
+            arg == "--audio.channels" || arg == "--audio.channel-type")
+            return true;
+    }
+    return false;
+}
+
+bool try_parse_command_line(int argc, char* argv[], args& args)
+{
+    std::map<std::string, option_handler> command_map =
+    {
+        { "version", {"v,version", false, nullptr, [&](const cxxopts::ParseResult& result) { args.show_version = true; }}},
+        { "help", {"h,help", false, nullptr, [&](const cxxopts::ParseResult& result) { args.help = true; }}},
+        { "disable-colors", {"disable-colors", false, nullptr, [&](const cxxopts::ParseResult& result) { args.disable_colors = result["disable-colors"].as<bool>(); }}},
+        { "disable-file-write", {"disable-file-write", false, nullptr, [&](const cxxopts::ParseResult& result) { args.disable_write_file = result["disable-file-write"].as<bool>(); }}},
+        { "ignore-config", {"ignore-config", false, nullptr, [&](const cxxopts::ParseResult& result) { args.ignore_config = result["ignore-config"].as<bool>(); }}},
+        { "list-properties", {"p,list-properties", false, nullptr, [&](const cxxopts::ParseResult& result) { args.list_properties = result["list-properties"].as<bool>(); }}},
+        { "use-json", {"j,use-json", false, nullptr, [&](const cxxopts::ParseResult& result) { args.use_json = result["use-json"].as<bool>(); }}},
+        { "search-mode", {"s,search-mode", true, cxxopts::value<std::string>()->default_value("independent"), [&](const cxxopts::ParseResult& result) { try_parse_search_mode(result["search-mode"].as<std::string>(), args.search_mode); }}},
+        { "included-devices", {"i,included-devices", true, cxxopts::value<std::string>()->default_value("all"), [&](const cxxopts::ParseResult& result) { try_parse_included_devices(result["included-devices"].as<std::string>(), args.included_devices); }}},
+        { "verbose", {"verbose", true, cxxopts::value<bool>()->default_value("true"), [&](const cxxopts::ParseResult& result) { args.verbose = result["verbose"].as<bool>(); }}},
+        { "no-stdout", {"no-stdout", false, nullptr, [&](const cxxopts::ParseResult& result) { args.no_stdout = true; }}},
+        { "no-verbose", {"no-verbose", false, nullptr, [&](const cxxopts::ParseResult& result) { args.verbose = false; }}},
+        { "config-file", {"c,config-file", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.config_file = result["config-file"].as<std::string>(); }}},
+        { "output-file", {"o,output-file", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.output_file = result["output-file"].as<std::string>(); }}},
+        { "audio.desc", {"audio.desc", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.desc_filter = result["audio.desc"].as<std::string>(); }}},
+        { "audio.name", {"audio.name", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.name_filter = result["audio.name"].as<std::string>(); }}},
+        { "audio.stream-name", {"audio.stream-name", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.stream_name_filter = result["audio.stream-name"].as<std::string>(); }}},
+        { "audio.type", {"audio.type", true, cxxopts::value<std::string>()->default_value("playback|capture"), [&](const cxxopts::ParseResult& result) { parse_audio_device_type(result["audio.type"].as<std::string>(), args); }}},
+        { "audio.bus", {"audio.bus", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.bus = result["audio.bus"].as<int>(); }}},
+        { "audio.device", {"audio.device", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.device = result["audio.device"].as<int>(); }}},
+        { "audio.topology", {"audio.topology", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.topology = result["audio.topology"].as<int>(); }}},
+        { "audio.path", {"audio.path", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.path = result["audio.path"].as<std::string>(); }}},     
+        { "audio.hw-path", {"audio.hw-path", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.hw_path = result["audio.hw-path"].as<std::string>(); }}},
+        { "audio.order-by", {"audio.order-by", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.order_by = result["audio.order-by"].as<std::string>(); }}},
+        { "audio.order-direction", {"audio.order-direction", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.audio_filter.order_direction = result["audio.order-direction"].as<std::string>(); }}},
+        { "audio.control", {"audio.control", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.volume_set[0].control_name = result["audio.control"].as<std::string>(); }}},
+        { "audio.channels", {"audio.channels", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { try_parse_channels(result["audio.channels"].as<std::string>(), args.volume_set[0].audio_channels); }}},
+        { "audio.volume", {"audio.volume", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.volume_set[0].volume = result["audio.volume"].as<int>(); }}},
+        { "audio.channel-type", {"audio.channel-type", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { try_parse_audio_device_type(result["audio.channel-type"].as<std::string>(), args.volume_set[0].audio_channel_type); }}},
+        { "audio.disable-volume-control", {"audio.disable-volume-control", false, nullptr, [&](const cxxopts::ParseResult& result) { args.disable_volume_control = result["audio.disable-volume-control"].as<bool>(); }}},
+        { "no-volume-control", {"no-volume-control", false, nullptr, [&](const cxxopts::ParseResult& result) { args.disable_volume_control = result["no-volume-control"].as<bool>(); }}},
+        { "test-volume-control", {"test-volume-control", false, nullptr, [&](const cxxopts::ParseResult& result) { args.test_volume_control = result["test-volume-control"].as<bool>(); }}},
+        { "probe-volume-control", {"probe-volume-control", false, nullptr, [&](const cxxopts::ParseResult& result) { args.probe_volume_control = result["probe-volume-control"].as<bool>(); }}},
+        { "port.name", {"port.name", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.port_filter.name_filter = result["port.name"].as<std::string>(); }}},
+        { "port.desc", {"port.desc", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.port_filter.description_filter = result["port.desc"].as<std::string>(); }}},
+        { "port.bus", {"port.bus", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.port_filter.bus = result["port.bus"].as<int>(); }}},
+        { "port.device", {"port.device", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.port_filter.device = result["port.device"].as<int>(); }}},
+        { "port.topology", {"port.topology", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.port_filter.topology = result["port.topology"].as<int>(); }}},
+        { "port.path", {"port.path", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.port_filter.path = result["port.path"].as<std::string>(); }}},
+        { "port.hw-path", {"port.hw-path", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.port_filter.hw_path = result["port.hw-path"].as<std::string>(); }}},
+        { "port.order-by", {"port.order-by", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.port_filter.order_by = result["port.order-by"].as<std::string>(); }}},
+        { "port.order-direction", {"port.order-direction", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.port_filter.order_direction = result["port.order-direction"].as<std::string>(); }}},
+        { "port.serial", {"port.serial", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.port_filter.device_serial_number = result["port.serial"].as<std::string>(); }}},
+        { "port.mfn", {"port.mfn", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.port_filter.manufacturer_filter = result["port.mfn"].as<std::string>(); }}},
+        { "direwolf-config", {"direwolf-config", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.direwolf_output_file = result["direwolf-config"].as<std::string>(); }}},
+        { "direwolf.agwport", {"direwolf.agwport", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { try_parse_number(result["direwolf.agwport"].as<std::string>(), args.direwolf_agwport); }}},
+        { "direwolf.kissport", {"direwolf.kissport", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { try_parse_number(result["direwolf.kissport"].as<std::string>(), args.direwolf_kissport); }}},
+        { "direwolf.callsign", {"direwolf.callsign", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.direwolf_callsign = result["direwolf.callsign"].as<std::string>(); }}},
+        { "run-server", {"run-server", false, nullptr, [&](const cxxopts::ParseResult& result) { args.run_server = true; }}},
+        { "shared-memory", {"shared-memory", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.shared_memory_name = result["shared-memory"].as<std::string>(); }}},
+        { "workers", {"workers", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.worker_count = result["workers"].as<int>(); if (!is_valid_worker_count(args.worker_count)) { args.command_line_error = fmt::format("Error parsing command line: --workers must be between 1 and {}\n\n", max_worker_count); args.command_line_has_errors = true; } }}},
+        { "daemon", {"daemon", false, nullptr, [&](const cxxopts::ParseResult& result) { args.run_daemon = true; }}},
+        { "no-daemon", {"no-daemon", false, nullptr, [&](const cxxopts::ParseResult& result) { args.no_daemon = true; }}},
+        { "daemon-socket", {"daemon-socket", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.daemon_socket = get_full_path(result["daemon-socket"].as<std::string>()); }}},
+        { "server-port", {"server-port", true, cxxopts::value<int>(), [&](const cxxopts::ParseResult& result) { args.server_port = result["server-port"].as<int>(); }}},
+        { "trace", {"trace", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.trace_file = get_full_path(result["trace"].as<std::string>()); }}},
+        { "timings", {"timings", false, nullptr, [&](const cxxopts::ParseResult& result) { args.timings = std::make_shared<run_timings>(); }}},
+        { "stats", {"stats", false, nullptr, [&](const cxxopts::ParseResult& result) { args.print_stats = true; }}},
+        { "test-data", {"test-data", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.test_data_file = get_full_path(result["test-data"].as<std::string>()); }}},
+        { "record", {"record", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.record_file = get_full_path(result["record"].as<std::string>()); }}},
+        { "replay", {"replay", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.replay_file = get_full_path(result["replay"].as<std::string>()); }}},
+        { "replay-time-scale", {"replay-time-scale", true, cxxopts::value<double>(), [&](const cxxopts::ParseResult& result) { args.replay_time_scale = result["replay-time-scale"].as<double>(); }}},
+        { "cache-file", {"cache-file", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { args.cache_file = get_full_path(result["cache-file"].as<std::string>()); }}},
+        { "query", {"q,query", true, cxxopts::value<std::string>(), [&](const cxxopts::ParseResult& result) { if (!try_parse_queries(result["query"].as<std::string>(), args.queries)) { args.command_line_error = "Error parsing command line: invalid query variable name\n\n"; args.command_line_has_errors = true; } }}}
+    };
+
+    if (has_volume_control_options(argc, argv))
+    {
+        args.volume_set.push_back(audio_device_volume_set{});
+    }
+
+    cxxopts::Options options("", "");
+
+    cxxopts::OptionAdder option_group = options.allow_unrecognised_options().add_options();
+
+    for (const auto& command : command_map)
+    {
+        if (command.second.type != nullptr)
+        {
+            option_group(command.second.command_line_arg_name, "", command.second.type);
+        }
+        else
+        {
+            option_group(command.second.command_line_arg_name, "");
+        }
+    }
+
+    cxxopts::ParseResult result;
+
+    try
+    {
+        result = options.parse(argc, argv);
+    }
+    catch (const cxxopts::exceptions::incorrect_argument_type& e)
+    {
+        args.command_line_error = fmt::format("Error parsing command line: {}\n\n", e.what());
+        args.command_line_has_errors = true;
+        return false;
+    }
+    catch (const std::exception& e)
+    {
+        args.command_line_error = "Error parsing command line.";
+        args.command_line_has_errors = true;
+        return false;
+    }
+
+    for (const auto& arg : result.arguments())
+    {
+        args.command_line_args.insert({ arg.key(), arg.value() });
+    }
+
+    std::vector<std::string> unmatched = result.unmatched();
+    if (unmatched.size() > 0)
+    {
+        args.command_line_error = fmt::format("Error parsing command line: {}\n\n", unmatched[0]);
+        args.command_line_has_errors = true;
+        return false;
+    }
+
+    for (const auto& command : command_map)
+    {
+        const std::string& key = command.first;
+        const std::function<void(const cxxopts::ParseResult&)>& handler = command.second.read_handler;
+        if (result.count(key) > 0)
+        {
+            handler(result);
+        }
+    }
+
+    return true;
+}
+
+// **************************************************************** //
+//                                                                  //
+// SETTINGS                                                         //
+//                                                                  //
+// **************************************************************** //
+
+void read_settings(args& args);
+void read_settings(args& args, const nlohmann::json& j);
+void parse_top_level_settings(args& args, const nlohmann::json& j);
+void parse_search_criteria(args& args, const nlohmann::json& j);
+void parse_sort(args& args, const nlohmann::json& j);
+void parse_volume_control(args& args, const nlohmann::json& j);
+void parse_profiles(args& args, const nlohmann::json& j);
+
+void read_settings(args& args)
+{
+    if (args.ignore_config)
+    {
+        return;
+    }
+
+    std::string config_file = args.config_file;
+
+    // Read settings from current executable directory if present.
+
+    if (args.config_file.empty())
+    {
+        config_file = std::filesystem::current_path() / "config.json";
+    }
+
+    if (!std::filesystem::exists(config_file))
+    {
+        return;
+    }
+
+    std::ifstream i;
+    try
+    {
+        i.open(config_file);
+    }
+    catch (std::ios_base::failure&)
+    {
+        return;
+    }
+
+    if (!i.is_open())
+    {
+        return;
+    }
+
+    nlohmann::json j;
+
+    try
+    {
+        j = nlohmann::json::parse(i, nullptr, true, /*ignore comments*/ true);
+    }
+    catch (nlohmann::json::parse_error&)
+    {
+        return;
+    }
+    catch (nlohmann::json::type_error&)
+    {
+        return;
+    }
+
+    read_settings(args, j);
+}
+
+void read_settings(args& args, const nlohmann::json& j)
+{
+    parse_top_level_settings(args, j);
+    parse_search_criteria(args, j);
+    parse_sort(args, j);
+    parse_volume_control(args, j);
+    parse_profiles(args, j);
+}
+
+void parse_top_level_settings(args& args, const nlohmann::json& j)
+{
+    if (!args.command_line_args.contains("search-mode"))
+        try_parse_search_mode(j.value("search_mode", ""), args.search_mode);
+    if (!args.command_line_args.contains("use-json"))
+        try_parse_bool(j.value("use_json", ""), args.use_json);
+    if (!args.command_line_args.contains("list-properties"))
+        try_parse_bool(j.value("list_properties", ""), args.list_properties);
+    if (j.contains("output_file") && !args.command_line_args.contains("output-file"))
+    {
+        args.disable_write_file = false;
+        args.output_file = j["output_file"];
+        args.output_file = get_full_path(args.output_file);
+    }
+    if (!args.command_line_args.contains("included-devices"))
+        try_parse_included_devices(j.value("included_devices", ""), args.included_devices);
+    if (j.contains("cache_file") && !args.command_line_args.contains("cache-file"))
+        args.cache_file = get_full_path(j["cache_file"]);
+    if (!args.command_line_args.contains("workers"))
+        try_parse_number(j.value("workers", ""), args.worker_count);
+}
+
+void parse_search_criteria(args& args, const nlohmann::json& j)
+{
+    if (j.contains("search_criteria"))
+    {
+        nlohmann::json search_criteria = j["search_criteria"];
+        if (search_criteria.contains("audio"))
+        {
+            nlohmann::json audio_match = search_criteria["audio"];
+            if (!args.command_line_args.contains("audio.name"))
+                args.audio_filter.name_filter = audio_match.value("name", "");
+            if (!args.command_line_args.contains("audio.stream-name"))
+                args.audio_filter.stream_name_filter = audio_match.value("stream_name", "");
+            if (!args.command_line_args.contains("audio.desc"))
+                args.audio_filter.desc_filter = audio_match.value("desc", "");
+            if (!args.command_line_args.contains("audio.type"))
+                parse_audio_device_type(audio_match.value("type", ""), args);
+            if (!args.command_line_args.contains("audio.bus"))
+                try_parse_number(audio_match.value("bus", ""), args.audio_filter.bus);
+            if (!args.command_line_args.contains("audio.device"))
+                try_parse_number(audio_match.value("device", ""), args.audio_filter.device);
+            if (!args.command_line_args.contains("audio.topology"))
+                try_parse_number(audio_match.value("topology_depth", ""), args.audio_filter.topology);
+            if (!args.command_line_args.contains("audio.path"))
+                args.audio_filter.path = audio_match.value("path", "");
+            if (!args.command_line_args.contains("audio.hw-path"))
+                args.audio_filter.hw_path = audio_match.value("hw_path", "");
+        }
+        if (search_criteria.contains("port"))
+        {
+            nlohmann::json port_match = search_criteria["port"];
+            if (!args.command_line_args.contains("port.name"))
+                args.port_filter.name_filter = port_match.value("name", "");
+            if (!args.command_line_args.contains("port.desc"))
+                args.port_filter.description_filter = port_match.value("desc", "");
+            if (!args.command_line_args.contains("port.bus"))
+                try_parse_number(port_match.value("bus", ""), args.port_filter.bus);
+            if (!args.command_line_args.contains("port.device"))
+                try_parse_number(port_match.value("device", ""), args.port_filter.device);
+            if (!args.command_line_args.contains("port.toplogy"))
+                try_parse_number(port_match.value("topology_depth", ""), args.port_filter.topology);
+            if (!args.command_line_args.contains("port.path"))
+                args.port_filter.path = port_match.value("path", "");
+            if (!args.command_line_args.contains("port.hw-path"))
+                args.port_filter.hw_path = port_match.value("hw_path", "");
+            if (!args.command_line_args.contains("port.serial"))
+                args.port_filter.device_serial_number = port_match.value("serial", "");
+        }
+    }
+}
+
+void parse_sort(args& args, const nlohmann::json& j)
+{
+    if (j.contains("sort"))
+    {
+        nlohmann::json sort = j["sort"];
+        if (sort.contains("audio"))
+        {
+            nlohmann::json audio_sort = sort["audio"];
+            if (!args.command_line_args.contains("audio.order-by"))
+                args.audio_filter.order_by = audio_sort.value("order_by", "");
+            if (!args.command_line_args.contains("audio.order-direction"))
+                args.audio_filter.order_direction = audio_sort.value("order_direction", "");
+        }
+        if (sort.contains("port"))
+        {
+            nlohmann::json port_sort = sort["port"];
+            if (!args.command_line_args.contains("port.order-by"))
+                args.port_filter.order_by = port_sort.value("order_by", "");
+            if (!args.command_line_args.contains("port.order-direction"))
+                args.port_filter.order_direction = port_sort.value("order_direction", "");
+        }
+    }
+}
+
+void parse_volume_control(args& args, const nlohmann::json& control, const std::string& control_name, const std::string& property_name, const std::string& err_property_name, audio_device_type type, audio_device_volume_set& volume_set)
+{
+    if (!control.contains(property_name))
+    {        
+        return;
+    }
+
+    try_parse_number(control.value(property_name, ""), volume_set.volume);
+    volume_set.audio_channel_type = type;
+    if (control.contains(err_property_name))
+    {
+        try_parse_number(control.value(err_property_name, ""), volume_set.volume_max_error);
+    }
+    volume_set.control_name = control_name;
+    args.volume_set.push_back(volume_set);
+}
+
+void parse_volume_control(args& args, const nlohmann::json& control, const std::string& control_name, const std::string& property_name, const std::string&  err_property_name, audio_device_type type)
+{
+    audio_device_volume_set volume_set;
+    parse_volume_control(args, control, control_name, property_name, err_property_name, type, volume_set);
+}
+
+void parse_volume_control(args& args, const nlohmann::json& control, const std::string& property_name, const std::string& err_property_name, audio_device_type type, audio_device_volume_set &volume_set)
+{
+    std::string control_name;
+    if (control.contains("name"))
+    {
+        control_name = control["name"];
+    }
+    parse_volume_control(args, control, control_name, property_name, err_property_name, type, volume_set);
+}
+
+void parse_volume_control(args& args, const nlohmann::json& control, const std::string& property_name, const std::string& err_property_name, audio_device_type type)
+{
+    audio_device_volume_set volume_set;
+    parse_volume_control(args, control, property_name, err_property_name, type, volume_set);
+}
+
+void parse_volume_control(args& args, const nlohmann::json& control, const nlohmann::json& channel, const std::string& property_name, const std::string& err_property_name, audio_device_type type)
+{
+    std::string control_name;
+    if (control.contains("name"))
+    {
+        control_name = control["name"];
+    }
+    parse_volume_control(args, channel, control_name, property_name, err_property_name, type);
+    std::string channel_name;
+    if (channel.contains("name"))
+    {
+        channel_name = channel["name"];
+        audio_device_channel_id channel_id;
+        if (try_parse_audio_device_channel_display_name(channel_name, channel_id))
+        {
+            args.volume_set.back().audio_channels.push_back(channel_id);
+        }
+    }
+}
+
+void parse_volume_control(args& args, const nlohmann::json& j)
+{
+    if (args.volume_set.size() > 0)
+    {
+        return;
+    }
+
+    if (!j.contains("volume_control"))
+    {
+        return;
+    }
+
+    nlohmann::json volume_control = j["volume_control"];
+
+    parse_volume_control(args, volume_control, "capture_value_percent", "capture_value_test_max_error", audio_device_type::capture);
+    parse_volume_control(args, volume_control, "playback_value_percent", "playback_value_test_max_error", audio_device_type::playback);
+
+    if (volume_control.contains("controls"))
+    {
+        nlohmann::json controls = volume_control["controls"];
+        for (const nlohmann::json& control : controls)
+        {
+            parse_volume_control(args, control, "capture_value_percent", "capture_value_test_max_error", audio_device_type::capture);
+            parse_volume_control(args, control, "playback_value_percent", "playback_value_test_max_error", audio_device_type::playback);
+
+            if (control.contains("channels"))
+            {
+                nlohmann::json channels = control["channels"];
+                for (const nlohmann::json& channel : channels)
+                {
+                    parse_volume_control(args, control, channel, "capture_value_percent", "capture_value_test_max_error", audio_device_type::capture);
+                    parse_volume_control(args, control, channel, "playback_value_percent", "playback_value_test_max_error", audio_device_type::playback);
+                }
+            }
+        }
+    }
+}
+
+void parse_profiles(args& args, const nlohmann::json& j)
+{
+    // Each profile is read like the top level of a config file, but the command line does not override it
+    // The search mode and the included devices of the config file, or of the command line, apply to the profiles without them
+
+    if (!j.contains("profiles") || !j["profiles"].is_array())
+    {
+        return;
+    }
+
+    for (const nlohmann::json& profile_json : j["profiles"])
+    {
+        if (!profile_json.is_object())
+        {
+            continue;
+        }
+
+        struct args profile_args;
+        parse_search_criteria(profile_args, profile_json);
+        parse_sort(profile_args, profile_json);
+        parse_volume_control(profile_args, profile_json);
+
+        profile p;
+        p.name = profile_json.value("name", "");
+        if (p.name.empty())
+        {
+            p.name = std::to_string(args.profiles.size() + 1);
+        }
+        p.audio_filter = profile_args.audio_filter;
+        p.port_filter = profile_args.port_filter;
+        p.volume_set = profile_args.volume_set;
+        p.search_mode = args.search_mode;
+        try_parse_search_mode(profile_json.value("search_mode", ""), p.search_mode);
+        p.included_devices = args.included_devices;
+        try_parse_included_devices(profile_json.value("included_devices", ""), p.included_devices);
+        args.profiles.push_back(p);
+    }
+}
+
+// **************************************************************** //
+//                                                                  //
+// HTTP AND WEB SOCKER SERVER                                       //
+//                                                                  //
+// **************************************************************** //
+
+std::vector<audio_device_unique_volume_set> adjust_volume(const args& args, search_result& result);
+bool test_volume_control(const args& args, const search_result& result);
+
+std::atomic<bool> interrupt_web_server {false};
+
+// Large enough for the JSON of a few hundred devices
+const size_t shared_snapshot_capacity = 4 * 1024 * 1024;
+
+void set_new_search_args(args& args);
+std::string process_devices_to_json(const nlohmann::json& j, const device_snapshot& devices);
+std::string process_volume_sets_to_json(const nlohmann::json& j, std::vector<int>& card_ids);
+bool try_parse_volume_set(const nlohmann::json& j, int& card_id, int& device_id, audio_device_channel_volume_set& set);
+bool try_get_volume_set_string(const nlohmann::json& j, const char* key, std::string& value);
+std::string to_json(const std::vector<audio_device_channel_volume_set>& sets, const std::vector<std::pair<int, int>>& hw_ids, bool result);
+void signal_handler(int signal);
+std::string to_json(const args& args, const search_result& result);
+std::string to_json(const args& args, const search_result& result, uint64_t generation);
+std::string print(const args& args, const search_result& result, bool volume_control_return_value, const std::vector<audio_device_unique_volume_set>& audio_set_result);
+bool render_text(mg_connection *conn, const std::string& text);
+bool render_text(mg_connection *conn, const std::string& text, const std::string& etag);
+bool render_not_modified(mg_connection *conn, const std::string& etag);
+bool is_not_modified(mg_connection *conn, const std::string& etag);
+bool render_result(mg_connection *conn, bool result, const std::string& message);
+int run_server(const args& args);
+void publish_server_snapshot(const args& args, std::shared_ptr<const device_snapshot> devices, server_state& state, shared_snapshot& shared_memory);
+void publish_server_snapshot(const args& args, std::shared_ptr<server_snapshot> snapshot, std::shared_ptr<const server_snapshot> current_snapshot, server_state& state, shared_snapshot& shared_memory);
+void publish_server_snapshot_volumes(const args& args, const std::vector<int>& card_ids, server_state& state);
+std::shared_ptr<const server_snapshot> get_server_snapshot(server_state& state);
+void set_server_snapshot(server_state& state, std::shared_ptr<const server_snapshot> snapshot);
+void run_server_refresher(const args& args, server_state& state, shared_snapshot& shared_memory);
+void run_server_mixer_watcher(const args& args, server_state& state);
+void broadcast_device_event(server_state& state, const std::string& event, const std::string& id, const std::string& hw_path, uint64_t generation);
+void write_websocket_message(websocket_client& client, const std::string& message);
+void broadcast_device_changes(server_state& state, const device_snapshot& previous, const device_snapshot& current, uint64_t generation);
+
+void set_new_search_args(args& args)
+{
+    args.ignore_config = true;
+    args.test_volume_control = false;
+}
+
+std::string process_devices_to_json(const nlohmann::json& j, const device_snapshot& devices)
+{
+    args args;
+
+    args.no_stdout = true;
+    args.ignore_config = true;
+    args.disable_write_file = true;
+    args.run_server = false;
+    args.test_volume_control = true;
+    args.disable_volume_control = false;
+
+    read_settings(args, j);
+
+    // Only the filtering and the volume work is done per request,
+    // the devices come from the server snapshot
+
+    search_result result = search(args, devices);
+
+    auto adjust_volume_results = adjust_volume(args, result);    
+
+    bool volume_test_return_value = test_volume_control(args, result);
+
+    std::string json_output = print(args, result, volume_test_return_value, adjust_volume_results);
+
+    return json_output;
+}
+
+std::string process_volume_sets_to_json(const nlohmann::json& j, std::vector<int>& card_ids)
+{
+    bool verify = false;
+    if (j.contains("verify") && j["verify"].is_boolean())
+    {
+        verify = j["verify"].get<bool>();
+    }
+    else if (j.contains("verify") && j["verify"].is_string())
+    {
+        try_parse_bool(j["verify"].get<std::string>(), verify);
+    }
+
+    std::vector<audio_device_channel_volume_set> sets;
+    std::vector<std::pair<int, int>> hw_ids;
+
+    // Sets are grouped by card, each card applies all of its sets in one mixer session
+
+    std::map<int, std::vector<size_t>> card_sets;
+
+    bool result = true;
+
+    if (j.contains("sets") && j["sets"].is_array())
+    {
+        for (const nlohmann::json& item : j["sets"])
+        {
+            audio_device_channel_volume_set set;
+            int card_id = -1;
+            int device_id = -1;
+
+            if (try_parse_volume_set(item, card_id, device_id, set))
+            {
+                card_sets[card_id].push_back(sets.size());
+            }
+            else
+            {
+                result = false;
+            }
+
+            sets.push_back(set);
+            hw_ids.emplace_back(card_id, device_id);
+        }
+    }
+
+    for (const auto& [card_id, indices] : card_sets)
+    {
+        std::vector<audio_device_channel_volume_set> card_volume_sets;
+        card_volume_sets.reserve(indices.size());
+        for (size_t i : indices)
+        {
+            card_volume_sets.push_back(sets[i]);
+        }
+
+        if (!try_set_audio_device_volume_percent(card_id, card_volume_sets, verify))
+        {
+            result = false;
+        }
+
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            sets[indices[i]] = card_volume_sets[i];
+        }
+
+        // Only the cards with an applied set have new volumes, a set which was written but read back
+        // with another volume may have changed the mixer too
+
+        if (std::any_of(card_volume_sets.begin(), card_volume_sets.end(), [](const auto& set) {
+                return set.status == audio_device_volume_set_status::applied || set.status == audio_device_volume_set_status::not_verified; }))
+        {
+            card_ids.push_back(card_id);
+        }
+    }
+
+    return to_json(sets, hw_ids, result);
+}
+
+bool try_parse_volume_set(const nlohmann::json& j, int& card_id, int& device_id, audio_device_channel_volume_set& set)
+{
+    if (!j.is_object())
+    {
+        set.error = "invalid set";
+        return false;
+    }
+
+    // The fields are type checked one by one, a malformed set only fails itself
+    // instead of throwing and failing every set of the request
+
+    std::string id;
+    if (!try_get_volume_set_string(j, "id", id) || !try_parse_audio_device_hw_id(id, card_id, device_id))
+    {
+        set.error = "invalid device id";
+        return false;
+    }
+
+    if (!try_get_volume_set_string(j, "control", set.control_name))
+    {
+        set.error = "invalid control";
+        return false;
+    }
+
+    if (set.control_name.empty())
+    {
+        set.error = "missing control";
+        return false;
+    }
+
+    std::string channel;
+    if (!try_get_volume_set_string(j, "channel", channel) || (j.contains("channel") && !try_parse_audio_device_channel_id(channel, set.channel)))
+    {
+        set.error = "invalid channel";
+        return false;
+    }
+
+    std::string type = "volume";
+    if (!try_get_volume_set_string(j, "type", type))
+    {
+        set.error = "invalid type";
+        return false;
+    }
+
+    if (type == "volume")
+    {
+        set.channel_type = audio_device_type::capture | audio_device_type::playback;
+    }
+    else if (type == "playback_volume")
+    {
+        set.channel_type = audio_device_type::playback;
+    }
+    else if (type == "capture_volume")
+    {
+        set.channel_type = audio_device_type::capture;
+    }
+    else
+    {
+        set.error = "type of volume set not supported, supported values are: volume, playback_volume, capture_volume";
+        return false;
+    }
+
+    // The volume is accepted as a string like the other values, or as an integer
+
+    const nlohmann::json* volume = j.contains("volume") ? &j["volume"] : nullptr;
+    if (volume != nullptr && volume->is_number_integer())
+    {
+        set.volume_percent = volume->get<int>();
+    }
+    else if (volume == nullptr || !volume->is_string() || !try_parse_number(volume->get<std::string>(), set.volume_percent))
+    {
+        set.error = "cannot parse volume as number";
+        return false;
+    }
+
+    if (set.volume_percent < 0 || set.volume_percent > 100)
+    {
+        set.error = "volume out of range";
+        return false;
+    }
+
+    return true;
+}
+
+bool try_get_volume_set_string(const nlohmann::json& j, const char* key, std::string& value)
+{
+    // A missing key leaves the default value in place
+
+    if (!j.contains(key))
+        return true;
+
+    const nlohmann::json& item = j[key];
+    if (!item.is_string())
+        return false;
+
+    value = item.get<std::string>();
+    return true;
+}
+
+std::string to_json(const std::vector<audio_device_channel_volume_set>& sets, const std::vector<std::pair<int, int>>& hw_ids, bool result)
+{
+    // Only values parsed from the request are echoed back, the sets are identified by their index
+
+    std::string s;
+    s += "{\n";
+    s += fmt::format("    \"success\": \"{}\",\n", result);
+    s += "    \"sets\": [\n";
+    for (size_t i = 0; i < sets.size(); i++)
+    {
+        const audio_device_channel_volume_set& set = sets[i];
+        s += "        {\n";
+        s += fmt::format("            \"index\": \"{}\",\n", i);
+        if (hw_ids[i].first >= 0)
+        {
+            s += fmt::format("            \"id\": \"hw:{},{}\",\n", hw_ids[i].first, hw_ids[i].second);
+        }
+        if (set.channel != audio_device_channel_id::none)
+        {
+            s += fmt::format("            \"channel\": \"{}\",\n", to_string(set.channel));
+        }
+        s += fmt::format("            \"volume\": \"{}\",\n", set.volume_percent);
+        s += fmt::format("            \"success\": \"{}\",\n", set.success);
+        s += fmt::format("            \"verified\": \"{}\",\n", set.verified);
+        s += fmt::format("            \"error\": \"{}\"\n", set.error);
+        s += "        }";
+        if ((i + 1) < sets.size())
+        {
+            s.append(",");
+        }
+        s.append("\n");
+    }
+    s += "    ]\n";
+    s += "}";
+    return s;
+}
+
+void signal_handler(int signal)
+{
+    if (signal == SIGINT || signal == SIGTERM)
+    {
+        interrupt_web_server = true;
+    }
+}
+
+std::string to_json(const args& args, const search_result& result)
+{
+    std::vector<audio_device_unique_volume_set> empty_audio_set_result;
+
+    std::string json_output = to_json(args, result, empty_audio_set_result, true);
+
+    return json_output;
+}
+
+std::string to_json(const args& args, const search_result& result, uint64_t generation)
+{
+    std::vector<audio_device_unique_volume_set> empty_audio_set_result;
+
+    std::string json_output = to_json(args, result, empty_audio_set_result, true, [generation]() { return fmt::format("    \"generation\": \"{}\"", generation); });
+
+    return json_output;
+}
+
+bool render_text(mg_connection *conn, const std::string& text)
+{
+    mg_printf(conn,
+          "HTTP/1.1 200 OK\r\n"
+          "Content-Type: application/json\r\n"
+          "Content-Length: %zu\r\n"
+          "Access-Control-Allow-Origin: *\r\n"
+          "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+          "Access-Control-Allow-Headers: Content-Type\r\n"
+          "\r\n"
+          "%s",
+          text.size(), text.c_str());
+    return true;
+}
+
+bool render_text(mg_connection *conn, const std::string& text, const std::string& etag)
+{
+    mg_printf(conn,
+          "HTTP/1.1 200 OK\r\n"
+          "Content-Type: application/json\r\n"
+          "Content-Length: %zu\r\n"
+          "ETag: %s\r\n"
+          "Cache-Control: no-cache\r\n"
+          "Access-Control-Allow-Origin: *\r\n"
+          "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+          "Access-Control-Allow-Headers: Content-Type, If-None-Match\r\n"
+          "Access-Control-Expose-Headers: ETag\r\n"
+          "\r\n"
+          "%s",
+          text.size(), etag.c_str(), text.c_str());
+    return true;
+}
+
+bool render_not_modified(mg_connection *conn, const std::string& etag)
+{
+    mg_printf(conn,
+          "HTTP/1.1 304 Not Modified\r\n"
+          "ETag: %s\r\n"
+          "Cache-Control: no-cache\r\n"
+          "Access-Control-Allow-Origin: *\r\n"
+          "Access-Control-Expose-Headers: ETag\r\n"
+          "\r\n",
+          etag.c_str());
+    return true;
+}
+
+bool is_not_modified(mg_connection *conn, const std::string& etag)
+{
+    const char* if_none_match = mg_get_header(conn, "If-None-Match");
+    if (if_none_match == nullptr || etag.empty())
+    {
+        return false;
+    }
+
+    // The header is a comma separated list of entity tags, or *
+
+    std::string_view header = if_none_match;
+    while (!header.empty())
+    {
+        size_t comma_pos = header.find(',');
+        std::string_view tag = header.substr(0, comma_pos);
+        header = (comma_pos == std::string_view::npos) ? std::string_view{} : header.substr(comma_pos + 1);
+
+        while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t'))
+            tag.remove_prefix(1);
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t'))
+            tag.remove_suffix(1);
+        if (tag.substr(0, 2) == "W/")
+            tag.remove_prefix(2);
+
+        if (tag == "*" || tag == etag)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool render_result(mg_connection *conn, bool result, const std::string& message)
+{
+    std::string response = fmt::format("{{ \"success\": \"{}\", \"message\": \"{}\" }}", result, message);
+    return render_text(conn, response);
+}
+
+class DeviceHttpHandler : public CivetHandler
+{
+public:
+    DeviceHttpHandler(const args& args, server_state& state) : args(args), state(state), request_metrics(get_metrics_histogram("find_devices_http_request_duration_seconds", "endpoint", "/device")) {}
+
+    bool handleGet(CivetServer *server, struct mg_connection *conn) override
+    {
+        scoped_metrics_timer timer(request_metrics);
+        trace_span span("GET /device", "uri", mg_get_request_info(conn)->local_uri);
+
+        if (!args.no_stdout)
+            print(!args.disable_colors, fg(fmt::color::gray), "HTTP server received GET request\n");
+
+        std::string_view request_uri = mg_get_request_info(conn)->request_uri;
+
+        std::vector<std::string_view> url_segments = split_url(request_uri);
+
+        if (url_segments.size() < 2 || url_segments.size() > 8)
+        {
+            return render_result(conn, false, "not supported");
+        }
+
+        std::string_view device_id = url_segments[1];
+
+        if (url_segments.size() == 2)
+        {
+            // Served from the current snapshot when the device is known to it
+
+            std::shared_ptr<const server_snapshot> snapshot = get_server_snapshot(state);
+
+            auto it = snapshot->all_devices_index.find(device_id);
+            if (it != snapshot->all_devices_index.end())
+            {
+                if (is_not_modified(conn, snapshot->etag))
+                {
+                    return render_not_modified(conn, snapshot->etag);
+                }
+
+                return render_text(conn, to_json(snapshot->all_result.devices[it->second].first), snapshot->etag);
+            }
+        }
+
+        // Open only the card named by the hw or plughw id, instead of enumerating every card
+
+        audio_device_info device;
+        int card_id = -1;
+        int card_device_id = -1;
+
+        if (!try_parse_audio_device_hw_id(device_id, card_id, card_device_id) ||
+            !try_get_audio_device(card_id, card_device_id, device) ||
+            (device.hw_id != device_id && device.plughw_id != device_id))
+        {
+            return render_result(conn, false, fmt::format("no device ""{}"" found", device_id));
+        }
+
+        if (url_segments.size() == 2)
+        {
+            audio_device_volume_info volume;
+            try_get_audio_device_volume(device, volume);
+            std::string response = to_json(volume);
+            return render_text(conn, response);
+        }
+        else if (url_segments.size() == 4)
+        {
+            std::string_view volume_set_type = url_segments[2];
+            std::string_view device_volume_str = url_segments[3];
+            int device_volume = -1;
+
+            if (!(volume_set_type == "volume" || volume_set_type == "playback_volume" || volume_set_type == "capture_volume"))
+            {
+                return render_result(conn, false, "type of volume set not supported, supported values are: volume, playback_volume, capture_volume");
+            }
+
+            if (!try_parse_int(device_volume_str, device_volume))
+            {
+                return render_result(conn, false, "cannot parse volume as number");
+            }
+
+            bool result = try_set_audio_device_volume_percent(device, device_volume);
+
+            // The volumes of the card are read again, so that the next GET does not serve the previous volumes
+
+            if (result)
+                publish_server_snapshot_volumes(args, { card_id }, state);
+
+            return render_result(conn, result, "");
+        }
+        else if (url_segments.size() == 8)
+        {
+            std::string_view control_str = url_segments[2];
+            std::string control_name(url_segments[3]);
+            std::string_view channel_str = url_segments[4];
+            std::string channel_name(url_segments[5]);
+            std::string_view channel_type_str = url_segments[6];
+            audio_device_type channel_type;
+            std::string_view device_volume_str = url_segments[7];
+            int device_volume = -1;
+
+            if (channel_str != "channel")
+            {
+                return render_result(conn, false, "not supported");
+            }
+
+            if (!(channel_type_str == "volume" || channel_type_str == "playback_volume" || channel_type_str == "capture_volume"))
+            {
+                return render_result(conn, false, "type of volume set not supported, supported values are: volume, playback_volume, capture_volume");
+            }
+
+            if (control_str != "control")
+            {
+                return render_result(conn, false, "not supported");
+            }
+
+            if (!try_parse_int(device_volume_str, device_volume))
+            {
+                return render_result(conn, false, "cannot parse volume as number");
+            }
+
+            if (channel_type_str == "volume")
+            {
+                channel_type = audio_device_type::capture | audio_device_type::playback; 
+            }
+            else if (channel_type_str == "playback_volume")
+            {
+                channel_type = audio_device_type::playback; 
+            }
+            else if (channel_type_str == "capture_volume")
+            {
+                channel_type = audio_device_type::capture; 
+            }
+
+            bool result = try_set_audio_device_volume_percent(device, control_name, channel_name, channel_type, device_volume);
+
+            if (result)
+                publish_server_snapshot_volumes(args, { card_id }, state);
+
+            return render_result(conn, result, "");
+        }
+
+        return render_result(conn, false, "not supported");
+    }
+
+    std::vector<std::string_view> split_url(std::string_view url)
+    {
+        // The segments refer to the request buffer, which outlives the request handling
+
+        std::vector<std::string_view> segments;
+        segments.reserve(8);
+
+        while (!url.empty())
+        {
+            size_t slash_pos = url.find('/');
+            std::string_view segment = url.substr(0, slash_pos);
+            if (!segment.empty())
+            {
+                segments.push_back(segment);
+            }
+            if (slash_pos == std::string_view::npos)
+            {
+                break;
+            }
+            url.remove_prefix(slash_pos + 1);
+        }
+
+        return segments;
+    }
+
+    const struct args& args;
+    server_state& state;
+    metrics_histogram& request_metrics;
+};
+
+DevicesHttpHandler::DevicesHttpHandler(const struct args& args, server_state& state) : args(args), state(state), request_metrics(get_metrics_histogram("find_devices_http_request_duration_seconds", "endpoint", "/devices"))
+{
+}
+
+bool DevicesHttpHandler::handleGet(CivetServer *server, struct mg_connection *conn)
+{
+    scoped_metrics_timer timer(request_metrics);
+    trace_span span("GET /devices", "uri", mg_get_request_info(conn)->local_uri);
+
+    if (!args.no_stdout)
+        print(!args.disable_colors, fg(fmt::color::gray), "HTTP server received GET request\n");
+
+    std::string uri = mg_get_request_info(conn)->local_uri;
+
+    // Only accept /devices and /devices/all
+    if (uri != "/devices" && uri != "/devices/all")
+    {
+        return false;
+    }
+
+    bool all = false;
+
+    if (uri == "/devices/all")
+    {
+        all = true;
+    }
+
+    try 
+    {
+        std::shared_ptr<const server_snapshot> snapshot = get_server_snapshot(state);
+        if (is_not_modified(conn, snapshot->etag))
+        {
+            render_not_modified(conn, snapshot->etag);
+        }
+        else if (!all)
+        {
+            render_text(conn, snapshot->devices_json, snapshot->etag);
+        }
+        else
+        {
+            render_text(conn, snapshot->all_devices_json, snapshot->etag);
+        }
+    }
+    catch (std::exception&)
+    {
+        render_result(conn, false, "An exception has occured on the server.");
+    }
+
+    return true;
+}
+
+bool DevicesHttpHandler::handlePost(CivetServer *server, struct mg_connection *conn)
+{
+    scoped_metrics_timer timer(request_metrics);
+    trace_span span("POST /devices", "uri", mg_get_request_info(conn)->local_uri);
+
+    if (!args.no_stdout)
+        print(!args.disable_colors, fg(fmt::color::gray), "HTTP server received POST request\n");
+
+    std::string uri = mg_get_request_info(conn)->local_uri;
+
+    // Only accept /devices
+    if (uri != "/devices")
+    {
+        return false;
+    }
+
+    char buffer[1024];
+    std::string payload;
+    int readBytes = 0;
+    while ((readBytes = mg_read(conn, buffer, sizeof(buffer) - 1)) > 0)
+    {
+        payload.append(buffer, readBytes);
+    }
+
+    if (payload.size() <= 0)
+    {
+        render_result(conn, false, "Invalid JSON payload");
+        return false;
+    }
+
+    nlohmann::json j;
+
+    try
+    {
+        j = nlohmann::json::parse(payload);
+
+        // Identical concurrent requests are processed once, setting the same volumes twice has no further effect
+
+        std::shared_ptr<const server_snapshot> snapshot = get_server_snapshot(state);
+
+        std::string response = state.process_devices_flight.run(j.dump(), [&]() { return process_devices_to_json(j, *snapshot->devices); });
+
+        render_text(conn, response);
+    }
+    catch (const nlohmann::json::exception& e)
+    {
+        render_result(conn, false, "Invalid JSON payload");
+        return false;
+    }
+
+    return true;
+}
+
+struct VolumeHttpHandler : public CivetHandler
+{
+    VolumeHttpHandler(const args& args, server_state& state) : args(args), state(state), request_metrics(get_metrics_histogram("find_devices_http_request_duration_seconds", "endpoint", "/volume")) {}
+
+    bool handlePost(CivetServer *server, struct mg_connection *conn) override
+    {
+        scoped_metrics_timer timer(request_metrics);
+        trace_span span("POST /volume", "uri", mg_get_request_info(conn)->local_uri);
+
+        if (!args.no_stdout)
+            print(!args.disable_colors, fg(fmt::color::gray), "HTTP server received POST request\n");
+
+        std::string uri = mg_get_request_info(conn)->local_uri;
+
+        // Only accept /volume
+        if (uri != "/volume")
+        {
+            return false;
+        }
+
+        char buffer[1024];
+        std::string payload;
+        int readBytes = 0;
+        while ((readBytes = mg_read(conn, buffer, sizeof(buffer) - 1)) > 0)
+        {
+            payload.append(buffer, readBytes);
+        }
+
+        if (payload.size() <= 0)
+        {
+            render_result(conn, false, "Invalid JSON payload");
+            return false;
+        }
+
+        try
+        {
+            nlohmann::json j = nlohmann::json::parse(payload);
+
+            std::vector<int> card_ids;
+            std::string response = process_volume_sets_to_json(j, card_ids);
+
+            publish_server_snapshot_volumes(args, card_ids, state);
+
+            render_text(conn, response);
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            render_result(conn, false, "Invalid JSON payload");
+            return false;
+        }
+
+        return true;
+    }
+
+    const struct args& args;
+    server_state& state;
+    metrics_histogram& request_metrics;
+};
+
+struct MetricsHttpHandler : public CivetHandler
+{
+    bool handleGet(CivetServer *server, struct mg_connection *conn) override
+    {
+        std::string text = to_metrics_text();
+
+        mg_printf(conn,
+              "HTTP/1.1 200 OK\r\n"
+              "Content-Type: text/plain; version=0.0.4\r\n"
+              "Content-Length: %zu\r\n"
+              "Cache-Control: no-cache\r\n"
+              "\r\n"
+              "%s",
+              text.size(), text.c_str());
+
+        return true;
+    }
+};
+
+// Pushes compact JSON events to the clients:
+//
+//    {"event":"audio_device_added","id":"hw:1,0","hw_path":"/sys/devices/...","generation":"5"}
+//
+//  Events: audio_device_added, audio_device_removed, serial_port_added, serial_port_removed, volume_changed
+//  Clients filter the events by device id or hardware path:
+//
+//    {"subscribe":["hw:1,0","/dev/ttyUSB0"]}
+//    {"unsubscribe":["hw:1,0"]}
+
+struct DevicesWebSocketHandler : public CivetWebSocketHandler
+{
+    DevicesWebSocketHandler(server_state& state) : state(state) {}
+
+    bool handleConnection(CivetServer *server, const struct mg_connection *conn) override
+    {
+        return true;
+    }
+
+    void handleReadyState(CivetServer *server, struct mg_connection *conn) override
+    {
+        std::string message = fmt::format("{{\"event\":\"ready\",\"generation\":\"{}\"}}", get_server_snapshot(state)->generation);
+
+        std::shared_ptr<websocket_client> client = std::make_shared<websocket_client>();
+        client->conn = conn;
+
+        {
+            std::lock_guard<std::mutex> lock(state.websocket_mutex);
+            state.websocket_clients[conn] = client;
+        }
+
+        write_websocket_message(*client, message);
+    }
+
+    bool handleData(CivetServer *server, struct mg_connection *conn, int bits, char *data, size_t data_len) override
+    {
+        int opcode = bits & 0x0f;
+
+        if (opcode == MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE)
+        {
+            return false;
+        }
+
+        if (opcode != MG_WEBSOCKET_OPCODE_TEXT)
+        {
+            return true;
+        }
+
+        try
+        {
+            nlohmann::json j = nlohmann::json::parse(std::string(data, data_len));
+
+            std::lock_guard<std::mutex> lock(state.websocket_mutex);
+            auto it = state.websocket_clients.find(conn);
+            if (it == state.websocket_clients.end())
+            {
+                return true;
+            }
+            std::set<std::string>& subscriptions = it->second->subscriptions;
+
+            if (j.contains("subscribe") && j["subscribe"].is_array())
+            {
+                for (const nlohmann::json& id : j["subscribe"])
+                {
+                    if (id.is_string())
+                        subscriptions.insert(id.get<std::string>());
+                }
+            }
+
+            if (j.contains("unsubscribe") && j["unsubscribe"].is_array())
+            {
+                for (const nlohmann::json& id : j["unsubscribe"])
+                {
+                    if (id.is_string())
+                        subscriptions.erase(id.get<std::string>());
+                }
+            }
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+        }
+
+        return true;
+    }
+
+    void handleClose(CivetServer *server, const struct mg_connection *conn) override
+    {
+        std::shared_ptr<websocket_client> client;
+
+        {
+            std::lock_guard<std::mutex> lock(state.websocket_mutex);
+            auto it = state.websocket_clients.find(const_cast<mg_connection*>(conn));
+            if (it == state.websocket_clients.end())
+            {
+                return;
+            }
+            client = it->second;
+            state.websocket_clients.erase(it);
+        }
+
+        // Waits for a write in progress, the connection is not used once closed
+
+        std::lock_guard<std::mutex> lock(client->write_mutex);
+        client->closed = true;
+    }
+
+    server_state& state;
+};
+
+struct RootHandler : public CivetHandler
+{
+    bool handleGet(CivetServer *server, struct mg_connection *conn) override
+    {
+        return false;
+    }
+};
+
+int run_server(const args& args)
+{
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    if (!args.run_server)
+    {
+        return 0;
+    }
+
+    std::string server_port = std::to_string(args.server_port);
+
+    const char *options[] = {
+        "listening_ports", server_port.c_str(),
+        "num_threads", "4",
+        nullptr
+    };
+
+    CivetServer server(options);
+
+    // 
+    //  Example supported requests:
+    //
+    //    http://192.168.1.11:8082/devices
+    //    http://192.168.1.11:8082/devices/all
+    //
+    //  GET responses carry an ETag, requests with a matching If-None-Match receive 304 Not Modified
+    //
+    //    http://192.168.1.11:8082/device/hw:0,0
+    //    http://192.168.1.11:8082/device/hw:0,0/volume/50
+    //    http://192.168.1.11:8082/device/hw:0,0/playback_volume/50
+    //    http://192.168.1.11:8082/device/hw:0,0/capture_volume/50
+    //    http://192.168.1.11:8082/device/hw:0,0/channel/front_right/volume/50
+    //    http://192.168.1.11:8082/device/hw:0,0/channel/front_right/playback_volume/50
+    //    http://192.168.1.11:8082/device/hw:0,0/channel/front_right/capture_volume/50    
+    //
+    //  POST /volume applies many sets at once, grouped per card:
+    //
+    //    { "verify": "true", "sets": [ { "id": "hw:0,0", "control": "Speaker", "channel": "front_left", "type": "playback_volume", "volume": "50" } ] }
+    //
+    //    ws://192.168.1.11:8082/events
+    //
+    //  Operation counters and latency histograms in the Prometheus text format:
+    //
+    //    http://192.168.1.11:8082/metrics
+    //
+
+    shared_snapshot shared_memory;
+
+    if (!args.shared_memory_name.empty())
+    {
+        std::string shared_memory_name = args.shared_memory_name;
+        if (shared_memory_name[0] != '/')
+        {
+            shared_memory_name = "/" + shared_memory_name;
+        }
+
+        if (!try_create_shared_snapshot(shared_memory_name, shared_snapshot_capacity, shared_memory) && !args.no_stdout)
+        {
+            print(!args.disable_colors, fg(fmt::color::red), "Failed to create shared memory {}, it may be owned by another running server\n", shared_memory_name);
+        }
+    }
+
+    // Publish the first snapshot before accepting requests
+
+    server_state state;
+
+    // Entity tags stay unique across server restarts
+    state.instance_id = fmt::format("{:x}", (uint64_t)std::chrono::system_clock::now().time_since_epoch().count());
+    state.shared_memory = &shared_memory;
+
+    publish_server_snapshot(args, std::make_shared<const device_snapshot>(get_device_snapshot(args)), state, shared_memory);
+
+    std::thread refresher(run_server_refresher, std::cref(args), std::ref(state), std::ref(shared_memory));
+    std::thread mixer_watcher(run_server_mixer_watcher, std::cref(args), std::ref(state));
+
+    DeviceHttpHandler device_handler(args, state);
+    server.addHandler("/device", device_handler);
+
+    DevicesHttpHandler devices_handler(args, state);
+    server.addHandler("/devices", devices_handler);
+
+    VolumeHttpHandler volume_handler(args, state);
+    server.addHandler("/volume", volume_handler);
+
+    DevicesWebSocketHandler events_handler(state);
+    server.addWebSocketHandler("/events", events_handler);
+
+    MetricsHttpHandler metrics_handler;
+    server.addHandler("/metrics", metrics_handler);
+
+    RootHandler root_handler;
+    server.addHandler("/", root_handler);
+
+    if (!args.no_stdout && args.verbose)
+    {
+        print(!args.disable_colors, fmt::emphasis::bold, "HTTP and Web Socket server started on port {}\n", args.server_port);
+        print(!args.disable_colors, fg(fmt::color::light_yellow) | fmt::emphasis::italic, "Use Ctrl+C to stop server\n");
+    }
+
+    while (!interrupt_web_server)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+
+    refresher.join();
+    mixer_watcher.join();
+
+    server.close();
+
+    return 0;
+}
+
+std::shared_ptr<const server_snapshot> get_server_snapshot(server_state& state)
+{
+    std::lock_guard<std::mutex> lock(state.snapshot_mutex);
+    return state.snapshot;
+}
+
+void set_server_snapshot(server_state& state, std::shared_ptr<const server_snapshot> snapshot)
+{
+    // The previous snapshot is released outside of the lock, by the last request using it
+
+    std::lock_guard<std::mutex> lock(state.snapshot_mutex);
+    state.snapshot.swap(snapshot);
+}
+
+void publish_server_snapshot(const args& args, std::shared_ptr<const device_snapshot> devices, server_state& state, shared_snapshot& shared_memory)
+{
+    std::lock_guard<std::mutex> lock(state.publish_mutex);
+
+    std::shared_ptr<server_snapshot> snapshot = std::make_shared<server_snapshot>();
+
+    struct args all_args;
+    set_new_search_args(all_args);
+
+    snapshot->devices = devices;
+    snapshot->result = search(args, *devices);
+    snapshot->all_result = search(all_args, *devices);
+
+    sort(args, snapshot->result);
+
+    publish_server_snapshot(args, snapshot, get_server_snapshot(state), state, shared_memory);
+}
+
+void publish_server_snapshot(const args& args, std::shared_ptr<server_snapshot> snapshot, std::shared_ptr<const server_snapshot> current_snapshot, server_state& state, shared_snapshot& shared_memory)
+{
+    // Renders the search results of the snapshot, the publish mutex is held by the caller
+
+    struct args all_args;
+    set_new_search_args(all_args);
+
+    // Keep the current snapshot, and its generation, if nothing changed
+
+    snapshot->content_hash = hash_content(to_json(args, snapshot->result) + to_json(all_args, snapshot->all_result));
+
+    if (current_snapshot != nullptr && current_snapshot->content_hash == snapshot->content_hash)
+    {
+        if (current_snapshot->devices != snapshot->devices)
+        {
+            // Same content from a newer enumeration, requests should use the newer devices
+            std::shared_ptr<server_snapshot> updated_snapshot = std::make_shared<server_snapshot>(*current_snapshot);
+            updated_snapshot->devices = snapshot->devices;
+            set_server_snapshot(state, updated_snapshot);
+        }
+        return;
+    }
+
+    snapshot->all_devices_index.clear();
+    for (size_t i = 0; i < snapshot->all_result.devices.size(); i++)
+    {
+        snapshot->all_devices_index.emplace(snapshot->all_result.devices[i].first.audio_device.hw_id, i);
+    }
+
+    snapshot->generation = (current_snapshot != nullptr) ? current_snapshot->generation + 1 : 1;
+    snapshot->etag = fmt::format("\"{}-{}\"", state.instance_id, snapshot->generation);
+    snapshot->devices_json = to_json(args, snapshot->result, snapshot->generation);
+    snapshot->all_devices_json = to_json(all_args, snapshot->all_result, snapshot->generation);
+
+    set_server_snapshot(state, snapshot);
+
+    if (shared_memory.data != nullptr)
+    {
+        try_publish_shared_snapshot(shared_memory, snapshot->devices_json);
+    }
+}
+
+void publish_server_snapshot_volumes(const args& args, const std::vector<int>& card_ids, server_state& state)
+{
+    // Only the mixers of the changed cards are read again, the devices and the search results are kept
+
+    if (card_ids.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(state.publish_mutex);
+
+    std::shared_ptr<const server_snapshot> current_snapshot = get_server_snapshot(state);
+
+    std::shared_ptr<server_snapshot> snapshot = std::make_shared<server_snapshot>(*current_snapshot);
+
+    for (int card_id : card_ids)
+    {
+        auto it = std::find_if(snapshot->all_result.devices.begin(), snapshot->all_result.devices.end(), [card_id](const auto& d) { return d.first.audio_device.card_id == card_id; });
+        if (it == snapshot->all_result.devices.end())
+        {
+            continue;
+        }
+
+        audio_device_volume_info volume;
+        try_get_audio_device_volume(it->first.audio_device, volume);
+
+        for (search_result* result : { &snapshot->result, &snapshot->all_result })
+        {
+            for (auto& d : result->devices)
+            {
+                if (d.first.audio_device.card_id == card_id)
+                    d.first.controls = volume.controls;
+            }
+        }
+    }
+
+    publish_server_snapshot(args, snapshot, current_snapshot, state, *state.shared_memory);
+}
+
+void run_server_refresher(const args& args, server_state& state, shared_snapshot& shared_memory)
+{
+    // The devices are enumerated again only when the uevent sequence number changes,
+    // the udev monitor wakes up the refresher as soon as a device is added or removed
+    // The snapshot is only published when the devices change, volume changes are published by the mixer watcher
+
+    std::shared_ptr<const device_snapshot> devices = get_server_snapshot(state)->devices;
+
+    device_monitor monitor;
+    bool monitoring = try_create_device_monitor(monitor);
+
+    while (!interrupt_web_server)
+    {
+        if (monitoring)
+        {
+            wait_for_device_change(monitor, 1000);
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+
+        if (interrupt_web_server)
+        {
+            break;
+        }
+
+        if (is_device_snapshot_current(*devices))
+        {
+            continue;
+        }
+
+        std::shared_ptr<const device_snapshot> previous_devices = devices;
+
+        devices = std::make_shared<const device_snapshot>(get_device_snapshot(args));
+
+        publish_server_snapshot(args, devices, state, shared_memory);
+
+        broadcast_device_changes(state, *previous_devices, *devices, get_server_snapshot(state)->generation);
+    }
+}
+
+void run_server_mixer_watcher(const args& args, server_state& state)
+{
+    // The mixers of the test data or of a replayed recording are not on this system,
+    // their volumes only change through the volume handlers, which publish them
+
+    if (!is_system_device_backend())
+    {
+        return;
+    }
+
+    // The mixers of the cards in the current snapshot are opened again when the devices change
+
+    std::shared_ptr<const device_snapshot> devices;
+    mixer_monitor monitor;
+    std::vector<int> changed_card_ids;
+
+    while (!interrupt_web_server)
+    {
+        std::shared_ptr<const device_snapshot> current_devices = get_server_snapshot(state)->devices;
+
+        if (current_devices != devices)
+        {
+            devices = current_devices;
+
+            std::vector<int> card_ids;
+            for (const auto& [d, desc] : devices->devices)
+            {
+                if (std::find(card_ids.begin(), card_ids.end(), d.card_id) == card_ids.end())
+                {
+                    card_ids.push_back(d.card_id);
+                }
+            }
+
+            try_create_mixer_monitor(card_ids, monitor);
+        }
+
+        if (monitor.mixers.empty())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            continue;
+        }
+
+        if (!wait_for_mixer_change(monitor, 250, changed_card_ids))
+        {
+            continue;
+        }
+
+        // The events carry the generation of a snapshot which has the new volumes
+
+        publish_server_snapshot_volumes(args, changed_card_ids, state);
+
+        uint64_t generation = get_server_snapshot(state)->generation;
+
+        for (int card_id : changed_card_ids)
+        {
+            for (const auto& [d, desc] : devices->devices)
+            {
+                if (d.card_id == card_id)
+                {
+                    broadcast_device_event(state, "volume_changed", d.hw_id, desc.hw_path, generation);
+                }
+            }
+        }
+    }
+}
+
+void broadcast_device_event(server_state& state, const std::string& event, const std::string& id, const std::string& hw_path, uint64_t generation)
+{
+    // The ids and paths come from the system, and are escaped by the JSON serializer
+
+    auto to_json_string = [](const std::string& value) { return nlohmann::json(value).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace); };
+
+    std::string message = fmt::format("{{\"event\":{},\"id\":{},\"hw_path\":{},\"generation\":\"{}\"}}", to_json_string(event), to_json_string(id), to_json_string(hw_path), generation);
+
+    // The matching clients are copied, so that a slow client does not block the others from subscribing or closing
+
+    std::vector<std::shared_ptr<websocket_client>> clients;
+
+    {
+        std::lock_guard<std::mutex> lock(state.websocket_mutex);
+
+        for (const auto& [conn, client] : state.websocket_clients)
+        {
+            const std::set<std::string>& subscriptions = client->subscriptions;
+            if (subscriptions.empty() || subscriptions.contains(id) || (!hw_path.empty() && subscriptions.contains(hw_path)))
+            {
+                clients.push_back(client);
+            }
+        }
+    }
+
+    for (const auto& client : clients)
+    {
+        write_websocket_message(*client, message);
+    }
+}
+
+void write_websocket_message(websocket_client& client, const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(client.write_mutex);
+
+    if (!client.closed)
+    {
+        mg_websocket_write(client.conn, MG_WEBSOCKET_OPCODE_TEXT, message.c_str(), message.size());
+    }
+}
+
+void broadcast_device_changes(server_state& state, const device_snapshot& previous, const device_snapshot& current, uint64_t generation)
+{
+    // Audio devices are identified by their hw id, serial ports by their name
+
+    auto find_audio_device = [](const device_snapshot& s, const std::string& hw_id) {
+        return std::find_if(s.devices.begin(), s.devices.end(), [&hw_id](const auto& d) { return d.first.hw_id == hw_id; }) != s.devices.end();
+    };
+
+    auto find_serial_port = [](const device_snapshot& s, const std::string& name) {
+        return std::find_if(s.ports.begin(), s.ports.end(), [&name](const auto& p) { return p.first.name == name; }) != s.ports.end();
+    };
+
+    for (const auto& [d, desc] : previous.devices)
+    {
+        if (!find_audio_device(current, d.hw_id))
+            broadcast_device_event(state, "audio_device_removed", d.hw_id, desc.hw_path, generation);
+    }
+
+    for (const auto& [d, desc] : current.devices)
+    {
+        if (!find_audio_device(previous, d.hw_id))
+            broadcast_device_event(state, "audio_device_added", d.hw_id, desc.hw_path, generation);
+    }
+
+    for (const auto& [p, desc] : previous.ports)
+    {
+        if (!find_serial_port(current, p.name))
+            broadcast_device_event(state, "serial_port_removed", p.name, desc.hw_path, generation);
+    }
+
+    for (const auto& [p, desc] : current.ports)
+    {
+        if (!find_serial_port(previous, p.name))
+            broadcast_device_event(state, "serial_port_added", p.name, desc.hw_path, generation);
+    }
+}
+
+// **************************************************************** //
+//                                                                  //
+// DAEMON                                                           //
+//                                                                  //
+// **************************************************************** //
+
+// A resident process started with --daemon, which keeps the device snapshot between runs
+// The command line connects to its Unix socket, and sends its arguments, its working directory, and its stdout and stderr
+// The daemon runs the command line with its output buffered, writes the output to the caller, and returns the exit code
+// Requests run one at a time, because the output redirection and the working directory are process wide
+
+int process_devices(const args& args);
+
+// Large enough for any command line
+const uint32_t max_daemon_request_size = 1024 * 1024;
+
+// How long the output of a request may wait for a caller which does not read it, ex: find_devices | sleep 60
+const int daemon_output_timeout_milliseconds = 1000;
+
+struct daemon_request
+{
+    std::string working_directory;
+    std::vector<std::string> arguments;
+    int stdout_fd = -1;
+    int stderr_fd = -1;
+};
+
+// A request which is not handled, ex: because the config file starts the HTTP server, runs in the calling process
+
+struct daemon_response
+{
+    int32_t handled = 0;
+    int32_t return_value = 1;
+};
+
+std::string get_daemon_socket(const args& args);
+bool try_get_daemon_socket_address(const std::string& path, sockaddr_un& address);
+bool can_run_in_daemon(const args& args);
+bool try_run_in_daemon(const args& args, int argc, char* argv[], int& return_value);
+int run_daemon(const args& args);
+int process_daemon_request(const daemon_request& request, std::shared_ptr<const device_snapshot>& devices, bool& handled);
+bool try_send_daemon_request(int fd, const std::string& body);
+bool try_receive_daemon_request(int fd, daemon_request& request);
+void append_daemon_string(std::string& body, std::string_view s);
+bool try_read_daemon_string(std::string_view body, size_t& position, std::string& s);
+bool try_send_all(int fd, const void* data, size_t size);
+bool try_receive_all(int fd, void* data, size_t size);
+bool try_write_daemon_output(int output_fd, int fd, int timeout_milliseconds);
+
+std::string get_daemon_socket(const args& args)
+{
+    if (!args.daemon_socket.empty())
+    {
+        return args.daemon_socket;
+    }
+
+    const char* runtime_directory = getenv("XDG_RUNTIME_DIR");
+    if (runtime_directory != nullptr && runtime_directory[0] != '\0')
+    {
+        return std::string(runtime_directory) + "/find_devices.sock";
+    }
+
+    return fmt::format("/tmp/find_devices-{}.sock", getuid());
+}
+
+bool try_get_daemon_socket_address(const std::string& path, sockaddr_un& address)
+{
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    return true;
+}
+
+bool can_run_in_daemon(const args& args)
+{
+    // These change the device backend of the process, or keep running
+
+    return !args.run_daemon && !args.run_server && args.shared_memory_name.empty() &&
+        args.test_data_file.empty() && args.record_file.empty() && args.replay_file.empty() && args.trace_file.empty();
+}
+
+bool try_run_in_daemon(const args& args, int argc, char* argv[], int& return_value)
+{
+    sockaddr_un address;
+    if (!try_get_daemon_socket_address(get_daemon_socket(args), address))
+    {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::path working_directory = std::filesystem::current_path(error);
+    if (error)
+    {
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    // No daemon is running if the socket does not exist or refuses the connection
+
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) == -1)
+    {
+        close(fd);
+        return false;
+    }
+
+    std::string body;
+    append_daemon_string(body, working_directory.string());
+    for (int i = 0; i < argc; i++)
+    {
+        append_daemon_string(body, argv[i]);
+    }
+
+    daemon_response response;
+
+    bool result = try_send_daemon_request(fd, body) && try_receive_all(fd, &response, sizeof(response));
+
+    close(fd);
+
+    if (!result || !response.handled)
+    {
+        return false;
+    }
+
+    return_value = response.return_value;
+
+    return true;
+}
+
+int run_daemon(const args& args)
+{
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    // A caller which exits before reading its output must not stop the daemon
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::string path = get_daemon_socket(args);
+
+    sockaddr_un address;
+    if (!try_get_daemon_socket_address(path, address))
+    {
+        if (!args.no_stdout)
+            print(!args.disable_colors, fg(fmt::color::red), "Socket path {} is too long\n", path);
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return 1;
+    }
+
+    // A socket left by a daemon which did not exit cleanly refuses connections, and is replaced
+
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) == 0)
+    {
+        if (!args.no_stdout)
+            print(!args.disable_colors, fg(fmt::color::red), "A daemon is already running on {}\n", path);
+        close(fd);
+        return 1;
+    }
+
+    unlink(path.c_str());
+
+    if (bind(fd, (const sockaddr*)&address, sizeof(address)) == -1 || chmod(path.c_str(), S_IRUSR | S_IWUSR) == -1 || listen(fd, 16) == -1)
+    {
+        if (!args.no_stdout)
+            print(!args.disable_colors, fg(fmt::color::red), "Failed to listen on {}\n", path);
+        close(fd);
+        return 1;
+    }
+
+    if (!args.no_stdout && args.verbose)
+    {
+        print(!args.disable_colors, fmt::emphasis::bold, "Daemon started on {}\n", path);
+        print(!args.disable_colors, fg(fmt::color::light_yellow) | fmt::emphasis::italic, "Use Ctrl+C to stop daemon\n");
+    }
+
+    std::shared_ptr<const device_snapshot> devices;
+
+    while (!interrupt_web_server)
+    {
+        pollfd listener = { fd, POLLIN, 0 };
+        if (poll(&listener, 1, 250) <= 0)
+        {
+            continue;
+        }
+
+        int client_fd = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_fd == -1)
+        {
+            continue;
+        }
+
+        // A client which stops sending its request cannot block the other requests,
+        // the output is written with its own timeout, see try_write_daemon_output
+
+        timeval timeout = { 1, 0 };
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        daemon_request request;
+
+        if (try_receive_daemon_request(client_fd, request))
+        {
+            bool handled = false;
+            daemon_response response;
+            response.return_value = process_daemon_request(request, devices, handled);
+            response.handled = handled ? 1 : 0;
+            try_send_all(client_fd, &response, sizeof(response));
+        }
+
+        if (request.stdout_fd != -1)
+            close(request.stdout_fd);
+        if (request.stderr_fd != -1)
+            close(request.stderr_fd);
+
+        close(client_fd);
+    }
+
+    close(fd);
+    unlink(path.c_str());
+
+    return 0;
+}
+
+int process_daemon_request(const daemon_request& request, std::shared_ptr<const device_snapshot>& devices, bool& handled)
+{
+    handled = false;
+
+    std::error_code error;
+    std::filesystem::current_path(request.working_directory, error);
+    if (error || request.arguments.empty())
+    {
+        return 1;
+    }
+
+    std::vector<char*> argv;
+    for (const std::string& argument : request.arguments)
+    {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    // The caller already printed the command line errors, help and version
+
+    struct args args;
+
+    if (!try_parse_command_line((int)request.arguments.size(), argv.data(), args) || args.command_line_has_errors || args.help || args.show_version)
+    {
+        return 1;
+    }
+
+    if (args.queries.size() > 0)
+    {
+        args.no_stdout = true;
+    }
+
+    read_settings(args);
+
+    if (!can_run_in_daemon(args))
+    {
+        return 1;
+    }
+
+    // The snapshot is enumerated again only after a hot-plug, the volume is always read from the devices
+
+    if (devices == nullptr || !is_device_snapshot_current(*devices))
+    {
+        devices = std::make_shared<const device_snapshot>(get_device_snapshot());
+    }
+
+    args.devices = devices;
+
+    // The output goes to memory files instead of the caller's stdout and stderr, which have no write timeout,
+    // a caller whose output is not read would otherwise block the daemon
+
+    int output_fds[2] = { memfd_create("find_devices_stdout", MFD_CLOEXEC), memfd_create("find_devices_stderr", MFD_CLOEXEC) };
+    if (output_fds[0] == -1 || output_fds[1] == -1)
+    {
+        if (output_fds[0] != -1)
+            close(output_fds[0]);
+        if (output_fds[1] != -1)
+            close(output_fds[1]);
+        return 1;
+    }
+
+    handled = true;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    int saved_stdout = dup(STDOUT_FILENO);
+    int saved_stderr = dup(STDERR_FILENO);
+
+    dup2(output_fds[0], STDOUT_FILENO);
+    dup2(output_fds[1], STDERR_FILENO);
+
+    int return_value = 1;
+
+    try
+    {
+        return_value = process_devices(args);
+    }
+    catch (const std::exception& e)
+    {
+        fmt::print(stderr, "{}\n", e.what());
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    dup2(saved_stdout, STDOUT_FILENO);
+    dup2(saved_stderr, STDERR_FILENO);
+
+    close(saved_stdout);
+    close(saved_stderr);
+
+    try_write_daemon_output(output_fds[0], request.stdout_fd, daemon_output_timeout_milliseconds);
+    try_write_daemon_output(output_fds[1], request.stderr_fd, daemon_output_timeout_milliseconds);
+
+    close(output_fds[0]);
+    close(output_fds[1]);
+
+    return return_value;
+}
+
+bool try_write_daemon_output(int output_fd, int fd, int timeout_milliseconds)
+{
+    // The caller's file is made non-blocking only while writing, it is shared with the caller, ex: a terminal
+    // The output which is not written before the timeout is dropped
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    off_t size = lseek(output_fd, 0, SEEK_END);
+    if (size <= 0)
+    {
+        return size == 0;
+    }
+
+    std::string output((size_t)size, '\0');
+    if (pread(output_fd, output.data(), output.size(), 0) != (ssize_t)output.size())
+    {
+        return false;
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_milliseconds);
+
+    bool result = true;
+    size_t written = 0;
+
+    while (written < output.size())
+    {
+        ssize_t count = write(fd, output.data() + written, output.size() - written);
+
+        if (count > 0)
+        {
+            written += (size_t)count;
+            continue;
+        }
+
+        if (count == -1 && errno == EINTR)
+        {
+            continue;
+        }
+
+        int remaining_milliseconds = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+
+        if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && remaining_milliseconds > 0)
+        {
+            pollfd output_poll = { fd, POLLOUT, 0 };
+            poll(&output_poll, 1, remaining_milliseconds);
+            continue;
+        }
+
+        result = false;
+        break;
+    }
+
+    fcntl(fd, F_SETFL, flags);
+
+    return result;
+}
+
+bool try_send_daemon_request(int fd, const std::string& body)
+{
+    // The size of the request is sent with the stdout and stderr of the caller
+
+    uint32_t size = (uint32_t)body.size();
+
+    iovec data = { &size, sizeof(size) };
+
+    int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    if (sendmsg(fd, &message, MSG_NOSIGNAL) != sizeof(size))
+    {
+        return false;
+    }
+
+    return try_send_all(fd, body.data(), body.size());
+}
+
+bool try_receive_daemon_request(int fd, daemon_request& request)
+{
+    uint32_t size = 0;
+
+    iovec data = { &size, sizeof(size) };
+
+    int fds[2] = { -1, -1 };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+
+    // The descriptors are kept even if the request is invalid, so that the caller closes them
+
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+    {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS && header->cmsg_len == CMSG_LEN(sizeof(fds)))
+        {
+            memcpy(fds, CMSG_DATA(header), sizeof(fds));
+            request.stdout_fd = fds[0];
+            request.stderr_fd = fds[1];
+        }
+    }
+
+    if (received != sizeof(size) || request.stdout_fd == -1 || request.stderr_fd == -1 || size > max_daemon_request_size)
+    {
+        return false;
+    }
+
+    std::string body(size, '\0');
+    if (!try_receive_all(fd, body.data(), body.size()))
+    {
+        return false;
+    }
+
+    size_t position = 0;
+    if (!try_read_daemon_string(body, position, request.working_directory))
+    {
+        return false;
+    }
+
+    while (position < body.size())
+    {
+        std::string argument;
+        if (!try_read_daemon_string(body, position, argument))
+        {
+            return false;
+        }
+        request.arguments.push_back(argument);
+    }
+
+    return true;
+}
+
+void append_daemon_string(std::string& body, std::string_view s)
+{
+    uint32_t size = (uint32_t)s.size();
+    body.append((const char*)&size, sizeof(size));
+    body.append(s);
+}
+
+bool try_read_daemon_string(std::string_view body, size_t& position, std::string& s)
+{
+    uint32_t size = 0;
+    if (body.size() - position < sizeof(size))
+    {
+        return false;
+    }
+
+    memcpy(&size, body.data() + position, sizeof(size));
+    position += sizeof(size);
+
+    if (body.size() - position < size)
+    {
+        return false;
+    }
+
+    s = std::string(body.substr(position, size));
+    position += size;
+
+    return true;
+}
+
+bool try_send_all(int fd, const void* data, size_t size)
+{
+    const char* p = (const char*)data;
+    while (size > 0)
+    {
+        ssize_t sent = send(fd, p, size, MSG_NOSIGNAL);
+        if (sent == -1 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        p += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool try_receive_all(int fd, void* data, size_t size)
+{
+    char* p = (char*)data;
+    while (size > 0)
+    {
+        ssize_t received = recv(fd, p, size, 0);
+        if (received == -1 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        p += received;
+        size -= received;
+    }
+    return true;
+}
+
+// **************************************************************** //
+//                                                                  //
+// PROFILES                                                         //
+//                                                                  //
+// **************************************************************** //
+
+// A config file can list named profiles, one per radio of a host, instead of a single search
+// Every profile is searched against the same device snapshot, and its volume is set like a single search
+// A device found by more than one profile is reported as a conflict, and its volume is not set
+
+std::vector<audio_device_unique_volume_set> adjust_volume(const args& args, const search_options& options, search_result& result);
+bool test_volume_control(const args& args, const search_options& options, const search_result& result);
+file_write_result print_to_file(const args& args, const std::string& json);
+void print_file_write_results(const args& args, const std::vector<file_write_result>& files);
+void print_adjust_volume_results(const args& args, const std::vector<audio_device_unique_volume_set>& audio_set_result);
+void print_stdout(const args& args, const search_result& result, enum included_devices included_devices);
+
+int process_profiles(const args& args);
+search_options get_profile_search_options(const args& args, const profile& p);
+std::vector<profile_result> search_profiles(const args& args, const device_snapshot& devices);
+std::vector<profile_conflict> find_profile_conflicts(const std::vector<profile_result>& results);
+void adjust_profiles_volume(const args& args, const std::vector<profile_conflict>& conflicts, std::vector<profile_result>& results);
+std::string to_json(const args& args, const std::vector<profile_result>& results, const std::vector<profile_conflict>& conflicts, const std::string& run_properties);
+void print_stdout(const args& args, const std::vector<profile_result>& results, const std::vector<profile_conflict>& conflicts);
+
+int process_profiles(const args& args)
+{
+    // The profiles are told apart by name, in the output and in the conflicts
+
+    std::set<std::string> names;
+    for (const auto& p : args.profiles)
+    {
+        if (!names.insert(p.name).second)
+        {
+            if (!args.no_stdout)
+                print(!args.disable_colors, fg(fmt::color::red), "Duplicate profile name \"{}\" in the configuration file\n", p.name);
+            return 1;
+        }
+    }
+
+    // The profiles replace the search and volume options of the command line,
+    // the warning goes to stderr so that it does not break the JSON output
+
+    std::set<std::string> ignored_names;
+    for (const auto& [name, value] : args.command_line_args)
+    {
+        if ((name.starts_with("audio.") || name.starts_with("port.")) && name != "audio.disable-volume-control")
+            ignored_names.insert(name);
+    }
+    std::string ignored_options;
+    for (const auto& name : ignored_names)
+    {
+        ignored_options += (ignored_options.empty() ? "--" : ", --") + name;
+    }
+    if (!ignored_options.empty() && !args.no_stdout)
+    {
+        fmt::print(stderr, "Ignoring {}, the profiles of the configuration file set their own search\n", ignored_options);
+    }
+
+    for (const auto& p : args.profiles)
+    {
+        compiled_audio_device_filter audio_filter;
+        compiled_serial_port_filter port_filter;
+
+        if (!try_compile_filter(p.audio_filter, audio_filter) || !try_compile_filter(p.port_filter, port_filter))
+        {
+            if (!args.no_stdout)
+                print(!args.disable_colors, fg(fmt::color::red), "Invalid search filter in profile \"{}\", a regular expression cannot be parsed\n", p.name);
+            return 1;
+        }
+    }
+
+    // The daemon keeps its snapshot, otherwise the devices are enumerated once for all the profiles
+
+    std::shared_ptr<const device_snapshot> devices = args.devices;
+    if (devices == nullptr)
+    {
+        scoped_timing timing(args, "snapshot");
+        devices = std::make_shared<const device_snapshot>(get_device_snapshot(args));
+    }
+
+    std::vector<profile_result> results = search_profiles(args, *devices);
+
+    std::vector<profile_conflict> conflicts = find_profile_conflicts(results);
+
+    adjust_profiles_volume(args, conflicts, results);
+
+    // Like a single search, the file content does not include the file write results or the timings
+
+    std::vector<file_write_result> files;
+
+    file_write_result output_file_result = print_to_file(args, to_json(args, results, conflicts, {}));
+    if (!output_file_result.path.empty())
+        files.push_back(output_file_result);
+
+    if (args.use_json && !args.no_stdout)
+    {
+        printf("%s\n", to_json(args, results, conflicts, to_json(args, files)).c_str());
+    }
+    else
+    {
+        print_stdout(args, results, conflicts);
+    }
+
+    print_file_write_results(args, files);
+
+    if (args.timings != nullptr)
+    {
+        args.timings->enabled = false;
+    }
+
+    if (args.print_stats)
+    {
+        fmt::print(stderr, "{}", to_metrics_text());
+    }
+
+    int return_value = conflicts.empty() ? 0 : 1;
+
+    for (const auto& r : results)
+    {
+        size_t count = 0;
+        if (r.included_devices == included_devices::all || r.included_devices == included_devices::audio)
+            count += r.result.devices.size();
+        if (r.included_devices == included_devices::all || r.included_devices == included_devices::ports)
+            count += r.result.ports.size();
+
+        if (!r.volume_test_result || count == 0)
+        {
+            return_value = 1;
+        }
+    }
+
+    return return_value;
+}
+
+search_options get_profile_search_options(const args& args, const profile& p)
+{
+    search_options options = args;
+    options.audio_filter = p.audio_filter;
+    options.port_filter = p.port_filter;
+    options.volume_set = p.volume_set;
+    options.search_mode = p.search_mode;
+    return options;
+}
+
+std::vector<profile_result> search_profiles(const args& args, const device_snapshot& devices)
+{
+    // The searches only read the snapshot and the mixers, so the profiles are searched concurrently
+
+    std::vector<profile_result> results(args.profiles.size());
+
+    parallel_for(args.profiles.size(), [&](size_t i) {
+        const profile& p = args.profiles[i];
+        scoped_timing timing(args, "profile", p.name);
+        search_options options = get_profile_search_options(args, p);
+        results[i].name = p.name;
+        results[i].included_devices = p.included_devices;
+        results[i].result = search(options, devices);
+        sort(options, results[i].result);
+    });
+
+    return results;
+}
+
+std::vector<profile_conflict> find_profile_conflicts(const std::vector<profile_result>& results)
+{
+    // A profile only claims the device types it includes, the conflicts are ordered by id
+
+    std::map<std::string, std::vector<std::string>> claims;
+
+    for (const auto& r : results)
+    {
+        if (r.included_devices == included_devices::all || r.included_devices == included_devices::audio)
+        {
+            for (const auto& d : r.result.devices)
+            {
+                std::vector<std::string>& profiles = claims[fmt::format("hw:{}", d.first.audio_device.card_id)];
+                if (profiles.empty() || profiles.back() != r.name)
+                    profiles.push_back(r.name);
+            }
+        }
+        if (r.included_devices == included_devices::all || r.included_devices == included_devices::ports)
+        {
+            for (const auto& p : r.result.ports)
+                claims[p.first.name].push_back(r.name);
+        }
+    }
+
+    std::vector<profile_conflict> conflicts;
+    for (auto& [id, profiles] : claims)
+    {
+        if (profiles.size() > 1)
+            conflicts.push_back(profile_conflict{ id, std::move(profiles) });
+    }
+    return conflicts;
+}
+
+void adjust_profiles_volume(const args& args, const std::vector<profile_conflict>& conflicts, std::vector<profile_result>& results)
+{
+    // The volumes are set one profile at a time, in the order of the config file,
+    // the cards claimed by more than one profile are left as they are
+
+    std::set<std::string> conflicted_cards;
+    for (const auto& c : conflicts)
+        conflicted_cards.insert(c.id);
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        search_result claimed;
+        for (const auto& d : results[i].result.devices)
+        {
+            if (!conflicted_cards.contains(fmt::format("hw:{}", d.first.audio_device.card_id)))
+                claimed.devices.push_back(d);
+        }
+
+        search_options options = get_profile_search_options(args, args.profiles[i]);
+        results[i].volume_sets = adjust_volume(args, options, claimed);
+        results[i].volume_test_result = test_volume_control(args, options, claimed);
+
+        // The volumes read back after the sets replace the ones of the search
+
+        for (auto& d : results[i].result.devices)
+        {
+            auto it = std::find_if(claimed.devices.begin(), claimed.devices.end(), [&d](const auto& c) { return c.first.audio_device.hw_id == d.first.audio_device.hw_id; });
+            if (it != claimed.devices.end())
+                d.first = it->first;
+        }
+    }
+}
+
+std::string to_json(const args& args, const std::vector<profile_result>& results, const std::vector<profile_conflict>& conflicts, const std::string& run_properties)
+{
+    scoped_metrics_timer timer(get_metrics_histogram("find_devices_json_render_duration_seconds"));
+
+    std::string s;
+    s += "{\n";
+    s += "    \"profiles\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        s += "        {\n";
+        s += "            \"name\": \"" + results[i].name + "\",\n";
+        s += to_json(results[i].result, results[i].volume_sets, 3);
+        if (args.test_volume_control)
+        {
+            s += ",\n";
+            s += "            \"volume_control_test_result\": ";
+            if (results[i].volume_test_result)
+                s += "\"success\"";
+            else
+                s += "\"failure\"";
+        }
+        s += "\n";
+        s += "        }";
+        if ((i + 1) < results.size())
+        {
+            s.append(",");
+        }
+        s.append("\n");
+    }
+    s += "    ],\n";
+    s += "    \"conflicts\": [\n";
+    for (size_t i = 0; i < conflicts.size(); i++)
+    {
+        s += "        {\n";
+        s += "            \"id\": \"" + conflicts[i].id + "\",\n";
+        s += "            \"profiles\": [";
+        for (size_t j = 0; j < conflicts[i].profiles.size(); j++)
+        {
+            s += "\"" + conflicts[i].profiles[j] + "\"";
+            if ((j + 1) < conflicts[i].profiles.size())
+                s += ", ";
+        }
+        s += "]\n";
+        s += "        }";
+        if ((i + 1) < conflicts.size())
+        {
+            s.append(",");
+        }
+        s.append("\n");
+    }
+    s += "    ]";
+
+    if (!run_properties.empty())
+    {
+        s += ",\n";
+        s += run_properties;
+    }
+
+    if (!args.ignore_config)
+    {
+        s += ",\n";
+        std::string config_file = std::filesystem::absolute(args.config_file).string();
+        s += "    \"config_file\": \"" + config_file + "\"\n";
+    }
+    else
+    {
+        s += "\n";
+    }
+
+    s += "}";
+
+    return s;
+}
+
+void print_stdout(const args& args, const std::vector<profile_result>& results, const std::vector<profile_conflict>& conflicts)
+{
+    if (args.no_stdout)
+    {
+        return;
+    }
+
+    // Without verbose output every line is prefixed by the profile name, so that scripts can split them
+
+    for (const auto& r : results)
+    {
+        if (!args.verbose)
+        {
+            if (r.included_devices == included_devices::all || r.included_devices == included_devices::audio)
+            {
+                for (const auto& d : r.result.devices)
+                    printf("%s %s\n", r.name.c_str(), d.first.audio_device.plughw_id.c_str());
+            }
+            if (r.included_devices == included_devices::all || r.included_devices == included_devices::ports)
+            {
+                for (const auto& p : r.result.ports)
+                    printf("%s %s\n", r.name.c_str(), p.first.name.c_str());
+            }
+            continue;
+        }
+
+        print(!args.disable_colors, fmt::emphasis::bold, "\nProfile: ");
+        print(!args.disable_colors, fmt::emphasis::bold | fg(fmt::color::chartreuse), "{}\n", r.name);
+        print_stdout(args, r.result, r.included_devices);
+        print_adjust_volume_results(args, r.volume_sets);
+    }
+
+    for (const auto& c : conflicts)
+    {
+        std::string profiles;
+        for (size_t i = 0; i < c.profiles.size(); i++)
+        {
+            profiles += (i > 0 ? ", " : "") + c.profiles[i];
+        }
+
+        if (!args.verbose)
+            fmt::print(stderr, "Device {} is claimed by profiles {}\n", c.id, profiles);
+        else
+            print(!args.disable_colors, fg(fmt::color::red), "Device {} is claimed by profiles {}\n", c.id, profiles);
+    }
+
+    if (args.verbose && conflicts.size() > 0)
+    {
+        fmt::println("");
+    }
+}
+
+// **************************************************************** //
+//                                                                  //
+// MAIN AND HIGH LEVEL FUNCTIONS                                    //
+//                                                                  //
+// **************************************************************** //
+
+void print_usage();
+void print_stdout(const args& args, const search_result& result);
+void print_stdout(const args& args, const search_result& result, enum included_devices included_devices);
+bool output_uses_descriptions(const args& args);
+file_write_result print_to_file(const args& args, const std::string& json);
+bool try_write_file_if_changed(const std::string& path, const std::string& content, file_write_result& result);
+void print_file_write_results(const args& args, const std::vector<file_write_result>& files);
+std::vector<audio_device_unique_volume_set> adjust_volume(const args& args, search_result& result);
+std::vector<audio_device_unique_volume_set> adjust_volume(const args& args, const search_options& options, search_result& result);
+bool test_volume_control(const args& args, const search_result& result);
+bool test_volume_control(const args& args, const search_options& options, const search_result& result);
+void print_adjust_volume_results(const args& args, const std::vector<audio_device_unique_volume_set>& audio_set_result);
+std::string print(const args& args, const search_result& result, bool volume_control_return_value, const std::vector<audio_device_unique_volume_set>& audio_set_result);
+std::string print(const args& args, const search_result& result, bool volume_control_return_value, const std::vector<audio_device_unique_volume_set>& audio_set_result, const file_write_result& direwolf_file_result);
+int process_devices(const args& args);
+int process_profiles(const args& args);
+void print_version();
+bool generate_direwolf_output_file(const args& args, const search_result& result, file_write_result& file_result);
+
+void print_usage()
+{
+    std::string usage =
+        "find_devices - audio device and serial ports finding utility\n"
+        "version "
+        STRINGIFY(FIND_DEVICES_VERSION)
+#ifdef GIT_HASH        
+        " "
+        STRINGIFY(GIT_HASH)
+#endif        
+        "\n"
+        "(C) 2023 Ion Todirel\n"
+        "\n"
+        "Usage:\n"
+        "    find_devices [OPTION]... \n"
+        "\n"
+        "Options:\n"
+        "    --audio.name <name>               search filter: partial or complete name of the audio device\n"
+        "    --audio.stream-name <name>        search filter: partial or complete name of the audio stream name\n"
+        "    --audio.desc <description>        search filter: partial or complete description of the audio device\n"
+        "    --audio.type <type>               search filter: types of audio devices to find: playback, capture, playback|capture, playback&capture:\n"
+        "                                          playback - playback only\n"
+        "                                          capture - capture only\n"
+        "                                          \"playback|capture\" - playback or capture\n"
+        "                                          \"playback&capture\" - playback and capture\n"
+        "                                          all\n"
+        "    --audio.bus <number>              search filter: audio device bus number\n"
+        "    --audio.device <number>           search filter: audio device number\n"
+        "    --audio.path <path>               search filter: audio device hardware system path\n"
+        "    --audio.topology <number>         search filter: the depth of the audio device topology, in the device tree\n"
+        "    --audio.control <name>            used to set a value on the audio device; this property is used to select the audio control to set\n"
+        "    --audio.channels <channels>       used to set a value on the audio device; this property is used to select the audio channels to set\n"
+        "    --audio.volume <volume>           used to set a value on the audio device; this property is used to set the audio volume\n"
+        "                                      on all devices that match --audio.control, --audio.channels and --audio.channel-type.\n"
+        "    --audio.channel-type <type>       used to set a value on the audio device; this property is used to select the channel type\n"
+        "                                          playback - playback only\n"
+        "                                          capture - capture only\n"
+        "                                          all\n"
+        "    --audio.disable-volume-control    disable setting the audio device volume\n"
+        "    --port.name <name>                search filter: partial or complete name of the serial port\n"
+        "    --port.desc <description>         search filter: partial or complete description of the serial port\n"
+        "    --port.bus <number>               search filter: serial port bus number\n"
+        "    --port.device <number>            search filter: serial port device number\n"
+        "    --port.topology <number>          search filter: the depth of the serial port device topology, in the device tree\n"
+        "    --port.path <path>                search filter: serial port hardware system path\n"
+        "    --port.serial <serial>            search filter: partial or complete serial port device serial number\n"
+        "    --port.mfn <name>                 search filter: partial or complete serial port manufacturer name\n"
+        "                                      the name, description, serial and manufacturer filters are case insensitive,\n"
+        "                                      prefix a filter with glob: to match the whole value with * and ?, ex: \"glob:USB*Audio\"\n"
+        "                                      or with regex: to search with a regular expression, ex: \"regex:^USB Audio.*\"\n"
+        "    -v, --verbose                     enable detailed printing to stdout\n"
+        "    --no-verbose                      disable detailed printing to stdout\n"
+        "    --no-stdout                       don't print to stdout\n"
+        "    --no-volume-control               disable setting the audio device volume\n"
+        "    --probe-volume-control            tests volume control from 0 to 100 and lists all valid volume levels\n"
+        "    --test-volume-control             verifies whether the audio devices matching the serarch criteria\n"
+        "                                      match the specification given in the volume control\n"
+        "                                      if the volume control do not match, the exit code is 1\n"
+        "    -h, --help                        print help\n"
+        "    -v, --version                     prints the version of this program\n"
+        "    -p, --list-properties             print detailed properties for each device and serial port\n"
+        "    -i, --included-devices <type>     type of devices to include in searches and in stdout or JSON:\n"
+        "                                          audio - include audio devices\n"
+        "                                          ports - include serial ports\n"
+        "                                          all - include audio devices and serial ports\n"
+        "    -s, --search-mode <mode>          how to conduct the search: \n"
+        "                                          independent - look for audio devices and serial ports independently\n"
+        "                                          audio-siblings - look for audio devices and find their sibling serial ports\n"
+        "                                          port-siblings - look for serial ports and find their sibling audio devices\n"
+        "    --output-file <file>              write results as JSON to a file\n"
+        "    --json                            display JSON to stdout\n"
+        "    --ignore-config                   ignore the configuration file, if a configurtion file is available or specified\n"
+        "    -c, --config-file <file>          use a configuration file to configure the program\n"
+        "                                      settings specified as command line args override settings present in the config file\n"
+        "                                      if not specified default config file name used is \"config.json\"\n"
+        "    --disable-colors                  do not print colors in stdout\n"
+        "    --disable-file-write              disables writing a JSON file with the results of the search, which is the defaul\n"
+        "    --test-data <file>                use the sound cards, mixer controls and serial ports described in a JSON file\n"
+        "                                      instead of the system devices, for testing purposes, see examples/test_data.json\n"
+        "    --record <file>                   record the results and the latency of every sound card, mixer, udev and serial port call\n"
+        "    --replay <file>                   answer the sound card, mixer, udev and serial port calls from a recording instead of the system\n"
+        "    --replay-time-scale <scale>       used with --replay, multiplies the recorded latencies, 0 replays without waiting, default 1\n"
+        "    -t, --test-devices                not yet implemented: test each device hardware that we find\n"
+        "                                      if hardware test fails, removes it from the search results list\n"
+        "    --direwolf-config <file>          generate a direwolf configuration file\n"
+        "    --direwolf.agwport <port>         the AGW port in the direwolf configuration\n"
+        "    --direwolf.kissport <port>        the KISS port in the direwolf configuration\n"
+        "    --direwolf.callsign <port>        the callsign in the direwolf configuration, NOCALL if not specified\n"
+        "    --run-server                      if specified runs an HTTP server which web clients can use to query and control devices\n"
+        "    --server-port <port>              the HTTP server port number used for listening to inbound connections\n"
+        "    --shared-memory <name>            used with --run-server, publish the search results as JSON into a POSIX shared memory segment\n"
+        "                                      refreshed every second, local readers use try_read_shared_snapshot from find_devices.hpp\n"
+        "    --cache-file <file>               cache the enumerated devices in a file, and reuse them while no devices are added or removed\n"
+        "                                      the volume of the audio devices is always read from the devices\n"
+        "    --workers <count>                 the number of threads enumerating the sound cards and loading their mixers, default 4, at most 64\n"
+        "                                      1 enumerates the cards one after the other\n"
+        "    --daemon                          run resident, and keep the enumerated devices until devices are added or removed\n"
+        "                                      the command line runs in the daemon when it is running, with the same output\n"
+        "    --daemon-socket <file>            the Unix socket of the daemon, default $XDG_RUNTIME_DIR/find_devices.sock\n"
+        "    --no-daemon                       run in this process even if a daemon is running\n"
+        "    --trace <file>                    write a Chrome trace event file with a span for every hardware access and server request\n"
+        "                                      open it in chrome://tracing or https://ui.perfetto.dev\n"
+        "    --timings                         add the duration of every phase, and of the per device steps, to the JSON output\n"
+        "    --stats                           print the operation counters and latency histograms to stderr when done\n"
+        "    -q, --query <queries>             print values extracted from the search results instead of the regular output\n"
+        "                                      multiple queries are separated by ';', each query can be prefixed by NAME=\n"
+        "                                      to print a shell variable assignment, ex: \"COUNT=.audio_devices | length\"\n"
+        "                                          paths: .audio_devices[0].plughw_id, .serial_ports[-1].name, .audio_devices[].hw_id\n"
+        "                                          filters: .serial_ports[description~cp210], .audio_devices[hw_id=hw:1,0]\n"
+        "                                          functions: length, first, last\n"
+        "                                          comparisons: ==, !=, <, <=, >, >=\n"
+        "\n"
+        "Return:\n"
+        "    0 - success, audio devices or serial ports are found matching the search criteria\n"
+        "    1 - if the command line arguments are incorrect, or if called with --help\n"
+        "    1 - if no devices are found, or no devices are matching the search criteria\n"
+        "    1 - if a query cannot be evaluated, or a query comparison evaluates to false\n"
+        "\n"
+        "Examples:\n"
+        "    find_devices --audio.name \"USB Audio\" --audio.desc \"Texas Instruments\" --no-verbose\n"
+        "    find_devices --audio.desc \"C-Media Electronics Inc.\" -s audio-siblings -i all\n"
+        "    find_devices --audio.desc \"C-Media\" --port.desc \"CP2102N\" -s port-siblings -i all \n"
+        "    find_devices --audio.bus=2 --audio.device=48 -s audio-siblings -i audio \n"
+        "    find_devices --audio.type \"playback&capture\"\n"
+        "    find_devices --audio.name \"regex:^USB Audio\" --port.desc \"glob:CP210?*\"\n"
+        "    find_devices -h\n"
+        "    find_devices -j -o output.json\n"
+        "    find_devices -c digirig_config.json\n"
+        "    find_devices --audio.control Speakers --audio.channels=\"Front Left, Front Center\" --audio.volume 60 --audio.channel-type=capture\n"
+        "    find_devices --audio.control Speakers --audio.channels=\"Front Left\" --audio.volume 80 --audio.channel-type=playback\n"
+        "    find_devices --audio.volume 50 --audio.channel-type=playback\n"
+        "    find_devices --audio.control Speakers --audio.channels=\"Front Left, Front Center\" --audio.volume 50\n"
+        "    find_devices -q \".audio_devices[0].plughw_id; .serial_ports[0].name\"\n"
+        "    find_devices --cache-file ~/.cache/find_devices.snapshot -q \".audio_devices[0].plughw_id\"\n"
+        "    find_devices --daemon --no-verbose &\n"
+        "    find_devices -q \"AUDIO_DEVICE=.audio_devices[0].plughw_id; COUNT=.audio_devices | length == 1\"\n"
+        "\n"
+        "Defaults:\n"
+        "    --verbose\n"
+        "    --audio.type all\n"
+        "    -i all\n"
+        "    -s independent\n"
+        "\n";
+    printf("%s", usage.c_str());
+}
+
+bool output_uses_descriptions(const args& args)
+{
+    // The descriptions are in the JSON output, the listed properties, and can be queried
+
+    return args.use_json || !args.output_file.empty() || args.list_properties || !args.queries.empty();
+}
+
+void print_stdout(const args& args, const search_result& result)
+{
+    print_stdout(args, result, args.included_devices);
+}
+
+void print_stdout(const args& args, const search_result& result, enum included_devices included_devices)
+{
+    if (args.no_stdout)
+    {
+        return;
+    }
+
+    if (included_devices == included_devices::all || included_devices == included_devices::audio)
+    {
+        if (args.verbose)
+        {
+            print(!args.disable_colors, fmt::emphasis::bold, "\nFound audio devices:\n\n");
+        }
+
+        // Current formatting settings support audio device count of up to 999
+        // and up to 999 serial ports before breaking formatting
+
+        size_t i = 1;
+        for (const auto& d : result.devices)
+        {
+            if (!args.verbose)
+                printf("%s\n", d.first.audio_device.plughw_id.c_str());
+            else
+            {
+                print(!args.disable_colors, fmt::emphasis::bold, "{:>4})", i);
+                print(!args.disable_colors, fmt::emphasis::bold | fg(fmt::color::chartreuse), " {}", d.first.audio_device.hw_id);
+                fmt::print(": ");
+                print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::cornflower_blue), "{}", d.first.audio_device.name);
+                fmt::print(" - ");
+                print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::chocolate), "{}", d.first.audio_device.description);
+                fmt::println("");
+
+                if (args.list_properties)
+                {
+                    fmt::println("");
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "hwid");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.first.audio_device.hw_id);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "plughwid");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.first.audio_device.plughw_id);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "name");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.first.audio_device.name);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "description");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.first.audio_device.description);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "stream name");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.first.audio_device.stream_name);
+
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "volume controls");
+                    for (size_t k = 0; k < d.first.controls.size(); k++)
+                    {
+                        for (size_t m = 0; m < d.first.controls[k].channels.size(); m++)
+                        {
+                            print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}%", d.first.controls[k].channels[m].volume_percent);
+                            if ((m + 1) < d.first.controls[k].channels.size())
+                                print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), ", ");
+                        }
+                        if ((k + 1) < d.first.controls.size())
+                            print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), ", ");
+                    }
+                    fmt::print("\n");
+
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "bus");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.second.bus_number);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "device");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.second.device_number);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "product");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.second.product);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "idProduct");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.second.id_product);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "idVendor");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.second.id_vendor);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "path");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.second.path);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "hardware path");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.second.hw_path);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "depth");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", d.second.topology_depth);
+                    if (i < result.devices.size())
+                        fmt::println("");
+                }
+            }
+            i++;
+        }
+    }
+
+    if (included_devices == included_devices::all || included_devices == included_devices::ports)
+    {
+        if (args.verbose)
+        {
+            print(!args.disable_colors, fmt::emphasis::bold, "\nFound serial ports:\n\n");
+        }
+
+        size_t j = 1;
+        for (const auto& p : result.ports)
+        {
+            if (!args.verbose)
+                printf("%s\n", p.first.name.c_str());
+            else
+            {
+                print(!args.disable_colors, fmt::emphasis::bold, "{:>4})", j);
+                print(!args.disable_colors, fmt::emphasis::bold | fg(fmt::color::chartreuse), " {}", p.first.name);
+                fmt::print(": ");
+                print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::cornflower_blue), "{}", p.first.manufacturer);
+                fmt::print(" - ");
+                print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::chocolate), "{}", p.first.description);
+                fmt::println("");
+
+                if (args.list_properties)
+                {
+                    fmt::println("");
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "name");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.first.name);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "manufacturer");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.first.manufacturer);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "description");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.first.description);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "sn");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.first.device_serial_number);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "bus");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.bus_number);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "device");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.device_number);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "major");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.major_number);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "minor");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.minor_number);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "product");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.product);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "idProduct");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.id_product);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "idVendor");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.id_vendor);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "path");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.path);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "hardware path");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.hw_path);
+                    print(!args.disable_colors, fmt::emphasis::bold | fmt::emphasis::italic | fg(fmt::color::rosy_brown), "{:>20}: ", "depth");
+                    print(!args.disable_colors, fmt::emphasis::italic | fg(fmt::color::gray), "{}\n", p.second.topology_depth);
+                    if (j < result.ports.size())
+                        fmt::println("");
+                }
+            }
+            j++;
+        }
+    }
+
+    printf("\n");
+}
+
+file_write_result print_to_file(const args& args, const std::string& json)
+{
+    file_write_result file_result;
+
+    if (args.disable_write_file)
+    {
+        return file_result;
+    }
+
+    std::string file_name = args.output_file;
+
+    if (args.output_file.empty())
+    {
+        try_find_new_filename(std::filesystem::current_path() / "output.json", file_name);
+    }
+
+    file_result.description = "output_file";
+
+    try_write_file_if_changed(file_name, json + "\n", file_result);
+
+    return file_result;
+}
+
+bool try_write_file_if_changed(const std::string& path, const std::string& content, file_write_result& result)
+{
+    result.path = path;
+    result.changed = false;
+    result.success = false;
+
+    // Skip writing files which already have the same content,
+    // to avoid triggering file watchers when nothing has changed
+
+    std::string existing_content;
+    if (try_read_file(path, existing_content) && existing_content == content)
+    {
+        result.success = true;
+        return true;
+    }
+
+    if (!try_write_file_atomically(path, content))
+    {
+        return false;
+    }
+
+    result.changed = true;
+    result.success = true;
+
+    return true;
+}
+
+void print_file_write_results(const args& args, const std::vector<file_write_result>& files)
+{
+    if (!args.verbose || args.use_json || args.no_stdout)
+    {
+        return;
+    }
+
+    for (const auto& file : files)
+    {
+        if (file.path.empty())
+        {
+            continue;
+        }
+
+        if (file.description == "direwolf_config")
+        {
+            if (!file.success)
+                print(!args.disable_colors, fmt::emphasis::bold, "Failed to write Direwolf configuration file: ");
+            else if (file.changed)
+                print(!args.disable_colors, fmt::emphasis::bold, "Created Direwolf configuration file: ");
+            else
+                print(!args.disable_colors, fmt::emphasis::bold, "Direwolf configuration file unchanged: ");
+        }
+        else
+        {
+            if (!file.success)
+                print(!args.disable_colors, fmt::emphasis::bold, "Failed to write to file: ");
+            else if (file.changed)
+                print(!args.disable_colors, fmt::emphasis::bold, "Wrote to file: ");
+            else
+                print(!args.disable_colors, fmt::emphasis::bold, "File unchanged: ");
+        }
+
+        print(!args.disable_colors, fg(fmt::color::red), "{}\n\n", file.path);
+    }
+}
+
+std::vector<audio_device_unique_volume_set> adjust_volume(const args& args, search_result& result)
+{
+    return adjust_volume(args, args, result);
+}
+
+std::vector<audio_device_unique_volume_set> adjust_volume(const args& args, const search_options& options, search_result& result)
+{
+    if (args.disable_volume_control)
+    {
+        return {};
+    }
+
+    return apply_volume_sets(options, result, args.test_volume_control);
+}
+
+bool test_volume_control(const args& args, const search_result& result)
+{
+    return test_volume_control(args, args, result);
+}
+
+bool test_volume_control(const args& args, const search_options& options, const search_result& result)
+{
+    if (!args.test_volume_control)
+    {
+        return true;
+    }
+
+    return verify_volume_sets(options, result);
+}
+
+void print_adjust_volume_results(const args& args, const std::vector<audio_device_unique_volume_set>& audio_set_result)
+{
+    if (audio_set_result.size() == 0)
+    {
+        return;
+    }
+
+    if (!args.verbose || args.use_json || args.no_stdout)
+    {
+        return;
+    }
+
+    print(!args.disable_colors, fmt::emphasis::bold, "Volume control:\n\n");
+
+    for (auto& audio_set : audio_set_result)
+    {
+        audio_device_channel updated_channel;   
+        if (try_get_audio_device_channel(audio_set.volume.audio_device, audio_set.control.name, audio_set.channel.id, audio_set.channel.type, updated_channel))
+        {
+            double percentage_error_double = updated_channel.volume_percent - audio_set.volume_set.volume;
+            int percentage_error = (int)std::rint(percentage_error_double);
+            std::string percentage_error_str = std::to_string(percentage_error);
+            if (percentage_error > 0)
+            {
+                percentage_error_str = "+" + percentage_error_str;
+            }
+            print(!args.disable_colors, fmt::emphasis::bold, "    Volume set to \"{}%\" (actual: {}%) with {}% error on device \"{}\" for control name \"{}\" and {} channel \"{}\"\n", audio_set.volume_set.volume, updated_channel.volume_percent, percentage_error_str, audio_set.volume.audio_device.hw_id, audio_set.control.name, to_string(audio_set.channel.type), audio_set.channel.name);
+        }
+    }
+
+    printf("\n");
+}
+
+std::vector<audio_device_volume_probe> probe_volume_control(const args& args, const search_result& result)
+{
+    std::vector<audio_device_volume_probe> probe_result;
+
+    if (!args.probe_volume_control)
+    {
+        return {};
+    }
+
+    for (const auto& device : result.devices)
+    {
+        for (const auto& control : device.first.controls)
+        {
+            for (auto channel : control.channels)
+            {
+                int initial_volume_value = channel.volume_percent;
+
+                for (int i = 0; i <= 100; i++)
+                {
+                    channel.volume_percent = i;
+
+                    try_set_audio_device_volume_percent(device.first.audio_device, control, channel);
+                    try_get_audio_device_channel(device.first.audio_device, control.name, channel.id, channel.type, channel);
+
+                    audio_device_volume_probe probe;
+                    probe.set_volume = i;
+                    probe.retrieved_volume = channel.volume_percent;
+                    probe.unique_channel_id = create_unique_channel_id(device.first.audio_device, control, channel);
+
+                    probe_result.push_back(probe);
+                }
+
+                channel.volume_percent = initial_volume_value;
+                try_set_audio_device_volume_percent(device.first.audio_device, control, channel);
+            }
+        }
+    }
+
+    return probe_result;
+}
+
+std::string print(const args& args, const search_result& result, bool volume_control_return_value, const std::vector<audio_device_unique_volume_set>& audio_set_result)
+{
+    return print(args, result, volume_control_return_value, audio_set_result, file_write_result{});
+}
+
+std::string print(const args& args, const search_result& result, bool volume_control_return_value, const std::vector<audio_device_unique_volume_set>& audio_set_result, const file_write_result& direwolf_file_result)
+{
+    std::string config_file = std::filesystem::absolute(args.config_file).string();
+
+    if (!args.no_stdout && !args.use_json && args.verbose && !args.ignore_config)
+    {
+        print(!args.disable_colors, fmt::emphasis::bold, "Using configuration file: ");
+        print(!args.disable_colors, fg(fmt::color::red), "{}\n", config_file);
+    }
+
+    // The file content does not include the file write results or the timings,
+    // otherwise the content would be different on every run
+
+    std::string json_output = to_json(args, result, audio_set_result, volume_control_return_value);
+
+    std::vector<file_write_result> files;
+
+    file_write_result output_file_result = print_to_file(args, json_output);
+    if (!output_file_result.path.empty())
+        files.push_back(output_file_result);
+    if (!direwolf_file_result.path.empty())
+        files.push_back(direwolf_file_result);
+
+    if (files.size() > 0 || (args.timings != nullptr && args.timings->enabled))
+    {
+        json_output = to_json(args, result, audio_set_result, volume_control_return_value, [&]() { return to_json(args, files); });
+    }
+
+    if (args.use_json && !args.no_stdout)
+    {
+        printf("%s\n", json_output.c_str());
+    }
+    else
+    {
+        print_stdout(args, result);
+    }
+
+    print_adjust_volume_results(args, audio_set_result);
+
+    print_file_write_results(args, files);
+
+    return json_output;
+}
+
+int process_devices(const args& args)
+{
+    // The worker count of the config file is only known here, the command line was checked when parsed
+
+    if (!is_valid_worker_count(args.worker_count))
+    {
+        if (!args.no_stdout)
+            print(!args.disable_colors, fg(fmt::color::red), "Invalid worker count {}, the count must be between 1 and {}\n", args.worker_count, max_worker_count);
+        return 1;
+    }
+
+    // The worker threads are restarted only when the count changes
+
+    if ((size_t)args.worker_count != get_worker_count())
+    {
+        set_worker_count(args.worker_count);
+    }
+
+    // The profiles of the config file replace the single search, the server only runs the single search
+
+    if (args.profiles.size() > 0 && !args.run_server)
+    {
+        return process_profiles(args);
+    }
+
+    // The search compiles the same filters, an invalid regular expression would only match nothing
+
+    compiled_audio_device_filter audio_filter;
+    compiled_serial_port_filter port_filter;
+
+    if (!try_compile_filter(args.audio_filter, audio_filter) || !try_compile_filter(args.port_filter, port_filter))
+    {
+        if (!args.no_stdout)
+            print(!args.disable_colors, fg(fmt::color::red), "Invalid search filter, a regular expression cannot be parsed\n");
+        return 1;
+    }
+
+    search_result result;
+    {
+        scoped_timing timing(args, "search");
+        result = args.devices != nullptr ? search(args, *args.devices) : search(args);
+    }
+
+    {
+        scoped_timing timing(args, "sort");
+        sort(args, result);
+    }
+
+    std::vector<audio_device_volume_probe> probe_results;
+    {
+        scoped_timing timing(args, "probe");
+        probe_results = probe_volume_control(args, result);
+    }
+
+    std::vector<audio_device_unique_volume_set> adjust_volume_results;
+    {
+        scoped_timing timing(args, "adjust");
+        adjust_volume_results = adjust_volume(args, result);
+    }
+
+    bool volume_test_return_value = false;
+    {
+        scoped_timing timing(args, "test");
+        volume_test_return_value = test_volume_control(args, result);
+    }
+
+    file_write_result direwolf_file_result;
+
+    bool generate_direwolf_result = false;
+    {
+        scoped_timing timing(args, "direwolf");
+        generate_direwolf_result = generate_direwolf_output_file(args, result, direwolf_file_result);
+    }
+
+    // The print phase renders the timings, so it cannot be part of them
+
+    print(args, result, volume_test_return_value, adjust_volume_results, direwolf_file_result);
+
+    // Only the command line run is timed, not the server refreshes
+
+    if (args.timings != nullptr)
+    {
+        args.timings->enabled = false;
+    }
+
+    int return_value = volume_test_return_value ? 0 : 1;
+
+    if (volume_test_return_value)
+    {
+        if (result.devices.size() == 0 && result.ports.size() == 0)
+        {
+           return_value = 1;
+        }
+    }
+    
+    if (!generate_direwolf_result)
+    {
+        return_value = 1;
+    }
+
+    if (!print_queries(args, result))
+    {
+        return_value = 1;
+    }
+
+    if (args.print_stats)
+    {
+        fmt::print(stderr, "{}", to_metrics_text());
+    }
+
+    run_server(args);
+
+    return return_value;
+}
+
+bool generate_direwolf_output_file(const args& args, const search_result& result, file_write_result& file_result)
+{
+    if (args.direwolf_output_file.empty())
+    {
+        return true;
+    }
+
+    std::string file_name = std::filesystem::absolute(args.direwolf_output_file).string();
+
+    if (result.devices.size() != 1)
+    {
+        return false;
+    }
+
+    const auto& audio_device = result.devices[0];
+
+    std::string lines;
+    lines += "# AUTO-GENERATED BY find_devices, DO NOT CHANGE\n";
+    lines += fmt::format("ADEVICE {}\n", audio_device.first.audio_device.plughw_id);
+    if (result.ports.size() == 1)
+    {
+        lines += fmt::format("PTT {} RTS\n", result.ports[0].first.name);
+    }
+    lines += "ACHANNELS 1\n";
+    lines += "CHANNEL 0\n";
+    lines += "DTMF\n";
+    lines += "MODEM 1200\n";
+    if (!args.direwolf_callsign.empty())
+    {
+        lines += fmt::format("MYCALL {}\n", args.direwolf_callsign);
+    }
+    else
+    {
+        lines += fmt::format("MYCALL N0CALL\n");
+    }
+    if (args.direwolf_agwport != -1)
+    {
+        lines += fmt::format("AGWPORT {}\n", args.direwolf_agwport);
+    }
+    if (args.direwolf_kissport != -1)
+    {
+        lines += fmt::format("KISSPORT {}", args.direwolf_kissport);
+    }
+
+    file_result.description = "direwolf_config";
+
+    return try_write_file_if_changed(file_name, lines + "\n", file_result);
+}
+
+void print_version()
+{
+    printf(
+        "find_devices - audio device and serial ports finding utility\n"
+        "version "
+        STRINGIFY(FIND_DEVICES_VERSION)
+#ifdef GIT_HASH
+        " "
+        STRINGIFY(GIT_HASH)
+#endif        
+        "\n"
+        "(C) 2023 Ion Todirel\n"
+        "\n");
+}
@@ -0,0 +1,401 @@
+// **************************************************************** //
+// find_devices - Audio device and serial ports search utility      // 
+// Version 0.1.0                                                    //
+// https://github.com/iontodirel/find_devices                       //
+// Copyright (c) 2023 Ion Todirel                                   //
+// **************************************************************** //
+//
+// find_devices_cli.hpp
+// The command line, server and daemon internals shared by the executable, the tests and the benchmarks.
+// 
+// MIT License
+// 
+// Copyright (c) 2022 Ion Todirel
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "find_devices.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <unordered_map>
+#include <string_view>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+#include <fmt/format.h>
+#include <fmt/color.h>
+#include <CivetServer.h>
+
+// **************************************************************** //
+//                                                                  //
+// UTILITIES                                                        //
+//                                                                  //
+// **************************************************************** //
+
+#define STR(x) #x
+#define STRINGIFY(x) STR(x)
+
+template <typename... Args>
+void print(bool enable_colors, const fmt::text_style& ts, fmt::format_string<Args...> fmt, Args&&... args)
+{
+    fmt::print(enable_colors ? ts : fmt::text_style(), fmt, std::forward<Args>(args)...);
+}
+
+// **************************************************************** //
+//                                                                  //
+// DATA TYPES                                                       //
+//                                                                  //
+// **************************************************************** //
+
+enum class included_devices;
+struct args;
+struct query;
+struct query_value;
+struct profile;
+struct file_write_result;
+
+struct query
+{
+    std::string name;
+    std::string expression;
+};
+
+enum class query_value_type
+{
+    null,
+    scalar,
+    boolean,
+    list,
+    object
+};
+
+struct query_value
+{
+    query_value_type type = query_value_type::null;
+    std::string text;
+    std::vector<query_value> items;
+    std::function<query_value(const std::string& field)> field;
+};
+
+enum class included_devices
+{
+    unknown = 0,
+    audio,
+    ports,
+    all
+};
+
+// A named search of a config file with profiles, see the PROFILES section
+
+struct profile
+{
+    std::string name;
+    audio_device_filter audio_filter;
+    serial_port_filter port_filter;
+    std::vector<audio_device_volume_set> volume_set;
+    enum search_mode search_mode = search_mode::independent;
+    enum included_devices included_devices = included_devices::all;
+};
+
+// The search options are shared with the library, everything else only applies to the command line and the server
+
+struct args : public search_options
+{
+    std::multimap<std::string, std::string> command_line_args;
+    bool verbose = true;
+    bool help = false;
+    bool use_json = false;
+    std::string output_file;
+    bool disable_write_file = false;
+    bool list_properties = false;
+    enum included_devices included_devices = included_devices::all;
+    std::string config_file = "config.json";
+    bool ignore_config = false;
+    bool disable_colors = false;
+    bool no_stdout = false;
+    bool command_line_has_errors = false;
+    std::string command_line_error = "";
+    bool show_version = false;
+    bool disable_volume_control = false;
+    bool test_volume_control = false;
+    bool probe_volume_control = false;
+    std::string direwolf_output_file;
+    std::string direwolf_callsign;
+    int direwolf_agwport = -1;
+    int direwolf_kissport = -1;
+    int server_port = 8088;
+    bool run_server = false;
+    std::string shared_memory_name;
+    std::vector<query> queries;
+    std::vector<profile> profiles;
+    bool print_stats = false;
+    std::string trace_file;
+    std::string test_data_file;
+    std::string record_file;
+    std::string replay_file;
+    double replay_time_scale = 1.0;
+    int worker_count = (int)default_worker_count;
+    bool run_daemon = false;
+    bool no_daemon = false;
+    std::string daemon_socket;
+    // The snapshot kept by the daemon, the search enumerates the devices if not set
+    std::shared_ptr<const device_snapshot> devices;
+    std::atomic<bool> keep_running {true};
+};
+
+struct file_write_result
+{
+    std::string path;
+    std::string description;
+    bool success = false;
+    bool changed = false;
+};
+
+// **************************************************************** //
+//                                                                  //
+// JSON                                                             //
+//                                                                  //
+// **************************************************************** //
+
+std::string to_json(const args& args, const search_result& result);
+std::string to_json(const args& args, const search_result& result, const std::vector<audio_device_unique_volume_set>& audio_set_result, bool volume_control_return_value);
+std::string to_json(const std::vector<file_write_result>& files);
+std::string to_json(run_timings& timings);
+std::string to_json(const std::vector<audio_device_channel_volume_set>& sets, const std::vector<std::pair<int, int>>& hw_ids, bool result);
+
+// **************************************************************** //
+//                                                                  //
+// TEST DATA                                                        //
+//                                                                  //
+// **************************************************************** //
+
+bool try_read_test_data(const std::string& path, fake_device_backend& backend);
+
+// **************************************************************** //
+//                                                                  //
+// DEVICE RECORDING                                                 //
+//                                                                  //
+// **************************************************************** //
+
+bool try_read_device_recording(const std::string& path, replay_device_backend& backend);
+
+// **************************************************************** //
+//                                                                  //
+// COMMAND LINE                                                     //
+//                                                                  //
+// **************************************************************** //
+
+bool try_parse_command_line(int argc, char* argv[], args& args);
+
+// **************************************************************** //
+//                                                                  //
+// SETTINGS                                                         //
+//                                                                  //
+// **************************************************************** //
+
+void read_settings(args& args);
+void read_settings(args& args, const nlohmann::json& j);
+
+// **************************************************************** //
+//                                                                  //
+// HTTP AND WEB SOCKER SERVER                                       //
+//                                                                  //
+// **************************************************************** //
+
+// Concurrent calls with the same key share one computation, every caller receives its result
+// Exceptions thrown by the computation are rethrown to every caller
+
+template<typename T>
+class single_flight
+{
+public:
+    T run(const std::string& key, std::function<T()> compute)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        auto it = in_flight.find(key);
+        if (it != in_flight.end())
+        {
+            std::shared_future<T> future = it->second;
+            lock.unlock();
+            return future.get();
+        }
+
+        std::promise<T> promise;
+        std::shared_future<T> future = promise.get_future().share();
+        in_flight.emplace(key, future);
+
+        lock.unlock();
+
+        try
+        {
+            promise.set_value(compute());
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+
+        lock.lock();
+        in_flight.erase(key);
+        lock.unlock();
+
+        return future.get();
+    }
+
+private:
+    std::mutex mutex;
+    std::map<std::string, std::shared_future<T>> in_flight;
+};
+
+// Allows looking up string keys with a std::string_view without allocating
+
+struct string_hash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const
+    {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+// The results served by the HTTP server, rendered once per refresh
+// Request threads only read the current snapshot, the refresher replaces it
+// The generation only changes when the content changes, and is used to build the ETag
+
+struct server_snapshot
+{
+    std::shared_ptr<const device_snapshot> devices;
+    search_result result;
+    search_result all_result;
+    std::unordered_map<std::string, size_t, string_hash, std::equal_to<>> all_devices_index;
+    std::string devices_json;
+    std::string all_devices_json;
+    uint64_t content_hash = 0;
+    uint64_t generation = 0;
+    std::string etag;
+};
+
+// A web socket client, the write mutex is held while writing, and a closed client is not written to anymore
+
+struct websocket_client
+{
+    mg_connection* conn = nullptr;
+    std::set<std::string> subscriptions;
+    std::mutex write_mutex;
+    bool closed = false;
+};
+
+struct server_state
+{
+    // The mutex only guards the replacement of the pointer, see get_server_snapshot
+    std::shared_ptr<const server_snapshot> snapshot;
+    std::mutex snapshot_mutex;
+    std::string instance_id;
+    single_flight<std::string> process_devices_flight;
+
+    // Snapshots are published by the refresher, and after volume changes by the request threads and the mixer watcher
+    // The mutex keeps the generations in order, the shared memory is owned by run_server
+    std::mutex publish_mutex;
+    shared_snapshot* shared_memory = nullptr;
+
+    // Web socket clients and the devices they subscribed to, a client without subscriptions receives every event
+    // The mutex only guards the clients and their subscriptions, the messages are written outside of it
+    std::mutex websocket_mutex;
+    std::map<mg_connection*, std::shared_ptr<websocket_client>> websocket_clients;
+};
+
+// Serves GET /devices and /devices/all from the current snapshot, and runs POST /devices searches
+
+struct DevicesHttpHandler : public CivetHandler
+{
+    DevicesHttpHandler(const args& args, server_state& state);
+
+    bool handleGet(CivetServer *server, struct mg_connection *conn) override;
+    bool handlePost(CivetServer *server, struct mg_connection *conn) override;
+
+    const struct args& args;
+    server_state& state;
+    metrics_histogram& request_metrics;
+};
+
+std::string process_devices_to_json(const nlohmann::json& j, const device_snapshot& devices);
+int run_server(const args& args);
+void publish_server_snapshot(const args& args, std::shared_ptr<const device_snapshot> devices, server_state& state, shared_snapshot& shared_memory);
+std::shared_ptr<const server_snapshot> get_server_snapshot(server_state& state);
+
+// **************************************************************** //
+//                                                                  //
+// DAEMON                                                           //
+//                                                                  //
+// **************************************************************** //
+
+bool can_run_in_daemon(const args& args);
+bool try_run_in_daemon(const args& args, int argc, char* argv[], int& return_value);
+int run_daemon(const args& args);
+
+// **************************************************************** //
+//                                                                  //
+// PROFILES                                                         //
+//                                                                  //
+// **************************************************************** //
+
+struct profile_result
+{
+    std::string name;
+    enum included_devices included_devices = included_devices::all;
+    search_result result;
+    std::vector<audio_device_unique_volume_set> volume_sets;
+    bool volume_test_result = true;
+};
+
+// The id is the card of an audio device, as hw:<card>, because the devices of a card share one mixer,
+// or the name of a serial port
+
+struct profile_conflict
+{
+    std::string id;
+    std::vector<std::string> profiles;
+};
+
+int process_profiles(const args& args);
+std::vector<profile_result> search_profiles(const args& args, const device_snapshot& devices);
+std::vector<profile_conflict> find_profile_conflicts(const std::vector<profile_result>& results);
+void adjust_profiles_volume(const args& args, const std::vector<profile_conflict>& conflicts, std::vector<profile_result>& results);
+
+// **************************************************************** //
+//                                                                  //
+// MAIN AND HIGH LEVEL FUNCTIONS                                    //
+//                                                                  //
+// **************************************************************** //
+
+void print_usage();
+void print_version();
+bool output_uses_descriptions(const args& args);
+int process_devices(const args& args);
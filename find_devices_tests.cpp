@@ -0,0 +1,546 @@
+// **************************************************************** //
+// find_devices - Audio device and serial ports search utility      //
+// Version 0.1.0                                                    //
+// https://github.com/iontodirel/find_devices                       //
+// Copyright (c) 2023 Ion Todirel                                   //
+// **************************************************************** //
+//
+// find_devices_tests.cpp
+// Behaviour tests of the patterns, profiles and device recordings against the fake backend.
+//
+// MIT License
+//
+// Copyright (c) 2022 Ion Todirel
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "find_devices_cli.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <filesystem>
+
+#include <cxxopts.hpp>
+
+// **************************************************************** //
+//                                                                  //
+// DATA TYPES                                                       //
+//                                                                  //
+// **************************************************************** //
+
+struct test_options
+{
+    std::string test_data_file;
+    std::string filter;
+};
+
+// Every test runs against a fresh fake backend loaded from the test data, see examples/test_data.json
+
+struct test_context
+{
+    const test_options& options;
+    std::shared_ptr<fake_device_backend> backend;
+    int failures = 0;
+};
+
+struct test_case
+{
+    std::string name;
+    std::function<void(test_context&)> run;
+};
+
+// A failed check is reported and counted, and the test continues with the next check
+
+#define CHECK(context, condition) check(context, (condition), #condition, __LINE__)
+
+// **************************************************************** //
+//                                                                  //
+// TESTS                                                            //
+//                                                                  //
+// **************************************************************** //
+
+void check(test_context& context, bool condition, const char* expression, int line);
+bool match(const std::string& pattern, std::string_view value);
+void init_test_args(args& args);
+void test_substring_patterns(test_context& context);
+void test_glob_patterns(test_context& context);
+void test_regex_patterns(test_context& context);
+void test_pattern_cache(test_context& context);
+void test_search_filters(test_context& context);
+void test_profiles(test_context& context);
+void test_profile_conflicts(test_context& context);
+void test_profile_volume(test_context& context);
+void test_record_replay(test_context& context);
+bool try_parse_test_command_line(int argc, char* argv[], test_options& options);
+
+void check(test_context& context, bool condition, const char* expression, int line)
+{
+    if (!condition)
+    {
+        fmt::print(stderr, "    line {}: {}\n", line, expression);
+        context.failures++;
+    }
+}
+
+bool match(const std::string& pattern, std::string_view value)
+{
+    std::shared_ptr<const compiled_pattern> compiled;
+    return try_compile_pattern(pattern, compiled) && match_pattern(*compiled, value);
+}
+
+void init_test_args(args& args)
+{
+    args.ignore_config = true;
+    args.no_stdout = true;
+    args.disable_write_file = true;
+}
+
+void test_substring_patterns(test_context& context)
+{
+    CHECK(context, match("", ""));
+    CHECK(context, match("", "USB PnP Sound Device"));
+    CHECK(context, match("pnp sound", "USB PnP Sound Device"));
+    CHECK(context, match("PNP SOUND", "USB PnP Sound Device"));
+    CHECK(context, !match("PnP Audio", "USB PnP Sound Device"));
+    CHECK(context, !match("Device ", "USB PnP Sound Device"));
+}
+
+void test_glob_patterns(test_context& context)
+{
+    // A glob matches the whole value, case insensitive
+
+    CHECK(context, match("glob:USB Audio*", "USB Audio Device"));
+    CHECK(context, match("glob:USB Audio*", "usb audio"));
+    CHECK(context, !match("glob:USB Audio*", "My USB Audio"));
+    CHECK(context, !match("glob:USB Audio", "USB Audio Device"));
+
+    CHECK(context, match("glob:hw:?,0", "hw:2,0"));
+    CHECK(context, !match("glob:hw:?,0", "hw:12,0"));
+    CHECK(context, !match("glob:hw:?,0", "hw:,0"));
+
+    CHECK(context, match("glob:*", ""));
+    CHECK(context, match("glob:*", "anything"));
+    CHECK(context, match("glob:", ""));
+    CHECK(context, !match("glob:", "anything"));
+    CHECK(context, match("glob:**x", "x"));
+
+    // The match backtracks to the last star when a later part fails
+
+    CHECK(context, match("glob:*PnP*Device", "USB PnP Sound Device"));
+    CHECK(context, match("glob:a*b*c", "aXbYbZc"));
+    CHECK(context, !match("glob:a*b*c", "aXbYbZ"));
+    CHECK(context, match("glob:*ab", "aab"));
+    CHECK(context, match("glob:*a?c", "abcaxc"));
+    CHECK(context, !match("glob:*a?c", "abcaxd"));
+}
+
+void test_regex_patterns(test_context& context)
+{
+    CHECK(context, match("regex:^USB Audio.*", "USB Audio Device"));
+    CHECK(context, match("regex:^usb audio", "USB Audio Device"));
+    CHECK(context, !match("regex:^USB Audio.*", "My USB Audio"));
+    CHECK(context, match("regex:Audio", "My USB Audio"));
+    CHECK(context, match("regex:hw:[0-9]+,0$", "hw:12,0"));
+
+    std::shared_ptr<const compiled_pattern> compiled;
+    CHECK(context, !try_compile_pattern("regex:(", compiled));
+    CHECK(context, compiled == nullptr);
+}
+
+void test_pattern_cache(test_context& context)
+{
+    // The same pattern text is compiled once and shared, the text and its prefix make the key
+
+    std::shared_ptr<const compiled_pattern> first;
+    std::shared_ptr<const compiled_pattern> second;
+    std::shared_ptr<const compiled_pattern> other;
+    CHECK(context, try_compile_pattern("glob:cache test*", first));
+    CHECK(context, try_compile_pattern("glob:cache test*", second));
+    CHECK(context, try_compile_pattern("cache test*", other));
+    CHECK(context, first != nullptr && first == second);
+    CHECK(context, other != nullptr && other != first);
+    CHECK(context, first->type == pattern_type::glob && first->text == "cache test*");
+    CHECK(context, other->type == pattern_type::substring);
+
+    // An invalid regular expression is not cached, and fails every time
+
+    std::shared_ptr<const compiled_pattern> invalid;
+    CHECK(context, !try_compile_pattern("regex:[", invalid));
+    CHECK(context, !try_compile_pattern("regex:[", invalid));
+
+    // The cache is cleared once full, the patterns in use are kept alive by their owners
+
+    for (int i = 0; i < 512; i++)
+    {
+        std::shared_ptr<const compiled_pattern> filler;
+        try_compile_pattern(fmt::format("cache filler {}", i), filler);
+    }
+
+    std::shared_ptr<const compiled_pattern> recompiled;
+    CHECK(context, try_compile_pattern("glob:cache test*", recompiled));
+    CHECK(context, recompiled != nullptr && recompiled != first);
+    CHECK(context, match_pattern(*first, "Cache Test Device") && match_pattern(*recompiled, "Cache Test Device"));
+
+    // The compiled filters share the cached patterns
+
+    audio_device_filter filter;
+    filter.name_filter = "glob:USB*";
+    compiled_audio_device_filter compiled_first;
+    compiled_audio_device_filter compiled_second;
+    CHECK(context, try_compile_filter(filter, compiled_first) && try_compile_filter(filter, compiled_second));
+    CHECK(context, compiled_first.name == compiled_second.name);
+    CHECK(context, compiled_first.description == compiled_second.description);
+}
+
+void test_search_filters(test_context& context)
+{
+    args args;
+    init_test_args(args);
+
+    args.audio_filter.name_filter = "glob:USB*Device";
+    search_result result = search(args);
+    CHECK(context, result.devices.size() == 1);
+    CHECK(context, result.devices.size() == 1 && result.devices[0].first.audio_device.hw_id == "hw:2,0");
+
+    args.audio_filter.name_filter = "regex:^HDA";
+    result = search(args);
+    CHECK(context, result.devices.size() == 2);
+    for (const auto& d : result.devices)
+        CHECK(context, d.first.audio_device.card_id == 0);
+
+    args.audio_filter.name_filter = "glob:HDA";
+    result = search(args);
+    CHECK(context, result.devices.empty());
+
+    args.audio_filter.name_filter = "";
+    args.port_filter.description_filter = "glob:cp2102n*";
+    result = search(args);
+    CHECK(context, result.ports.size() == 1 && result.ports[0].first.name == "/dev/ttyUSB1");
+}
+
+void test_profiles(test_context& context)
+{
+    // The profiles are read from the config file, a profile without a name is named by its position
+
+    nlohmann::json j = nlohmann::json::parse(R"({
+        "search_mode": "independent",
+        "profiles": [
+            { "name": "vhf", "search_criteria": { "port": { "desc": "CP2102N" } }, "search_mode": "port-siblings" },
+            { "included_devices": "audio", "search_criteria": { "audio": { "name": "glob:HDA*" } } }
+        ]
+    })");
+
+    args args;
+    init_test_args(args);
+    read_settings(args, j);
+
+    CHECK(context, args.profiles.size() == 2);
+    if (args.profiles.size() != 2)
+        return;
+
+    CHECK(context, args.profiles[0].name == "vhf");
+    CHECK(context, args.profiles[0].search_mode == search_mode::port_siblings);
+    CHECK(context, args.profiles[0].included_devices == included_devices::all);
+    CHECK(context, args.profiles[1].name == "2");
+    CHECK(context, args.profiles[1].search_mode == search_mode::independent);
+    CHECK(context, args.profiles[1].included_devices == included_devices::audio);
+
+    // Every profile is searched against the same snapshot
+
+    device_snapshot devices = get_device_snapshot(args);
+    std::vector<profile_result> results = search_profiles(args, devices);
+
+    CHECK(context, results.size() == 2);
+    if (results.size() != 2)
+        return;
+
+    CHECK(context, results[0].name == "vhf");
+    CHECK(context, results[0].result.ports.size() == 1);
+    CHECK(context, results[0].result.devices.size() == 1 && results[0].result.devices[0].first.audio_device.card_id == 2);
+    CHECK(context, results[1].result.devices.size() == 2);
+    CHECK(context, find_profile_conflicts(results).empty());
+
+    // Duplicate names fail the run before searching
+
+    args.profiles[1].name = "vhf";
+    CHECK(context, process_profiles(args) == 1);
+}
+
+void test_profile_conflicts(test_context& context)
+{
+    args args;
+    init_test_args(args);
+
+    profile usb;
+    usb.name = "usb";
+    usb.audio_filter.name_filter = "glob:USB*";
+    usb.port_filter.name_filter = "glob:none";
+    usb.included_devices = included_devices::audio;
+
+    profile pnp;
+    pnp.name = "pnp";
+    pnp.port_filter.description_filter = "CP2102N";
+    pnp.search_mode = search_mode::port_siblings;
+
+    profile ports;
+    ports.name = "ports";
+    ports.port_filter.name_filter = "ttyUSB1";
+    ports.included_devices = included_devices::ports;
+
+    args.profiles = { usb, pnp, ports };
+
+    device_snapshot devices = get_device_snapshot(args);
+    std::vector<profile_result> results = search_profiles(args, devices);
+    std::vector<profile_conflict> conflicts = find_profile_conflicts(results);
+
+    // The audio devices conflict by card, the ports by name, and the conflicts are ordered by id
+
+    CHECK(context, conflicts.size() == 2);
+    if (conflicts.size() != 2)
+        return;
+
+    CHECK(context, conflicts[0].id == "/dev/ttyUSB1");
+    CHECK(context, (conflicts[0].profiles == std::vector<std::string>{ "pnp", "ports" }));
+    CHECK(context, conflicts[1].id == "hw:2");
+    CHECK(context, (conflicts[1].profiles == std::vector<std::string>{ "usb", "pnp" }));
+
+    // A profile only claims the device types it includes
+
+    args.profiles[0].included_devices = included_devices::ports;
+    results = search_profiles(args, devices);
+    conflicts = find_profile_conflicts(results);
+    CHECK(context, conflicts.size() == 1 && conflicts[0].id == "/dev/ttyUSB1");
+
+    // Every profile matching a conflicted device makes the run fail
+
+    args.profiles = { usb, pnp, ports };
+    CHECK(context, process_profiles(args) == 1);
+}
+
+void test_profile_volume(test_context& context)
+{
+    // The volume of a card claimed by two profiles is left as it is, the other cards are set
+
+    nlohmann::json j = nlohmann::json::parse(R"({
+        "included_devices": "audio",
+        "profiles": [
+            { "name": "hda", "search_criteria": { "audio": { "name": "glob:HDA*" } }, "volume_control": { "controls": [ { "name": "Master", "playback_value_percent": "25" } ] } },
+            { "name": "usb", "search_criteria": { "audio": { "name": "glob:USB*" } }, "volume_control": { "controls": [ { "name": "Speaker", "playback_value_percent": "25" } ] } },
+            { "name": "pnp", "search_criteria": { "audio": { "desc": "C-Media" } } }
+        ]
+    })");
+
+    args args;
+    init_test_args(args);
+    read_settings(args, j);
+
+    device_snapshot devices = get_device_snapshot(args);
+    std::vector<profile_result> results = search_profiles(args, devices);
+    std::vector<profile_conflict> conflicts = find_profile_conflicts(results);
+
+    CHECK(context, conflicts.size() == 1 && conflicts[0].id == "hw:2");
+
+    adjust_profiles_volume(args, conflicts, results);
+
+    CHECK(context, results.size() == 3);
+    if (results.size() != 3)
+        return;
+
+    CHECK(context, results[0].volume_sets.size() > 0);
+    CHECK(context, results[1].volume_sets.empty());
+
+    for (const fake_audio_card& card : context.backend->cards)
+    {
+        for (const audio_device_volume_control& control : card.controls)
+        {
+            for (const audio_device_channel& channel : control.channels)
+            {
+                if (card.card_id == 0 && control.name == "Master")
+                    CHECK(context, channel.volume_percent == 25);
+                if (card.card_id == 2 && control.name == "Speaker")
+                    CHECK(context, channel.volume == 100);
+            }
+        }
+    }
+}
+
+void test_record_replay(test_context& context)
+{
+    // A recording of the fake backend replays the same devices, without the fake backend
+
+    auto recording = std::make_shared<recording_device_backend>(context.backend);
+    set_device_backend(recording);
+
+    args args;
+    init_test_args(args);
+    args.include_descriptions = true;
+
+    device_snapshot recorded_devices = get_device_snapshot(args);
+    search_result recorded_result = search(args, recorded_devices);
+
+    audio_device_info usb_device;
+    CHECK(context, get_device_backend()->try_get_audio_device(2, 0, usb_device));
+
+    std::vector<audio_device_channel_volume_set> sets(1);
+    sets[0].control_name = "Speaker";
+    sets[0].channel = audio_device_channel_id::front_left;
+    sets[0].channel_type = audio_device_type::playback;
+    sets[0].volume_percent = 40;
+    CHECK(context, get_device_backend()->try_set_audio_device_volume_percent(2, sets, true));
+
+    std::string path = (std::filesystem::temp_directory_path() / fmt::format("find_devices_tests_{}.json", getpid())).string();
+
+    CHECK(context, try_write_device_recording(path, *recording));
+
+    auto replay = std::make_shared<replay_device_backend>();
+    replay->time_scale = 0;
+    CHECK(context, try_read_device_recording(path, *replay));
+    std::filesystem::remove(path);
+
+    CHECK(context, replay->calls.size() == recording->calls.size());
+
+    set_device_backend(replay);
+
+    device_snapshot replayed_devices = get_device_snapshot(args);
+    search_result replayed_result = search(args, replayed_devices);
+
+    CHECK(context, replayed_devices.devices.size() == recorded_devices.devices.size());
+    CHECK(context, replayed_devices.ports.size() == recorded_devices.ports.size());
+    CHECK(context, to_json(args, replayed_result) == to_json(args, recorded_result));
+
+    audio_device_info replayed_device;
+    CHECK(context, get_device_backend()->try_get_audio_device(2, 0, replayed_device));
+    CHECK(context, replayed_device.hw_id == usb_device.hw_id && replayed_device.name == usb_device.name);
+
+    std::vector<audio_device_channel_volume_set> replayed_sets(1);
+    replayed_sets[0] = sets[0];
+    replayed_sets[0].status = audio_device_volume_set_status::not_applied;
+    CHECK(context, get_device_backend()->try_set_audio_device_volume_percent(2, replayed_sets, true));
+    CHECK(context, replayed_sets[0].status == sets[0].status);
+    CHECK(context, replayed_sets[0].status == audio_device_volume_set_status::applied);
+
+    // The calls that were not recorded fail
+
+    audio_device_info missing;
+    CHECK(context, !get_device_backend()->try_get_audio_device(9, 0, missing));
+}
+
+bool try_parse_test_command_line(int argc, char* argv[], test_options& options)
+{
+    cxxopts::Options cxxopts_options("find_devices_tests", "Behaviour tests of find_devices against the fake backend");
+
+    cxxopts_options.add_options()
+        ("test-data", "The test data served by the fake backend, see examples/test_data.json", cxxopts::value<std::string>()->default_value(""))
+        ("filter", "Only run the tests with names containing the filter", cxxopts::value<std::string>()->default_value(""))
+        ("h,help", "Print usage");
+
+    try
+    {
+        auto result = cxxopts_options.parse(argc, argv);
+
+        if (result.count("help") > 0)
+        {
+            printf("%s\n", cxxopts_options.help().c_str());
+            return false;
+        }
+
+        options.test_data_file = result["test-data"].as<std::string>();
+        options.filter = result["filter"].as<std::string>();
+    }
+    catch (const std::exception& e)
+    {
+        fmt::print(stderr, "{}\n", e.what());
+        return false;
+    }
+
+    if (options.test_data_file.empty())
+    {
+        fmt::print(stderr, "The --test-data option is required\n");
+        return false;
+    }
+
+    return true;
+}
+
+// **************************************************************** //
+//                                                                  //
+// MAIN                                                             //
+//                                                                  //
+// **************************************************************** //
+
+int main(int argc, char* argv[])
+{
+    test_options options;
+
+    if (!try_parse_test_command_line(argc, argv, options))
+    {
+        return 1;
+    }
+
+    std::vector<test_case> tests = {
+        { "substring_patterns", test_substring_patterns },
+        { "glob_patterns", test_glob_patterns },
+        { "regex_patterns", test_regex_patterns },
+        { "pattern_cache", test_pattern_cache },
+        { "search_filters", test_search_filters },
+        { "profiles", test_profiles },
+        { "profile_conflicts", test_profile_conflicts },
+        { "profile_volume", test_profile_volume },
+        { "record_replay", test_record_replay },
+    };
+
+    int failed_tests = 0;
+    int run_tests = 0;
+
+    for (const test_case& test : tests)
+    {
+        if (!options.filter.empty() && test.name.find(options.filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        test_context context{ options, std::make_shared<fake_device_backend>() };
+
+        if (!try_read_test_data(options.test_data_file, *context.backend))
+        {
+            fmt::print(stderr, "Failed to read test data file {}\n", options.test_data_file);
+            return 1;
+        }
+
+        set_device_backend(context.backend);
+
+        test.run(context);
+
+        set_device_backend(nullptr);
+
+        printf("%s %s\n", context.failures == 0 ? "passed" : "FAILED", test.name.c_str());
+
+        run_tests++;
+        if (context.failures > 0)
+        {
+            failed_tests++;
+        }
+    }
+
+    printf("%d of %d tests passed\n", run_tests - failed_tests, run_tests);
+
+    return failed_tests == 0 ? 0 : 1;
+}